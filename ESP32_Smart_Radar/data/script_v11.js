@@ -33,6 +33,7 @@ async function initData() {
     try { vendors = await (await fetch('/vendors.json')).json(); } catch (e) { }
     await fetchSurveillanceStatus();
     fetchData();
+    initPush();
     setInterval(fetchData, 3000);
 }
 
@@ -61,18 +62,58 @@ async function toggleSurveillance() {
     updateSurveillanceButton();
 }
 
+// Incremental device list: the firmware only returns what changed since
+// `devSeq` (plus removed MACs), or the full list when `full` is set.
+let devSeq = null;
+const devState = new Map();
+
+// Live push (Server-Sent Events): while connected, device changes and
+// intrusion alerts arrive as events and only the whitelist is polled.
+let pushOpen = false;
+
+function initPush() {
+    if (!window.EventSource) return;
+    const es = new EventSource('/api/events');
+    es.onopen = () => { pushOpen = true; };
+    es.onerror = () => { pushOpen = false; };
+    es.addEventListener('upsert', e => { const d = JSON.parse(e.data); devState.set(d.mac, d); });
+    es.addEventListener('expire', e => devState.delete(JSON.parse(e.data)));
+    es.addEventListener('sync', e => { devSeq = JSON.parse(e.data).seq; renderDeviceState(); });
+    es.addEventListener('resync', () => fetchDevices().catch(err => console.error("Fetch error:", err)));
+    es.addEventListener('alert', e => {
+        const a = JSON.parse(e.data);
+        if (surveillanceActive && !alertedOnClient.has(a.mac)) {
+            alertedOnClient.add(a.mac);
+            showToast(a.mac, a.name || 'Appareil Inconnu');
+        }
+    });
+}
+
+async function fetchDevices() {
+    const devUrl = devSeq === null ? '/api/devices' : `/api/devices?since=${devSeq}`;
+    const devData = await (await fetch(devUrl)).json();
+    if (devData.version) document.getElementById('firmware-version').innerText = devData.version;
+    if (devData.full !== false) devState.clear();
+    (devData.removed || []).forEach(mac => devState.delete(mac));
+    (devData.devices || []).forEach(d => devState.set(d.mac, d));
+    devSeq = devData.seq !== undefined ? devData.seq : null;
+    renderDeviceState();
+}
+
+function renderDeviceState() {
+    const all = [...devState.values()];
+    if (initialMacs === null) {
+        initialMacs = new Set(all.filter(d => !d.whitelisted).map(d => d.mac));
+    }
+    renderDevices(all.filter(d => !d.whitelisted));
+}
+
 async function fetchData() {
     try {
-        const [wlData, devData] = await Promise.all([
+        const [wlData] = await Promise.all([
             fetch('/api/whitelist').then(r => r.json()),
-            fetch('/api/devices').then(r => r.json())
+            pushOpen ? null : fetchDevices()
         ]);
-        if (devData.version) document.getElementById('firmware-version').innerText = devData.version;
-        const all = devData.devices || [];
-        if (initialMacs === null) {
-            initialMacs = new Set(all.filter(d => !d.whitelisted).map(d => d.mac));
-        }
-        renderDevices(all.filter(d => !d.whitelisted));
         renderWhitelist(wlData);
     } catch (e) { console.error("Fetch error:", e); }
 }
@@ -197,7 +238,9 @@ function renderDevices(devices) {
         const intrusClass = (surveillanceActive && alertedOnClient.has(dev.mac)) ? ' intrus' : '';
         const displayName = dev.gattName ? `🔗 ${dev.gattName}`
             : (dev.name && dev.name !== 'Unknown' ? dev.name : 'Appareil Inconnu');
-        const pct = Math.min(Math.max((dev.rssi + 100) / 60 * 100, 0), 100);
+        const rssi = Math.round(dev.rssiSmooth ?? dev.rssi);
+        const rssiText = dev.distanceM != null ? `${rssi} dBm · ~${dev.distanceM} m` : `${rssi} dBm`;
+        const pct = Math.min(Math.max((rssi + 100) / 60 * 100, 0), 100);
         const col = pct > 60 ? 'var(--success)' : pct > 30 ? '#eab308' : 'var(--danger)';
         const txHtml = (dev.txPower && dev.txPower !== -999) ? `<div class="tx-power">Tx: ${dev.txPower} dBm</div>` : "";
         const badges = buildBadgesHtml(dev);
@@ -206,7 +249,7 @@ function renderDevices(devices) {
             const c = deviceElements.get(dev.mac);
             c.el.querySelector('.device-title').innerHTML = `<b>${displayName}</b>`;
             c.el.querySelector('.badges-container').innerHTML = badges;
-            c.el.querySelector('.rssi span').textContent = `${dev.rssi} dBm`;
+            c.el.querySelector('.rssi span').textContent = rssiText;
             c.el.querySelector('.rssi-fill').style.cssText = `width:${pct}%;background:${col}`;
             if (intrusClass) c.el.classList.add('intrus');
         } else {
@@ -217,7 +260,7 @@ function renderDevices(devices) {
                 <div class="device-meta"><div class="device-title"><b>${displayName}</b></div>
                 <div class="badges-container">${badges}</div></div></div>
                 <div class="device-right">${txHtml}
-                <div class="rssi"><span>${dev.rssi} dBm</span>
+                <div class="rssi"><span>${rssiText}</span>
                 <div class="rssi-bar"><div class="rssi-fill" style="width:${pct}%;background:${col}"></div></div></div>
                 <button class="btn btn-primary" style="margin-top:10px;width:100%;" onclick="addToWhitelist('${dev.mac}')">✅ Autoriser</button>
                 </div>`;
@@ -1,72 +1,243 @@
 import urllib.request
 import json
 import re
+import sys
 
 URL = "https://raw.githubusercontent.com/silverwind/oui-data/master/index.json"
 OUTPUT_FILE = "src/progmem_vendors.h"
+MAX_VENDOR_LEN = 30
+EYTZINGER_RAM_LEVELS = 9  # top 2^9 - 1 nodes mirrored in RAM (~2 KB)
 
-print("Downloading JSON database from silverwind/oui-data...")
-req = urllib.request.Request(URL, headers={'User-Agent': 'Mozilla/5.0'})
-response = urllib.request.urlopen(req)
-data = json.loads(response.read().decode('utf-8'))
-
-print("Parsing the database and resolving to 24-bit integers...")
-vendors = []
-added_prefixes = set()
-
-for prefix, company in data.items():
-    clean_prefix = prefix.replace(":", "").replace("-", "").upper()
-    p = clean_prefix[0:6]
-    if len(p) == 6:
-        try:
-            mac_int = int(p, 16)
-            if mac_int not in added_prefixes:
-                safe_company = company.replace('"', '\\"').replace("\n", "").replace("\\", "").strip()
-                if len(safe_company) > 30:
-                    safe_company = safe_company[:27] + "..."
-                    
-                vendors.append((mac_int, safe_company))
-                added_prefixes.add(mac_int)
-        except ValueError:
-            pass
+# Usage:
+#   python generate_oui_header.py                 -> download the OUI database
+#   python generate_oui_header.py --from-header   -> rebuild from the current
+#       src/progmem_vendors.h (legacy {prefix, "vendor"} table or packed
+#       format), e.g. to change the layout offline with identical lookups.
+
+
+def load_from_url():
+    print("Downloading JSON database from silverwind/oui-data...")
+    req = urllib.request.Request(URL, headers={'User-Agent': 'Mozilla/5.0'})
+    response = urllib.request.urlopen(req)
+    data = json.loads(response.read().decode('utf-8'))
+
+    print("Parsing the database and resolving to 24-bit integers...")
+    vendors = {}
+    for prefix, company in data.items():
+        clean_prefix = prefix.replace(":", "").replace("-", "").upper()
+        p = clean_prefix[0:6]
+        if len(p) == 6:
+            try:
+                mac_int = int(p, 16)
+            except ValueError:
+                continue
+            if mac_int not in vendors:
+                safe_company = company.replace("\n", "").strip()
+                if len(safe_company) > MAX_VENDOR_LEN:
+                    safe_company = safe_company[:MAX_VENDOR_LEN - 3] + "..."
+                vendors[mac_int] = safe_company
+    return vendors
+
+
+def unescape_c(s):
+    return re.sub(r'\\(.)', lambda m: {'n': '\n', '0': ''}.get(m.group(1), m.group(1)), s)
+
+
+def load_from_header(path):
+    print(f"Reading existing table from {path}...")
+    with open(path, encoding='utf-8') as f:
+        content = f.read()
+    vendors = {}
+    legacy = re.findall(r'\{0x([0-9A-Fa-f]{6}), "((?:[^"\\]|\\.)*)"\}', content)
+    if legacy:
+        for prefix, company in legacy:
+            vendors[int(prefix, 16)] = unescape_c(company)
+        return vendors
+    pool = [unescape_c(s) for s in re.findall(r'^    "((?:[^"\\]|\\.)*)\\0"', content, re.M)]
+    prefixes = re.search(r'oui_prefixes\[\] PROGMEM = \{(.*?)\};', content, re.S).group(1)
+    prefix_bytes = [int(b, 16) for b in re.findall(r'0x([0-9A-F]{2})', prefixes)]
+    indexes = re.search(r'oui_vendor_index\[\] PROGMEM = \{(.*?)\};', content, re.S).group(1)
+    for i, idx in enumerate(re.findall(r'\d+', indexes)):
+        b = prefix_bytes[3 * i:3 * i + 3]
+        vendors[(b[0] << 16) | (b[1] << 8) | b[2]] = pool[int(idx)]
+    return vendors
+
+
+def c_string(s):
+    out = ""
+    for ch in s:
+        if ch in '"\\':
+            out += "\\" + ch
+        elif ch == "?":
+            out += "\\?"  # avoid trigraphs
+        else:
+            out += ch
+    return out
+
+
+def eytzinger_order(items):
+    # Breadth-first layout of the implicit search tree: node k (1-based)
+    # has children 2k and 2k+1, so the top levels share a few cache lines.
+    out = [None] * len(items)
+    it = iter(items)
+
+    def fill(k):
+        if k <= len(items):
+            fill(2 * k)
+            out[k - 1] = next(it)
+            fill(2 * k + 1)
+    fill(1)
+    return out
+
+
+def wrap(items, per_line):
+    lines = []
+    for i in range(0, len(items), per_line):
+        lines.append("    " + ", ".join(items[i:i + per_line]) + ",")
+    return "\n".join(lines)
+
+
+if len(sys.argv) > 1 and sys.argv[1] == "--from-header":
+    vendors = load_from_header(OUTPUT_FILE)
+else:
+    vendors = load_from_url()
 
 # Sort vendors by MAC integer value for binary search
-vendors.sort(key=lambda x: x[0])
+entries = sorted(vendors.items())
+
+# Deduplicate vendor names into a string pool, in first-use order
+pool_index = {}
+pool = []
+for _, company in entries:
+    if company not in pool_index:
+        pool_index[company] = len(pool)
+        pool.append(company)
+assert len(pool) <= 0xFFFF, "vendor index no longer fits in 16 bits"
+
+offsets = []
+pos = 0
+for company in pool:
+    offsets.append(pos)
+    pos += len(company.encode('utf-8')) + 1
+pool_bytes = pos
+
+print(f"Generating C++ Header file with {len(entries)} unique OUI entries "
+      f"and {len(pool)} distinct vendor names...")
+
 
-print(f"Generating C++ Header file with {len(vendors)} unique OUI entries...")
+def prefix_bytes(mac):
+    return f"0x{(mac >> 16) & 0xFF:02X}, 0x{(mac >> 8) & 0xFF:02X}, 0x{mac & 0xFF:02X}"
 
-header_content = """#ifndef PROGMEM_VENDORS_H
+
+sys.setrecursionlimit(10000)
+eytzinger = eytzinger_order(entries)
+ram_nodes = min(len(entries), (1 << EYTZINGER_RAM_LEVELS) - 1)
+
+prefix_items = [prefix_bytes(mac) for mac, _ in entries]
+index_items = [str(pool_index[company]) for _, company in entries]
+eyt_prefix_items = [prefix_bytes(mac) for mac, _ in eytzinger]
+eyt_index_items = [str(pool_index[company]) for _, company in eytzinger]
+eyt_top_items = [f"0x{mac:06X}" for mac, _ in eytzinger[:ram_nodes]]
+offset_items = [str(o) for o in offsets]
+pool_lines = "\n".join(f'    "{c_string(c)}\\0" // {i}' for i, c in enumerate(pool))
+
+flash_bytes = 3 * len(entries) + 2 * len(entries) + 4 * len(pool) + pool_bytes
+
+header_content = f"""#ifndef PROGMEM_VENDORS_H
 #define PROGMEM_VENDORS_H
 
 #include <Arduino.h>
 
-struct OuiEntry {
-    uint32_t prefix;
-    const char* vendor;
-};
+// Generated by generate_oui_header.py -- do not edit.
+//
+// {len(entries)} OUI prefixes, {len(pool)} distinct vendor names, ~{flash_bytes // 1024} KB of flash:
+//  - oui_prefixes:       24-bit prefixes, 3 big-endian bytes each
+//  - oui_vendor_index:   16-bit index into the vendor pool, per prefix
+//  - oui_vendor_offsets: byte offset of each vendor name in oui_vendor_pool
+//  - oui_vendor_pool:    deduplicated, NUL-separated vendor names
+//
+// Search layout is chosen at compile time:
+//  - default: prefixes sorted, classic binary search (~16 dependent reads
+//    scattered over 114 KB of flash).
+//  - OUI_LAYOUT_EYTZINGER: prefixes in Eytzinger (breadth-first) order, so
+//    each step reads node 2k or 2k+1 and the hot top of the tree is
+//    contiguous; the first {EYTZINGER_RAM_LEVELS} levels ({ram_nodes} nodes) are also mirrored in
+//    RAM, leaving ~{max(0, len(entries).bit_length() - EYTZINGER_RAM_LEVELS)} flash reads per lookup.
 
-// Sorted array of OUI prefixes for binary search
-const OuiEntry oui_table[] PROGMEM = {
-"""
+const size_t OUI_TABLE_SIZE = {len(entries)};
+const size_t OUI_VENDOR_COUNT = {len(pool)};
+
+#ifndef OUI_LAYOUT_EYTZINGER
+const uint8_t oui_prefixes[] PROGMEM = {{
+{wrap(prefix_items, 4)}
+}};
+
+const uint16_t oui_vendor_index[] PROGMEM = {{
+{wrap(index_items, 12)}
+}};
+#else
+const uint8_t oui_prefixes[] PROGMEM = {{
+{wrap(eyt_prefix_items, 4)}
+}};
+
+const uint16_t oui_vendor_index[] PROGMEM = {{
+{wrap(eyt_index_items, 12)}
+}};
+
+// Not const: lives in DRAM.
+const size_t OUI_EYTZINGER_RAM_NODES = {ram_nodes};
+uint32_t oui_eytzinger_top[OUI_EYTZINGER_RAM_NODES] = {{
+{wrap(eyt_top_items, 8)}
+}};
+#endif
+
+const uint32_t oui_vendor_offsets[] PROGMEM = {{
+{wrap(offset_items, 10)}
+}};
 
-for mac, company in vendors:
-    header_content += f'    {{0x{mac:06X}, "{company}"}},\n'
+const char oui_vendor_pool[] PROGMEM =
+{pool_lines}
+    ;
 
-header_content += f"""}};
+inline uint32_t ouiPrefixAt(size_t i) {{
+    const uint8_t *p = oui_prefixes + 3 * i;
+    return ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+}}
 
-const size_t OUI_TABLE_SIZE = {len(vendors)};
+inline const char* ouiVendorAt(size_t i) {{
+    return oui_vendor_pool + oui_vendor_offsets[oui_vendor_index[i]];
+}}
 
+#ifdef OUI_LAYOUT_EYTZINGER
+const char* getVendorFromPROGMEM(uint32_t targetPrefix) {{
+    size_t k = 1; // 1-based node index
+    while (k <= OUI_EYTZINGER_RAM_NODES) {{
+        uint32_t nodePrefix = oui_eytzinger_top[k - 1];
+        if (nodePrefix == targetPrefix) {{
+            return ouiVendorAt(k - 1);
+        }}
+        k = 2 * k + (nodePrefix < targetPrefix);
+    }}
+    while (k <= OUI_TABLE_SIZE) {{
+        uint32_t nodePrefix = ouiPrefixAt(k - 1);
+        if (nodePrefix == targetPrefix) {{
+            return ouiVendorAt(k - 1);
+        }}
+        k = 2 * k + (nodePrefix < targetPrefix);
+    }}
+    return nullptr;
+}}
+#else
 const char* getVendorFromPROGMEM(uint32_t targetPrefix) {{
     int left = 0;
     int right = OUI_TABLE_SIZE - 1;
 
     while (left <= right) {{
         int mid = left + (right - left) / 2;
-        // Read uint32_t from PROGMEM correctly for ESP32
-        uint32_t midPrefix = oui_table[mid].prefix;
-        
+        uint32_t midPrefix = ouiPrefixAt(mid);
+
         if (midPrefix == targetPrefix) {{
-            return oui_table[mid].vendor;
+            return ouiVendorAt(mid);
         }}
         if (midPrefix < targetPrefix) {{
             left = mid + 1;
@@ -76,6 +247,7 @@ const char* getVendorFromPROGMEM(uint32_t targetPrefix) {{
     }}
     return nullptr;
 }}
+#endif
 
 #endif // PROGMEM_VENDORS_H
 """
@@ -83,4 +255,4 @@ const char* getVendorFromPROGMEM(uint32_t targetPrefix) {{
 with open(OUTPUT_FILE, 'w', encoding='utf-8') as f:
     f.write(header_content)
 
-print(f"Done! Created {OUTPUT_FILE} optimized for PROGMEM Binary Search.")
+print(f"Done! Created {OUTPUT_FILE} ({flash_bytes} bytes of tables) optimized for PROGMEM Binary Search.")
@@ -0,0 +1,372 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// Host stand-in for the Arduino-ESP32 core: the part of it the firmware
+// uses, for the "native" PlatformIO environment (see platformio.ini).
+// millis() and time() are the fake clock of native_clock.h, FreeRTOS runs
+// on std threads (native_freertos.h), and Serial prints to stdout unless
+// muted.
+
+#include <algorithm>
+#include <ctype.h>
+#include <math.h>
+#include <random>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <strings.h>
+#include <time.h>
+
+#include "native_clock.h"
+#include "native_freertos.h"
+
+#define PROGMEM
+#define IRAM_ATTR
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+
+inline unsigned long millis() { return (unsigned long)nativeClock.ms(); }
+inline unsigned long micros() { return (unsigned long)nativeClock.us(); }
+inline void delay(uint32_t ms) { nativeClock.advance(ms); }
+inline void yield() {}
+
+// time() is the wall clock of the fake clock (NativeClock::epoch()), as
+// SNTP sets it on the board; 0 while epochStart is 0, as without NTP.
+inline time_t nativeTime(time_t *out) {
+  time_t now = nativeClock.epoch();
+  if (out)
+    *out = now;
+  return now;
+}
+#define time(out) nativeTime(out)
+
+inline uint32_t esp_random() {
+  static std::mt19937 rng(0x5EED);
+  return rng();
+}
+
+inline size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t len = strlen(src);
+  if (size) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = 0;
+  }
+  return len;
+}
+
+// Arduino's WString, on std::string.
+class String {
+public:
+  String() {}
+  String(const char *s) : s_(s ? s : "") {}
+  String(const char *s, unsigned len) : s_(s, len) {}
+  String(const std::string &s) : s_(s) {}
+  explicit String(char c) : s_(1, c) {}
+  explicit String(unsigned char v, unsigned char base = 10) : s_(num(v, base)) {}
+  explicit String(int v, unsigned char base = 10) : s_(num(v, base)) {}
+  explicit String(unsigned v, unsigned char base = 10) : s_(num(v, base)) {}
+  explicit String(long v, unsigned char base = 10) : s_(num(v, base)) {}
+  explicit String(unsigned long v, unsigned char base = 10) : s_(num(v, base)) {}
+  explicit String(long long v, unsigned char base = 10) : s_(num(v, base)) {}
+  explicit String(unsigned long long v, unsigned char base = 10)
+      : s_(num(v, base)) {}
+  explicit String(float v, unsigned decimals = 2) : s_(fixed(v, decimals)) {}
+  explicit String(double v, unsigned decimals = 2) : s_(fixed(v, decimals)) {}
+
+  const char *c_str() const { return s_.c_str(); }
+  unsigned length() const { return (unsigned)s_.size(); }
+  bool isEmpty() const { return s_.empty(); }
+  bool reserve(unsigned size) {
+    s_.reserve(size);
+    return true;
+  }
+  void clear() { s_.clear(); }
+
+  bool concat(const String &s) {
+    s_ += s.s_;
+    return true;
+  }
+  bool concat(const char *s) {
+    if (!s)
+      return false;
+    s_ += s;
+    return true;
+  }
+  bool concat(const char *s, unsigned len) {
+    if (!s)
+      return false;
+    s_.append(s, len);
+    return true;
+  }
+  bool concat(char c) {
+    s_ += c;
+    return true;
+  }
+  bool concat(int v) { return concat(String(v)); }
+  bool concat(unsigned v) { return concat(String(v)); }
+  bool concat(long v) { return concat(String(v)); }
+  bool concat(unsigned long v) { return concat(String(v)); }
+  String &operator+=(const String &s) { return concat(s), *this; }
+  String &operator+=(const char *s) { return concat(s), *this; }
+  String &operator+=(char c) { return concat(c), *this; }
+  String &operator+=(int v) { return concat(v), *this; }
+  String &operator+=(unsigned v) { return concat(v), *this; }
+  String &operator+=(long v) { return concat(v), *this; }
+  String &operator+=(unsigned long v) { return concat(v), *this; }
+
+  bool equals(const String &s) const { return s_ == s.s_; }
+  bool equals(const char *s) const { return s_ == (s ? s : ""); }
+  bool equalsIgnoreCase(const String &s) const {
+    return strcasecmp(s_.c_str(), s.c_str()) == 0;
+  }
+  int compareTo(const String &s) const { return s_.compare(s.s_); }
+  bool operator==(const String &s) const { return equals(s); }
+  bool operator==(const char *s) const { return equals(s); }
+  bool operator!=(const String &s) const { return !equals(s); }
+  bool operator!=(const char *s) const { return !equals(s); }
+  bool operator<(const String &s) const { return s_ < s.s_; }
+  bool startsWith(const String &s) const { return s_.rfind(s.s_, 0) == 0; }
+  bool endsWith(const String &s) const {
+    return s_.size() >= s.s_.size() &&
+           s_.compare(s_.size() - s.s_.size(), s.s_.size(), s.s_) == 0;
+  }
+
+  char charAt(unsigned i) const { return i < s_.size() ? s_[i] : 0; }
+  char operator[](unsigned i) const { return charAt(i); }
+  char &operator[](unsigned i) { return s_[i]; }
+  int indexOf(char c, unsigned from = 0) const { return pos(s_.find(c, from)); }
+  int indexOf(const String &s, unsigned from = 0) const {
+    return pos(s_.find(s.s_, from));
+  }
+  int lastIndexOf(char c) const { return pos(s_.rfind(c)); }
+  String substring(unsigned from) const {
+    return from < s_.size() ? String(s_.substr(from)) : String();
+  }
+  String substring(unsigned from, unsigned to) const {
+    if (from > to)
+      std::swap(from, to);
+    if (from >= s_.size())
+      return String();
+    return String(s_.substr(from, to - from));
+  }
+  void replace(const String &find, const String &with) {
+    if (find.s_.empty())
+      return;
+    for (size_t p = 0; (p = s_.find(find.s_, p)) != std::string::npos;
+         p += with.s_.size())
+      s_.replace(p, find.s_.size(), with.s_);
+  }
+  void remove(unsigned index) { s_.erase(std::min<size_t>(index, s_.size())); }
+  void remove(unsigned index, unsigned count) {
+    if (index < s_.size())
+      s_.erase(index, count);
+  }
+  void toUpperCase() {
+    for (char &c : s_)
+      c = (char)toupper((unsigned char)c);
+  }
+  void toLowerCase() {
+    for (char &c : s_)
+      c = (char)tolower((unsigned char)c);
+  }
+  void trim() {
+    size_t a = s_.find_first_not_of(" \t\r\n");
+    size_t b = s_.find_last_not_of(" \t\r\n");
+    s_ = a == std::string::npos ? std::string() : s_.substr(a, b - a + 1);
+  }
+  long toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(s_.c_str(), nullptr); }
+  double toDouble() const { return strtod(s_.c_str(), nullptr); }
+
+private:
+  static int pos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+  template <typename T> static std::string num(T v, unsigned char base) {
+    if (base == 10)
+      return std::to_string(v);
+    bool neg = v < 0;
+    unsigned long long u = neg ? 0ULL - (unsigned long long)v
+                               : (unsigned long long)v;
+    std::string out;
+    do {
+      unsigned d = (unsigned)(u % base);
+      out.insert(out.begin(), (char)(d < 10 ? '0' + d : 'a' + d - 10));
+      u /= base;
+    } while (u);
+    return neg ? "-" + out : out;
+  }
+  static std::string fixed(double v, unsigned decimals) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+    return buf;
+  }
+
+  std::string s_;
+};
+
+// What `"a" + String(...)` yields in the Arduino core.
+class StringSumHelper : public String {
+public:
+  StringSumHelper(const String &s) : String(s) {}
+  StringSumHelper(const char *s) : String(s) {}
+};
+
+inline StringSumHelper operator+(const String &a, const String &b) {
+  String s(a);
+  s += b;
+  return s;
+}
+inline StringSumHelper operator+(const String &a, const char *b) {
+  String s(a);
+  s += b;
+  return s;
+}
+inline StringSumHelper operator+(const char *a, const String &b) {
+  String s(a);
+  s += b;
+  return s;
+}
+inline StringSumHelper operator+(const String &a, char b) {
+  String s(a);
+  s += b;
+  return s;
+}
+inline StringSumHelper operator+(const String &a, int b) {
+  String s(a);
+  s += b;
+  return s;
+}
+inline StringSumHelper operator+(const String &a, unsigned b) {
+  String s(a);
+  s += b;
+  return s;
+}
+inline StringSumHelper operator+(const String &a, long b) {
+  String s(a);
+  s += b;
+  return s;
+}
+inline StringSumHelper operator+(const String &a, unsigned long b) {
+  String s(a);
+  s += b;
+  return s;
+}
+
+class IPAddress {
+public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : b_{a, b, c, d} {}
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", b_[0], b_[1], b_[2], b_[3]);
+    return String(buf);
+  }
+  uint8_t operator[](int i) const { return b_[i]; }
+
+private:
+  uint8_t b_[4] = {0, 0, 0, 0};
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t len) {
+    size_t n = 0;
+    while (len--)
+      n += write(*buf++);
+    return n;
+  }
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return print(String(v)); }
+  size_t print(unsigned v) { return print(String(v)); }
+  size_t print(long v) { return print(String(v)); }
+  size_t print(unsigned long v) { return print(String(v)); }
+  size_t print(double v, int decimals = 2) {
+    return print(String(v, (unsigned)decimals));
+  }
+  size_t print(const IPAddress &ip) { return print(ip.toString()); }
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(const T &v) {
+    size_t n = print(v);
+    return n + println();
+  }
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    char small[256];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(small, sizeof(small), fmt, args);
+    va_end(args);
+    if (len < 0)
+      return 0;
+    if ((size_t)len < sizeof(small))
+      return write((const uint8_t *)small, len);
+    std::string big(len + 1, '\0');
+    va_start(args, fmt);
+    vsnprintf(&big[0], big.size(), fmt, args);
+    va_end(args);
+    return write((const uint8_t *)big.data(), len);
+  }
+};
+
+// Serial goes to stdout; set `muted` for benchmarks and noisy tests.
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t c) override {
+    if (!muted)
+      fputc(c, stdout);
+    return 1;
+  }
+  size_t write(const uint8_t *buf, size_t len) override {
+    if (!muted)
+      fwrite(buf, 1, len, stdout);
+    return len;
+  }
+  using Print::write;
+  bool muted = false;
+};
+
+inline HardwareSerial Serial;
+
+// The chip: a 240 MHz core whose cycle counter follows the host's steady
+// clock, so cycle budgets (hot_path_stats.h) read as real host time.
+class EspClass {
+public:
+  uint32_t getCycleCount() {
+    using namespace std::chrono;
+    return (uint32_t)(duration_cast<nanoseconds>(
+                          steady_clock::now().time_since_epoch())
+                          .count() *
+                      getCpuFreqMHz() / 1000);
+  }
+  uint32_t getCpuFreqMHz() { return 240; }
+  uint32_t getFreeHeap() { return 200 * 1024; }
+  uint32_t getMinFreeHeap() { return 150 * 1024; }
+  uint32_t getMaxAllocHeap() { return 110 * 1024; }
+  uint32_t getPsramSize() { return 0; }
+  uint32_t getFreePsram() { return 0; }
+  void restart() { exit(0); }
+};
+
+inline EspClass ESP;
+
+inline bool psramFound() { return false; }
+inline void *ps_malloc(size_t size) { return malloc(size); }
+
+inline void configTime(long, int, const char *, const char * = nullptr,
+                       const char * = nullptr) {}
+
+inline bool getLocalTime(struct tm *info, uint32_t = 5000) {
+  time_t now = time(nullptr);
+  localtime_r(&now, info);
+  return true;
+}
+
+#endif // ARDUINO_H
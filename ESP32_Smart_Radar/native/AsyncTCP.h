@@ -0,0 +1,7 @@
+#ifndef ASYNCTCP_H
+#define ASYNCTCP_H
+
+// Host build: no TCP stack, ESPAsyncWebServer.h dispatches in process.
+#include <Arduino.h>
+
+#endif // ASYNCTCP_H
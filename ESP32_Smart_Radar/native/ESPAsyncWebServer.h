@@ -0,0 +1,409 @@
+#ifndef ESPASYNCWEBSERVER_H
+#define ESPASYNCWEBSERVER_H
+
+// Host stand-in for ESPAsyncWebServer 3.x with an in-process dispatcher:
+// a test calls server.request(...) on the thread playing the AsyncTCP task
+// and gets the response back, chunked responses pulled chunk by chunk as
+// the TCP stack would. Routing follows the library: the first handler
+// registered whose method matches and whose URI equals the path, or is a
+// prefix of it followed by '/', takes the request.
+//
+// AsyncEventSource keeps its client list behind a mutex that send(),
+// count(), and connecting a client all take, the latter while onConnect
+// runs, as the library does. Clients record what they are sent.
+
+#include <Arduino.h>
+#include <AsyncTCP.h>
+#include <FS.h>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef enum {
+  HTTP_GET = 0b00000001,
+  HTTP_POST = 0b00000010,
+  HTTP_DELETE = 0b00000100,
+  HTTP_PUT = 0b00001000,
+  HTTP_PATCH = 0b00010000,
+  HTTP_HEAD = 0b00100000,
+  HTTP_OPTIONS = 0b01000000,
+  HTTP_ANY = 0b01111111,
+} WebRequestMethod;
+typedef uint8_t WebRequestMethodComposite;
+
+#define RESPONSE_TRY_AGAIN 0xFFFFFFFF
+
+class AsyncWebServerRequest;
+class AsyncWebServerResponse;
+class AsyncEventSourceClient;
+
+typedef std::function<void(AsyncWebServerRequest *request)>
+    ArRequestHandlerFunction;
+typedef std::function<size_t(uint8_t *buffer, size_t maxLen, size_t index)>
+    AwsResponseFiller;
+typedef std::function<void(AsyncEventSourceClient *client)>
+    ArEventHandlerFunction;
+
+// What the in-process dispatcher hands back to a test.
+struct NativeHttpResponse {
+  int code = 0;
+  std::string contentType;
+  std::string body;
+  std::vector<std::pair<std::string, std::string>> headers;
+  size_t chunks = 0; // filler calls that produced data (chunked responses)
+  bool download = false;
+};
+
+class AsyncWebParameter {
+public:
+  AsyncWebParameter(const String &name, const String &value, bool post)
+      : name_(name), value_(value), post_(post) {}
+  const String &name() const { return name_; }
+  const String &value() const { return value_; }
+  bool isPost() const { return post_; }
+  bool isFile() const { return false; }
+
+private:
+  String name_;
+  String value_;
+  bool post_;
+};
+
+class AsyncWebServerResponse {
+public:
+  virtual ~AsyncWebServerResponse() {}
+  void setCode(int code) { code_ = code; }
+  void addHeader(const char *name, const char *value) {
+    headers_.emplace_back(name, value);
+  }
+  void addHeader(const String &name, const String &value) {
+    addHeader(name.c_str(), value.c_str());
+  }
+
+private:
+  friend class AsyncWebServerRequest;
+  int code_ = 200;
+  std::string type_;
+  std::string body_;
+  AwsResponseFiller filler_;
+  bool download_ = false;
+  std::vector<std::pair<std::string, std::string>> headers_;
+};
+
+class AsyncWebServerRequest {
+public:
+  AsyncWebServerRequest(WebRequestMethod method, const std::string &url,
+                        size_t chunkSize)
+      : method_(method), chunkSize_(chunkSize) {
+    size_t q = url.find('?');
+    url_ = url.substr(0, q).c_str();
+    if (q != std::string::npos)
+      parseQuery(url.substr(q + 1), false);
+  }
+
+  WebRequestMethodComposite method() const { return method_; }
+  const String &url() const { return url_; }
+
+  bool hasParam(const char *name, bool post = false, bool = false) const {
+    return getParam(name, post) != nullptr;
+  }
+  bool hasParam(const String &name, bool post = false, bool = false) const {
+    return hasParam(name.c_str(), post);
+  }
+  const AsyncWebParameter *getParam(const char *name, bool post = false,
+                                    bool = false) const {
+    for (const AsyncWebParameter &p : params_)
+      if (p.isPost() == post && p.name() == name)
+        return &p;
+    return nullptr;
+  }
+  const AsyncWebParameter *getParam(const String &name, bool post = false,
+                                    bool = false) const {
+    return getParam(name.c_str(), post);
+  }
+  size_t params() const { return params_.size(); }
+
+  void send(int code, const char *contentType = "",
+            const char *content = "") {
+    AsyncWebServerResponse *r = beginResponse(code, contentType, content);
+    send(r);
+  }
+  void send(int code, const char *contentType, const String &content) {
+    send(code, contentType, content.c_str());
+  }
+  void send(int code, const String &contentType, const String &content) {
+    send(code, contentType.c_str(), content.c_str());
+  }
+  void send(fs::FS &fs, const String &path, const char *contentType = nullptr,
+            bool download = false) {
+    send(beginResponse(fs, path, contentType, download));
+  }
+  void send(AsyncWebServerResponse *response);
+
+  AsyncWebServerResponse *beginResponse(int code, const char *contentType,
+                                        const char *content) {
+    AsyncWebServerResponse *r = new AsyncWebServerResponse;
+    r->code_ = code;
+    r->type_ = contentType ? contentType : "";
+    r->body_ = content ? content : "";
+    return r;
+  }
+  AsyncWebServerResponse *beginResponse(int code, const char *contentType,
+                                        const String &content) {
+    return beginResponse(code, contentType, content.c_str());
+  }
+  AsyncWebServerResponse *beginResponse(fs::FS &fs, const String &path,
+                                        const char *contentType = nullptr,
+                                        bool download = false) {
+    AsyncWebServerResponse *r = new AsyncWebServerResponse;
+    File f = fs.open(path.c_str(), "r");
+    if (!f) {
+      r->code_ = 404;
+      return r;
+    }
+    r->type_ = contentType ? contentType : "";
+    r->body_.resize(f.size());
+    f.read((uint8_t *)&r->body_[0], r->body_.size());
+    r->download_ = download;
+    return r;
+  }
+  AsyncWebServerResponse *beginChunkedResponse(const char *contentType,
+                                               AwsResponseFiller callback) {
+    AsyncWebServerResponse *r = new AsyncWebServerResponse;
+    r->type_ = contentType ? contentType : "";
+    r->filler_ = callback;
+    return r;
+  }
+  AsyncWebServerResponse *beginChunkedResponse(const String &contentType,
+                                               AwsResponseFiller callback) {
+    return beginChunkedResponse(contentType.c_str(), callback);
+  }
+
+  // Host side
+  void addParam(const String &name, const String &value, bool post) {
+    params_.emplace_back(name, value, post);
+  }
+  NativeHttpResponse response;
+  bool sent = false;
+
+private:
+  static std::string decode(const std::string &s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); i++) {
+      if (s[i] == '+')
+        out += ' ';
+      else if (s[i] == '%' && i + 2 < s.size()) {
+        out += (char)strtol(s.substr(i + 1, 2).c_str(), nullptr, 16);
+        i += 2;
+      } else
+        out += s[i];
+    }
+    return out;
+  }
+  void parseQuery(const std::string &q, bool post) {
+    size_t start = 0;
+    while (start < q.size()) {
+      size_t end = q.find('&', start);
+      if (end == std::string::npos)
+        end = q.size();
+      std::string kv = q.substr(start, end - start);
+      size_t eq = kv.find('=');
+      std::string k = decode(kv.substr(0, eq));
+      std::string v = eq == std::string::npos ? "" : decode(kv.substr(eq + 1));
+      if (!k.empty())
+        addParam(k.c_str(), v.c_str(), post);
+      start = end + 1;
+    }
+  }
+
+  WebRequestMethod method_;
+  String url_;
+  std::vector<AsyncWebParameter> params_;
+  size_t chunkSize_;
+};
+
+// Pulls a chunked response as the TCP stack does: one filler call per
+// chunk of at most chunkSize bytes, until it returns 0.
+inline void AsyncWebServerRequest::send(AsyncWebServerResponse *r) {
+  std::unique_ptr<AsyncWebServerResponse> owned(r);
+  if (sent)
+    return;
+  sent = true;
+  response.code = r->code_;
+  response.contentType = r->type_;
+  response.headers = r->headers_;
+  response.download = r->download_;
+  if (!r->filler_) {
+    response.body = r->body_;
+    return;
+  }
+  std::vector<uint8_t> buf(chunkSize_);
+  for (size_t index = 0;;) {
+    size_t n = r->filler_(buf.data(), buf.size(), index);
+    if (n == RESPONSE_TRY_AGAIN)
+      continue;
+    if (n == 0)
+      break;
+    if (n > buf.size()) { // the library would overrun its buffer
+      response.code = -1;
+      break;
+    }
+    response.body.append((const char *)buf.data(), n);
+    response.chunks++;
+    index += n;
+  }
+}
+
+class AsyncWebHandler {
+public:
+  virtual ~AsyncWebHandler() {}
+};
+
+// A browser on /api/events. `received` holds what it was sent; `backlog`
+// is what packetsWaiting() reports, for tests of a slow client.
+class AsyncEventSourceClient {
+public:
+  struct Event {
+    std::string data;
+    std::string event;
+    uint32_t id;
+  };
+
+  explicit AsyncEventSourceClient(uint32_t lastId) : lastId_(lastId) {}
+
+  uint32_t lastId() const { return lastId_; }
+  bool connected() const { return true; }
+  size_t packetsWaiting() const { return backlog; }
+
+  bool send(const char *message, const char *event = nullptr, uint32_t id = 0,
+            uint32_t = 0) {
+    std::lock_guard<std::mutex> lk(lock_);
+    received.push_back({message ? message : "", event ? event : "", id});
+    return true;
+  }
+
+  std::vector<Event> take() {
+    std::lock_guard<std::mutex> lk(lock_);
+    std::vector<Event> out;
+    out.swap(received);
+    return out;
+  }
+
+  std::vector<Event> received;
+  size_t backlog = 0;
+
+private:
+  uint32_t lastId_;
+  std::mutex lock_;
+};
+
+class AsyncEventSource : public AsyncWebHandler {
+public:
+  explicit AsyncEventSource(const char *url) : url_(url) {}
+
+  void onConnect(ArEventHandlerFunction cb) { connect_ = cb; }
+  void onDisconnect(ArEventHandlerFunction cb) { disconnect_ = cb; }
+
+  void send(const char *message, const char *event = nullptr, uint32_t id = 0,
+            uint32_t reconnect = 0) {
+    std::lock_guard<std::mutex> lk(clientsLock_);
+    for (auto &c : clients_)
+      c->send(message, event, id, reconnect);
+  }
+
+  size_t count() const {
+    std::lock_guard<std::mutex> lk(clientsLock_);
+    return clients_.size();
+  }
+
+  // Host side: a browser connects, optionally resuming with Last-Event-ID.
+  AsyncEventSourceClient *connect(uint32_t lastId = 0) {
+    std::lock_guard<std::mutex> lk(clientsLock_);
+    clients_.emplace_back(new AsyncEventSourceClient(lastId));
+    AsyncEventSourceClient *c = clients_.back().get();
+    if (connect_)
+      connect_(c);
+    return c;
+  }
+
+  // Host side: the browser goes away; the client is freed afterwards.
+  void disconnect(AsyncEventSourceClient *c) {
+    if (disconnect_)
+      disconnect_(c);
+    std::lock_guard<std::mutex> lk(clientsLock_);
+    clients_.remove_if(
+        [c](const std::unique_ptr<AsyncEventSourceClient> &p) {
+          return p.get() == c;
+        });
+  }
+
+  const char *url() const { return url_; }
+
+private:
+  const char *url_;
+  ArEventHandlerFunction connect_;
+  ArEventHandlerFunction disconnect_;
+  mutable std::mutex clientsLock_;
+  std::list<std::unique_ptr<AsyncEventSourceClient>> clients_;
+};
+
+class AsyncWebServer {
+public:
+  explicit AsyncWebServer(uint16_t port) : port_(port) {}
+
+  void on(const char *uri, WebRequestMethodComposite method,
+          ArRequestHandlerFunction onRequest) {
+    routes_.push_back({uri, method, onRequest});
+  }
+  void addHandler(AsyncWebHandler *handler) { handlers_.push_back(handler); }
+  void begin() { begun = true; }
+  void end() { begun = false; }
+
+  // Host side: one request, dispatched on the calling thread. `url` may
+  // carry a query string; `form` holds the POST body fields.
+  NativeHttpResponse
+  request(WebRequestMethod method, const std::string &url,
+          const std::vector<std::pair<std::string, std::string>> &form = {}) {
+    AsyncWebServerRequest req(method, url, chunkSize);
+    for (auto &kv : form)
+      req.addParam(kv.first.c_str(), kv.second.c_str(), true);
+    for (Route &r : routes_) {
+      if (!(r.method & method))
+        continue;
+      std::string path = req.url().c_str();
+      if (r.uri != path && path.rfind(r.uri + "/", 0) != 0)
+        continue;
+      r.handler(&req);
+      if (!req.sent)
+        req.response.code = 500; // the library would leak the request
+      return req.response;
+    }
+    req.response.code = 404;
+    return req.response;
+  }
+  NativeHttpResponse get(const std::string &url) { return request(HTTP_GET, url); }
+  NativeHttpResponse
+  post(const std::string &url,
+       const std::vector<std::pair<std::string, std::string>> &form = {}) {
+    return request(HTTP_POST, url, form);
+  }
+
+  size_t chunkSize = 1436; // TCP payload left after the chunk framing
+  bool begun = false;
+
+private:
+  struct Route {
+    std::string uri;
+    WebRequestMethodComposite method;
+    ArRequestHandlerFunction handler;
+  };
+  uint16_t port_;
+  std::vector<Route> routes_;
+  std::vector<AsyncWebHandler *> handlers_;
+};
+
+#endif // ESPASYNCWEBSERVER_H
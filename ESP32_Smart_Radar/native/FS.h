@@ -0,0 +1,213 @@
+#ifndef FS_H
+#define FS_H
+
+// Host stand-in for the Arduino-ESP32 FS API, on a directory of the host
+// (see native_storage.h).
+//
+// Files behave like LittleFS's: an open file works on a RAM copy and its
+// content reaches the disk, atomically, on close() or flush(); until then
+// the previous content stays. rename() replaces the target atomically.
+// powerCutAfter(n) lets n more writes to the disk (file commits, removes,
+// renames) happen and then drops every later one, as if the board lost
+// power, until powerRestore().
+
+#include <Arduino.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#include "native_storage.h"
+
+namespace fs {
+
+class FS;
+
+class File {
+public:
+  File() {}
+
+  size_t write(const uint8_t *buf, size_t len) {
+    if (!f_ || !f_->writable)
+      return 0;
+    if (f_->pos > f_->data.size())
+      f_->data.resize(f_->pos);
+    if (f_->append)
+      f_->pos = f_->data.size();
+    size_t overlap = std::min(len, f_->data.size() - f_->pos);
+    f_->data.replace(f_->pos, overlap, (const char *)buf, len);
+    f_->pos += len;
+    f_->dirty = true;
+    return len;
+  }
+  size_t write(uint8_t c) { return write(&c, 1); }
+
+  size_t read(uint8_t *buf, size_t len) {
+    if (!f_ || f_->pos >= f_->data.size())
+      return 0;
+    size_t n = std::min(len, f_->data.size() - f_->pos);
+    memcpy(buf, f_->data.data() + f_->pos, n);
+    f_->pos += n;
+    return n;
+  }
+  int read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+  int available() {
+    return f_ && f_->pos < f_->data.size() ? (int)(f_->data.size() - f_->pos)
+                                           : 0;
+  }
+  bool seek(uint32_t pos) {
+    if (!f_ || pos > f_->data.size())
+      return false;
+    f_->pos = pos;
+    return true;
+  }
+  size_t position() const { return f_ ? f_->pos : 0; }
+  size_t size() const { return f_ ? f_->data.size() : 0; }
+  const char *name() const { return f_ ? f_->path.c_str() : ""; }
+  const char *path() const { return name(); }
+  operator bool() const { return f_ != nullptr; }
+
+  void flush();
+  void close() {
+    flush();
+    f_.reset();
+  }
+
+private:
+  friend class FS;
+  struct Impl {
+    FS *fs;
+    std::string path;
+    std::string data;
+    size_t pos = 0;
+    bool writable = false;
+    bool append = false;
+    bool dirty = false;
+    ~Impl();
+  };
+  std::shared_ptr<Impl> f_;
+};
+
+class FS {
+public:
+  explicit FS(const char *subdir) : subdir_(subdir) {}
+
+  File open(const char *path, const char *mode = "r", bool = false) {
+    File f;
+    std::string host = hostPath(path);
+    bool exists = std::filesystem::is_regular_file(host);
+    if (mode[0] == 'r' && !exists)
+      return f;
+    f.f_ = std::make_shared<File::Impl>();
+    f.f_->fs = this;
+    f.f_->path = path;
+    f.f_->writable = mode[0] != 'r' || mode[1] == '+';
+    f.f_->append = mode[0] == 'a';
+    if (mode[0] != 'w' && exists) {
+      std::ifstream in(host, std::ios::binary);
+      f.f_->data.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    if (mode[0] == 'w')
+      f.f_->dirty = true; // truncation is committed on close
+    return f;
+  }
+  File open(const String &path, const char *mode = "r", bool create = false) {
+    return open(path.c_str(), mode, create);
+  }
+
+  bool exists(const char *path) {
+    return std::filesystem::exists(hostPath(path));
+  }
+  bool exists(const String &path) { return exists(path.c_str()); }
+
+  bool remove(const char *path) {
+    if (!exists(path) || !diskWrite())
+      return false;
+    std::error_code ec;
+    return std::filesystem::remove(hostPath(path), ec);
+  }
+  bool remove(const String &path) { return remove(path.c_str()); }
+
+  bool rename(const char *from, const char *to) {
+    if (!exists(from) || !diskWrite())
+      return false;
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+  }
+  bool rename(const String &from, const String &to) {
+    return rename(from.c_str(), to.c_str());
+  }
+
+  bool mkdir(const char *path) {
+    std::error_code ec;
+    return std::filesystem::create_directories(hostPath(path), ec) || !ec;
+  }
+
+  // Power-loss simulation, see the top of this file.
+  void powerCutAfter(int writes) { writesLeft_ = writes; }
+  void powerRestore() { writesLeft_ = -1; }
+  bool powerCut() const { return writesLeft_ == 0; }
+
+  uint64_t bytesCommitted = 0; // bytes file commits wrote to the disk
+
+private:
+  friend class File;
+
+  std::string hostPath(const char *path) const {
+    std::filesystem::path root =
+        std::filesystem::path(nativeStorageDir()) / subdir_;
+    std::filesystem::create_directories(root);
+    return (root / (path[0] == '/' ? path + 1 : path)).string();
+  }
+
+  bool diskWrite() {
+    if (writesLeft_ == 0)
+      return false;
+    if (writesLeft_ > 0)
+      writesLeft_--;
+    return true;
+  }
+
+  void commit(File::Impl &f) {
+    if (!f.dirty)
+      return;
+    f.dirty = false;
+    if (!diskWrite())
+      return;
+    std::string host = hostPath(f.path.c_str());
+    std::string tmp = host + ".commit";
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      out.write(f.data.data(), (std::streamsize)f.data.size());
+    }
+    ::rename(tmp.c_str(), host.c_str());
+    bytesCommitted += f.data.size();
+  }
+
+  std::string subdir_;
+  int writesLeft_ = -1;
+};
+
+inline void File::flush() {
+  if (f_ && f_->writable)
+    f_->fs->commit(*f_);
+}
+
+inline File::Impl::~Impl() {
+  if (writable)
+    fs->commit(*this);
+}
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+#endif // FS_H
@@ -0,0 +1,40 @@
+#ifndef HTTPCLIENT_H
+#define HTTPCLIENT_H
+
+// Host stand-in for the ESP32 HTTPClient: requests go to an in-process
+// server set by the test (nativeHttpServer), which returns the status code
+// and may take its time like a slow home automation box would. Without one,
+// connections are refused.
+
+#include <Arduino.h>
+#include <functional>
+#include <string>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+inline std::function<int(const std::string &url)> nativeHttpServer;
+
+class HTTPClient {
+public:
+  bool begin(const String &url) {
+    url_ = url.c_str();
+    return true;
+  }
+  void setConnectTimeout(int32_t ms) { connectTimeoutMs = ms; }
+  void setTimeout(uint16_t ms) { timeoutMs = ms; }
+  int GET() {
+    return nativeHttpServer ? nativeHttpServer(url_)
+                            : HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  String getString() { return String(); }
+  void end() { url_.clear(); }
+
+  int32_t connectTimeoutMs = 5000;
+  uint16_t timeoutMs = 5000;
+
+private:
+  std::string url_;
+};
+
+#endif // HTTPCLIENT_H
@@ -0,0 +1,259 @@
+#ifndef NIMBLEDEVICE_H
+#define NIMBLEDEVICE_H
+
+// Host stand-in for NimBLE-Arduino 1.4 with a fake radio: a test (or a
+// thread playing the NimBLE host task) calls NimBLEScan::hear() with an
+// advert, and the scan callbacks see it as from the controller, provided a
+// scan is running. GATT connections reach the fake peripherals registered
+// in NimBLEDevice::peripherals().
+
+#include <Arduino.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define BLE_ADDR_PUBLIC 0x00
+#define BLE_ADDR_RANDOM 0x01
+#define BLE_ADDR_PUBLIC_ID 0x02
+#define BLE_ADDR_RANDOM_ID 0x03
+
+class NimBLEAddress {
+public:
+  NimBLEAddress() {}
+  NimBLEAddress(uint64_t address, uint8_t type = BLE_ADDR_PUBLIC)
+      : addr_(address & 0xFFFFFFFFFFFFULL), type_(type) {}
+  operator uint64_t() const { return addr_; }
+  uint8_t getType() const { return type_; }
+  std::string toString() const {
+    char buf[18];
+    snprintf(buf, sizeof(buf), "%02x:%02x:%02x:%02x:%02x:%02x",
+             (unsigned)(addr_ >> 40) & 0xFF, (unsigned)(addr_ >> 32) & 0xFF,
+             (unsigned)(addr_ >> 24) & 0xFF, (unsigned)(addr_ >> 16) & 0xFF,
+             (unsigned)(addr_ >> 8) & 0xFF, (unsigned)addr_ & 0xFF);
+    return buf;
+  }
+  bool operator==(const NimBLEAddress &o) const { return addr_ == o.addr_; }
+
+private:
+  uint64_t addr_ = 0;
+  uint8_t type_ = BLE_ADDR_PUBLIC;
+};
+
+class NimBLEUUID {
+public:
+  NimBLEUUID() {}
+  NimBLEUUID(uint16_t uuid16) : uuid16_(uuid16) {}
+  bool operator==(const NimBLEUUID &o) const { return uuid16_ == o.uuid16_; }
+  uint16_t uuid16() const { return uuid16_; }
+  std::string toString() const {
+    char buf[8];
+    snprintf(buf, sizeof(buf), "0x%04x", uuid16_);
+    return buf;
+  }
+
+private:
+  uint16_t uuid16_ = 0;
+};
+
+class NimBLEAdvertisedDevice {
+public:
+  NimBLEAdvertisedDevice(const NimBLEAddress &address, int rssi,
+                         const uint8_t *payload, size_t len,
+                         bool connectable = true)
+      : address_(address), rssi_(rssi), payload_(payload, payload + len),
+        connectable_(connectable) {}
+
+  NimBLEAddress getAddress() const { return address_; }
+  uint8_t getAddressType() const { return address_.getType(); }
+  int getRSSI() const { return rssi_; }
+  bool isConnectable() const { return connectable_; }
+  uint8_t *getPayload() { return payload_.data(); }
+  size_t getPayloadLength() const { return payload_.size(); }
+
+private:
+  NimBLEAddress address_;
+  int rssi_;
+  std::vector<uint8_t> payload_;
+  bool connectable_;
+};
+
+class NimBLEAdvertisedDeviceCallbacks {
+public:
+  virtual ~NimBLEAdvertisedDeviceCallbacks() {}
+  virtual void onResult(NimBLEAdvertisedDevice *advertisedDevice) = 0;
+};
+
+class NimBLEScanResults {};
+
+class NimBLEScan {
+public:
+  void setAdvertisedDeviceCallbacks(NimBLEAdvertisedDeviceCallbacks *cb,
+                                    bool wantDuplicates = false) {
+    callbacks_ = cb;
+    wantDuplicates_ = wantDuplicates;
+  }
+  void setActiveScan(bool active) { active_ = active; }
+  void setInterval(uint16_t ms) { intervalMs = ms; }
+  void setWindow(uint16_t ms) { windowMs = ms; }
+  void setMaxResults(uint8_t n) { maxResults_ = n; }
+  void setDuplicateFilter(bool enabled) { wantDuplicates_ = !enabled; }
+  void clearResults() {}
+
+  bool start(uint32_t duration, void (*)(NimBLEScanResults),
+             bool = false) {
+    scanning_ = true;
+    duration_ = duration;
+    starts++;
+    return true;
+  }
+  bool stop() {
+    scanning_ = false;
+    stops++;
+    return true;
+  }
+  bool isScanning() const { return scanning_; }
+
+  // Fake radio: the controller reports an advert. Dropped, as on the air,
+  // while no scan runs; otherwise onResult runs on the calling thread.
+  bool hear(NimBLEAdvertisedDevice &advert) {
+    if (!scanning_ || !callbacks_)
+      return false;
+    callbacks_->onResult(&advert);
+    return true;
+  }
+
+  uint16_t intervalMs = 0;
+  uint16_t windowMs = 0;
+  uint32_t starts = 0;
+  uint32_t stops = 0;
+
+private:
+  NimBLEAdvertisedDeviceCallbacks *callbacks_ = nullptr;
+  bool wantDuplicates_ = false;
+  bool active_ = false;
+  bool scanning_ = false;
+  uint8_t maxResults_ = 0xFF;
+  uint32_t duration_ = 0;
+};
+
+// What a fake peripheral answers over GATT: Device Name (0x1800 / 0x2A00)
+// and Battery Level (0x180F / 0x2A19); battery < 0 leaves the service out.
+// connect() returns once the fake clock has moved by connectMs, as the
+// connection takes radio time while loop() keeps running.
+struct NimBLEFakePeripheral {
+  std::string name;
+  int battery = -1;
+  uint32_t connectMs = 0;
+};
+
+class NimBLERemoteCharacteristic {
+public:
+  explicit NimBLERemoteCharacteristic(const std::string &value)
+      : value_(value) {}
+  bool canRead() const { return true; }
+  std::string readValue() { return value_; }
+
+private:
+  std::string value_;
+};
+
+class NimBLERemoteService {
+public:
+  NimBLERemoteCharacteristic *getCharacteristic(const NimBLEUUID &uuid) {
+    auto it = chars_.find(uuid.uuid16());
+    return it == chars_.end() ? nullptr : &it->second;
+  }
+  std::map<uint16_t, NimBLERemoteCharacteristic> chars_;
+};
+
+class NimBLEDevice;
+
+class NimBLEClient {
+public:
+  void setConnectionParams(uint16_t, uint16_t, uint16_t, uint16_t,
+                           uint16_t = 16, uint16_t = 16) {}
+  void setConnectTimeout(uint32_t seconds) { timeoutS_ = seconds; }
+  bool connect(const NimBLEAddress &address, bool = true);
+  bool isConnected() const { return connected_; }
+  NimBLERemoteService *getService(const NimBLEUUID &uuid) {
+    if (!connected_)
+      return nullptr;
+    auto it = services_.find(uuid.uuid16());
+    return it == services_.end() ? nullptr : &it->second;
+  }
+  int disconnect(uint8_t = 0x13) {
+    connected_ = false;
+    services_.clear();
+    return 0;
+  }
+
+private:
+  std::map<uint16_t, NimBLERemoteService> services_;
+  uint32_t timeoutS_ = 30;
+  bool connected_ = false;
+};
+
+class NimBLEDevice {
+public:
+  static void init(const std::string &) {}
+  static NimBLEScan *getScan() {
+    static NimBLEScan scan;
+    return &scan;
+  }
+  static NimBLEClient *createClient() { return new NimBLEClient; }
+  static bool deleteClient(NimBLEClient *client) {
+    delete client;
+    return true;
+  }
+  static void setScanDuplicateCacheSize(uint16_t) {}
+  static void setScanFilterMode(uint8_t) {}
+
+  // Host side: the peripherals that accept connections, by address. Take
+  // peripheralsLock() to change them while a GATT task runs.
+  static std::map<uint64_t, NimBLEFakePeripheral> &peripherals() {
+    static std::map<uint64_t, NimBLEFakePeripheral> p;
+    return p;
+  }
+  static std::mutex &peripheralsLock() {
+    static std::mutex m;
+    return m;
+  }
+  // Addresses connect() was called for, in order, under peripheralsLock().
+  static std::vector<uint64_t> &connected() {
+    static std::vector<uint64_t> c;
+    return c;
+  }
+  static uint32_t connectAttempts;
+};
+
+inline uint32_t NimBLEDevice::connectAttempts = 0;
+
+inline bool NimBLEClient::connect(const NimBLEAddress &address, bool) {
+  NimBLEFakePeripheral peer;
+  {
+    std::lock_guard<std::mutex> lk(NimBLEDevice::peripheralsLock());
+    NimBLEDevice::connectAttempts++;
+    NimBLEDevice::connected().push_back((uint64_t)address);
+    auto it = NimBLEDevice::peripherals().find((uint64_t)address);
+    if (it == NimBLEDevice::peripherals().end())
+      return false;
+    peer = it->second;
+  }
+  uint64_t until = nativeClock.ms() + peer.connectMs;
+  while (nativeClock.ms() < until)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  services_.clear();
+  services_[0x1800].chars_.emplace(0x2A00, peer.name);
+  if (peer.battery >= 0)
+    services_[0x180F].chars_.emplace(
+        0x2A19, std::string(1, (char)(uint8_t)peer.battery));
+  connected_ = true;
+  return true;
+}
+
+#endif // NIMBLEDEVICE_H
@@ -0,0 +1,99 @@
+#ifndef PREFERENCES_H
+#define PREFERENCES_H
+
+// Host stand-in for the Arduino-ESP32 Preferences library, on the NVS
+// stand-in (nvs.h): same limits, same failures (a put that does not fit
+// returns 0), persisted across simulated reboots.
+
+#include <Arduino.h>
+#include <nvs.h>
+
+class Preferences {
+public:
+  bool begin(const char *name, bool readOnly = false,
+             const char * = nullptr) {
+    if (started_)
+      return false;
+    readOnly_ = readOnly;
+    started_ = nvs_open(name, readOnly ? NVS_READONLY : NVS_READWRITE,
+                        &handle_) == ESP_OK;
+    return started_;
+  }
+  void end() {
+    if (started_)
+      nvs_close(handle_);
+    started_ = false;
+  }
+
+  bool clear() { return started_ && nvs_erase_all(handle_) == ESP_OK; }
+  bool remove(const char *key) {
+    return started_ && nvs_erase_key(handle_, key) == ESP_OK;
+  }
+  bool isKey(const char *key) {
+    size_t len;
+    uint8_t v;
+    return started_ &&
+           (nvs_get_str(handle_, key, nullptr, &len) == ESP_OK ||
+            nvs_get_blob(handle_, key, nullptr, &len) == ESP_OK ||
+            nvs_get_u8(handle_, key, &v) == ESP_OK);
+  }
+
+  size_t putString(const char *key, const char *value) {
+    if (!started_ || !value || nvs_set_str(handle_, key, value) != ESP_OK)
+      return 0;
+    return strlen(value);
+  }
+  size_t putString(const char *key, const String &value) {
+    return putString(key, value.c_str());
+  }
+  String getString(const char *key, const String &defaultValue = String()) {
+    size_t len = 0;
+    if (!started_ || nvs_get_str(handle_, key, nullptr, &len) != ESP_OK)
+      return defaultValue;
+    std::string buf(len, '\0');
+    if (nvs_get_str(handle_, key, &buf[0], &len) != ESP_OK)
+      return defaultValue;
+    return String(buf.c_str());
+  }
+
+  size_t putBytes(const char *key, const void *value, size_t len) {
+    if (!started_ || !value || !len ||
+        nvs_set_blob(handle_, key, value, len) != ESP_OK)
+      return 0;
+    return len;
+  }
+  size_t getBytesLength(const char *key) {
+    size_t len = 0;
+    if (!started_ || nvs_get_blob(handle_, key, nullptr, &len) != ESP_OK)
+      return 0;
+    return len;
+  }
+  size_t getBytes(const char *key, void *buf, size_t maxLen) {
+    size_t len = getBytesLength(key);
+    if (!len || !buf || len > maxLen)
+      return 0;
+    return nvs_get_blob(handle_, key, buf, &len) == ESP_OK ? len : 0;
+  }
+
+  size_t putBool(const char *key, bool value) {
+    return putUChar(key, value ? 1 : 0);
+  }
+  bool getBool(const char *key, bool defaultValue = false) {
+    return getUChar(key, defaultValue ? 1 : 0) == 1;
+  }
+  size_t putUChar(const char *key, uint8_t value) {
+    return started_ && nvs_set_u8(handle_, key, value) == ESP_OK ? 1 : 0;
+  }
+  uint8_t getUChar(const char *key, uint8_t defaultValue = 0) {
+    uint8_t v;
+    return started_ && nvs_get_u8(handle_, key, &v) == ESP_OK ? v
+                                                               : defaultValue;
+  }
+
+private:
+  nvs_handle_t handle_ = 0;
+  bool started_ = false;
+  bool readOnly_ = false;
+};
+
+#endif // PREFERENCES_H
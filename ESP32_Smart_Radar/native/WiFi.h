@@ -0,0 +1,32 @@
+#ifndef WIFI_H
+#define WIFI_H
+
+// Host stand-in for the ESP32 WiFi library: always connected, on loopback.
+#include <Arduino.h>
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+
+class WiFiClass {
+public:
+  bool mode(wifi_mode_t) { return true; }
+  bool config(IPAddress, IPAddress, IPAddress, IPAddress = IPAddress(),
+              IPAddress = IPAddress()) {
+    return true;
+  }
+  wl_status_t begin(const char *, const char * = nullptr) { return status(); }
+  wl_status_t status() { return WL_CONNECTED; }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+  int8_t RSSI() { return -50; }
+};
+
+inline WiFiClass WiFi;
+
+#endif // WIFI_H
@@ -0,0 +1,28 @@
+#ifndef ESP_HEAP_CAPS_H
+#define ESP_HEAP_CAPS_H
+
+// Host stand-in: one heap, and no PSRAM (psramFound() is false).
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_EXEC (1 << 0)
+#define MALLOC_CAP_32BIT (1 << 1)
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+inline void *heap_caps_malloc(size_t size, uint32_t caps) {
+  return caps & MALLOC_CAP_SPIRAM ? nullptr : malloc(size);
+}
+
+inline size_t heap_caps_get_free_size(uint32_t caps) {
+  return caps & MALLOC_CAP_SPIRAM ? 0 : 200 * 1024;
+}
+
+inline size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  return caps & MALLOC_CAP_SPIRAM ? 0 : 110 * 1024;
+}
+
+#endif // ESP_HEAP_CAPS_H
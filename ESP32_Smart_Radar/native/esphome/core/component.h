@@ -0,0 +1,25 @@
+#ifndef ESPHOME_CORE_COMPONENT_H
+#define ESPHOME_CORE_COMPONENT_H
+
+// Host stand-in for the part of ESPHome's Component the custom components
+// of ../components use.
+namespace esphome {
+
+namespace setup_priority {
+const float DATA = 600.0f;
+const float HARDWARE = 800.0f;
+const float AFTER_BLUETOOTH = 700.0f;
+} // namespace setup_priority
+
+class Component {
+public:
+  virtual ~Component() {}
+  virtual void setup() {}
+  virtual void loop() {}
+  virtual void dump_config() {}
+  virtual float get_setup_priority() const { return 0.0f; }
+};
+
+} // namespace esphome
+
+#endif // ESPHOME_CORE_COMPONENT_H
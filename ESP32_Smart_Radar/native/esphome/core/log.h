@@ -0,0 +1,14 @@
+#ifndef ESPHOME_CORE_LOG_H
+#define ESPHOME_CORE_LOG_H
+
+// Host stand-in for ESPHome's logger: warnings and errors to stderr, the
+// rest dropped.
+#include <stdio.h>
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "[E][%s] " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "[W][%s] " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) ((void)(tag))
+#define ESP_LOGD(tag, fmt, ...) ((void)(tag))
+#define ESP_LOGV(tag, fmt, ...) ((void)(tag))
+
+#endif // ESPHOME_CORE_LOG_H
@@ -0,0 +1,31 @@
+#ifndef NATIVE_CLOCK_H
+#define NATIVE_CLOCK_H
+
+#include <atomic>
+#include <stdint.h>
+#include <time.h>
+
+// The host build's millis(): a fake clock that only moves when told to, by
+// delay() (loop() ends with delay(1)) or by a test calling advance(), so a
+// test decides how much time passes and runs the same way every time.
+// Threads standing in for FreeRTOS tasks read it; only the test thread, or
+// code it calls, moves it.
+class NativeClock {
+public:
+  uint64_t ms() const { return ms_.load(std::memory_order_relaxed); }
+  uint64_t us() const { return ms() * 1000; }
+  void advance(uint32_t ms) { ms_.fetch_add(ms, std::memory_order_relaxed); }
+  void set(uint64_t ms) { ms_.store(ms, std::memory_order_relaxed); }
+
+  // Wall clock seen by time(): the epoch the fake clock started at, plus
+  // its progress. 0 keeps it unset, as on a board without NTP.
+  time_t epoch() const { return epochStart ? epochStart + (time_t)(ms() / 1000) : 0; }
+  time_t epochStart = 1700000000;
+
+private:
+  std::atomic<uint64_t> ms_{0};
+};
+
+inline NativeClock nativeClock;
+
+#endif // NATIVE_CLOCK_H
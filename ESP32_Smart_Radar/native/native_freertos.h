@@ -0,0 +1,152 @@
+#ifndef NATIVE_FREERTOS_H
+#define NATIVE_FREERTOS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "native_clock.h"
+
+// FreeRTOS on std threads: tasks are detached threads, mutexes are
+// std::timed_mutex, queues copy items under a lock. A tick is 1 ms.
+// xTaskGetTickCount() and queue block times follow the fake clock like
+// millis(): a task waiting 60 s on a queue wakes when the test has moved
+// the clock by 60 s, however little real time that took. Mutex block times
+// and vTaskDelay() are real time.
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define errQUEUE_FULL 0
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+struct NativeSemaphore {
+  std::timed_mutex m;
+};
+typedef NativeSemaphore *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new NativeSemaphore; }
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+  if (ticks == portMAX_DELAY) {
+    s->m.lock();
+    return pdTRUE;
+  }
+  return s->m.try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+  s->m.unlock();
+  return pdTRUE;
+}
+
+struct NativeQueue {
+  NativeQueue(UBaseType_t length, UBaseType_t itemSize)
+      : length(length), itemSize(itemSize) {}
+  std::mutex m;
+  std::condition_variable cv;
+  std::deque<std::vector<uint8_t>> items;
+  UBaseType_t length;
+  UBaseType_t itemSize;
+};
+typedef NativeQueue *QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  return new NativeQueue(length, itemSize);
+}
+
+template <typename Pred>
+inline bool nativeWait(std::unique_lock<std::mutex> &lk,
+                       std::condition_variable &cv, TickType_t ticks,
+                       Pred pred) {
+  if (ticks == portMAX_DELAY) {
+    cv.wait(lk, pred);
+    return true;
+  }
+  // Nothing signals the clock moving: poll it between notifications
+  uint64_t until = nativeClock.ms() + ticks;
+  while (!pred()) {
+    if (nativeClock.ms() >= until)
+      return false;
+    cv.wait_for(lk, std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t q, const void *item,
+                             TickType_t ticks) {
+  std::unique_lock<std::mutex> lk(q->m);
+  if (!nativeWait(lk, q->cv, ticks,
+                  [&] { return q->items.size() < q->length; }))
+    return errQUEUE_FULL;
+  const uint8_t *p = (const uint8_t *)item;
+  q->items.emplace_back(p, p + q->itemSize);
+  q->cv.notify_all();
+  return pdPASS;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lk(q->m);
+  if (!nativeWait(lk, q->cv, ticks, [&] { return !q->items.empty(); }))
+    return pdFALSE;
+  memcpy(item, q->items.front().data(), q->itemSize);
+  q->items.pop_front();
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+  std::lock_guard<std::mutex> lk(q->m);
+  return (UBaseType_t)q->items.size();
+}
+
+// vTaskDelete(NULL) from a task unwinds its thread.
+struct NativeTaskExit {};
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *,
+                                          uint32_t, void *param, UBaseType_t,
+                                          TaskHandle_t *handle, BaseType_t) {
+  std::thread t([fn, param] {
+    try {
+      fn(param);
+    } catch (const NativeTaskExit &) {
+    }
+  });
+  if (handle)
+    *handle = nullptr;
+  t.detach();
+  return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *name,
+                              uint32_t stack, void *param, UBaseType_t prio,
+                              TaskHandle_t *handle) {
+  return xTaskCreatePinnedToCore(fn, name, stack, param, prio, handle,
+                                 tskNO_AFFINITY);
+}
+
+inline void vTaskDelete(TaskHandle_t) { throw NativeTaskExit(); }
+
+inline void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+inline TickType_t xTaskGetTickCount() { return (TickType_t)nativeClock.ms(); }
+
+inline void taskYIELD() { std::this_thread::yield(); }
+
+#endif // NATIVE_FREERTOS_H
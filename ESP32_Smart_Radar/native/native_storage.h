@@ -0,0 +1,35 @@
+#ifndef NATIVE_STORAGE_H
+#define NATIVE_STORAGE_H
+
+#include <filesystem>
+#include <string>
+
+// Where the host build keeps what the board keeps in flash: LittleFS files
+// under littlefs/ and the NVS partition in nvs.dat. One directory per test
+// suite, under the system temp directory; nativeStorageReset() wipes it
+// (a blank board), rebooting a board is just not calling it.
+inline std::string &nativeStorageDir() {
+  static std::string dir =
+      (std::filesystem::temp_directory_path() / "radar_native" / "default")
+          .string();
+  return dir;
+}
+
+// Bumped by every reset, so that stores caching the directory's content
+// (the NVS shim) reload it even when the name is the same.
+inline unsigned &nativeStorageGeneration() {
+  static unsigned generation = 0;
+  return generation;
+}
+
+inline void nativeStorageReset(const char *name) {
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "radar_native" / name;
+  std::error_code ec;
+  std::filesystem::remove_all(dir, ec);
+  std::filesystem::create_directories(dir / "littlefs", ec);
+  nativeStorageDir() = dir.string();
+  nativeStorageGeneration()++;
+}
+
+#endif // NATIVE_STORAGE_H
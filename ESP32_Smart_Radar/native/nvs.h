@@ -0,0 +1,332 @@
+#ifndef NVS_H
+#define NVS_H
+
+// Host stand-in for ESP-IDF's NVS: namespaces of typed keys, saved to
+// nvs.dat in the storage directory (native_storage.h) on every write, so
+// they survive a simulated reboot.
+//
+// Space is accounted as NVS does, in 32-byte entries: one per key plus one
+// per started 32 bytes of a string or blob, 126 entries per 4 KB page, one
+// page kept free for garbage collection. The default partition is
+// huge_app.csv's 20 KB; nativeNvsPartition() changes it. Strings are
+// limited to 4000 bytes and keys to 15 characters, as on the chip.
+
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#include "native_storage.h"
+
+typedef int esp_err_t;
+typedef uint32_t nvs_handle_t;
+typedef nvs_handle_t nvs_handle;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NVS_BASE 0x1100
+#define ESP_ERR_NVS_NOT_FOUND (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_TYPE_MISMATCH (ESP_ERR_NVS_BASE + 0x03)
+#define ESP_ERR_NVS_READ_ONLY (ESP_ERR_NVS_BASE + 0x04)
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE (ESP_ERR_NVS_BASE + 0x05)
+#define ESP_ERR_NVS_INVALID_HANDLE (ESP_ERR_NVS_BASE + 0x07)
+#define ESP_ERR_NVS_KEY_TOO_LONG (ESP_ERR_NVS_BASE + 0x09)
+#define ESP_ERR_NVS_INVALID_LENGTH (ESP_ERR_NVS_BASE + 0x0c)
+#define ESP_ERR_NVS_VALUE_TOO_LONG (ESP_ERR_NVS_BASE + 0x0e)
+
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+typedef nvs_open_mode_t nvs_open_mode;
+
+class NativeNvs {
+public:
+  enum Type : uint8_t { U8 = 1, STR = 2, BLOB = 3 };
+  struct Item {
+    Type type;
+    std::string data;
+  };
+  typedef std::map<std::string, Item> Keys;
+
+  static const size_t ENTRY = 32;
+  static const size_t ENTRIES_PER_PAGE = 126;
+  static const size_t PAGE = 4096;
+  static const size_t STR_MAX = 4000;
+  static const size_t BLOB_MAX = 508000;
+  static const size_t KEY_MAX = 15;
+
+  static NativeNvs &get() {
+    static NativeNvs nvs;
+    return nvs;
+  }
+
+  std::mutex lock;
+  size_t partitionBytes = 0x5000;
+  uint64_t bytesWritten = 0; // payload bytes of every successful set
+
+  // Namespaces of the current storage directory, reloaded when it changes.
+  std::map<std::string, Keys> &spaces() {
+    if (loadedDir_ != nativeStorageDir() ||
+        loadedGeneration_ != nativeStorageGeneration())
+      load();
+    return spaces_;
+  }
+
+  size_t entriesUsed() {
+    size_t used = 0;
+    for (auto &ns : spaces()) {
+      used++;
+      for (auto &kv : ns.second)
+        used += entriesOf(kv.second);
+    }
+    return used;
+  }
+  size_t entriesTotal() const {
+    size_t pages = partitionBytes / PAGE;
+    return pages > 1 ? (pages - 1) * ENTRIES_PER_PAGE : 0;
+  }
+  static size_t entriesOf(const Item &it) {
+    return it.type == U8 ? 1 : 1 + (it.data.size() + ENTRY - 1) / ENTRY;
+  }
+
+  esp_err_t set(const std::string &ns, const char *key, Type type,
+                const std::string &data) {
+    if (strlen(key) > KEY_MAX)
+      return ESP_ERR_NVS_KEY_TOO_LONG;
+    if ((type == STR && data.size() > STR_MAX) ||
+        (type == BLOB && data.size() > BLOB_MAX))
+      return ESP_ERR_NVS_VALUE_TOO_LONG;
+    Keys &keys = spaces()[ns];
+    Item item = {type, data};
+    size_t used = entriesUsed();
+    auto old = keys.find(key);
+    // NVS writes the new value before erasing the old one
+    if (used + entriesOf(item) > entriesTotal())
+      return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    if (old != keys.end() && old->second.type != type)
+      keys.erase(old);
+    keys[key] = item;
+    bytesWritten += data.size();
+    save();
+    return ESP_OK;
+  }
+
+  esp_err_t find(const std::string &ns, const char *key, Type type,
+                 const Item *&out) {
+    auto s = spaces().find(ns);
+    if (s == spaces().end())
+      return ESP_ERR_NVS_NOT_FOUND;
+    auto it = s->second.find(key);
+    if (it == s->second.end())
+      return ESP_ERR_NVS_NOT_FOUND;
+    if (it->second.type != type)
+      return ESP_ERR_NVS_TYPE_MISMATCH;
+    out = &it->second;
+    return ESP_OK;
+  }
+
+  esp_err_t erase(const std::string &ns, const char *key) {
+    auto s = spaces().find(ns);
+    if (s == spaces().end() || !s->second.erase(key))
+      return ESP_ERR_NVS_NOT_FOUND;
+    save();
+    return ESP_OK;
+  }
+
+  esp_err_t eraseAll(const std::string &ns) {
+    spaces()[ns].clear();
+    save();
+    return ESP_OK;
+  }
+
+  // Handles: index into the namespace names they were opened on.
+  nvs_handle_t open(const std::string &ns, bool readOnly) {
+    handles_[++lastHandle_] = {ns, readOnly};
+    spaces()[ns];
+    return lastHandle_;
+  }
+  bool handle(nvs_handle_t h, std::string &ns, bool &readOnly) {
+    auto it = handles_.find(h);
+    if (it == handles_.end())
+      return false;
+    ns = it->second.first;
+    readOnly = it->second.second;
+    return true;
+  }
+  void close(nvs_handle_t h) { handles_.erase(h); }
+
+private:
+  std::string file() const { return nativeStorageDir() + "/nvs.dat"; }
+
+  static void put(std::string &out, const std::string &s) {
+    uint32_t n = (uint32_t)s.size();
+    out.append((const char *)&n, 4);
+    out += s;
+  }
+  static bool take(const std::string &in, size_t &pos, std::string &s) {
+    uint32_t n;
+    if (pos + 4 > in.size())
+      return false;
+    memcpy(&n, in.data() + pos, 4);
+    pos += 4;
+    if (pos + n > in.size())
+      return false;
+    s.assign(in, pos, n);
+    pos += n;
+    return true;
+  }
+
+  void save() {
+    std::string out;
+    for (auto &ns : spaces_)
+      for (auto &kv : ns.second) {
+        put(out, ns.first);
+        put(out, kv.first);
+        out += (char)kv.second.type;
+        put(out, kv.second.data);
+      }
+    std::ofstream(file(), std::ios::binary | std::ios::trunc) << out;
+  }
+
+  void load() {
+    loadedDir_ = nativeStorageDir();
+    loadedGeneration_ = nativeStorageGeneration();
+    spaces_.clear();
+    std::ifstream f(file(), std::ios::binary);
+    std::string in((std::istreambuf_iterator<char>(f)), {});
+    size_t pos = 0;
+    std::string ns, key, data;
+    while (take(in, pos, ns) && take(in, pos, key) && pos < in.size()) {
+      Type type = (Type)in[pos++];
+      if (!take(in, pos, data))
+        break;
+      spaces_[ns][key] = {type, data};
+    }
+  }
+
+  std::map<std::string, Keys> spaces_;
+  std::string loadedDir_ = "\n"; // never a directory: load on first use
+  unsigned loadedGeneration_ = 0;
+  std::map<nvs_handle_t, std::pair<std::string, bool>> handles_;
+  nvs_handle_t lastHandle_ = 0;
+};
+
+// Sets the partition size; returns the previous one.
+inline size_t nativeNvsPartition(size_t bytes) {
+  std::lock_guard<std::mutex> lk(NativeNvs::get().lock);
+  size_t old = NativeNvs::get().partitionBytes;
+  NativeNvs::get().partitionBytes = bytes;
+  return old;
+}
+
+inline esp_err_t nvs_open(const char *name, nvs_open_mode_t mode,
+                          nvs_handle_t *out) {
+  if (strlen(name) > NativeNvs::KEY_MAX)
+    return ESP_ERR_NVS_KEY_TOO_LONG;
+  std::lock_guard<std::mutex> lk(NativeNvs::get().lock);
+  *out = NativeNvs::get().open(name, mode == NVS_READONLY);
+  return ESP_OK;
+}
+
+inline void nvs_close(nvs_handle_t h) {
+  std::lock_guard<std::mutex> lk(NativeNvs::get().lock);
+  NativeNvs::get().close(h);
+}
+
+inline esp_err_t nvs_commit(nvs_handle_t) { return ESP_OK; }
+
+inline esp_err_t nvsNativeSet(nvs_handle_t h, const char *key,
+                              NativeNvs::Type type, const std::string &data) {
+  NativeNvs &nvs = NativeNvs::get();
+  std::lock_guard<std::mutex> lk(nvs.lock);
+  std::string ns;
+  bool readOnly;
+  if (!nvs.handle(h, ns, readOnly))
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  if (readOnly)
+    return ESP_ERR_NVS_READ_ONLY;
+  return nvs.set(ns, key, type, data);
+}
+
+// Reads as ESP-IDF does: out == nullptr asks for the length; a buffer too
+// small fails with ESP_ERR_NVS_INVALID_LENGTH.
+inline esp_err_t nvsNativeGet(nvs_handle_t h, const char *key,
+                              NativeNvs::Type type, void *out, size_t *len) {
+  NativeNvs &nvs = NativeNvs::get();
+  std::lock_guard<std::mutex> lk(nvs.lock);
+  std::string ns;
+  bool readOnly;
+  if (!nvs.handle(h, ns, readOnly))
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  const NativeNvs::Item *item;
+  esp_err_t err = nvs.find(ns, key, type, item);
+  if (err != ESP_OK)
+    return err;
+  size_t need = item->data.size() + (type == NativeNvs::STR ? 1 : 0);
+  if (!out) {
+    *len = need;
+    return ESP_OK;
+  }
+  if (*len < need) {
+    *len = need;
+    return ESP_ERR_NVS_INVALID_LENGTH;
+  }
+  memcpy(out, item->data.data(), item->data.size());
+  if (type == NativeNvs::STR)
+    ((char *)out)[item->data.size()] = 0;
+  *len = need;
+  return ESP_OK;
+}
+
+inline esp_err_t nvs_set_str(nvs_handle_t h, const char *key,
+                             const char *value) {
+  return nvsNativeSet(h, key, NativeNvs::STR, value);
+}
+inline esp_err_t nvs_get_str(nvs_handle_t h, const char *key, char *out,
+                             size_t *len) {
+  return nvsNativeGet(h, key, NativeNvs::STR, out, len);
+}
+inline esp_err_t nvs_set_blob(nvs_handle_t h, const char *key,
+                              const void *value, size_t len) {
+  return nvsNativeSet(h, key, NativeNvs::BLOB,
+                      std::string((const char *)value, len));
+}
+inline esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out,
+                              size_t *len) {
+  return nvsNativeGet(h, key, NativeNvs::BLOB, out, len);
+}
+inline esp_err_t nvs_set_u8(nvs_handle_t h, const char *key, uint8_t value) {
+  return nvsNativeSet(h, key, NativeNvs::U8, std::string(1, (char)value));
+}
+inline esp_err_t nvs_get_u8(nvs_handle_t h, const char *key, uint8_t *out) {
+  size_t len = 1;
+  return nvsNativeGet(h, key, NativeNvs::U8, out, &len);
+}
+
+inline esp_err_t nvs_erase_key(nvs_handle_t h, const char *key) {
+  NativeNvs &nvs = NativeNvs::get();
+  std::lock_guard<std::mutex> lk(nvs.lock);
+  std::string ns;
+  bool readOnly;
+  if (!nvs.handle(h, ns, readOnly))
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  if (readOnly)
+    return ESP_ERR_NVS_READ_ONLY;
+  return nvs.erase(ns, key);
+}
+
+inline esp_err_t nvs_erase_all(nvs_handle_t h) {
+  NativeNvs &nvs = NativeNvs::get();
+  std::lock_guard<std::mutex> lk(nvs.lock);
+  std::string ns;
+  bool readOnly;
+  if (!nvs.handle(h, ns, readOnly))
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  if (readOnly)
+    return ESP_ERR_NVS_READ_ONLY;
+  return nvs.eraseAll(ns);
+}
+
+#endif // NVS_H
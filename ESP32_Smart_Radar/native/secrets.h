@@ -0,0 +1,12 @@
+#ifndef SECRETS_H
+#define SECRETS_H
+
+// Host build only: src/secrets.h (not in git) takes precedence when present.
+#define WIFI_SSID "native"
+#define WIFI_PASSWORD "native"
+#define EEDOMUS_IP "127.0.0.1"
+#define EEDOMUS_PERIPH_ID "1234"
+#define EEDOMUS_API_USER "user"
+#define EEDOMUS_API_SECRET "secret"
+
+#endif // SECRETS_H
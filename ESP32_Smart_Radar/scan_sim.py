@@ -0,0 +1,71 @@
+import random
+import statistics
+import sys
+
+# Scan scheduling simulator: detection latency of a BLE advertiser that
+# appears at a random time, for the firmware's scan modes, without hardware.
+#
+# Usage:
+#   python scan_sim.py [adv_interval_ms] [trials]
+#
+# Model (deliberately simple):
+#  - the advertiser sends one event every adv_interval + 0..10 ms (advDelay),
+#    each event being 3 packets on channels 37, 38, 39, ~0.4 ms apart;
+#  - the scanner listens on one channel per scan interval, rotating
+#    37 -> 38 -> 39, for `window` ms at the start of each interval;
+#  - WiFi coexistence steals a random COEX_LOSS share of the packets that
+#    fall inside a window (more when the window is wide);
+#  - duty-cycle mode scans SCAN_TIME s then is blind for PAUSE_TIME s.
+
+SCAN_TIME_MS = 10000
+PAUSE_TIME_MS = 2000
+PACKET_SPACING_MS = 0.4
+HORIZON_MS = 60000
+
+# name, interval, window, duty cycle, packet loss to WiFi coexistence
+MODES = [
+    ("duty 10s/2s, 97/37", 97, 37, True, 0.05),
+    ("continuous busy, 97/37", 97, 37, False, 0.05),
+    ("continuous normal, 97/60", 97, 60, False, 0.10),
+    ("continuous idle, 97/85", 97, 85, False, 0.15),
+]
+
+
+def heard(t, interval, window, channel, duty):
+    if duty and t % (SCAN_TIME_MS + PAUSE_TIME_MS) >= SCAN_TIME_MS:
+        return False
+    # the scan restarts at each duty cycle, so its phase restarts too
+    local = t % (SCAN_TIME_MS + PAUSE_TIME_MS) if duty else t
+    n = int(local // interval)
+    return local - n * interval < window and 37 + n % 3 == channel
+
+
+def first_detection(rng, adv_interval, interval, window, duty, loss):
+    # Scanner phase is random; the advertiser starts at t0
+    t0 = rng.uniform(0, SCAN_TIME_MS + PAUSE_TIME_MS)
+    t = t0
+    while t - t0 < HORIZON_MS:
+        for i, channel in enumerate((37, 38, 39)):
+            tp = t + i * PACKET_SPACING_MS
+            if heard(tp, interval, window, channel, duty) and rng.random() >= loss:
+                return tp - t0
+        t += adv_interval + rng.uniform(0, 10)
+    return HORIZON_MS
+
+
+def main():
+    adv_interval = float(sys.argv[1]) if len(sys.argv) > 1 else 1000.0
+    trials = int(sys.argv[2]) if len(sys.argv) > 2 else 2000
+    rng = random.Random(1)
+    print(f"Advertiser interval {adv_interval:.0f} ms, {trials} trials")
+    print(f"{'mode':28} {'mean':>8} {'p50':>8} {'p95':>8} {'max':>8}  (ms)")
+    for name, interval, window, duty, loss in MODES:
+        lat = sorted(first_detection(rng, adv_interval, interval, window,
+                                     duty, loss) for _ in range(trials))
+        p95 = lat[int(0.95 * (len(lat) - 1))]
+        print(f"{name:28} {statistics.mean(lat):8.0f} {lat[len(lat) // 2]:8.0f} "
+              f"{p95:8.0f} {lat[-1]:8.0f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,173 @@
+#ifndef ADV_TRACE_H
+#define ADV_TRACE_H
+
+#include "ble_event.h"
+#include <FS.h>
+#include <stdint.h>
+#include <string.h>
+
+// Advertisement traces on LittleFS, for replaying identical traffic.
+//
+// File layout: 4-byte magic "BTR1", then one record per advert:
+// { u32 ms since the start of the recording (little-endian), 6-byte MAC
+// (big-endian), u8 address type | 0x80 if connectable, i8 RSSI, u8 payload
+// length, raw AD payload }, 13 bytes + payload (~40 bytes on average).
+const size_t TRACE_RECORD_HEADER = 13;
+
+// Records adverts through a RAM buffer, written out when full, so the file
+// sees one write per ~1 KB. Stops by itself at maxBytes.
+class TraceWriter {
+public:
+  static const size_t BUFFER_SIZE = 1024;
+
+  bool start(fs::FS &fs, const char *path, uint32_t maxBytes, uint32_t now) {
+    stop();
+    file_ = fs.open(path, "w");
+    if (!file_)
+      return false;
+    static const uint8_t MAGIC[4] = {'B', 'T', 'R', '1'};
+    file_.write(MAGIC, 4);
+    maxBytes_ = maxBytes;
+    bytes_ = 4;
+    records = 0;
+    used_ = 0;
+    startMs_ = now;
+    active_ = true;
+    return true;
+  }
+
+  // Appends one advert; false once the file is full (recording stopped).
+  bool add(const BleEvent &ev) {
+    if (!active_)
+      return false;
+    size_t n = TRACE_RECORD_HEADER + ev.len;
+    if (bytes_ + n > maxBytes_) {
+      stop();
+      return false;
+    }
+    if (used_ + n > BUFFER_SIZE)
+      flush();
+    uint8_t *p = buf_ + used_;
+    uint32_t t = ev.ms - startMs_;
+    for (int b = 0; b < 4; b++)
+      p[b] = (uint8_t)(t >> (8 * b));
+    for (int b = 0; b < 6; b++)
+      p[4 + b] = (uint8_t)(ev.mac >> (40 - 8 * b));
+    p[10] = (ev.addrType & 0x7F) | (ev.connectable ? 0x80 : 0);
+    p[11] = (uint8_t)ev.rssi;
+    p[12] = ev.len;
+    memcpy(p + TRACE_RECORD_HEADER, ev.payload, ev.len);
+    used_ += n;
+    bytes_ += n;
+    records++;
+    return true;
+  }
+
+  void flush() {
+    if (used_ > 0 && file_)
+      file_.write(buf_, used_);
+    used_ = 0;
+  }
+
+  void stop() {
+    if (!active_)
+      return;
+    flush();
+    file_.close();
+    active_ = false;
+  }
+
+  bool active() const { return active_; }
+  uint32_t bytes() const { return bytes_; }
+  uint32_t records = 0;
+
+private:
+  File file_;
+  uint8_t buf_[BUFFER_SIZE];
+  size_t used_ = 0;
+  uint32_t bytes_ = 0;
+  uint32_t maxBytes_ = 0;
+  uint32_t startMs_ = 0;
+  bool active_ = false;
+};
+
+// Plays a trace back as an AdvertSource, at its recorded pace times
+// `speed`: each advert is due, and stamped, at now + its offset / speed.
+// On a virtual clock (see radar_clock.h) the recorded pace costs no wall
+// time.
+class TraceReplay : public AdvertSource {
+public:
+  bool begin(fs::FS &fs, const char *path, uint16_t speed, uint32_t now) {
+    stop();
+    file_ = fs.open(path, "r");
+    uint8_t magic[4];
+    if (!file_ || file_.read(magic, 4) != 4 || memcmp(magic, "BTR1", 4)) {
+      file_.close();
+      return false;
+    }
+    speed_ = speed > 0 ? speed : 1;
+    startMs_ = now;
+    records = 0;
+    pending_ = false;
+    active_ = true;
+    return true;
+  }
+
+  bool next(uint32_t now, BleEvent &ev) override {
+    if (!active_)
+      return false;
+    if (!pending_ && !(pending_ = readRecord())) {
+      stop(); // end of trace
+      return false;
+    }
+    uint32_t due = startMs_ + nextT_ / speed_;
+    if ((int32_t)(due - now) > 0)
+      return false;
+    ev = next_;
+    ev.ms = due;
+    pending_ = false;
+    records++;
+    return true;
+  }
+
+  const char *name() const override { return "trace"; }
+
+  void stop() override {
+    if (active_)
+      file_.close();
+    active_ = false;
+  }
+
+  bool active() const override { return active_; }
+  uint32_t records = 0;
+
+private:
+  bool readRecord() {
+    uint8_t h[TRACE_RECORD_HEADER];
+    if (file_.read(h, sizeof(h)) != sizeof(h))
+      return false;
+    nextT_ = h[0] | (h[1] << 8) | (h[2] << 16) | ((uint32_t)h[3] << 24);
+    next_.mac = 0;
+    for (int b = 0; b < 6; b++)
+      next_.mac = (next_.mac << 8) | h[4 + b];
+    next_.addrType = h[10] & 0x7F;
+    next_.connectable = (h[10] & 0x80) != 0;
+    next_.rssi = (int8_t)h[11];
+    next_.len = h[12] < sizeof(next_.payload) ? h[12] : sizeof(next_.payload);
+    if (file_.read(next_.payload, next_.len) != next_.len)
+      return false;
+    if (h[12] > next_.len) // longer than this build keeps: skip the rest
+      file_.seek(file_.position() + h[12] - next_.len);
+    return true;
+  }
+
+  File file_;
+  BleEvent next_;
+  uint32_t nextT_ = 0;
+  uint32_t startMs_ = 0;
+  uint16_t speed_ = 1;
+  bool pending_ = false;
+  bool active_ = false;
+};
+
+#endif // ADV_TRACE_H
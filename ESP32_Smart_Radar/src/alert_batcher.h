@@ -0,0 +1,109 @@
+#ifndef ALERT_BATCHER_H
+#define ALERT_BATCHER_H
+
+#include "mac_address.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Batching and retry policy for the Eedomus intrusion notification, kept
+// apart from the HTTP transport and the FreeRTOS task that drives it.
+//
+// Intruders seen within `coalesceMs` of the first one (or during the
+// cooldown after the previous notification) are sent together as one
+// comma-separated value. A failed send is retried with exponential backoff
+// (1 s, 2 s, 4 s, ... capped at 30 s) and dropped after MAX_ATTEMPTS.
+// Times are millis() values; comparisons are wrap-safe.
+class AlertBatcher {
+public:
+  static const uint8_t MAX_BATCH = 8;
+  static const uint8_t MAX_ATTEMPTS = 5;
+  static const uint32_t BACKOFF_BASE_MS = 1000;
+  static const uint32_t BACKOFF_MAX_MS = 30000;
+  static const uint32_t NEVER = 0xFFFFFFFF;
+  // "AA:BB:CC:DD:EE:FF," per MAC
+  static const size_t VALUE_MAX = MAX_BATCH * 18;
+
+  AlertBatcher(uint32_t cooldownMs, uint32_t coalesceMs)
+      : cooldownMs_(cooldownMs), coalesceMs_(coalesceMs) {}
+
+  // Adds mac to the pending batch (no-op if already there). Returns false
+  // if the batch is full.
+  bool add(uint64_t mac, uint32_t now) {
+    for (uint8_t i = 0; i < count_; i++)
+      if (macs_[i] == mac)
+        return true;
+    if (count_ == MAX_BATCH) {
+      dropped++;
+      return false;
+    }
+    if (count_ == 0) {
+      readyAt_ = now + coalesceMs_;
+      uint32_t cooldownEnd = lastSent_ + cooldownMs_;
+      if (hasSent_ && (int32_t)(cooldownEnd - readyAt_) > 0)
+        readyAt_ = cooldownEnd;
+    } else {
+      coalesced++;
+    }
+    macs_[count_++] = mac;
+    return true;
+  }
+
+  bool empty() const { return count_ == 0; }
+
+  // Milliseconds until the batch is due (0 = now), NEVER if empty.
+  uint32_t waitMs(uint32_t now) const {
+    if (count_ == 0)
+      return NEVER;
+    int32_t left = (int32_t)(readyAt_ - now);
+    return left > 0 ? (uint32_t)left : 0;
+  }
+
+  // Writes the batch as "AA:BB:CC:DD:EE:FF,11:22:..." (VALUE_MAX bytes).
+  void format(char *out) const {
+    out[0] = '\0';
+    for (uint8_t i = 0; i < count_; i++) {
+      formatMac(macs_[i], out + 18 * i);
+      if (i + 1 < count_)
+        out[18 * i + 17] = ',';
+    }
+  }
+
+  // Outcome of the send attempt made for the current batch.
+  void sent(bool ok, uint32_t now) {
+    if (ok) {
+      sentBatches++;
+      lastSent_ = now;
+      hasSent_ = true;
+      count_ = 0;
+      attempts_ = 0;
+      return;
+    }
+    failures++;
+    if (++attempts_ >= MAX_ATTEMPTS) {
+      givenUp += count_;
+      count_ = 0;
+      attempts_ = 0;
+      return;
+    }
+    uint32_t backoff = BACKOFF_BASE_MS << (attempts_ - 1);
+    readyAt_ = now + (backoff < BACKOFF_MAX_MS ? backoff : BACKOFF_MAX_MS);
+  }
+
+  uint32_t sentBatches = 0;
+  uint32_t failures = 0;
+  uint32_t coalesced = 0; // MACs that joined an already pending batch
+  uint32_t dropped = 0;   // MACs refused because the batch was full
+  uint32_t givenUp = 0;   // MACs abandoned after MAX_ATTEMPTS
+
+private:
+  uint32_t cooldownMs_;
+  uint32_t coalesceMs_;
+  uint64_t macs_[MAX_BATCH];
+  uint8_t count_ = 0;
+  uint8_t attempts_ = 0;
+  uint32_t readyAt_ = 0;
+  uint32_t lastSent_ = 0;
+  bool hasSent_ = false;
+};
+
+#endif // ALERT_BATCHER_H
@@ -0,0 +1,166 @@
+#ifndef API_JSON_H
+#define API_JSON_H
+
+#include "ble_record.h"
+#include "mac_address.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Minimal JSON writer into a caller-provided buffer, used to stream API
+// responses without building a JsonDocument. Output matches ArduinoJson's
+// serializeJson byte for byte (same escapes: \" \\ \b \f \n \r \t, other
+// bytes raw; no whitespace). On overflow `ok` turns false and the content
+// must be discarded.
+struct JsonOut {
+  char *p;
+  char *end;
+  bool ok;
+
+  JsonOut(char *buf, size_t cap) : p(buf), end(buf + cap), ok(true) {}
+
+  size_t length(const char *buf) const { return p - buf; }
+
+  void raw(const char *s) {
+    size_t n = strlen(s);
+    if (p + n > end) {
+      ok = false;
+      return;
+    }
+    memcpy(p, s, n);
+    p += n;
+  }
+
+  void ch(char c) {
+    if (p >= end) {
+      ok = false;
+      return;
+    }
+    *p++ = c;
+  }
+
+  void str(const char *s) {
+    ch('"');
+    for (; *s; s++) {
+      char esc = 0;
+      switch (*s) {
+      case '"':
+        esc = '"';
+        break;
+      case '\\':
+        esc = '\\';
+        break;
+      case '\b':
+        esc = 'b';
+        break;
+      case '\f':
+        esc = 'f';
+        break;
+      case '\n':
+        esc = 'n';
+        break;
+      case '\r':
+        esc = 'r';
+        break;
+      case '\t':
+        esc = 't';
+        break;
+      }
+      if (esc) {
+        ch('\\');
+        ch(esc);
+      } else {
+        ch(*s);
+      }
+    }
+    ch('"');
+  }
+
+  void num(long v) {
+    char buf[24]; // a 64-bit long on the host build
+    snprintf(buf, sizeof(buf), "%ld", v);
+    raw(buf);
+  }
+
+  // Fixed-point value with one decimal, printed as ArduinoJson prints
+  // v / 10.0: -635 -> -63.5, -630 -> -63
+  void tenths(long v) {
+    char buf[24];
+    unsigned long a = v < 0 ? -v : v;
+    if (a % 10)
+      snprintf(buf, sizeof(buf), "%s%lu.%lu", v < 0 ? "-" : "", a / 10,
+               a % 10);
+    else
+      snprintf(buf, sizeof(buf), "%s%lu", v < 0 ? "-" : "", a / 10);
+    raw(buf);
+  }
+
+  void boolean(bool v) { raw(v ? "true" : "false"); }
+
+  void null() { raw("null"); }
+
+  // ,"key": (leading comma unless first member)
+  void key(const char *k, bool first = false) {
+    if (!first)
+      ch(',');
+    str(k);
+    ch(':');
+  }
+};
+
+// Worst case for one device object (escaped strings doubled) is < 760.
+const size_t DEVICE_JSON_MAX = 832;
+
+// One element of /api/devices "devices", same members and order as the
+// former ArduinoJson handler.
+inline void writeDeviceJson(JsonOut &out, uint64_t mac,
+                            const BleDeviceData &dev, bool whitelisted) {
+  char macStr[18];
+  char services[BLE_SERVICES_STR_MAX];
+  char mfgHex[2 * BLE_MFG_MAX + 1];
+  formatMac(mac, macStr);
+  formatServices(dev, services);
+  formatMfgHex(dev, mfgHex);
+  out.ch('{');
+  out.key("mac", true);
+  out.str(macStr);
+  out.key("name");
+  out.str(deviceDisplayName(dev));
+  out.key("rssi");
+  out.num(dev.rssi);
+  out.key("rssiSmooth");
+  out.tenths(dev.rssiFilter.levelTenths());
+  out.key("rssiVar");
+  out.tenths(dev.rssiFilter.varianceTenths());
+  out.key("distanceM");
+  if (dev.hasTxPower) {
+    float d = rssiDistanceM(dev.rssiFilter.levelTenths() / 10.0f, dev.txPower);
+    out.tenths(lroundf(10 * (d < 999.9f ? d : 999.9f)));
+  } else {
+    out.null();
+  }
+  out.key("vendor");
+  out.str(dev.vendor ? dev.vendor : "N/A");
+  out.key("addressType");
+  out.str(addrTypeLabel(dev.addressType));
+  out.key("txPower");
+  out.num(dev.hasTxPower ? dev.txPower : BLE_TX_POWER_UNKNOWN);
+  out.key("services");
+  out.str(services);
+  out.key("mfgData");
+  out.str(mfgHex);
+  out.key("appearance");
+  out.num(dev.appearance);
+  out.key("gattName");
+  out.str(dev.gattName);
+  out.key("battery");
+  out.num(dev.batteryLevel);
+  out.key("whitelisted");
+  out.boolean(whitelisted);
+  out.key("presence");
+  out.str(presenceLabel(dev.presence.state));
+  out.ch('}');
+}
+
+#endif // API_JSON_H
@@ -0,0 +1,49 @@
+#ifndef BLE_EVENT_H
+#define BLE_EVENT_H
+
+#include "ble_record.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// One received advertisement, independent of the BLE stack: what onResult
+// copies out of NimBLE, and what any other advert source produces. Only
+// this struct crosses from the radio side to the radar logic, so that logic
+// can be fed without a radio.
+struct BleEvent {
+  uint64_t mac;
+  uint32_t ms; // millis() at reception
+  int8_t rssi;
+  uint8_t addrType; // BleAddrType
+  bool connectable;
+  uint8_t len;
+  uint8_t payload[BLE_ADV_PAYLOAD_MAX];
+};
+
+// Copies a raw AD payload (advert + scan response), truncated to fit.
+inline void setBleEventPayload(BleEvent &ev, const uint8_t *payload,
+                               size_t len) {
+  ev.len = len < sizeof(ev.payload) ? len : sizeof(ev.payload);
+  memcpy(ev.payload, payload, ev.len);
+}
+
+// Advert source polled by loop() next to the radio, e.g. a trace replay or
+// generated traffic. next() returns false when nothing is due at `now`;
+// events it returns carry ev.ms <= now. active() turns false for good once
+// the source is exhausted or stopped.
+//
+// A source that standsInForRadio() takes the radio's place: the scan is
+// off while it runs and its adverts go through onResult() and the radio's
+// ring, which drops what loop() has not drained in time. Other sources
+// (a trace) are applied directly, none lost.
+class AdvertSource {
+public:
+  virtual ~AdvertSource() {}
+  virtual bool next(uint32_t now, BleEvent &ev) = 0;
+  virtual const char *name() const = 0;
+  virtual bool active() const = 0;
+  virtual void stop() = 0;
+  virtual bool standsInForRadio() const { return false; }
+};
+
+#endif // BLE_EVENT_H
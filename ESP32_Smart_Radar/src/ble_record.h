@@ -0,0 +1,235 @@
+#ifndef BLE_RECORD_H
+#define BLE_RECORD_H
+
+#include "presence.h"
+#include "rssi_filter.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Packed, heap-free representation of what we know about a BLE device, plus
+// an allocation-free parser for raw advertising payloads (AD structures).
+// Text formatting only happens when the web API serializes a record.
+
+enum class BleAddrType : uint8_t {
+  Public = 0,   // BLE_ADDR_PUBLIC
+  Random = 1,   // BLE_ADDR_RANDOM
+  PublicId = 2, // BLE_ADDR_PUBLIC_ID
+  RandomId = 3, // BLE_ADDR_RANDOM_ID
+  Unknown = 0xFF,
+};
+
+inline const char *addrTypeLabel(BleAddrType t) {
+  switch (t) {
+  case BleAddrType::Public:
+    return "Public (Fixe)";
+  case BleAddrType::Random:
+    return "Static Random";
+  case BleAddrType::PublicId:
+    return "Public ID";
+  case BleAddrType::RandomId:
+    return "Random Resolvable (Smartphone)";
+  default:
+    return "Unknown";
+  }
+}
+
+// Service UUID as found on air: 2, 4 or 16 bytes, little-endian.
+struct BleUuid {
+  uint8_t size;
+  uint8_t bytes[16];
+};
+
+const size_t BLE_NAME_MAX = 31;     // 29 fits one AD structure, plus margin
+const size_t BLE_MFG_MAX = 31;      // a legacy advertisement is 31 bytes
+const uint8_t BLE_MAX_UUIDS = 4;    // extra UUIDs are dropped
+const size_t BLE_ADV_PAYLOAD_MAX = 62; // advert + scan response (legacy)
+const int BLE_TX_POWER_UNKNOWN = -999; // API value when not advertised
+
+struct BleDeviceData {
+  char name[BLE_NAME_MAX + 1]; // Advertised local name ("" = none)
+  const char *vendor;          // OUI vendor string (flash) or nullptr
+  int8_t rssi;                 // last sample
+  RssiFilter rssiFilter;       // smoothed level, see rssi_filter.h
+  int8_t txPower;
+  bool hasTxPower;
+  BleAddrType addressType;
+  uint8_t mfgLen;
+  uint8_t mfgData[BLE_MFG_MAX];
+  uint8_t uuidCount;
+  BleUuid uuids[BLE_MAX_UUIDS];
+  uint16_t appearance;
+  char gattName[BLE_NAME_MAX + 1]; // Name read via GATT connection
+  int8_t batteryLevel;             // Battery % read via GATT (-1 = unknown)
+  uint8_t gattAttempts;            // GATT connections tried (budgeted)
+  uint32_t gattLastTry;            // millis() of the last GATT attempt
+  bool connectable;                // last advert was connectable
+  uint32_t lastSeen;
+  uint32_t changeSeq; // ChangeLog sequence of the last visible change
+  int8_t seqRssi;     // smoothed level reported at changeSeq
+  bool listed;        // currently part of the /api/devices list
+  PresenceState presence;
+};
+
+// Fields decoded from one advertising (or scan response) payload.
+struct BleAdvFields {
+  const uint8_t *name;
+  uint8_t nameLen;
+  bool hasTxPower;
+  int8_t txPower;
+  bool hasAppearance;
+  uint16_t appearance;
+  const uint8_t *mfgData;
+  uint8_t mfgLen;
+  uint8_t uuidCount;
+  BleUuid uuids[BLE_MAX_UUIDS];
+};
+
+// Walks the AD structures of payload. Pointers in out reference payload.
+inline void parseAdvPayload(const uint8_t *payload, size_t len,
+                            BleAdvFields &out) {
+  memset(&out, 0, sizeof(out));
+  size_t pos = 0;
+  while (pos + 1 < len) {
+    uint8_t adLen = payload[pos];
+    if (adLen == 0 || pos + 1 + adLen > len)
+      break;
+    uint8_t type = payload[pos + 1];
+    const uint8_t *data = payload + pos + 2;
+    uint8_t dataLen = adLen - 1;
+    switch (type) {
+    case 0x02: // Incomplete / complete list of 16-bit UUIDs
+    case 0x03:
+    case 0x04: // 32-bit
+    case 0x05:
+    case 0x06: // 128-bit
+    case 0x07: {
+      uint8_t size = (type <= 0x03) ? 2 : (type <= 0x05) ? 4 : 16;
+      for (uint8_t i = 0; i + size <= dataLen; i += size) {
+        if (out.uuidCount == BLE_MAX_UUIDS)
+          break;
+        BleUuid &u = out.uuids[out.uuidCount++];
+        u.size = size;
+        memcpy(u.bytes, data + i, size);
+      }
+      break;
+    }
+    case 0x08: // Shortened local name, only if no complete name seen
+      if (out.name != nullptr)
+        break;
+      // fall through
+    case 0x09: // Complete local name
+      out.name = data;
+      out.nameLen = dataLen > BLE_NAME_MAX ? BLE_NAME_MAX : dataLen;
+      break;
+    case 0x0A: // TX power level
+      if (dataLen >= 1) {
+        out.hasTxPower = true;
+        out.txPower = (int8_t)data[0];
+      }
+      break;
+    case 0x19: // Appearance
+      if (dataLen >= 2) {
+        out.hasAppearance = true;
+        out.appearance = (uint16_t)(data[0] | (data[1] << 8));
+      }
+      break;
+    case 0xFF: // Manufacturer specific data
+      out.mfgData = data;
+      out.mfgLen = dataLen > BLE_MFG_MAX ? BLE_MFG_MAX : dataLen;
+      break;
+    }
+    pos += 1 + adLen;
+  }
+}
+
+// Merges one advert into a record. Fields absent from this advert keep the
+// value from earlier packets (adverts and scan responses carry different
+// AD structures). Returns true if a field shown by the web UI changed.
+inline bool applyAdvFields(BleDeviceData &dev, const BleAdvFields &f) {
+  bool changed = false;
+  if (f.name != nullptr && f.nameLen > 0 &&
+      (memcmp(dev.name, f.name, f.nameLen) != 0 ||
+       dev.name[f.nameLen] != '\0')) {
+    memcpy(dev.name, f.name, f.nameLen);
+    dev.name[f.nameLen] = '\0';
+    changed = true;
+  }
+  if (f.hasTxPower && (!dev.hasTxPower || dev.txPower != f.txPower)) {
+    dev.hasTxPower = true;
+    dev.txPower = f.txPower;
+    changed = true;
+  }
+  if (f.uuidCount > 0 &&
+      (dev.uuidCount != f.uuidCount ||
+       memcmp(dev.uuids, f.uuids, sizeof(BleUuid) * f.uuidCount) != 0)) {
+    dev.uuidCount = f.uuidCount;
+    memcpy(dev.uuids, f.uuids, sizeof(BleUuid) * f.uuidCount);
+    changed = true;
+  }
+  if (f.mfgLen > 0 && (dev.mfgLen != f.mfgLen ||
+                       memcmp(dev.mfgData, f.mfgData, f.mfgLen) != 0)) {
+    dev.mfgLen = f.mfgLen;
+    memcpy(dev.mfgData, f.mfgData, f.mfgLen);
+    changed = true;
+  }
+  if (f.hasAppearance && dev.appearance != f.appearance) {
+    dev.appearance = f.appearance;
+    changed = true;
+  }
+  return changed;
+}
+
+// Display name: advertised name, else vendor, else "Unknown".
+inline const char *deviceDisplayName(const BleDeviceData &dev) {
+  if (dev.name[0] != '\0')
+    return dev.name;
+  return dev.vendor != nullptr ? dev.vendor : "Unknown";
+}
+
+// Uppercase hex of the manufacturer data; out needs 2 * BLE_MFG_MAX + 1.
+inline void formatMfgHex(const BleDeviceData &dev, char *out) {
+  static const char HEX_DIGITS[] = "0123456789ABCDEF";
+  for (uint8_t i = 0; i < dev.mfgLen; i++) {
+    out[2 * i] = HEX_DIGITS[dev.mfgData[i] >> 4];
+    out[2 * i + 1] = HEX_DIGITS[dev.mfgData[i] & 0x0F];
+  }
+  out[2 * dev.mfgLen] = '\0';
+}
+
+// Same text as NimBLEUUID::toString(): "0x180f", "0x0000fe2c" or the
+// canonical 128-bit form. out needs 37 bytes.
+inline void formatUuid(const BleUuid &u, char *out) {
+  if (u.size == 2) {
+    snprintf(out, 37, "0x%04x", u.bytes[0] | (u.bytes[1] << 8));
+  } else if (u.size == 4) {
+    snprintf(out, 37, "0x%08lx",
+             (unsigned long)u.bytes[0] | ((unsigned long)u.bytes[1] << 8) |
+                 ((unsigned long)u.bytes[2] << 16) |
+                 ((unsigned long)u.bytes[3] << 24));
+  } else {
+    char *p = out;
+    for (int i = 15; i >= 0; i--) {
+      p += sprintf(p, "%02x", u.bytes[i]);
+      if (i == 12 || i == 10 || i == 8 || i == 6)
+        *p++ = '-';
+    }
+    *p = '\0';
+  }
+}
+
+// "uuid, uuid, " as the API has always returned it.
+const size_t BLE_SERVICES_STR_MAX = BLE_MAX_UUIDS * 38 + 1;
+inline void formatServices(const BleDeviceData &dev, char *out) {
+  char *p = out;
+  for (uint8_t i = 0; i < dev.uuidCount; i++) {
+    formatUuid(dev.uuids[i], p);
+    p += strlen(p);
+    *p++ = ',';
+    *p++ = ' ';
+  }
+  *p = '\0';
+}
+
+#endif // BLE_RECORD_H
@@ -0,0 +1,60 @@
+#ifndef CHANGE_LOG_H
+#define CHANGE_LOG_H
+
+#include <stdint.h>
+
+// Change sequence for incremental polling (/api/devices?since=<seq>).
+// Every visible change to a device record takes the next sequence number
+// (stored in the record); removals from the list are kept in a small ring
+// of tombstones. A client holding cursor `since` gets the records whose
+// sequence is > since plus the tombstones > since, as long as no tombstone
+// newer than its cursor has been overwritten; otherwise it must resync.
+template <uint16_t Capacity> class ChangeLog {
+public:
+  // The counter starts at a per-boot base so that a cursor issued before
+  // a reboot is (almost certainly) outside the valid window afterwards.
+  void begin(uint32_t base) {
+    seq_ = floor_ = base;
+    head_ = 0;
+    for (uint16_t i = 0; i < Capacity; i++)
+      ring_[i].seq = 0;
+  }
+
+  uint32_t current() const { return seq_; }
+  uint32_t next() { return ++seq_; }
+
+  void removed(uint64_t mac) {
+    Tombstone &t = ring_[head_];
+    if (t.seq != 0)
+      floor_ = t.seq; // history up to t.seq is now incomplete
+    t.mac = mac;
+    t.seq = ++seq_;
+    head_ = (head_ + 1) % Capacity;
+  }
+
+  // True if the changes after `since` can be reported as a delta.
+  bool covers(uint32_t since) const { return since >= floor_ && since <= seq_; }
+
+  // Tombstone access by ring slot (0..Capacity-1), for incremental
+  // writers. Returns false if the slot holds no removal newer than since.
+  bool removedAt(uint16_t slot, uint32_t since, uint64_t &mac) const {
+    if (ring_[slot].seq == 0 || ring_[slot].seq <= since)
+      return false;
+    mac = ring_[slot].mac;
+    return true;
+  }
+
+  static uint16_t capacity() { return Capacity; }
+
+private:
+  struct Tombstone {
+    uint64_t mac;
+    uint32_t seq;
+  };
+  Tombstone ring_[Capacity];
+  uint16_t head_ = 0;
+  uint32_t seq_ = 0;
+  uint32_t floor_ = 0;
+};
+
+#endif // CHANGE_LOG_H
@@ -0,0 +1,265 @@
+#ifndef CROWD_SIM_H
+#define CROWD_SIM_H
+
+#include "ble_event.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+// Synthetic crowd, as an AdvertSource, for load testing the ingest path
+// without a crowd. Deterministic for a given seed. It stands in for the
+// radio: its adverts take the whole radio path, onResult() and the ring
+// included.
+//
+// Phones arrive as a Poisson process (arrivalsPerMin), stay an
+// exponentially distributed time (mean stayMs), advertise every advMs (plus
+// the 0-10 ms advDelay of the BLE spec) from a resolvable private address
+// that rotates every rotateMs, with an Apple / Samsung / Google manufacturer
+// data mix (50/30/20). Fixed iBeacons advertise at 10 Hz from a static
+// address for the whole run. Each device's RSSI follows a random walk.
+// At most Capacity devices exist at once; arrivals beyond are counted in
+// `rejected`. The advert rate is roughly visitors * 1000 / advMs + 10 per
+// beacon: 500 phones at 20 ms give ~25k adverts/s.
+struct CrowdConfig {
+  uint32_t seed;
+  uint32_t arrivalsPerMin;
+  uint32_t stayMs;   // mean
+  uint16_t advMs;    // phone advertising interval
+  uint16_t beacons;
+  uint32_t rotateMs; // RPA lifetime
+  uint32_t durationMs; // 0 = until stopped
+};
+
+template <uint16_t Capacity> class CrowdGenerator : public AdvertSource {
+public:
+  static const uint32_t NEVER = 0xFFFFFFFF;
+  static const uint16_t BEACON_MS = 100;
+
+  void begin(const CrowdConfig &c, uint32_t now) {
+    cfg_ = c;
+    rng_ = c.seed ? c.seed : 1;
+    startMs_ = now;
+    count_ = 0;
+    for (uint16_t i = 0; i < Capacity; i++)
+      free_[i] = Capacity - 1 - i;
+    freeCount_ = Capacity;
+    adverts = arrivals = departures = rotations = rejected = 0;
+    maxLagMs = 0;
+    for (uint16_t b = 0; b < cfg_.beacons && freeCount_ > 0; b++)
+      spawn(now, BEACON);
+    nextArrival_ = cfg_.arrivalsPerMin ? now + interArrival() : NEVER;
+    active_ = true;
+  }
+
+  bool next(uint32_t now, BleEvent &ev) override {
+    if (!active_)
+      return false;
+    if (cfg_.durationMs && now - startMs_ >= cfg_.durationMs) {
+      stop();
+      return false;
+    }
+    while (nextArrival_ != NEVER && (int32_t)(nextArrival_ - now) <= 0) {
+      if (freeCount_ > 0) {
+        arrivals++;
+        spawn(nextArrival_, (Kind)(pick(10) < 5 ? APPLE
+                                   : pick(10) < 6 ? SAMSUNG : GOOGLE));
+      } else {
+        rejected++;
+      }
+      nextArrival_ += interArrival();
+    }
+    while (count_ > 0) {
+      uint16_t slot = heap_[0];
+      Visitor &v = v_[slot];
+      uint32_t t = v.nextAdv;
+      if ((int32_t)(t - now) > 0)
+        return false;
+      if (v.leaveAt != NEVER && (int32_t)(t - v.leaveAt) >= 0) {
+        departures++;
+        free_[freeCount_++] = slot;
+        heap_[0] = heap_[--count_];
+        siftDown(0);
+        continue;
+      }
+      if (v.rotateAt != NEVER && (int32_t)(t - v.rotateAt) >= 0) {
+        v.mac = randomMac(0x1); // new RPA: top bits 01
+        v.rotateAt += cfg_.rotateMs;
+        rotations++;
+      }
+      emit(v, t, ev);
+      v.nextAdv = t + v.intervalMs + pick(11);
+      siftDown(0);
+      adverts++;
+      if (now - t > maxLagMs)
+        maxLagMs = now - t;
+      return true;
+    }
+    return false;
+  }
+
+  const char *name() const override { return "crowd"; }
+  bool active() const override { return active_; }
+  void stop() override { active_ = false; }
+  bool standsInForRadio() const override { return true; }
+
+  uint16_t visitors() const { return count_; }
+
+  uint32_t adverts = 0;
+  uint32_t arrivals = 0;
+  uint32_t departures = 0;
+  uint32_t rotations = 0;
+  uint32_t rejected = 0;   // arrivals while Capacity devices were present
+  uint32_t maxLagMs = 0;   // how far behind schedule adverts were emitted
+
+private:
+  enum Kind : uint8_t { APPLE, SAMSUNG, GOOGLE, BEACON };
+
+  struct Visitor {
+    uint64_t mac;
+    uint32_t nextAdv;
+    uint32_t leaveAt;
+    uint32_t rotateAt;
+    uint16_t intervalMs;
+    int8_t level; // random walk, dBm
+    Kind kind;
+    uint8_t salt[3];
+  };
+
+  uint32_t rand32() { // xorshift32
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 17;
+    rng_ ^= rng_ << 5;
+    return rng_;
+  }
+  uint32_t pick(uint32_t n) { return rand32() % n; }
+  uint32_t exponential(uint32_t mean) {
+    float u = (rand32() >> 8) * (1.0f / 16777216.0f); // [0, 1)
+    return (uint32_t)(-logf(1.0f - u) * mean) + 1;
+  }
+  uint32_t interArrival() { return exponential(60000 / cfg_.arrivalsPerMin); }
+
+  uint64_t randomMac(uint8_t topBits) {
+    uint64_t mac = ((uint64_t)rand32() << 16) ^ rand32();
+    return (mac & 0x3FFFFFFFFFFFULL) | ((uint64_t)topBits << 46);
+  }
+
+  void spawn(uint32_t at, Kind kind) {
+    uint16_t slot = free_[--freeCount_];
+    Visitor &v = v_[slot];
+    v.kind = kind;
+    v.level = (int8_t)(-95 + (int)pick(41));
+    for (uint8_t &s : v.salt)
+      s = (uint8_t)rand32();
+    if (kind == BEACON) {
+      v.mac = randomMac(0x3); // static random
+      v.intervalMs = BEACON_MS;
+      v.leaveAt = v.rotateAt = NEVER;
+    } else {
+      v.mac = randomMac(0x1);
+      v.intervalMs = cfg_.advMs;
+      v.leaveAt = at + exponential(cfg_.stayMs);
+      // Already part-way through its current address lifetime
+      v.rotateAt = cfg_.rotateMs ? at + 1 + pick(cfg_.rotateMs) : NEVER;
+    }
+    v.nextAdv = at + pick(v.intervalMs);
+    heap_[count_] = slot;
+    siftUp(count_++);
+  }
+
+  void emit(Visitor &v, uint32_t t, BleEvent &ev) {
+    int level = v.level + (int)pick(5) - 2;
+    v.level = (int8_t)(level < -100 ? -100 : level > -35 ? -35 : level);
+    ev.mac = v.mac;
+    ev.ms = t;
+    ev.rssi = (int8_t)(v.level + (int)pick(7) - 3); // multipath noise
+    ev.addrType = 1; // BleAddrType::Random
+    ev.connectable = v.kind != BEACON;
+    uint8_t *p = ev.payload;
+    uint8_t n = 0;
+    p[n++] = 0x02; // Flags
+    p[n++] = 0x01;
+    p[n++] = v.kind == APPLE ? 0x1A : 0x06;
+    switch (v.kind) {
+    case APPLE: { // Nearby Info
+      static const uint8_t AD[] = {0x0A, 0xFF, 0x4C, 0x00, 0x10, 0x05, 0x01,
+                                   0x18};
+      memcpy(p + n, AD, sizeof(AD));
+      n += sizeof(AD);
+      break;
+    }
+    case SAMSUNG: {
+      static const uint8_t AD[] = {0x0B, 0xFF, 0x75, 0x00, 0x42,
+                                   0x04, 0x01, 0x80, 0x66};
+      memcpy(p + n, AD, sizeof(AD));
+      n += sizeof(AD);
+      break;
+    }
+    case GOOGLE: { // Fast Pair service data
+      static const uint8_t AD[] = {0x03, 0x03, 0x2C, 0xFE,
+                                   0x06, 0x16, 0x2C, 0xFE};
+      memcpy(p + n, AD, sizeof(AD));
+      n += sizeof(AD);
+      break;
+    }
+    case BEACON: { // iBeacon: UUID, major, minor (salt), TX power
+      static const uint8_t AD[] = {0x1A, 0xFF, 0x4C, 0x00, 0x02, 0x15};
+      memcpy(p + n, AD, sizeof(AD));
+      n += sizeof(AD);
+      for (uint8_t i = 0; i < 16; i++)
+        p[n++] = (uint8_t)(0xE2 + i);
+      p[n++] = 0x00;
+      p[n++] = v.salt[0];
+      p[n++] = v.salt[1];
+      p[n++] = v.salt[2];
+      p[n++] = 0xC5; // -59 dBm at 1 m
+      ev.len = n;
+      return;
+    }
+    }
+    for (uint8_t s : v.salt)
+      p[n++] = s;
+    ev.len = n;
+  }
+
+  // Min-heap of slots on nextAdv (wrap-safe)
+  bool earlier(uint16_t a, uint16_t b) const {
+    return (int32_t)(v_[heap_[a]].nextAdv - v_[heap_[b]].nextAdv) < 0;
+  }
+  void swap(uint16_t a, uint16_t b) {
+    uint16_t t = heap_[a];
+    heap_[a] = heap_[b];
+    heap_[b] = t;
+  }
+  void siftUp(uint16_t i) {
+    while (i > 0 && earlier(i, (i - 1) / 2)) {
+      swap(i, (i - 1) / 2);
+      i = (i - 1) / 2;
+    }
+  }
+  void siftDown(uint16_t i) {
+    while (true) {
+      uint16_t l = 2 * i + 1, r = l + 1, m = i;
+      if (l < count_ && earlier(l, m))
+        m = l;
+      if (r < count_ && earlier(r, m))
+        m = r;
+      if (m == i)
+        return;
+      swap(i, m);
+      i = m;
+    }
+  }
+
+  CrowdConfig cfg_ = {};
+  uint32_t rng_ = 1;
+  uint32_t startMs_ = 0;
+  uint32_t nextArrival_ = NEVER;
+  bool active_ = false;
+  Visitor v_[Capacity];
+  uint16_t heap_[Capacity];
+  uint16_t count_ = 0;
+  uint16_t free_[Capacity];
+  uint16_t freeCount_ = 0;
+};
+
+#endif // CROWD_SIM_H
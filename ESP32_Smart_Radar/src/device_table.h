@@ -0,0 +1,246 @@
+#ifndef DEVICE_TABLE_H
+#define DEVICE_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-capacity device table keyed on the 48-bit MAC.
+//
+// Records live in a slot array of Capacity elements supplied by the caller
+// through begin(), so the bulk of the memory can be placed anywhere (e.g.
+// PSRAM); the hot part -- keys, index, LRU links -- stays inside the table.
+// A power-of-two open-addressed index (linear probing, backward-shift
+// deletion) maps MAC -> slot, and an intrusive doubly-linked list keeps
+// slots ordered from least to most recently seen, so lookup, insert and LRU
+// eviction are all O(1) and nothing here ever touches the heap.
+//
+// Records never move between slots, and each slot carries a generation
+// bumped on every insert: a DeviceHandle {slot, generation} stays valid for
+// as long as that device stays in the table, and resolves to nullptr once
+// it has been evicted, even if the slot has been reused since.
+struct DeviceHandle {
+  uint16_t slot;
+  uint16_t gen; // 0 = invalid handle
+};
+
+template <typename T, uint16_t Capacity> class DeviceTable {
+public:
+  static constexpr uint16_t NONE = 0xFFFF;
+
+  DeviceTable() {
+    for (uint16_t i = 0; i < Capacity; i++)
+      gen_[i] = 0;
+    clear();
+  }
+
+  void clear() {
+    for (uint16_t i = 0; i < INDEX_SIZE; i++)
+      index_[i] = NONE;
+    for (uint16_t i = 0; i < Capacity; i++) {
+      next_[i] = (i + 1 < Capacity) ? i + 1 : NONE;
+      live_[i] = false;
+    }
+    freeHead_ = 0;
+    lruHead_ = lruTail_ = NONE;
+    count_ = 0;
+  }
+
+  // Record storage, Capacity elements; must be called before any access.
+  void begin(T *records) { records_ = records; }
+
+  size_t size() const { return count_; }
+  static size_t capacity() { return Capacity; }
+
+  T *find(uint64_t mac) {
+    uint16_t slot = lookup(mac);
+    return slot == NONE ? nullptr : &records_[slot];
+  }
+
+  // Returns the record for mac and marks it most recently seen. A missing
+  // record is default-initialised, evicting the least recently seen one when
+  // the table is full; `inserted` tells the caller which case happened.
+  T *upsert(uint64_t mac, bool &inserted) {
+    uint16_t slot = lookup(mac);
+    inserted = (slot == NONE);
+    if (inserted) {
+      if (freeHead_ == NONE)
+        removeSlot(lruHead_);
+      slot = freeHead_;
+      freeHead_ = next_[slot];
+      keys_[slot] = mac;
+      live_[slot] = true;
+      if (++gen_[slot] == 0)
+        gen_[slot] = 1;
+      records_[slot] = T();
+      indexInsert(mac, slot);
+      linkTail(slot);
+      count_++;
+    } else if (slot != lruTail_) {
+      unlink(slot);
+      linkTail(slot);
+    }
+    return &records_[slot];
+  }
+
+  bool remove(uint64_t mac) {
+    uint16_t slot = lookup(mac);
+    if (slot == NONE)
+      return false;
+    removeSlot(slot);
+    return true;
+  }
+
+  bool full() const { return count_ == Capacity; }
+
+  DeviceHandle handleOf(uint64_t mac) const {
+    uint16_t slot = lookup(mac);
+    if (slot == NONE)
+      return DeviceHandle{0, 0};
+    return DeviceHandle{slot, gen_[slot]};
+  }
+
+  // Record behind a handle, or nullptr if that device has left the table.
+  T *get(DeviceHandle h, uint64_t *mac = nullptr) {
+    if (h.gen == 0 || h.slot >= Capacity || !live_[h.slot] ||
+        gen_[h.slot] != h.gen)
+      return nullptr;
+    if (mac)
+      *mac = keys_[h.slot];
+    return &records_[h.slot];
+  }
+
+  // Least recently seen record, i.e. the one upsert() evicts next.
+  const T *oldest(uint64_t &mac) const {
+    if (lruHead_ == NONE)
+      return nullptr;
+    mac = keys_[lruHead_];
+    return &records_[lruHead_];
+  }
+
+  // Drops records from the least recently seen end while pred(mac, record)
+  // holds. Because upsert() keeps the list in sighting order, an age test
+  // stops at the first fresh record: cost is O(expired), not O(size).
+  template <typename Pred> size_t evictOldestWhile(Pred pred) {
+    size_t removed = 0;
+    while (lruHead_ != NONE && pred(keys_[lruHead_], records_[lruHead_])) {
+      removeSlot(lruHead_);
+      removed++;
+    }
+    return removed;
+  }
+
+  // Raw slot access for incremental readers (e.g. chunked HTTP responses)
+  // that walk 0..capacity()-1 across several calls: a slot cursor stays
+  // valid while the table changes, at worst missing or repeating a device.
+  const T *atSlot(uint16_t slot, uint64_t &mac) const {
+    if (slot >= Capacity || !live_[slot])
+      return nullptr;
+    mac = keys_[slot];
+    return &records_[slot];
+  }
+
+  // Visits records from least to most recently seen: fn(mac, record).
+  template <typename Fn> void forEach(Fn fn) {
+    for (uint16_t s = lruHead_; s != NONE; s = next_[s])
+      fn(keys_[s], records_[s]);
+  }
+  template <typename Fn> void forEach(Fn fn) const {
+    for (uint16_t s = lruHead_; s != NONE; s = next_[s])
+      fn(keys_[s], (const T &)records_[s]);
+  }
+
+private:
+  static constexpr uint16_t indexSizeFor(uint32_t n, uint16_t p = 1) {
+    return p >= n ? p : indexSizeFor(n, (uint16_t)(p << 1));
+  }
+  // Keep the load factor at or below 50% so probe chains stay short.
+  static constexpr uint16_t INDEX_SIZE = indexSizeFor(2u * Capacity);
+  static_assert(Capacity > 0 && Capacity < 0x4000, "capacity out of range");
+
+  static uint16_t bucketOf(uint64_t mac) {
+    // Fibonacci hashing: the OUI half of a MAC is shared by many devices,
+    // so mix all 48 bits before taking the index bits.
+    return (uint16_t)((mac * 0x9E3779B97F4A7C15ULL) >> 40) & (INDEX_SIZE - 1);
+  }
+
+  uint16_t lookup(uint64_t mac) const {
+    for (uint16_t b = bucketOf(mac);; b = (b + 1) & (INDEX_SIZE - 1)) {
+      uint16_t slot = index_[b];
+      if (slot == NONE)
+        return NONE;
+      if (keys_[slot] == mac)
+        return slot;
+    }
+  }
+
+  void indexInsert(uint64_t mac, uint16_t slot) {
+    uint16_t b = bucketOf(mac);
+    while (index_[b] != NONE)
+      b = (b + 1) & (INDEX_SIZE - 1);
+    index_[b] = slot;
+  }
+
+  void indexErase(uint64_t mac) {
+    uint16_t b = bucketOf(mac);
+    while (keys_[index_[b]] != mac)
+      b = (b + 1) & (INDEX_SIZE - 1);
+    // Backward-shift deletion: pull later members of the probe chain into
+    // the hole so lookups never need tombstones.
+    uint16_t hole = b;
+    for (uint16_t j = (hole + 1) & (INDEX_SIZE - 1); index_[j] != NONE;
+         j = (j + 1) & (INDEX_SIZE - 1)) {
+      uint16_t home = bucketOf(keys_[index_[j]]);
+      bool movable = (hole <= j) ? (home <= hole || home > j)
+                                 : (home <= hole && home > j);
+      if (movable) {
+        index_[hole] = index_[j];
+        hole = j;
+      }
+    }
+    index_[hole] = NONE;
+  }
+
+  void linkTail(uint16_t slot) {
+    prev_[slot] = lruTail_;
+    next_[slot] = NONE;
+    if (lruTail_ != NONE)
+      next_[lruTail_] = slot;
+    else
+      lruHead_ = slot;
+    lruTail_ = slot;
+  }
+
+  void unlink(uint16_t slot) {
+    if (prev_[slot] != NONE)
+      next_[prev_[slot]] = next_[slot];
+    else
+      lruHead_ = next_[slot];
+    if (next_[slot] != NONE)
+      prev_[next_[slot]] = prev_[slot];
+    else
+      lruTail_ = prev_[slot];
+  }
+
+  void removeSlot(uint16_t slot) {
+    indexErase(keys_[slot]);
+    unlink(slot);
+    live_[slot] = false;
+    next_[slot] = freeHead_;
+    freeHead_ = slot;
+    count_--;
+  }
+
+  T *records_ = nullptr;
+  uint64_t keys_[Capacity];
+  uint16_t prev_[Capacity];
+  uint16_t next_[Capacity]; // LRU list for live slots, free list otherwise
+  uint16_t index_[INDEX_SIZE];
+  bool live_[Capacity];
+  uint16_t gen_[Capacity]; // survives clear(), so old handles stay invalid
+  uint16_t freeHead_;
+  uint16_t lruHead_;
+  uint16_t lruTail_;
+  uint16_t count_;
+};
+
+#endif // DEVICE_TABLE_H
@@ -0,0 +1,134 @@
+#ifndef EXPIRY_WHEEL_H
+#define EXPIRY_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bucketed timer wheel: at most one pending deadline per entry id
+// (0..Entries-1), Buckets buckets of tickMs each.
+//
+// Each bucket is an intrusive doubly-linked list over preallocated arrays,
+// so schedule() and cancel() are O(1) and advance() costs one step per
+// elapsed tick plus the entries that fire: nothing is scanned that is not
+// due. A deadline beyond the horizon (Buckets * tickMs) waits in the last
+// bucket and is re-filed when that bucket comes round. Entries fire when
+// their bucket has fully elapsed, i.e. up to tickMs late, never early.
+//
+// The caller's `tag` is handed back on expiry, e.g. a DeviceTable
+// generation to tell whether the id still names the same device. Times are
+// millis() values; comparisons are wrap-safe.
+template <uint16_t Entries, uint16_t Buckets> class ExpiryWheel {
+public:
+  static constexpr uint16_t NONE = 0xFFFF;
+  static_assert(Buckets > 1 && Entries < NONE, "wheel size out of range");
+
+  explicit ExpiryWheel(uint32_t tickMs) : tickMs_(tickMs) {
+    for (uint16_t b = 0; b < Buckets; b++)
+      head_[b] = NONE;
+    for (uint16_t i = 0; i < Entries; i++)
+      bucket_[i] = NONE;
+  }
+
+  // Aligns the wheel on the current time; call once before use.
+  void begin(uint32_t now) { startMs_ = now; }
+
+  // Drops every deadline and aligns the wheel on `now` again, so that what
+  // is scheduled next fires at the same offsets from `now` every time.
+  // Not from within advance().
+  void clear(uint32_t now) {
+    for (uint16_t b = 0; b < Buckets; b++)
+      head_[b] = NONE;
+    for (uint16_t i = 0; i < Entries; i++)
+      bucket_[i] = NONE;
+    count_ = 0;
+    cursor_ = 0;
+    startMs_ = now;
+  }
+
+  void schedule(uint16_t id, uint16_t tag, uint32_t due) {
+    cancel(id);
+    due_[id] = due;
+    tag_[id] = tag;
+    link(id);
+  }
+
+  void cancel(uint16_t id) {
+    if (bucket_[id] == NONE)
+      return;
+    if (prev_[id] != NONE)
+      next_[prev_[id]] = next_[id];
+    else
+      head_[bucket_[id]] = next_[id];
+    if (next_[id] != NONE)
+      prev_[next_[id]] = prev_[id];
+    bucket_[id] = NONE;
+    count_--;
+  }
+
+  bool scheduled(uint16_t id) const { return bucket_[id] != NONE; }
+  size_t size() const { return count_; }
+
+  // Calls fn(id, tag) for every entry whose bucket has elapsed by `now`.
+  // fn may schedule or cancel any id, including its own; what it schedules
+  // lands in a later bucket, at the earliest the next one.
+  template <typename Fn> size_t advance(uint32_t now, Fn fn) {
+    size_t fired = 0;
+    advancing_ = true;
+    while ((int32_t)(now - (startMs_ + tickMs_)) >= 0) {
+      uint32_t end = startMs_ + tickMs_;
+      uint16_t id;
+      while ((id = head_[cursor_]) != NONE) {
+        cancel(id);
+        if ((int32_t)(due_[id] - end) < 0) {
+          fired++;
+          fn(id, tag_[id]);
+        } else {
+          link(id); // was past the horizon: file it again
+        }
+      }
+      cursor_ = (uint16_t)((cursor_ + 1) % Buckets);
+      startMs_ = end;
+    }
+    advancing_ = false;
+    return fired;
+  }
+
+private:
+  // Bucket for due relative to the current one; overdue goes in the
+  // current bucket (the next one while it is being emptied), beyond the
+  // horizon in the last one.
+  uint16_t bucketFor(uint32_t due) const {
+    int32_t delta = (int32_t)(due - startMs_);
+    uint32_t ticks = delta > 0 ? (uint32_t)delta / tickMs_ : 0;
+    if (ticks == 0 && advancing_)
+      ticks = 1;
+    if (ticks >= Buckets)
+      ticks = Buckets - 1;
+    return (uint16_t)((cursor_ + ticks) % Buckets);
+  }
+
+  void link(uint16_t id) {
+    uint16_t b = bucketFor(due_[id]);
+    bucket_[id] = b;
+    prev_[id] = NONE;
+    next_[id] = head_[b];
+    if (head_[b] != NONE)
+      prev_[head_[b]] = id;
+    head_[b] = id;
+    count_++;
+  }
+
+  uint32_t tickMs_;
+  uint32_t startMs_ = 0; // start of the cursor bucket
+  uint16_t cursor_ = 0;
+  bool advancing_ = false;
+  uint16_t head_[Buckets];
+  uint16_t bucket_[Entries]; // NONE = not scheduled
+  uint16_t next_[Entries];
+  uint16_t prev_[Entries];
+  uint16_t tag_[Entries];
+  uint32_t due_[Entries];
+  size_t count_ = 0;
+};
+
+#endif // EXPIRY_WHEEL_H
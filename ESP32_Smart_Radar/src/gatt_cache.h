@@ -0,0 +1,158 @@
+#ifndef GATT_CACHE_H
+#define GATT_CACHE_H
+
+#include <FS.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+// GATT results (Device Name, Battery Level) by MAC, kept across evictions
+// and reboots so a device is not reconnected each time it comes back.
+//
+// Fixed table of Capacity entries; when full, the oldest fetch is replaced.
+// An entry is fresh for `ttl` seconds (unix time; while the clock is not
+// set, entries are stamped 0 and count as fresh). Persisted to one small
+// LittleFS file, rewritten by flush() when results were added: "GC1\0"
+// then 44-byte records { 6-byte MAC, u32 time, i8 battery, name[32], pad }.
+// Under a lock that must not be held across flash writes, takeSnapshot()
+// (locked) encodes the file and writeSnapshot() (unlocked) writes it;
+// flush() runs both.
+template <uint16_t Capacity> class GattCache {
+public:
+  static const size_t NAME_MAX = 32; // including NUL, as BleDeviceData
+  static const size_t RECORD_SIZE = 44;
+
+  struct Entry {
+    uint64_t mac;
+    uint32_t fetched; // unix time, 0 if unknown
+    int8_t battery;   // -1 = unknown
+    char name[NAME_MAX];
+  };
+
+  void begin(fs::FS &fs, const char *path, uint32_t ttl) {
+    fs_ = &fs;
+    path_ = path;
+    ttl_ = ttl;
+  }
+
+  bool load() {
+    count_ = 0;
+    File f = fs_->open(path_, "r");
+    if (!f)
+      return false;
+    uint8_t rec[RECORD_SIZE];
+    if (f.read(rec, 4) == 4 && memcmp(rec, magic(), 4) == 0) {
+      while (count_ < Capacity && f.read(rec, RECORD_SIZE) == RECORD_SIZE) {
+        Entry &e = entries_[count_++];
+        e.mac = 0;
+        for (int b = 0; b < 6; b++)
+          e.mac = (e.mac << 8) | rec[b];
+        e.fetched = rec[6] | (rec[7] << 8) | (rec[8] << 16) |
+                    ((uint32_t)rec[9] << 24);
+        e.battery = (int8_t)rec[10];
+        memcpy(e.name, rec + 11, NAME_MAX);
+        e.name[NAME_MAX - 1] = '\0';
+      }
+    }
+    f.close();
+    return true;
+  }
+
+  const Entry *find(uint64_t mac) const {
+    return const_cast<GattCache *>(this)->lookup(mac);
+  }
+
+  bool fresh(const Entry &e, time_t now) const {
+    return e.fetched == 0 || now < 100000 || (uint32_t)now - e.fetched < ttl_;
+  }
+
+  // Stores a result in memory; flush() writes it.
+  void put(uint64_t mac, const char *name, int8_t battery, time_t now) {
+    Entry *e = lookup(mac);
+    if (e == nullptr) {
+      if (count_ < Capacity) {
+        e = &entries_[count_++];
+      } else {
+        e = &entries_[0];
+        for (uint16_t i = 1; i < count_; i++)
+          if (entries_[i].fetched < e->fetched)
+            e = &entries_[i];
+      }
+      e->mac = mac;
+    }
+    e->fetched = now > 100000 ? (uint32_t)now : 0;
+    e->battery = battery;
+    strncpy(e->name, name, NAME_MAX - 1);
+    e->name[NAME_MAX - 1] = '\0';
+    dirty_ = true;
+  }
+
+  void flush() {
+    std::vector<uint8_t> file;
+    if (takeSnapshot(file) && !writeSnapshot(file))
+      retrySnapshot();
+  }
+
+  // The file contents, if results were added since the last snapshot.
+  bool takeSnapshot(std::vector<uint8_t> &file) {
+    if (!dirty_)
+      return false;
+    dirty_ = false;
+    file.assign(magic(), magic() + 4);
+    uint8_t rec[RECORD_SIZE];
+    for (uint16_t i = 0; i < count_; i++) {
+      const Entry &e = entries_[i];
+      memset(rec, 0, sizeof(rec));
+      for (int b = 0; b < 6; b++)
+        rec[b] = (uint8_t)(e.mac >> (40 - 8 * b));
+      rec[6] = (uint8_t)e.fetched;
+      rec[7] = (uint8_t)(e.fetched >> 8);
+      rec[8] = (uint8_t)(e.fetched >> 16);
+      rec[9] = (uint8_t)(e.fetched >> 24);
+      rec[10] = (uint8_t)e.battery;
+      memcpy(rec + 11, e.name, NAME_MAX);
+      file.insert(file.end(), rec, rec + RECORD_SIZE);
+    }
+    return true;
+  }
+
+  // Returns false if the file could not be opened.
+  bool writeSnapshot(const std::vector<uint8_t> &file) const {
+    File f = fs_->open(path_, "w");
+    if (!f)
+      return false;
+    f.write(file.data(), file.size());
+    f.close();
+    return true;
+  }
+
+  // The next snapshot is due even if nothing else is added.
+  void retrySnapshot() { dirty_ = true; }
+
+  uint16_t size() const { return count_; }
+  uint32_t hits = 0;
+  uint32_t misses = 0;
+
+private:
+  Entry *lookup(uint64_t mac) {
+    for (uint16_t i = 0; i < count_; i++)
+      if (entries_[i].mac == mac)
+        return &entries_[i];
+    return nullptr;
+  }
+
+  static const uint8_t *magic() {
+    static const uint8_t MAGIC[4] = {'G', 'C', '1', 0};
+    return MAGIC;
+  }
+
+  fs::FS *fs_ = nullptr;
+  const char *path_ = nullptr;
+  uint32_t ttl_ = 0;
+  Entry entries_[Capacity];
+  uint16_t count_ = 0;
+  bool dirty_ = false;
+};
+
+#endif // GATT_CACHE_H
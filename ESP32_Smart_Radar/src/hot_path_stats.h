@@ -0,0 +1,39 @@
+#ifndef HOT_PATH_STATS_H
+#define HOT_PATH_STATS_H
+
+#include <stdint.h>
+
+// Timing of one hot path in CPU cycles, with a budget: every sample above
+// budget is counted, so a regression shows on the running device (in
+// /api/stats) without a bench setup. Each HotPath has one writer at a time
+// (its task, or whoever holds the lock around the path); readers only take
+// a snapshot for statistics, where a torn read costs one sample at worst.
+struct HotPath {
+  const char *name;
+  uint32_t budgetUs;
+  uint32_t budgetCycles; // set by setClock()
+  uint32_t count;
+  uint32_t overBudget;
+  uint32_t maxCycles;
+  uint64_t totalCycles;
+
+  void setClock(uint32_t cyclesPerUs) { budgetCycles = budgetUs * cyclesPerUs; }
+
+  void add(uint32_t cycles) {
+    count++;
+    totalCycles += cycles;
+    if (cycles > maxCycles)
+      maxCycles = cycles;
+    if (cycles > budgetCycles)
+      overBudget++;
+  }
+
+  float avgUs(uint32_t cyclesPerUs) const {
+    return count ? (float)totalCycles / count / cyclesPerUs : 0.0f;
+  }
+  float maxUs(uint32_t cyclesPerUs) const {
+    return (float)maxCycles / cyclesPerUs;
+  }
+};
+
+#endif // HOT_PATH_STATS_H
@@ -0,0 +1,272 @@
+#ifndef LASTSEEN_JOURNAL_H
+#define LASTSEEN_JOURNAL_H
+
+#include <FS.h>
+#include <map>
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+
+// "Last seen" unix timestamps per MAC, persisted as an append-only journal
+// on LittleFS instead of rewriting one big NVS JSON string.
+//
+// File layout: 4-byte magic "LSJ1", then 10-byte records
+// { 6-byte MAC (big-endian), u32 unix time (little-endian) }; on load the
+// last record for a MAC wins. flush() appends only the entries that moved
+// by at least `resolution` seconds since they were last written, so write
+// cost is proportional to what changed. When dead records make the file
+// more than twice its live size, it is compacted: rewritten to a temp file
+// that is then renamed over the journal, so a power cut at any point
+// leaves either the old or the new file. load() finishes or discards an
+// interrupted compaction, and rewrites a file with a bad magic or a torn
+// last record so that later appends never land after garbage.
+//
+// A journal shared under a lock that must not be held across flash writes
+// is flushed in three steps: takeFlush() (locked) encodes what is due,
+// writeFlush() (unlocked, from one task) puts it on flash, endFlush()
+// (locked) accounts for it. Updates made meanwhile wait for the next flush;
+// a clear() made meanwhile wins over the write. flush() runs the three.
+class LastSeenJournal {
+public:
+  static const size_t RECORD_SIZE = 10;
+
+  struct FlushBatch {
+    bool compact = false;          // rewrite the whole file
+    std::vector<uint8_t> records;  // encoded, RECORD_SIZE each
+    std::vector<uint64_t> dirty;   // due again if the write does not land
+    uint32_t epoch = 0;
+    uint32_t written = 0;
+    bool landed = false;
+  };
+
+  void begin(fs::FS &fs, const char *path, uint32_t resolution) {
+    fs_ = &fs;
+    path_ = path;
+    resolution_ = resolution;
+  }
+
+  // Replays the journal into memory. Returns false if there is no file.
+  bool load() {
+    entries_.clear();
+    dirty_.clear();
+    fileRecords_ = 0;
+    String tmp = tmpPath();
+    if (fs_->exists(tmp.c_str())) {
+      // Compaction cut short. Before its rename the journal is intact and
+      // the temp file may be partial; firmware that removed the journal
+      // first can also leave only the complete temp file.
+      if (fs_->exists(path_))
+        fs_->remove(tmp.c_str());
+      else
+        fs_->rename(tmp.c_str(), path_);
+    }
+    File f = fs_->open(path_, "r");
+    if (!f)
+      return false;
+    uint8_t rec[RECORD_SIZE];
+    size_t records = 0;
+    bool damaged = true;
+    if (f.read(rec, 4) == 4 && memcmp(rec, magic(), 4) == 0) {
+      size_t n;
+      while ((n = f.read(rec, RECORD_SIZE)) == RECORD_SIZE) {
+        uint64_t mac = 0;
+        for (int b = 0; b < 6; b++)
+          mac = (mac << 8) | rec[b];
+        uint32_t ts = rec[6] | (rec[7] << 8) | (rec[8] << 16) |
+                      ((uint32_t)rec[9] << 24);
+        Entry &e = entries_[mac];
+        e.seen = e.persisted = ts;
+        records++;
+      }
+      damaged = n != 0; // torn last append
+    }
+    fileRecords_ = records;
+    f.close();
+    if (damaged) {
+      repairs++;
+      compact();
+    }
+    return true;
+  }
+
+  // In-memory update; persisted by the next flush() if it moved enough.
+  void update(uint64_t mac, time_t now) {
+    Entry &e = entries_[mac];
+    e.seen = (uint32_t)now;
+    if (!e.dirty && e.seen - e.persisted >= resolution_) {
+      e.dirty = true;
+      dirty_.push_back(mac);
+    }
+  }
+
+  time_t get(uint64_t mac) const {
+    auto it = entries_.find(mac);
+    return it == entries_.end() ? 0 : (time_t)it->second.seen;
+  }
+
+  size_t size() const { return entries_.size(); }
+  bool pending() const { return !dirty_.empty(); }
+
+  void flush() {
+    FlushBatch b;
+    if (!takeFlush(b))
+      return;
+    writeFlush(b);
+    endFlush(b);
+  }
+
+  // Encodes the entries due, or all of them when dead records call for a
+  // compaction. Returns false if there is nothing to write.
+  bool takeFlush(FlushBatch &b) {
+    if (dirty_.empty())
+      return false;
+    b.compact = (fileRecords_ + dirty_.size()) > 2 * entries_.size() + 64;
+    b.epoch = epoch_;
+    b.written = 0;
+    b.landed = false;
+    b.records.clear();
+    uint8_t rec[RECORD_SIZE];
+    if (b.compact) {
+      b.records.reserve(entries_.size() * RECORD_SIZE);
+      for (auto &kv : entries_) {
+        encode(kv.first, kv.second.seen, rec);
+        b.records.insert(b.records.end(), rec, rec + RECORD_SIZE);
+      }
+    } else {
+      b.records.reserve(dirty_.size() * RECORD_SIZE);
+      for (uint64_t mac : dirty_) {
+        encode(mac, entries_[mac].seen, rec);
+        b.records.insert(b.records.end(), rec, rec + RECORD_SIZE);
+      }
+    }
+    for (uint64_t mac : dirty_) {
+      Entry &e = entries_[mac];
+      e.persisted = e.seen;
+      e.dirty = false;
+    }
+    b.dirty.swap(dirty_);
+    dirty_.clear();
+    return true;
+  }
+
+  // Appends the batch, or rewrites the file with it through the temp file
+  // as compact() does. Touches the file only, not the entries.
+  void writeFlush(FlushBatch &b) const {
+    String tmp = tmpPath();
+    bool fresh = b.compact || !fs_->exists(path_);
+    File f = fs_->open(b.compact ? tmp.c_str() : path_, b.compact ? "w" : "a");
+    if (!f)
+      return;
+    if (fresh)
+      b.written += f.write(magic(), 4);
+    b.written += f.write(b.records.data(), b.records.size());
+    f.close();
+    b.landed = b.written == (fresh ? 4 : 0) + b.records.size() &&
+               (!b.compact || fs_->rename(tmp.c_str(), path_));
+  }
+
+  void endFlush(FlushBatch &b) {
+    if (b.epoch != epoch_) {
+      if (b.landed)
+        fs_->remove(path_); // cleared meanwhile: the batch is stale
+      return;
+    }
+    bytesWritten += b.written;
+    if (!b.landed) {
+      for (uint64_t mac : b.dirty) {
+        auto it = entries_.find(mac);
+        if (it != entries_.end() && !it->second.dirty) {
+          it->second.dirty = true;
+          dirty_.push_back(mac);
+        }
+      }
+      return;
+    }
+    if (b.compact) {
+      fileRecords_ = b.records.size() / RECORD_SIZE;
+      compactions++;
+    } else {
+      fileRecords_ += b.records.size() / RECORD_SIZE;
+    }
+  }
+
+  // Rewrites the file with exactly one record per MAC. Returns false, with
+  // the journal and the dirty set unchanged, if the rewrite did not land.
+  bool compact() {
+    String tmp = tmpPath();
+    File f = fs_->open(tmp.c_str(), "w");
+    if (!f)
+      return false;
+    size_t written = f.write(magic(), 4);
+    uint8_t rec[RECORD_SIZE];
+    for (auto &kv : entries_) {
+      encode(kv.first, kv.second.seen, rec);
+      written += f.write(rec, RECORD_SIZE);
+    }
+    f.close();
+    bytesWritten += written;
+    if (written != 4 + entries_.size() * RECORD_SIZE ||
+        !fs_->rename(tmp.c_str(), path_))
+      return false;
+    for (auto &kv : entries_) {
+      kv.second.persisted = kv.second.seen;
+      kv.second.dirty = false;
+    }
+    fileRecords_ = entries_.size();
+    dirty_.clear();
+    compactions++;
+    return true;
+  }
+
+  void clear() {
+    epoch_++;
+    entries_.clear();
+    dirty_.clear();
+    fs_->remove(path_);
+    fileRecords_ = 0;
+  }
+
+  // Used once to import the former NVS "lastseen" JSON.
+  void import(uint64_t mac, time_t ts) {
+    Entry &e = entries_[mac];
+    e.seen = (uint32_t)ts;
+  }
+
+  uint32_t bytesWritten = 0;
+  uint32_t compactions = 0;
+  uint32_t repairs = 0; // damaged files rewritten by load()
+  size_t fileRecords() const { return fileRecords_; }
+
+private:
+  String tmpPath() const { return String(path_) + ".tmp"; }
+
+  static const uint8_t *magic() {
+    static const uint8_t MAGIC[4] = {'L', 'S', 'J', '1'};
+    return MAGIC;
+  }
+
+  struct Entry {
+    uint32_t seen = 0;
+    uint32_t persisted = 0;
+    bool dirty = false;
+  };
+
+  static void encode(uint64_t mac, uint32_t ts, uint8_t *rec) {
+    for (int b = 0; b < 6; b++)
+      rec[b] = (uint8_t)(mac >> (40 - 8 * b));
+    rec[6] = (uint8_t)ts;
+    rec[7] = (uint8_t)(ts >> 8);
+    rec[8] = (uint8_t)(ts >> 16);
+    rec[9] = (uint8_t)(ts >> 24);
+  }
+
+  fs::FS *fs_ = nullptr;
+  const char *path_ = nullptr;
+  uint32_t resolution_ = 60;
+  std::map<uint64_t, Entry> entries_;
+  std::vector<uint64_t> dirty_;
+  size_t fileRecords_ = 0;
+  uint32_t epoch_ = 0; // clear() count, to spot a stale FlushBatch
+};
+
+#endif // LASTSEEN_JOURNAL_H
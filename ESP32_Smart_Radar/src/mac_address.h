@@ -0,0 +1,52 @@
+#ifndef MAC_ADDRESS_H
+#define MAC_ADDRESS_H
+
+#include <stdint.h>
+
+// MAC addresses are handled as 48-bit integers in display order:
+// "AA:BB:CC:DD:EE:FF" <-> 0xAABBCCDDEEFF (same value as NimBLEAddress's
+// uint64_t conversion). The OUI prefix is therefore (mac >> 24).
+
+inline int hexNibble(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+// Accepts "AA:BB:CC:DD:EE:FF", "aa-bb-cc-dd-ee-ff" or "AABBCCDDEEFF".
+inline bool parseMac(const char *s, uint64_t &out) {
+  if (s == nullptr)
+    return false;
+  uint64_t v = 0;
+  int digits = 0;
+  for (; *s; s++) {
+    if (*s == ':' || *s == '-')
+      continue;
+    int n = hexNibble(*s);
+    if (n < 0 || digits == 12)
+      return false;
+    v = (v << 4) | (uint64_t)n;
+    digits++;
+  }
+  if (digits != 12)
+    return false;
+  out = v;
+  return true;
+}
+
+// Writes "AA:BB:CC:DD:EE:FF" into out (at least 18 bytes).
+inline void formatMac(uint64_t mac, char *out) {
+  static const char HEX_DIGITS[] = "0123456789ABCDEF";
+  for (int i = 0; i < 6; i++) {
+    uint8_t b = (uint8_t)(mac >> (40 - 8 * i));
+    out[i * 3] = HEX_DIGITS[b >> 4];
+    out[i * 3 + 1] = HEX_DIGITS[b & 0x0F];
+    out[i * 3 + 2] = (i < 5) ? ':' : '\0';
+  }
+}
+
+#endif // MAC_ADDRESS_H
@@ -0,0 +1,169 @@
+#ifndef MAC_SET_H
+#define MAC_SET_H
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+// Set of 48-bit MACs with O(log n) membership, for the whitelist.
+// The MACs are packed in 6 bytes each, in insertion order (for the UI and
+// for persistence), and a 16-bit index sorted by MAC serves lookups
+// (binary search, no allocation, no string compares): 8 B per entry, so at
+// most MAX_CAPACITY entries. Updates are O(n) but only happen on user
+// actions. A set is built with the capacity it may grow to.
+class MacSet {
+public:
+  static const size_t BYTES_PER_ENTRY = 8;
+  static const size_t MAX_CAPACITY = 0xFFFF;
+
+  explicit MacSet(size_t capacity)
+      : capacity_(std::min(capacity, MAX_CAPACITY)) {}
+
+  bool contains(uint64_t mac) const {
+    auto it = lowerBound(mac);
+    return it != sorted_.end() && at(*it) == mac;
+  }
+
+  // Returns false if mac was already present or the set is full().
+  bool add(uint64_t mac) {
+    auto it = lowerBound(mac);
+    if ((it != sorted_.end() && at(*it) == mac) || full())
+      return false;
+    sorted_.insert(it, (uint16_t)order_.size());
+    order_.push_back(pack(mac));
+    return true;
+  }
+
+  bool remove(uint64_t mac) {
+    auto it = lowerBound(mac);
+    if (it == sorted_.end() || at(*it) != mac)
+      return false;
+    uint16_t index = *it;
+    sorted_.erase(it);
+    order_.erase(order_.begin() + index);
+    for (uint16_t &i : sorted_)
+      i -= (i > index);
+    return true;
+  }
+
+  // Replaces the content with the first capacity() distinct items, keeping
+  // the first of any duplicates; O(n log n), for loading a stored list
+  // (add() per entry is O(n^2)).
+  void assign(const std::vector<uint64_t> &items) {
+    std::vector<uint64_t> distinct = items;
+    std::sort(distinct.begin(), distinct.end());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()),
+                   distinct.end());
+    std::vector<bool> taken(distinct.size());
+    order_.clear();
+    order_.reserve(std::min(distinct.size(), capacity_));
+    for (uint64_t mac : items) {
+      if (full())
+        break;
+      size_t i = std::lower_bound(distinct.begin(), distinct.end(), mac) -
+                 distinct.begin();
+      if (!taken[i]) {
+        taken[i] = true;
+        order_.push_back(pack(mac));
+      }
+    }
+    sorted_.resize(order_.size());
+    for (size_t i = 0; i < sorted_.size(); i++)
+      sorted_[i] = (uint16_t)i;
+    std::sort(sorted_.begin(), sorted_.end(),
+              [this](uint16_t a, uint16_t b) { return at(a) < at(b); });
+  }
+
+  void clear() {
+    sorted_.clear();
+    order_.clear();
+  }
+
+  void reserve(size_t n) {
+    n = std::min(n, capacity_);
+    sorted_.reserve(n);
+    order_.reserve(n);
+  }
+
+  size_t size() const { return order_.size(); }
+  bool empty() const { return order_.empty(); }
+  bool full() const { return order_.size() >= capacity_; }
+  size_t capacity() const { return capacity_; }
+
+  // Entries in insertion order.
+  class Items {
+  public:
+    class iterator {
+    public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef uint64_t value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const uint64_t *pointer;
+      typedef uint64_t reference;
+
+      iterator(const MacSet *set, size_t i) : set_(set), i_(i) {}
+      uint64_t operator*() const { return set_->at(i_); }
+      iterator &operator++() {
+        i_++;
+        return *this;
+      }
+      bool operator==(const iterator &o) const { return i_ == o.i_; }
+      bool operator!=(const iterator &o) const { return i_ != o.i_; }
+
+    private:
+      const MacSet *set_;
+      size_t i_;
+    };
+
+    explicit Items(const MacSet &set) : set_(set) {}
+    iterator begin() const { return iterator(&set_, 0); }
+    iterator end() const { return iterator(&set_, set_.size()); }
+    size_t size() const { return set_.size(); }
+    uint64_t operator[](size_t i) const { return set_.at(i); }
+
+  private:
+    const MacSet &set_;
+  };
+  Items items() const { return Items(*this); }
+
+private:
+  struct Packed {
+    uint8_t b[6]; // big-endian
+  };
+
+  static Packed pack(uint64_t mac) {
+    Packed p;
+    for (size_t i = 0; i < 6; i++)
+      p.b[i] = (uint8_t)(mac >> (40 - 8 * i));
+    return p;
+  }
+
+  // Two loads rather than six: this runs at every step of the search
+  uint64_t at(size_t i) const {
+    const uint8_t *b = order_[i].b;
+    uint32_t hi;
+    uint16_t lo;
+    memcpy(&hi, b, 4);
+    memcpy(&lo, b + 4, 2);
+    return (uint64_t)__builtin_bswap32(hi) << 16 | __builtin_bswap16(lo);
+  }
+
+  std::vector<uint16_t>::const_iterator lowerBound(uint64_t mac) const {
+    return std::lower_bound(
+        sorted_.begin(), sorted_.end(), mac,
+        [this](uint16_t i, uint64_t key) { return at(i) < key; });
+  }
+  std::vector<uint16_t>::iterator lowerBound(uint64_t mac) {
+    return std::lower_bound(
+        sorted_.begin(), sorted_.end(), mac,
+        [this](uint16_t i, uint64_t key) { return at(i) < key; });
+  }
+
+  size_t capacity_;
+  std::vector<uint16_t> sorted_; // indexes into order_, by MAC
+  std::vector<Packed> order_;
+};
+
+#endif // MAC_SET_H
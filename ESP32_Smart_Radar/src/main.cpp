@@ -8,6 +8,9 @@
 #include <NimBLEDevice.h>
 #include <Preferences.h>
 #include <WiFi.h>
+#include <atomic>
+#include <esp_heap_caps.h>
+#include <memory>
 #include <time.h>
 
 
@@ -24,6 +27,11 @@ const long GMT_OFFSET_SEC = 3600;     // UTC+1 (France)
 const int DAYLIGHT_OFFSET_SEC = 3600; // +1h summer
 
 // Timing configurable parameters
+// Continuous mode only stops the scan while a GATT connection is set up
+// (GATT_GAP_MAX_MS at most, no restart every cycle) and adapts the scan
+// window to web traffic, see SCAN_PROFILES.
+// false = former duty cycle: scan SCAN_TIME, pause PAUSE_TIME.
+const bool CONTINUOUS_SCAN = true;
 const int SCAN_TIME = 10; // Seconds to scan BLE
 const int PAUSE_TIME = 2; // Pause between scans to give WiFi room to breathe
 
@@ -40,42 +48,305 @@ IPAddress secondaryDNS(8, 8, 4, 4); // Optional
 AsyncWebServer server(80);
 NimBLEScan *pBLEScan;
 Preferences preferences;
-
+uint32_t nvsWrites = 0; // Preferences commits since boot
+
+#include "adv_trace.h"
+#include "alert_batcher.h"
+#include "api_json.h"
+#include "ble_event.h"
+#include "ble_record.h"
+#include "change_log.h"
+#include "crowd_sim.h"
+#include "device_table.h"
+#include "expiry_wheel.h"
+#include "gatt_cache.h"
+#include "hot_path_stats.h"
+#include "lastseen_journal.h"
+#include "mac_address.h"
+#include "mac_set.h"
+#include "presence.h"
+#include "scan_stats.h"
 #include "progmem_vendors.h"
-
-// Store recently detected devices (short memory for the UI)
-struct BleDeviceData {
-  String address;
-  String name;
-  int rssi;
-  String vendor;
-  String addressType;
-  int txPower;
-  String serviceUUIDs;
-  String manufacturerData;
-  uint16_t appearance;
-  String gattName;     // Name read via GATT connection
-  int8_t batteryLevel; // Battery % read via GATT (-1 = unknown)
-  bool gattAttempted;  // Avoid retrying indefinitely
-  unsigned long lastSeen;
+#include "radar_clock.h"
+#include "spsc_ring.h"
+#include "vendor_cache.h"
+
+// Time base of everything that compares sighting times (see radar_clock.h):
+// real time, or virtual time while a replay or simulation runs at speed 0.
+uint32_t radarMillis() { return millis(); }
+time_t radarEpoch() { return time(nullptr); }
+RadarClock radarClock(radarMillis, radarEpoch);
+
+// Hot path timings, reported by /api/stats with the number of samples over
+// budget (see hot_path_stats.h). Budgets are in us, about 10x the typical
+// cost at 240 MHz, so `over` > 0 means a regression or a stall. Every
+// field is spelled out: HotPath stays an aggregate under gnu++11.
+HotPath hpOnResult = {"onResult", 20, 0, 0, 0, 0, 0};
+HotPath hpApplyAdvert = {"applyBleEvent", 300, 0, 0, 0, 0, 0};
+HotPath hpVendorLookup = {"vendorLookup", 50, 0, 0, 0, 0, 0};
+HotPath hpWhitelist = {"isWhitelisted", 5, 0, 0, 0, 0, 0};
+HotPath hpDevicesChunk = {"devicesChunk", 3000, 0, 0, 0, 0, 0};
+HotPath hpLastSeenFlush = {"lastSeenFlush", 50000, 0, 0, 0, 0, 0};
+HotPath *const HOT_PATHS[] = {&hpOnResult,     &hpApplyAdvert,
+                              &hpVendorLookup, &hpWhitelist,
+                              &hpDevicesChunk, &hpLastSeenFlush};
+uint32_t cpuCyclesPerUs = 240;
+
+// Adds the lifetime of the enclosing scope to a HotPath.
+struct HotPathTimer {
+  HotPath &path;
+  uint32_t start;
+  explicit HotPathTimer(HotPath &p) : path(p), start(ESP.getCycleCount()) {}
+  ~HotPathTimer() { path.add(ESP.getCycleCount() - start); }
 };
-std::vector<BleDeviceData> detectedDevices;
 
-// Store known whitelist internally
-std::vector<String> whitelist;
+const char *timedVendorLookup(uint32_t oui) {
+  HotPathTimer timer(hpVendorLookup);
+  return getVendorFromPROGMEM(oui);
+}
+
+// RAM cache in front of the flash OUI search (64 entries)
+VendorCache<32> vendorCache(timedVendorLookup);
+
+// Store recently detected devices (short memory for the UI).
+// BleDeviceData is a POD record (see ble_record.h);
+// preallocated, keyed on the 48-bit MAC; the least recently seen device is
+// evicted when full. Capacity is a build option (RADAR_MAX_DEVICES, see
+// platformio.ini): the records go to PSRAM when the board has some, the
+// index, LRU links, timers and change log stay in internal RAM.
+#ifndef RADAR_MAX_DEVICES
+#define RADAR_MAX_DEVICES 64
+#endif
+const uint16_t MAX_DEVICES = RADAR_MAX_DEVICES;
+DeviceTable<BleDeviceData, MAX_DEVICES> detectedDevices;
+bool deviceRecordsInPsram = false;
+
+// Concurrency: onResult (NimBLE host task) never touches shared state, it
+// only copies each advert into bleEvents, a lock-free SPSC ring that loop()
+// drains. Everything else (device table, change log, whitelist, lastSeen,
+// alerts, wlMetaMap) is guarded by stateMutex, taken by loop(), the web
+// handlers (AsyncTCP task) and the GATT worker -- never by the BLE path.
+// Adverts that do not come from the radio enter through advertSource,
+// polled by loop() itself, and go through the same applyBleEvent(); a
+// source standing in for the radio goes through onResult() and bleEvents,
+// with the scan off so that the ring keeps a single producer.
+// loop() holds stateMutex only for the state: what it decides there (scan
+// start/stop, the GATT hand-off, push events, flash writes) is captured and
+// carried out after it releases the lock.
+SpscRing<BleEvent, 64> bleEvents; // onResult -> loop
+AdvertSource *advertSource = nullptr;
+const uint16_t ADVERT_SOURCE_BATCH = 32; // per loop() pass
+SemaphoreHandle_t stateMutex;
+
+// Holds stateMutex for the enclosing scope.
+struct StateLock {
+  StateLock() { xSemaphoreTake(stateMutex, portMAX_DELAY); }
+  ~StateLock() { xSemaphoreGive(stateMutex); }
+};
 
-// Keep track of alert cooldown
-unsigned long lastAlertTime = 0;
-const unsigned long ALERT_COOLDOWN = 60000; // 1 min between identical alerts
+// Devices seen within DEVICE_VISIBLE_MS are listed by /api/devices. Each
+// visible change takes a sequence number so that ?since=<seq> only returns
+// what changed; RSSI jitter below RSSI_CHANGE_DB is not a change. Devices
+// not seen for DEVICE_RETAIN_MS are forgotten.
+const unsigned long DEVICE_VISIBLE_MS = 60000;
+const unsigned long DEVICE_RETAIN_MS = 120000;
+const int RSSI_CHANGE_DB = 4;
+ChangeLog<MAX_DEVICES> deviceChanges;
+
+// Live push channel (Server-Sent Events on /api/events). Nothing is sent
+// from the BLE callback: loop() pushes each client the device changes since
+// its own cursor every PUSH_INTERVAL_MS, so bursts coalesce into one event
+// per device, and skips clients whose send queue is backed up. Intrusions
+// are pushed as soon as loop() applies the advert that revealed them.
+AsyncEventSource events("/api/events");
+struct PushClient {
+  AsyncEventSourceClient *client;
+  uint32_t seq;  // last ChangeLog sequence delivered, 0 until placed
+  bool resync;   // must refetch /api/devices before deltas make sense
+};
+std::vector<PushClient> pushClients;
+SemaphoreHandle_t pushLock;
+// Events are rendered under StateLock into pushOutbox and sent by loop()
+// once it has released the lock (sendPushOutbox), so no client queue is
+// fed while the radar state is held. client nullptr: every client.
+struct PushOutbox {
+  struct Item {
+    AsyncEventSourceClient *client;
+    const char *event;
+    uint32_t id;
+    size_t offset; // of the NUL-terminated data in text
+  };
+  std::vector<Item> items;
+  std::vector<char> text;
+
+  void add(AsyncEventSourceClient *client, const char *event, const char *data,
+           uint32_t id = 0) {
+    items.push_back({client, event, id, text.size()});
+    text.insert(text.end(), data, data + strlen(data) + 1);
+  }
+  void clear() {
+    items.clear();
+    text.clear();
+  }
+};
+PushOutbox pushOutbox;
+const unsigned long PUSH_INTERVAL_MS = 250;
+const size_t PUSH_MAX_BACKLOG = 8;   // queued packets before a client waits
+const uint16_t PUSH_MAX_EVENTS = 16; // per client and tick, else "resync"
+unsigned long lastPush = 0;
+uint32_t pushSkipped = 0;
+uint32_t pushResyncs = 0;
+
+// Presence state machine (see presence.h): "arrived" / "left" events for
+// the alert path and the API.
+const PresenceConfig PRESENCE = {
+    3000,  // enterDwellMs
+    10000, // candidateSilenceMs
+    20000, // leaveSilenceMs
+    30000, // exitDwellMs
+    -88,   // enterDbm
+    -94,   // exitDbm
+};
+uint32_t presenceArrivals = 0;
+uint32_t presenceDepartures = 0;
+
+// Advert traces (see adv_trace.h). While recording, loop() appends every
+// radio advert it applies to TRACE_PATH. A replay clears the radar state
+// and feeds the trace back through advertSource, at its recorded pace times
+// `speed`, or with speed 0 in virtual time: the clock jumps from one advert
+// (or timer deadline) to the next, so hours of traffic replay in minutes
+// with the same presence and expiry sequence. Radio adverts are discarded
+// meanwhile, Eedomus is not notified and lastSeen goes to a scratch
+// journal. The replay reports its throughput, memory, flash and NVS writes
+// and the first TRACE_TIMELINE_MAX device events it produced, so two
+// firmware builds can be compared on identical traffic. Any other
+// AdvertSource run (the crowd generator) goes through the same report.
+const char *TRACE_PATH = "/trace.bin";
+const uint32_t TRACE_MAX_BYTES = 512 * 1024;
+const size_t TRACE_TIMELINE_MAX = 64;
+const uint32_t VIRTUAL_STEP_MS = 250;  // one deviceTimers tick
+const uint16_t VIRTUAL_BATCH = 256;    // steps per loop() pass
+TraceWriter traceWriter;
+TraceReplay traceReplay;
+LastSeenJournal runLastSeen; // lastSeen of the running replay
+struct ReplayEvent {
+  uint32_t ms; // radar time since the start of the replay
+  uint64_t mac;
+  const char *event; // "arrived", "left", "alert"
+};
+struct ReplayReport {
+  bool running;
+  const char *source; // AdvertSource::name()
+  uint16_t speed;     // 0 = virtual time
+  uint32_t startMs;   // radarClock
+  uint32_t wallStartMs;
+  uint32_t durationMs;  // wall time
+  uint32_t simulatedMs; // radar time, > durationMs in virtual time
+  uint32_t adverts;
+  uint16_t peakDevices;
+  uint32_t arrivals;
+  uint32_t departures;
+  uint32_t alerts;
+  uint32_t alertMinute; // alert storm: most alerts in one radar minute
+  uint32_t alertsInMinute;
+  uint32_t peakAlertsPerMin;
+  uint32_t evictions;     // devices pushed out of a full table
+  uint32_t evictionBase;  // deviceEvictions at the start
+  uint32_t heapStart;
+  uint32_t heapMin;
+  uint32_t nvsWrites;
+  uint32_t nvsBase;
+  uint32_t flashBytes; // lastSeen journal bytes, scratch journal
+  uint32_t compactions;
+  uint32_t lastMaintenance; // radar time of the last scratch journal flush
+  uint32_t timelineDropped;
+  std::vector<ReplayEvent> timeline;
+};
+ReplayReport replayReport = {};
+
+// Synthetic crowd for load tests (see crowd_sim.h), built with
+// -DRADAR_CROWD_SIM: up to 512 simultaneous phones and beacons, started by
+// POST /api/sim/crowd and reported like a trace replay.
+#ifdef RADAR_CROWD_SIM
+CrowdGenerator<512> crowdSim;
+#endif
+
+// Every per-device deadline lives in one timer wheel (see expiry_wheel.h),
+// one entry per table slot and kind, so expiry costs O(due) instead of
+// sweeping the table. Deadlines are lazy: sightings only push them later,
+// and a timer that fires early re-arms itself.
+enum TimerKind : uint8_t {
+  TIMER_PRESENCE, // next presence transition
+  TIMER_VISIBLE,  // leaves the /api/devices list
+  TIMER_RETAIN,   // forgotten
+  TIMER_REARM,    // intrusion alert re-armed after leaving
+  TIMER_KINDS
+};
+ExpiryWheel<MAX_DEVICES * TIMER_KINDS, 256> deviceTimers(250); // 64 s horizon
+
+// Store known whitelist internally (normalized 48-bit MACs, O(log n) lookup).
+// MacSet::BYTES_PER_ENTRY (8 B) of RAM per entry: 80 KB when full; wlMetaMap
+// only holds the entries added from a live device.
+const size_t WHITELIST_MAX = 10000;
+MacSet whitelist(WHITELIST_MAX);
+
+// Eedomus notifications run on their own task: loop() only posts the MAC
+// to alertQueue (never blocks), the task batches intruders and retries
+const unsigned long ALERT_COOLDOWN = 60000; // 1 min between notifications
+const unsigned long ALERT_COALESCE_MS = 500; // gather intruders seen together
+// An intruder that left and stayed away this long alerts again on return.
+// Must end before DEVICE_RETAIN_MS forgets it (it left after 50 s silent).
+const unsigned long ALERT_REARM_MS = 60000;
+QueueHandle_t alertQueue;
+AlertBatcher alertBatcher(ALERT_COOLDOWN, ALERT_COALESCE_MS);
+uint32_t alertQueueDrops = 0;
+
+// Scan profiles (ms). The 97 ms interval stays off the 102.4 ms WiFi
+// beacon period; the window is the share of each interval given to BLE,
+// the remainder is left to WiFi by the coexistence arbiter.
+struct ScanProfile {
+  const char *name;
+  uint16_t intervalMs;
+  uint16_t windowMs;
+};
+const ScanProfile SCAN_PROFILES[] = {
+    {"idle", 97, 85},   // no web client
+    {"normal", 97, 60}, // page open / SSE client connected
+    {"busy", 97, 37},   // sustained HTTP traffic (former fixed setting)
+};
+const unsigned long SCAN_ADAPT_MS = 5000;
+const uint32_t SCAN_BUSY_REQUESTS = 10; // per SCAN_ADAPT_MS (2 req/s)
+const uint8_t SCAN_CALM_PERIODS = 3; // quiet periods before widening again
+const unsigned long MAINTENANCE_MS = (SCAN_TIME + PAUSE_TIME) * 1000;
+uint8_t scanProfile = 2;
+uint8_t calmPeriods = 0;
+unsigned long lastScanAdapt = 0;
+unsigned long lastMaintenance = 0;
+uint32_t httpRequests = 0; // /api requests, counted under stateMutex
+uint32_t lastPushSkipped = 0;
+uint32_t scanRestarts = 0;
+SightingGaps sightingGaps;
+// Devices pushed out of a full table, and how many of them were present:
+// the sign that RADAR_MAX_DEVICES is too small for the crowd around
+uint32_t deviceEvictions = 0;
+uint32_t presentEvictions = 0;
+// Radio time: scanning vs GATT connections (ms since boot)
+unsigned long scanOnSince = 0;
+uint64_t scanRadioMs = 0;
+uint64_t gattRadioMs = 0;
 
 // Flags
 bool scanInProgress = false;
 unsigned long scanStartTime = 0;
 bool surveillanceActive = false;
-std::vector<String> alertedMacs;
+// MACs alerted since the last arming, until re-armed (TIMER_REARM) or
+// forgotten with their record: never more than MAX_DEVICES entries.
+MacSet alertedMacs(MAX_DEVICES);
 
-// LastSeen timestamps: mac -> unix timestamp
-std::map<String, time_t> lastSeenMap;
+// LastSeen timestamps of whitelisted MACs: append-only journal on LittleFS,
+// written once per scan cycle and only for entries that moved >= 60 s
+LastSeenJournal lastSeen;
+const uint32_t LASTSEEN_RESOLUTION_SEC = 60;
 
 // Whitelist enriched metadata: mac -> {name, vendor}
 struct WlMeta {
@@ -83,22 +354,64 @@ struct WlMeta {
   String vendor;
   String mfgData;
 };
-std::map<String, WlMeta> wlMetaMap;
+std::map<uint64_t, WlMeta> wlMetaMap;
+
+WlMeta wlMetaFrom(const BleDeviceData &dev) {
+  char mfgHex[2 * BLE_MFG_MAX + 1];
+  formatMfgHex(dev, mfgHex);
+  WlMeta m;
+  m.name = dev.gattName[0] ? dev.gattName : deviceDisplayName(dev);
+  m.vendor = dev.vendor ? dev.vendor : "N/A";
+  m.mfgData = mfgHex;
+  return m;
+}
 
-// GATT FreeRTOS task
+// GATT enrichment (Device Name 0x2A00, Battery Level 0x2A19). Setting up a
+// connection takes the radio away from scanning, so it is only made in a
+// scan gap: the pause of the duty cycle or, in continuous mode, a gap opened
+// at most once per GATT_PERIOD_MS and closed within GATT_GAP_MAX_MS (its
+// time counts in the detectLatencyMs estimate). One connection at a time, to the candidate with the
+// best gattPriority(); each device gets GATT_MAX_ATTEMPTS tries,
+// GATT_RETRY_MS apart. The worker names its target by DeviceHandle, so a
+// device evicted meanwhile is detected, not confused with whatever reused
+// its slot. Results of stable addresses go to gattCache, so a device that
+// comes back after eviction (or a reboot) is not reconnected until its
+// entry is GATT_CACHE_TTL_SEC old.
+const bool GATT_ENABLED = true;
+const unsigned long GATT_PERIOD_MS = 15000;
+const uint8_t GATT_MAX_ATTEMPTS = 2;
+const unsigned long GATT_RETRY_MS = 60000;
+const int GATT_MIN_RSSI = -80; // weaker links rarely connect within 2 s
+const uint32_t GATT_CONNECT_TIMEOUT_S = 2;
+// The scan stops only while a connection is set up: it resumes once the
+// link is up, reads then sharing the radio with it, and at the latest
+// GATT_GAP_MAX_MS of radar time after it stopped, however long the worker
+// takes.
+const uint32_t GATT_GAP_MAX_MS = GATT_CONNECT_TIMEOUT_S * 1000 + 250;
+const int GATT_NOVELTY_BONUS = 40;  // nothing known about the device yet
+const int GATT_STRANGER_BONUS = 20; // not whitelisted: the name matters more
+const uint32_t GATT_CACHE_TTL_SEC = 24 * 3600;
+GattCache<128> gattCache;
 QueueHandle_t gattQueue;
 struct GattTask {
-  int devIndex;
+  DeviceHandle handle;
 };
 
-bool gattTaskRunning = false;
-bool lastSeenDirty = false; // NVS flush only when map changed
+std::atomic<bool> gattTaskRunning{false};
+std::atomic<bool> gattConnecting{false}; // the scan gap is still needed
+bool gattGapOpen = false; // scan stopped for a connection, since gattGapSince
+uint32_t gattGapSince = 0;
+unsigned long lastGatt = 0;
+uint32_t gattConnects = 0;
+uint32_t gattFailures = 0;
+uint32_t gattStale = 0; // device evicted while its connection ran
+uint32_t gattCacheSkips = 0; // connections avoided thanks to gattCache
 
 // ------------------------------------------------------------------
 // FORWARD DECLARATIONS
 // ------------------------------------------------------------------
-void saveLastSeen(const String &mac);
 void loadLastSeen();
+void saveWhitelist();
 void saveWlMeta();
 void loadWlMeta();
 
@@ -106,287 +419,746 @@ void loadWlMeta();
 // HELPERS
 // ------------------------------------------------------------------
 
+// Whitelist persistence: WHITELIST_PATH on LittleFS holds packed 6-byte
+// big-endian MACs in insertion order, and scales to tens of thousands of
+// entries (the 20 KB NVS partition cannot). LittleFS replaces a file
+// atomically when it is closed. The legacy NVS "whitelist" JSON array is
+// still written, with as many entries as fit in an NVS string, so older
+// firmware flashed back keeps the list (or its first entries). Without the
+// file, NVS "wlbin" then "whitelist" are read once and moved to it.
+const char *WHITELIST_PATH = "/whitelist.bin";
+const size_t NVS_STR_MAX = 4000;
+const size_t WL_JSON_ENTRY = 20; // "AA:BB:CC:DD:EE:FF",
+
+uint64_t macFromBytes(const uint8_t *b) {
+  uint64_t mac = 0;
+  for (size_t i = 0; i < 6; i++)
+    mac = (mac << 8) | b[i];
+  return mac;
+}
+
+void macToBytes(uint64_t mac, uint8_t *b) {
+  for (size_t i = 0; i < 6; i++)
+    b[i] = (uint8_t)(mac >> (40 - 8 * i));
+}
+
+// Capacity for deserializing a JSON array of n MAC strings (or an object
+// of n small objects), strings copied: sized from the text, never capped.
+size_t jsonCapacityFor(const String &json, char separator, size_t perItem) {
+  size_t items = 1;
+  for (const char *c = json.c_str(); *c; c++)
+    items += (*c == separator);
+  return items * perItem + json.length() + 64;
+}
+
 void loadWhitelist() {
   preferences.begin("radar", false);
-  String wlstr = preferences.getString("whitelist", "[]");
   surveillanceActive = preferences.getBool("surveillance", false);
   preferences.end();
 
-  DynamicJsonDocument doc(2048);
-  deserializeJson(doc, wlstr);
-  JsonArray arr = doc.as<JsonArray>();
-
-  whitelist.clear();
-  for (JsonVariant v : arr) {
-    whitelist.push_back(v.as<String>());
+  std::vector<uint64_t> macs;
+  File f = LittleFS.open(WHITELIST_PATH, "r");
+  if (f) {
+    macs.reserve(f.size() / 6);
+    uint8_t buf[64 * 6];
+    size_t n;
+    while ((n = f.read(buf, sizeof(buf))) >= 6)
+      for (size_t i = 0; i + 6 <= n; i += 6)
+        macs.push_back(macFromBytes(buf + i));
+    f.close();
+    whitelist.assign(macs);
+    return;
   }
-}
 
-void saveWhitelist() {
-  DynamicJsonDocument doc(2048);
-  JsonArray arr = doc.to<JsonArray>();
-  for (String m : whitelist) {
-    arr.add(m);
-  }
-  String output;
-  serializeJson(doc, output);
+  // No file yet: import from NVS, packed "wlbin" first
   preferences.begin("radar", false);
-  preferences.putString("whitelist", output);
+  size_t binLen = preferences.getBytesLength("wlbin");
+  std::vector<uint8_t> bin(binLen);
+  if (binLen > 0)
+    preferences.getBytes("wlbin", bin.data(), binLen);
+  String wlstr = binLen > 0 ? String("[]")
+                            : preferences.getString("whitelist", "[]");
   preferences.end();
+
+  for (size_t i = 0; i + 6 <= binLen; i += 6)
+    macs.push_back(macFromBytes(&bin[i]));
+  DynamicJsonDocument doc(
+      jsonCapacityFor(wlstr, ',', JSON_ARRAY_SIZE(1)));
+  deserializeJson(doc, wlstr);
+  for (JsonVariant v : doc.as<JsonArray>()) {
+    uint64_t mac;
+    if (parseMac(v.as<const char *>(), mac))
+      macs.push_back(mac);
+  }
+  whitelist.assign(macs);
+  if (!whitelist.empty())
+    saveWhitelist();
 }
 
-void saveLastSeen(const String &mac) {
-  time_t now;
-  time(&now);
-  if (now < 100000)
-    return; // NTP not synced
-  lastSeenMap[mac] = now;
-  DynamicJsonDocument doc(4096);
-  JsonObject obj = doc.to<JsonObject>();
-  for (auto &kv : lastSeenMap) {
-    obj[kv.first] = (long)kv.second;
+void saveWhitelist() {
+  MacSet::Items items = whitelist.items();
+  File f = LittleFS.open(WHITELIST_PATH, "w");
+  if (f) {
+    uint8_t buf[64 * 6];
+    size_t used = 0;
+    for (uint64_t mac : items) {
+      macToBytes(mac, buf + used);
+      used += 6;
+      if (used == sizeof(buf)) {
+        f.write(buf, used);
+        used = 0;
+      }
+    }
+    f.write(buf, used);
+    f.close();
+  } else {
+    Serial.println("Cannot write the whitelist file");
   }
+
+  // Legacy JSON copy, cut to the entries that fit in an NVS string
+  size_t fit = std::min(items.size(), (NVS_STR_MAX - 2) / WL_JSON_ENTRY);
   String output;
-  serializeJson(doc, output);
+  output.reserve(fit * WL_JSON_ENTRY + 2);
+  output += '[';
+  char macStr[18];
+  for (size_t i = 0; i < fit; i++) {
+    formatMac(items[i], macStr);
+    if (i)
+      output += ',';
+    output += '"';
+    output += macStr;
+    output += '"';
+  }
+  output += ']';
+
   preferences.begin("radar", false);
-  preferences.putString("lastseen", output);
+  preferences.putString("whitelist", output);
+  preferences.remove("wlbin"); // superseded by the file
   preferences.end();
+  nvsWrites++;
 }
 
 void loadLastSeen() {
+  lastSeen.begin(LittleFS, "/lastseen.bin", LASTSEEN_RESOLUTION_SEC);
+  if (lastSeen.load())
+    return;
+  // First boot with the journal: import the former NVS JSON once
   preferences.begin("radar", false);
   String lsStr = preferences.getString("lastseen", "{}");
-  preferences.end();
-  DynamicJsonDocument doc(4096);
+  // {"AA:..":1700000000,...}: six ':' per entry, sized from the text
+  DynamicJsonDocument doc(
+      jsonCapacityFor(lsStr, ':', (JSON_OBJECT_SIZE(1) + 5) / 6));
   deserializeJson(doc, lsStr);
   JsonObject obj = doc.as<JsonObject>();
   for (JsonPair kv : obj) {
-    lastSeenMap[String(kv.key().c_str())] = (time_t)kv.value().as<long>();
+    uint64_t mac;
+    if (parseMac(kv.key().c_str(), mac))
+      lastSeen.import(mac, (time_t)kv.value().as<long>());
   }
+  lastSeen.compact();
+  preferences.remove("lastseen");
+  preferences.end();
 }
 
+// Whitelist metadata on LittleFS (WLMETA_PATH): magic "WLM1", then per
+// entry the 6-byte MAC and name, vendor, mfgData as u8 length + bytes,
+// each cut to WL_META_STR_MAX. Written whole on each change (user actions
+// only), atomically on close. The former NVS "wlmeta" JSON is imported
+// once when the file is missing.
+const char *WLMETA_PATH = "/wlmeta.bin";
+const size_t WL_META_STR_MAX = 63;
+
 void saveWlMeta() {
-  DynamicJsonDocument doc(4096);
-  JsonObject root = doc.to<JsonObject>();
+  File f = LittleFS.open(WLMETA_PATH, "w");
+  if (!f) {
+    Serial.println("Cannot write the whitelist metadata file");
+    return;
+  }
+  f.write((const uint8_t *)"WLM1", 4);
+  uint8_t rec[6 + 3 * (1 + WL_META_STR_MAX)];
   for (auto &kv : wlMetaMap) {
-    JsonObject entry = root.createNestedObject(kv.first);
-    entry["n"] = kv.second.name;
-    entry["v"] = kv.second.vendor;
-    entry["m"] = kv.second.mfgData;
+    macToBytes(kv.first, rec);
+    size_t n = 6;
+    for (const String *str :
+         {&kv.second.name, &kv.second.vendor, &kv.second.mfgData}) {
+      size_t len = std::min((size_t)str->length(), WL_META_STR_MAX);
+      rec[n++] = (uint8_t)len;
+      memcpy(rec + n, str->c_str(), len);
+      n += len;
+    }
+    f.write(rec, n);
   }
-  String out;
-  serializeJson(doc, out);
-  preferences.begin("radar", false);
-  preferences.putString("wlmeta", out);
-  preferences.end();
+  f.close();
 }
 
 void loadWlMeta() {
+  wlMetaMap.clear();
+  File f = LittleFS.open(WLMETA_PATH, "r");
+  if (f) {
+    uint8_t magic[4];
+    if (f.read(magic, 4) == 4 && memcmp(magic, "WLM1", 4) == 0) {
+      uint8_t mac[6];
+      char str[WL_META_STR_MAX + 1];
+      while (f.read(mac, 6) == 6) {
+        WlMeta m;
+        bool ok = true;
+        for (String *out : {&m.name, &m.vendor, &m.mfgData}) {
+          uint8_t len;
+          ok = ok && f.read(&len, 1) == 1 && len <= WL_META_STR_MAX &&
+               f.read((uint8_t *)str, len) == len;
+          if (!ok)
+            break;
+          str[len] = '\0';
+          *out = str;
+        }
+        if (!ok)
+          break; // truncated or corrupt tail: keep what was read
+        wlMetaMap[macFromBytes(mac)] = m;
+      }
+    }
+    f.close();
+    return;
+  }
+
   preferences.begin("radar", false);
   String s = preferences.getString("wlmeta", "{}");
   preferences.end();
-  DynamicJsonDocument doc(4096);
+  // {"AA:..":{"n":..,"v":..,"m":..}}: at least four ':' per entry
+  DynamicJsonDocument doc(
+      jsonCapacityFor(s, ':', (JSON_OBJECT_SIZE(1) + JSON_OBJECT_SIZE(3)) / 4));
   deserializeJson(doc, s);
   JsonObject root = doc.as<JsonObject>();
   for (JsonPair kv : root) {
     WlMeta m;
-    m.name = kv.value()["n"].as<String>();
-    m.vendor = kv.value()["v"].as<String>();
-    m.mfgData = kv.value()["m"].as<String>();
-    wlMetaMap[String(kv.key().c_str())] = m;
+    m.name = kv.value()["n"].as<String>().substring(0, WL_META_STR_MAX);
+    m.vendor = kv.value()["v"].as<String>().substring(0, WL_META_STR_MAX);
+    m.mfgData = kv.value()["m"].as<String>().substring(0, WL_META_STR_MAX);
+    uint64_t mac;
+    if (parseMac(kv.key().c_str(), mac))
+      wlMetaMap[mac] = m;
   }
+  if (!wlMetaMap.empty())
+    saveWlMeta();
+  preferences.begin("radar", false);
+  preferences.remove("wlmeta");
+  preferences.end();
 }
 
 void saveSurveillance() {
   preferences.begin("radar", false);
   preferences.putBool("surveillance", surveillanceActive);
   preferences.end();
+  nvsWrites++;
 }
 
-bool isAlerted(const String &mac) {
-  for (const String &m : alertedMacs) {
-    if (m == mac)
-      return true;
-  }
-  return false;
+bool isAlerted(uint64_t mac) { return alertedMacs.contains(mac); }
+
+void unmarkAlerted(uint64_t mac) { alertedMacs.remove(mac); }
+
+bool isWhitelisted(uint64_t mac) {
+  HotPathTimer timer(hpWhitelist);
+  return whitelist.contains(mac);
 }
 
-bool isWhitelisted(String mac) {
-  for (String w : whitelist) {
-    if (w.equalsIgnoreCase(mac))
-      return true;
+// One element of /api/whitelist, same members and order as the former
+// ArduinoJson handler: live data when the device is in the table, else the
+// stored metadata, and the lastSeen timestamp.
+void writeWhitelistJson(JsonOut &json, uint64_t mac) {
+  char macStr[18];
+  formatMac(mac, macStr);
+  json.ch('{');
+  json.key("mac", true);
+  json.str(macStr);
+  const BleDeviceData *dev = detectedDevices.find(mac);
+  auto meta = wlMetaMap.find(mac);
+  if (dev != nullptr) {
+    char services[BLE_SERVICES_STR_MAX];
+    char mfgHex[2 * BLE_MFG_MAX + 1];
+    formatServices(*dev, services);
+    formatMfgHex(*dev, mfgHex);
+    json.key("name");
+    json.str(dev->gattName[0] ? dev->gattName : deviceDisplayName(*dev));
+    json.key("vendor");
+    json.str(dev->vendor ? dev->vendor : "N/A");
+    json.key("mfgData");
+    json.str(mfgHex);
+    json.key("appearance");
+    json.num(dev->appearance);
+    json.key("battery");
+    json.num(dev->batteryLevel);
+    json.key("services");
+    json.str(services);
+    json.key("addressType");
+    json.str(addrTypeLabel(dev->addressType));
+    json.key("live");
+    json.boolean(true);
+  } else if (meta != wlMetaMap.end()) {
+    json.key("name");
+    json.str(meta->second.name.c_str());
+    json.key("vendor");
+    json.str(meta->second.vendor.c_str());
+    json.key("mfgData");
+    json.str(meta->second.mfgData.c_str());
+    json.key("live");
+    json.boolean(false);
+  } else {
+    json.key("live");
+    json.boolean(false);
   }
-  return false;
+  json.key("lastSeen");
+  json.num((long)lastSeen.get(mac));
+  json.ch('}');
 }
 
-void notifyEedomus(String mac) {
-  if (WiFi.status() == WL_CONNECTED) {
-    HTTPClient http;
-    String url = String("http://") + EEDOMUS_IP +
-                 "/api/set?action=periph.value&periph_id=" + EEDOMUS_PERIPH_ID +
-                 "&value=" + mac + "&api_user=" + EEDOMUS_API_USER +
-                 "&api_secret=" + EEDOMUS_API_SECRET;
-    http.begin(url);
-    int httpCode = http.GET();
-    Serial.printf("Eedomus notification sent for %s, response code: %d\n",
-                  mac.c_str(), httpCode);
-    http.end();
-  } else {
+// Marks a record as changed for incremental /api/devices clients.
+void touchDevice(BleDeviceData &dev) {
+  dev.changeSeq = deviceChanges.next();
+  dev.seqRssi = (int8_t)dev.rssiFilter.level();
+}
+
+void touchDevice(uint64_t mac) {
+  BleDeviceData *dev = detectedDevices.find(mac);
+  if (dev != nullptr)
+    touchDevice(*dev);
+}
+
+void armTimer(DeviceHandle h, TimerKind kind, uint32_t due) {
+  deviceTimers.schedule(h.slot * TIMER_KINDS + kind, h.gen, due);
+}
+
+void cancelTimer(DeviceHandle h, TimerKind kind) {
+  deviceTimers.cancel(h.slot * TIMER_KINDS + kind);
+}
+
+// Blocking HTTP call, only made from alertTask. Returns true on 2xx.
+bool notifyEedomus(const char *value) {
+  if (WiFi.status() != WL_CONNECTED) {
     Serial.println("Cannot notify Eedomus, WiFi disconnected.");
+    return false;
   }
+  HTTPClient http;
+  String url = String("http://") + EEDOMUS_IP +
+               "/api/set?action=periph.value&periph_id=" + EEDOMUS_PERIPH_ID +
+               "&value=" + value + "&api_user=" + EEDOMUS_API_USER +
+               "&api_secret=" + EEDOMUS_API_SECRET;
+  http.setConnectTimeout(3000);
+  http.setTimeout(5000);
+  http.begin(url);
+  int httpCode = http.GET();
+  Serial.printf("Eedomus notification sent for %s, response code: %d\n",
+                value, httpCode);
+  http.end();
+  return httpCode >= 200 && httpCode < 300;
 }
 
 // ------------------------------------------------------------------
-// BLE CALLBACKS
+// ALERT TASK (FreeRTOS) — Eedomus notifications off the BLE path
 // ------------------------------------------------------------------
-class MyAdvertisedDeviceCallbacks : public NimBLEAdvertisedDeviceCallbacks {
-  void onResult(NimBLEAdvertisedDevice *advertisedDevice) {
-    String address = String(advertisedDevice->getAddress().toString().c_str());
-    address.toUpperCase();
-    String name = "Unknown";
-    if (advertisedDevice->haveName()) {
-      name = String(advertisedDevice->getName().c_str());
-    }
-    int rssi = advertisedDevice->getRSSI();
-
-    // -- Advanced Metadata Extraction --
-
-    // 1. Address Type
-    String addrType = "Unknown";
-    switch (advertisedDevice->getAddressType()) {
-    case BLE_ADDR_PUBLIC:
-      addrType = "Public (Fixe)";
-      break;
-    case BLE_ADDR_RANDOM:
-      addrType = "Static Random";
-      break;
-    case BLE_ADDR_PUBLIC_ID:
-      addrType = "Public ID";
-      break;
-    case BLE_ADDR_RANDOM_ID:
-      addrType = "Random Resolvable (Smartphone)";
-      break;
-    }
-
-    // 2. TX Power
-    int txPower =
-        advertisedDevice->haveTXPower() ? advertisedDevice->getTXPower() : -999;
-
-    // 3. Service UUIDs
-    String services = "";
-    if (advertisedDevice->haveServiceUUID()) {
-      for (int i = 0; i < advertisedDevice->getServiceUUIDCount(); i++) {
-        NimBLEUUID uuid = advertisedDevice->getServiceUUID(i);
-        services += String(uuid.toString().c_str()) + ", ";
-      }
+void alertTask(void *) {
+  uint64_t mac;
+  char value[AlertBatcher::VALUE_MAX];
+  while (true) {
+    uint32_t wait = alertBatcher.waitMs(millis());
+    TickType_t ticks =
+        wait == AlertBatcher::NEVER ? portMAX_DELAY : pdMS_TO_TICKS(wait);
+    if (xQueueReceive(alertQueue, &mac, ticks) == pdTRUE) {
+      alertBatcher.add(mac, millis());
+      continue;
+    }
+    if (alertBatcher.waitMs(millis()) == 0) {
+      alertBatcher.format(value);
+      alertBatcher.sent(notifyEedomus(value), millis());
     }
+  }
+}
 
-    // 4. Manufacturer data snippet
-    String mfgData = "";
-    if (advertisedDevice->haveManufacturerData()) {
-      std::string rawStr = advertisedDevice->getManufacturerData();
-      char buf[4];
-      for (int i = 0; i < rawStr.length(); i++) {
-        sprintf(buf, "%02X", (uint8_t)rawStr[i]);
-        mfgData += String(buf);
-      }
+// Adds a device event produced by the running replay to its report.
+void noteReplayEvent(const char *event, uint64_t mac) {
+  ReplayReport &r = replayReport;
+  uint32_t ms = radarClock.ms() - r.startMs;
+  if (!strcmp(event, "arrived")) {
+    r.arrivals++;
+  } else if (!strcmp(event, "left")) {
+    r.departures++;
+  } else {
+    r.alerts++;
+    if (ms / 60000 != r.alertMinute) {
+      r.alertMinute = ms / 60000;
+      r.alertsInMinute = 0;
     }
+    if (++r.alertsInMinute > r.peakAlertsPerMin)
+      r.peakAlertsPerMin = r.alertsInMinute;
+  }
+  if (r.timeline.size() < TRACE_TIMELINE_MAX)
+    r.timeline.push_back({ms, mac, event});
+  else
+    r.timelineDropped++;
+}
 
-    // 5. Appearance
-    uint16_t appearance = advertisedDevice->haveAppearance()
-                              ? advertisedDevice->getAppearance()
-                              : 0;
-
-    // Try to extract vendor from local PROGMEM database (Binary Search)
-    String vendor = "N/A";
-
-    // Extract the first 3 octets of MAC address safely
-    if (address.length() >= 8) {
-      String cleanPrefix = address.substring(0, 8); // Format is XX:XX:XX
-      cleanPrefix.replace(":", "");                 // Make it XXXXXX
-      if (cleanPrefix.length() == 6) {
-        uint32_t prefix_int = strtoul(cleanPrefix.c_str(), NULL, 16);
-        const char *foundVendor = getVendorFromPROGMEM(prefix_int);
-        if (foundVendor != nullptr) {
-          vendor = String(foundVendor);
-          // Si la puce n'a pas diffusé son propre nom, on met le constructeur à
-          // la place
-          if (name == "Unknown") {
-            name = vendor;
-          }
-        }
-      }
+// Pushes a one-off device event ("alert", "arrived", "left") to every
+// client, ahead of the coalesced device changes.
+void pushDeviceEvent(const char *event, uint64_t mac, int8_t rssi) {
+  if (replayReport.running)
+    noteReplayEvent(event, mac);
+  char buf[192];
+  char macStr[18];
+  formatMac(mac, macStr);
+  const BleDeviceData *dev = detectedDevices.find(mac);
+  JsonOut json(buf, sizeof(buf) - 1);
+  json.ch('{');
+  json.key("mac", true);
+  json.str(macStr);
+  json.key("name");
+  json.str(dev ? (dev->gattName[0] ? dev->gattName : deviceDisplayName(*dev))
+               : "Unknown");
+  json.key("rssi");
+  json.num(rssi);
+  json.ch('}');
+  if (!json.ok)
+    return;
+  *json.p = '\0';
+  pushOutbox.add(nullptr, event, buf);
+}
+
+// Sends one client the changes after its cursor: "expire" (MAC) events,
+// then "upsert" (device object) events, then "sync" carrying the new cursor
+// as event id. Too many changes, or a cursor the ChangeLog no longer
+// covers, become a single "resync" telling the page to GET /api/devices.
+void pushDeviceChanges(PushClient &pc, uint32_t seq) {
+  uint16_t pending = 0;
+  uint64_t mac;
+  if (!pc.resync && deviceChanges.covers(pc.seq)) {
+    for (uint16_t i = 0; i < deviceChanges.capacity(); i++)
+      pending += deviceChanges.removedAt(i, pc.seq, mac);
+    for (uint16_t i = 0; i < detectedDevices.capacity(); i++) {
+      const BleDeviceData *dev = detectedDevices.atSlot(i, mac);
+      pending += dev && dev->listed && dev->changeSeq > pc.seq;
     }
+  } else {
+    pending = PUSH_MAX_EVENTS + 1;
+  }
 
-    // Update detected devices list
-    bool found = false;
-    for (auto &dev : detectedDevices) {
-      if (dev.address == address) {
-        if (name != "Unknown")
-          dev.name = name;
-        dev.rssi = rssi;
-        dev.vendor = vendor;
-        dev.addressType = addrType;
-        if (txPower != -999)
-          dev.txPower = txPower;
-        if (services.length() > 0)
-          dev.serviceUUIDs = services;
-        if (mfgData.length() > 0)
-          dev.manufacturerData = mfgData;
-        dev.appearance = appearance;
-
-        dev.lastSeen = millis();
-        // In-memory only — NVS flush happens once per scan cycle in loop()
-        time_t now;
-        time(&now);
-        if (now > 100000) {
-          lastSeenMap[dev.address] = now;
-          lastSeenDirty = true;
-        }
-        found = true;
+  char buf[DEVICE_JSON_MAX + 1];
+  if (pending > PUSH_MAX_EVENTS) {
+    pushOutbox.add(pc.client, "resync", "{}");
+    pushResyncs++;
+  } else {
+    for (uint16_t i = 0; i < deviceChanges.capacity(); i++) {
+      if (!deviceChanges.removedAt(i, pc.seq, mac))
+        continue;
+      JsonOut json(buf, sizeof(buf) - 1);
+      char macStr[18];
+      formatMac(mac, macStr);
+      json.str(macStr);
+      *json.p = '\0';
+      pushOutbox.add(pc.client, "expire", buf);
+    }
+    for (uint16_t i = 0; i < detectedDevices.capacity(); i++) {
+      const BleDeviceData *dev = detectedDevices.atSlot(i, mac);
+      if (!dev || !dev->listed || dev->changeSeq <= pc.seq)
+        continue;
+      JsonOut json(buf, sizeof(buf) - 1);
+      writeDeviceJson(json, mac, *dev, isWhitelisted(mac));
+      if (!json.ok)
+        continue;
+      *json.p = '\0';
+      pushOutbox.add(pc.client, "upsert", buf);
+    }
+  }
+  snprintf(buf, sizeof(buf), "{\"seq\":%lu}", (unsigned long)seq);
+  pushOutbox.add(pc.client, "sync", buf, seq);
+  pc.seq = seq;
+  pc.resync = false;
+}
+
+// Places the cursor of a client that just connected: onConnect runs on
+// the AsyncTCP task and must not wait for StateLock, so it only queues the
+// client. A Last-Event-ID the ChangeLog still covers resumes from there;
+// anything else leaves the resync flag set.
+void placePushCursor(PushClient &pc) {
+  uint32_t last = pc.client->lastId();
+  if (last != 0 && deviceChanges.covers(last)) {
+    pc.seq = last;
+    pc.resync = false;
+  }
+}
+
+void pushEvents() {
+  uint32_t seq = deviceChanges.current();
+  xSemaphoreTake(pushLock, portMAX_DELAY);
+  for (PushClient &pc : pushClients) {
+    if (pc.seq == 0 && pc.resync)
+      placePushCursor(pc);
+    if (pc.seq == seq && !pc.resync)
+      continue;
+    if (pc.client->packetsWaiting() > PUSH_MAX_BACKLOG) {
+      pushSkipped++; // retried next tick with everything since pc.seq
+      continue;
+    }
+    pushDeviceChanges(pc, seq);
+  }
+  xSemaphoreGive(pushLock);
+}
+
+// Sends what was rendered under StateLock, without it. A client that
+// disconnected meanwhile is no longer in pushClients and is skipped.
+void sendPushOutbox(PushOutbox &out) {
+  if (out.items.empty())
+    return;
+  xSemaphoreTake(pushLock, portMAX_DELAY);
+  for (const PushOutbox::Item &it : out.items) {
+    const char *data = out.text.data() + it.offset;
+    if (it.client == nullptr) {
+      events.send(data, it.event, it.id);
+      continue;
+    }
+    for (const PushClient &pc : pushClients)
+      if (pc.client == it.client) {
+        it.client->send(data, it.event, it.id);
         break;
       }
+  }
+  xSemaphoreGive(pushLock);
+  out.clear();
+}
+
+// ------------------------------------------------------------------
+// BLE CALLBACKS
+// ------------------------------------------------------------------
+// Random non-static addresses rotate every few minutes: caching their
+// GATT results would only fill gattCache with MACs never seen again.
+bool gattCacheable(uint64_t mac, BleAddrType type) {
+  return type == BleAddrType::Public || type == BleAddrType::PublicId ||
+         (mac >> 46) == 0x3; // static random
+}
+
+// Prefills a new record from gattCache; a fresh entry means no connection.
+void applyGattCache(uint64_t mac, BleDeviceData &dev, time_t now) {
+  const auto *e = gattCache.find(mac);
+  if (e == nullptr) {
+    gattCache.misses++;
+    return;
+  }
+  gattCache.hits++;
+  strlcpy(dev.gattName, e->name, sizeof(dev.gattName));
+  dev.batteryLevel = e->battery;
+  if (gattCache.fresh(*e, now)) {
+    dev.gattAttempts = GATT_MAX_ATTEMPTS;
+    gattCacheSkips++;
+  }
+}
+
+// Intrusion check — uniquement si surveillance active. Only a Present
+// device counts: one packet from a passer-by does not raise an alert.
+void checkIntrusion(uint64_t mac, const BleDeviceData &dev) {
+  if (!surveillanceActive || dev.presence.state != Presence::Present ||
+      isAlerted(mac) || isWhitelisted(mac))
+    return;
+  char macStr[18];
+  formatMac(mac, macStr);
+  int level = dev.rssiFilter.level();
+  alertedMacs.add(mac);
+  pushDeviceEvent("alert", mac, (int8_t)level);
+  Serial.printf("🚨 INTRUS: %s (%s) RSSI: %d\n", macStr,
+                deviceDisplayName(dev), level);
+  // A replayed intruder is reported, not notified
+  if (!replayReport.running && xQueueSend(alertQueue, &mac, 0) != pdTRUE)
+    alertQueueDrops++;
+}
+
+void reportPresence(uint64_t mac, const BleDeviceData &dev, PresenceEvent e) {
+  if (e == PresenceEvent::Arrived) {
+    presenceArrivals++;
+    pushDeviceEvent("arrived", mac, (int8_t)dev.rssiFilter.level());
+  } else if (e == PresenceEvent::Left) {
+    presenceDepartures++;
+    pushDeviceEvent("left", mac, (int8_t)dev.rssiFilter.level());
+  }
+}
+
+// Runs the presence state machine for one device, on a sighting (heard) or
+// when its timer fires, and re-arms the timer after a transition.
+void updatePresence(uint64_t mac, BleDeviceData &dev, uint32_t now,
+                    bool heard) {
+  Presence before = dev.presence.state;
+  PresenceEvent e =
+      presenceStep(dev.presence, PRESENCE, now, dev.lastSeen, heard,
+                   dev.rssiFilter.level(), dev.rssiFilter.ready());
+  if (dev.presence.state != before || !heard) {
+    DeviceHandle h = detectedDevices.handleOf(mac);
+    uint32_t due = presenceDeadline(dev.presence, PRESENCE, now, dev.lastSeen);
+    if (due == PRESENCE_NO_DEADLINE)
+      cancelTimer(h, TIMER_PRESENCE);
+    else
+      armTimer(h, TIMER_PRESENCE, due);
+    if (e == PresenceEvent::Left && isAlerted(mac))
+      armTimer(h, TIMER_REARM, now + ALERT_REARM_MS);
+  }
+  if (dev.presence.state != before)
+    touchDevice(dev);
+  reportPresence(mac, dev, e);
+  checkIntrusion(mac, dev);
+}
+
+// Expiry of one deadline of one device; see TimerKind.
+void onDeviceTimer(uint16_t id, uint16_t gen) {
+  DeviceHandle h = {(uint16_t)(id / TIMER_KINDS), gen};
+  uint64_t mac;
+  BleDeviceData *dev = detectedDevices.get(h, &mac);
+  if (dev == nullptr)
+    return; // evicted since
+  uint32_t now = radarClock.ms();
+  switch (id % TIMER_KINDS) {
+  case TIMER_PRESENCE:
+    updatePresence(mac, *dev, now, false);
+    break;
+  case TIMER_VISIBLE:
+    if (now - dev->lastSeen < DEVICE_VISIBLE_MS) {
+      armTimer(h, TIMER_VISIBLE, dev->lastSeen + DEVICE_VISIBLE_MS);
+    } else if (dev->listed) {
+      dev->listed = false;
+      deviceChanges.removed(mac);
+    }
+    break;
+  case TIMER_RETAIN:
+    if (now - dev->lastSeen < DEVICE_RETAIN_MS) {
+      armTimer(h, TIMER_RETAIN, dev->lastSeen + DEVICE_RETAIN_MS);
+    } else {
+      for (uint8_t k = 0; k < TIMER_KINDS; k++)
+        cancelTimer(h, (TimerKind)k);
+      unmarkAlerted(mac);
+      detectedDevices.remove(mac);
     }
+    break;
+  case TIMER_REARM:
+    if (dev->presence.state == Presence::Absent)
+      unmarkAlerted(mac);
+    break;
+  }
+}
 
-    if (!found) {
-      if (detectedDevices.size() > 50) {
-        detectedDevices.erase(detectedDevices.begin());
-      }
-      detectedDevices.push_back({address, name, rssi, vendor, addrType, txPower,
-                                 services, mfgData, appearance, "", -1, false,
-                                 millis()});
-    }
-
-    // Intrusion check — uniquement si surveillance active
-    if (surveillanceActive && !isWhitelisted(address)) {
-      if (rssi > -90 && !isAlerted(address)) {
-        alertedMacs.push_back(address);
-        Serial.printf("🚨 INTRUS: %s (%s) RSSI: %d\n", address.c_str(),
-                      name.c_str(), rssi);
-        if (millis() - lastAlertTime > ALERT_COOLDOWN) {
-          lastAlertTime = millis();
-          notifyEedomus(address);
-        }
-      }
+// Applies one advert to the shared state. Called by loop() only, with
+// stateMutex held.
+void applyBleEvent(const BleEvent &ev) {
+  HotPathTimer timer(hpApplyAdvert);
+  // Allocation-free: decode the raw AD payload straight into the record,
+  // text is only produced when the web API serializes.
+  uint64_t mac = ev.mac;
+  int rssi = ev.rssi;
+  BleAdvFields fields;
+  parseAdvPayload(ev.payload, ev.len, fields);
+
+  // A listed device pushed out of a full table is reported as removed,
+  // and as gone if it was still present; its alert is forgotten with it
+  uint64_t victim;
+  const BleDeviceData *old;
+  if (detectedDevices.full() && detectedDevices.find(mac) == nullptr &&
+      (old = detectedDevices.oldest(victim)) != nullptr) {
+    deviceEvictions++;
+    unmarkAlerted(victim);
+    if (old->listed)
+      deviceChanges.removed(victim);
+    if (old->presence.state == Presence::Present ||
+        old->presence.state == Presence::Leaving) {
+      presentEvictions++;
+      reportPresence(victim, *old, PresenceEvent::Left);
     }
   }
+
+  // Update detected devices table (O(1), evicts least recently seen)
+  bool inserted;
+  BleDeviceData &dev = *detectedDevices.upsert(mac, inserted);
+  if (!inserted)
+    sightingGaps.add(dev.lastSeen, ev.ms);
+  time_t now = radarClock.epoch();
+  if (inserted) {
+    dev.batteryLevel = -1;
+    // Vendor from local PROGMEM database (cached, keyed on the OUI)
+    dev.vendor = vendorCache.get((uint32_t)(mac >> 24));
+    applyGattCache(mac, dev, now);
+  }
+  bool changed = applyAdvFields(dev, fields);
+  BleAddrType addrType = (BleAddrType)ev.addrType;
+  changed |= dev.addressType != addrType;
+  dev.addressType = addrType;
+  dev.rssi = (int8_t)rssi;
+  dev.rssiFilter.add((int8_t)rssi);
+  int level = dev.rssiFilter.level();
+  dev.lastSeen = ev.ms;
+  dev.connectable = ev.connectable;
+  if (inserted)
+    armTimer(detectedDevices.handleOf(mac), TIMER_RETAIN,
+             ev.ms + DEVICE_RETAIN_MS);
+  if (!dev.listed)
+    armTimer(detectedDevices.handleOf(mac), TIMER_VISIBLE,
+             ev.ms + DEVICE_VISIBLE_MS);
+  if (!dev.listed || changed || abs(level - dev.seqRssi) >= RSSI_CHANGE_DB) {
+    dev.listed = true;
+    touchDevice(dev);
+  }
+
+  // In-memory only — journal flush happens once per scan cycle in loop().
+  // A replay writes to its own scratch journal.
+  if (now > 100000 && isWhitelisted(mac)) {
+    (replayReport.running ? runLastSeen : lastSeen).update(mac, now);
+  }
+
+  // Presence transitions, then the intrusion check
+  updatePresence(mac, dev, ev.ms, true);
+}
+
+class MyAdvertisedDeviceCallbacks : public NimBLEAdvertisedDeviceCallbacks {
+public:
+  void onResult(NimBLEAdvertisedDevice *advertisedDevice) {
+    HotPathTimer timer(hpOnResult);
+    // Lock-free hand-off to loop(): the NimBLE host task never waits on
+    // the web server or on flash writes. A full ring drops the advert.
+    BleEvent ev;
+    ev.mac = (uint64_t)advertisedDevice->getAddress();
+    ev.ms = radarClock.ms();
+    ev.rssi = (int8_t)advertisedDevice->getRSSI();
+    ev.addrType = advertisedDevice->getAddressType();
+    ev.connectable = advertisedDevice->isConnectable();
+    setBleEventPayload(ev, advertisedDevice->getPayload(),
+                       advertisedDevice->getPayloadLength());
+    bleEvents.push(ev);
+  }
+
+  // An advert from a source standing in for the radio, already decoded
+  // and stamped with its time on air.
+  void onResult(const BleEvent &ev) {
+    HotPathTimer timer(hpOnResult);
+    bleEvents.push(ev);
+  }
 };
+MyAdvertisedDeviceCallbacks scanCallbacks;
+
+// True while the running source stands in for the radio.
+bool radioStandIn() {
+  return advertSource != nullptr && advertSource->standsInForRadio();
+}
 
 // ------------------------------------------------------------------
 // GATT TASK (FreeRTOS) — non-blocking
 // ------------------------------------------------------------------
-void tryReadGattInfo(BleDeviceData &dev) {
-  if (dev.gattAttempted)
-    return;
-  dev.gattAttempted = true;
-  NimBLEAddress bleAddr(dev.address.c_str());
+// Fills dev.gattName / dev.batteryLevel. Blocks for the whole connection,
+// so it works on a private copy of the record, not under stateMutex.
+// Returns false if the connection failed.
+bool tryReadGattInfo(uint64_t mac, BleDeviceData &dev) {
+  char macStr[18];
+  formatMac(mac, macStr);
+  NimBLEAddress bleAddr(mac, dev.addressType == BleAddrType::Unknown
+                                 ? BLE_ADDR_PUBLIC
+                                 : (uint8_t)dev.addressType);
   NimBLEClient *pClient = NimBLEDevice::createClient();
   pClient->setConnectionParams(12, 12, 0, 51);
-  pClient->setConnectTimeout(2);
-  Serial.printf("[GATT] Connecting to %s...\n", dev.address.c_str());
-  if (!pClient->connect(bleAddr)) {
+  pClient->setConnectTimeout(GATT_CONNECT_TIMEOUT_S);
+  Serial.printf("[GATT] Connecting to %s...\n", macStr);
+  bool connected = pClient->connect(bleAddr);
+  gattConnecting = false; // loop() may scan again
+  if (!connected) {
     NimBLEDevice::deleteClient(pClient);
-    return;
+    return false;
   }
   NimBLERemoteService *pSvcGAP =
       pClient->getService(NimBLEUUID((uint16_t)0x1800));
@@ -396,7 +1168,7 @@ void tryReadGattInfo(BleDeviceData &dev) {
     if (pChar && pChar->canRead()) {
       std::string val = pChar->readValue();
       if (!val.empty()) {
-        dev.gattName = String(val.c_str());
+        strlcpy(dev.gattName, val.c_str(), sizeof(dev.gattName));
       }
     }
   }
@@ -414,33 +1186,378 @@ void tryReadGattInfo(BleDeviceData &dev) {
   }
   pClient->disconnect();
   NimBLEDevice::deleteClient(pClient);
+  return true;
 }
 
-void gattWorkerTask(void *param) {
+void gattWorkerTask(void *) {
   GattTask task;
   while (true) {
     if (xQueueReceive(gattQueue, &task, portMAX_DELAY) == pdTRUE) {
-      if (task.devIndex >= 0 && task.devIndex < (int)detectedDevices.size()) {
-        tryReadGattInfo(detectedDevices[task.devIndex]);
+      BleDeviceData info;
+      uint64_t mac;
+      bool valid;
+      {
+        StateLock lock;
+        BleDeviceData *dev = detectedDevices.get(task.handle, &mac);
+        valid = dev != nullptr;
+        if (valid)
+          info = *dev;
+      }
+      if (valid) {
+        unsigned long started = millis();
+        bool ok = tryReadGattInfo(mac, info);
+        StateLock lock;
+        gattRadioMs += millis() - started;
+        BleDeviceData *dev = detectedDevices.get(task.handle);
+        if (dev == nullptr) {
+          gattStale++; // evicted meanwhile: drop the result
+        } else if (ok) {
+          memcpy(dev->gattName, info.gattName, sizeof(dev->gattName));
+          dev->batteryLevel = info.batteryLevel;
+          dev->gattAttempts = GATT_MAX_ATTEMPTS; // done, no retry
+          touchDevice(*dev);
+        }
+        if (ok) {
+          gattConnects++;
+          // The address was read under the lock with the record copy
+          if (gattCacheable(mac, info.addressType))
+            gattCache.put(mac, info.gattName, info.batteryLevel,
+                          radarClock.epoch());
+        } else {
+          gattFailures++;
+        }
       }
+      gattConnecting = false;
       gattTaskRunning = false;
     }
   }
 }
 
+// Rank of a GATT candidate: a stronger signal connects faster and more
+// reliably, a device never tried and without a cached name gains the most,
+// and strangers come before whitelisted devices.
+int gattPriority(uint64_t mac, const BleDeviceData &dev) {
+  int score = dev.rssiFilter.level() - GATT_MIN_RSSI;
+  if (dev.gattAttempts == 0 && dev.gattName[0] == '\0')
+    score += GATT_NOVELTY_BONUS;
+  if (!isWhitelisted(mac))
+    score += GATT_STRANGER_BONUS;
+  return score;
+}
+
+// Best device worth a GATT connection: connectable, close enough, heard in
+// the last few seconds and with attempts left. One pass over the table (at
+// most MAX_DEVICES records) per scan gap, so no queue is kept.
+bool pickGattCandidate(unsigned long now, DeviceHandle &out) {
+  if (replayReport.running)
+    return false; // replayed devices are not around to connect to
+  int best = -1;
+  detectedDevices.forEach([&](uint64_t mac, const BleDeviceData &dev) {
+    if (!dev.connectable || !dev.listed ||
+        dev.rssiFilter.level() < GATT_MIN_RSSI ||
+        now - dev.lastSeen > 5000 || dev.gattAttempts >= GATT_MAX_ATTEMPTS ||
+        (dev.gattAttempts > 0 && now - dev.gattLastTry < GATT_RETRY_MS))
+      return;
+    int score = gattPriority(mac, dev);
+    if (score > best) {
+      best = score;
+      out = detectedDevices.handleOf(mac);
+    }
+  });
+  return best >= 0;
+}
+
+// Books one connection for the GATT worker; the caller has stopped the
+// scan. loop() hands it over with sendGattTask() once the scan stop is
+// applied, so the worker never connects while the radio still scans.
+void startGatt(DeviceHandle h, unsigned long now, GattTask &out) {
+  BleDeviceData *dev = detectedDevices.get(h);
+  dev->gattAttempts++;
+  dev->gattLastTry = now;
+  gattTaskRunning = true;
+  gattConnecting = true;
+  out = {h};
+}
+
+void sendGattTask(const GattTask &task) {
+  if (xQueueSend(gattQueue, &task, 0) != pdTRUE)
+    gattConnecting = gattTaskRunning = false;
+}
+
+// The scan may resume: the GATT link is set up, or the gap reached
+// GATT_GAP_MAX_MS.
+bool gattGapOver(uint32_t now) {
+  return !gattConnecting || now - gattGapSince >= GATT_GAP_MAX_MS;
+}
+
+// ------------------------------------------------------------------
+// SCAN SCHEDULING
+// ------------------------------------------------------------------
+// startScan() / stopScan() do the bookkeeping under StateLock and leave
+// the NimBLE calls, which wait on the controller, to applyScanOp() once
+// loop() has released the lock. A stop and a start in the same pass make
+// one restart.
+enum class ScanOp : uint8_t { None, Start, Stop, Restart };
+ScanOp scanOp = ScanOp::None;
+
+void startScan() {
+  scanOp = scanOp == ScanOp::None ? ScanOp::Start : ScanOp::Restart;
+  scanOnSince = millis();
+}
+
+void stopScan() {
+  scanOp = scanOp == ScanOp::Start ? ScanOp::None : ScanOp::Stop;
+  scanRadioMs += millis() - scanOnSince;
+}
+
+void applyScanOp(ScanOp op, const ScanProfile &p) {
+  if (op == ScanOp::Stop || op == ScanOp::Restart)
+    pBLEScan->stop();
+  if (op == ScanOp::Start || op == ScanOp::Restart) {
+    pBLEScan->setInterval(p.intervalMs);
+    pBLEScan->setWindow(p.windowMs);
+    // Non-blocking start (callback form); 0 = until stopped
+    pBLEScan->start(CONTINUOUS_SCAN ? 0 : SCAN_TIME, nullptr, false);
+  }
+}
+
+// Picks the scan profile from the web load of the last SCAN_ADAPT_MS:
+// narrower windows as soon as traffic rises, wider only after
+// SCAN_CALM_PERIODS quieter periods, to avoid flapping. Changing the
+// parameters needs a scan restart, so it only happens on a switch.
+void adaptScanProfile() {
+  uint8_t wanted = 0;
+  if (events.count() > 0 || httpRequests > 0)
+    wanted = 1;
+  if (httpRequests >= SCAN_BUSY_REQUESTS || pushSkipped != lastPushSkipped)
+    wanted = 2;
+  httpRequests = 0;
+  lastPushSkipped = pushSkipped;
+  sightingGaps.decay(radarClock.ms());
+
+  if (wanted < scanProfile && ++calmPeriods < SCAN_CALM_PERIODS)
+    return;
+  calmPeriods = 0;
+  if (wanted == scanProfile)
+    return;
+  scanProfile = wanted;
+  Serial.printf("[SCAN] Profile %s (%u/%u ms)\n", SCAN_PROFILES[wanted].name,
+                SCAN_PROFILES[wanted].intervalMs,
+                SCAN_PROFILES[wanted].windowMs);
+  if (CONTINUOUS_SCAN && scanInProgress) {
+    stopScan();
+    startScan();
+    scanRestarts++;
+  }
+}
+
+// ------------------------------------------------------------------
+// TRACE REPLAY / SIMULATED TRAFFIC
+// ------------------------------------------------------------------
+// Forgets every device, alert and deadline, so a replay starts from the
+// same state each time, timer ticks included. Clients see a fresh change
+// sequence and resync.
+void resetRadarState() {
+  detectedDevices.clear();
+  deviceTimers.clear(radarClock.ms());
+  deviceChanges.begin(deviceChanges.current() + 1);
+  alertedMacs.clear();
+}
+
+// Hands the radar over to a started source, from a clean state; the run
+// lasts until the source is no longer active(). Speed 0 switches the radar
+// clock to virtual time.
+void startSourceRun(AdvertSource &src, uint16_t speed) {
+  if (advertSource != nullptr && advertSource != &src)
+    advertSource->stop();
+  if (speed == 0)
+    radarClock.startVirtual();
+  else
+    radarClock.stopVirtual();
+  resetRadarState();
+  runLastSeen.clear();
+  runLastSeen.bytesWritten = 0;
+  runLastSeen.compactions = 0;
+  ReplayReport &r = replayReport;
+  r = {};
+  r.running = true;
+  r.source = src.name();
+  r.speed = speed;
+  r.startMs = r.lastMaintenance = radarClock.ms();
+  r.wallStartMs = millis();
+  r.evictionBase = deviceEvictions;
+  r.nvsBase = nvsWrites;
+  r.heapStart = r.heapMin = ESP.getFreeHeap();
+  r.timeline.reserve(TRACE_TIMELINE_MAX);
+  advertSource = &src;
+  Serial.printf("[TRACE] %s started (speed %u)\n", src.name(), speed);
+}
+
+bool startReplay(uint16_t speed) {
+  traceWriter.stop();
+  if (!traceReplay.begin(LittleFS, TRACE_PATH, speed, radarClock.ms()))
+    return false;
+  startSourceRun(traceReplay, speed);
+  return true;
+}
+
+// Moves virtual time to t through every timer tick on the way, so that
+// deadlines fire in order and at the time they would have in real time.
+// The scratch lastSeen journal is flushed on the same clock.
+void advanceVirtualTime(uint32_t t) {
+  while ((int32_t)(t - radarClock.ms()) > 0) {
+    uint32_t step = radarClock.ms() + VIRTUAL_STEP_MS;
+    radarClock.advanceTo((int32_t)(t - step) < 0 ? t : step);
+    deviceTimers.advance(radarClock.ms(), onDeviceTimer);
+    if (radarClock.ms() - replayReport.lastMaintenance >= MAINTENANCE_MS) {
+      replayReport.lastMaintenance = radarClock.ms();
+      runLastSeen.flush();
+    }
+  }
+}
+
+// Virtual time: the source drives the clock. Each step looks one timer tick
+// ahead and jumps to the next advert due, or to that horizon when none is.
+// Returns the number of adverts applied.
+uint16_t stepVirtualTime() {
+  BleEvent ev;
+  uint16_t applied = 0;
+  for (uint16_t i = 0; i < VIRTUAL_BATCH && advertSource->active(); i++) {
+    uint32_t horizon = radarClock.ms() + VIRTUAL_STEP_MS;
+    bool due = advertSource->next(horizon, ev);
+    advanceVirtualTime(due ? ev.ms : horizon);
+    if (due && radioStandIn()) {
+      scanCallbacks.onResult(ev);
+      while (bleEvents.pop(ev)) {
+        applyBleEvent(ev);
+        applied++;
+      }
+    } else if (due) {
+      applyBleEvent(ev);
+      applied++;
+    }
+  }
+  return applied;
+}
+
+// Called by loop() after each batch of `adverts`; closes the report once
+// the source is done (end of trace, or stopped). In virtual time the clock
+// first runs on for DEVICE_RETAIN_MS, so that the departures and expiries
+// the last adverts lead to are part of the report.
+void updateReplay(uint16_t adverts) {
+  ReplayReport &r = replayReport;
+  if (!r.running)
+    return;
+  if (!advertSource->active() && radarClock.isVirtual())
+    advanceVirtualTime(radarClock.ms() + DEVICE_RETAIN_MS);
+  r.adverts += adverts;
+  r.durationMs = millis() - r.wallStartMs;
+  r.simulatedMs = radarClock.ms() - r.startMs;
+  r.evictions = deviceEvictions - r.evictionBase;
+  r.nvsWrites = nvsWrites - r.nvsBase;
+  r.flashBytes = runLastSeen.bytesWritten;
+  r.compactions = runLastSeen.compactions;
+  if (ESP.getFreeHeap() < r.heapMin)
+    r.heapMin = ESP.getFreeHeap();
+  if (detectedDevices.size() > r.peakDevices)
+    r.peakDevices = detectedDevices.size();
+  if (advertSource->active())
+    return;
+  r.running = false;
+  advertSource = nullptr;
+  radarClock.stopVirtual();
+  runLastSeen.clear();
+  Serial.printf("[TRACE] %s done: %lu adverts, %lu ms simulated in %lu ms, "
+                "%u arrived, %u left, %u alerts\n",
+                r.source, (unsigned long)r.adverts,
+                (unsigned long)r.simulatedMs, (unsigned long)r.durationMs,
+                (unsigned)r.arrivals, (unsigned)r.departures,
+                (unsigned)r.alerts);
+}
+
+// Periodic flash writes, once per former scan cycle (devices expire
+// through deviceTimers), in three steps so that StateLock is not held
+// across LittleFS writes (a sector erase stalls whoever waits): take under
+// the lock, write without it, end under it again.
+struct Maintenance {
+  bool lastSeen, runLastSeen, gattCache, gattCacheLanded;
+  LastSeenJournal::FlushBatch lastSeenBatch, runLastSeenBatch;
+  std::vector<uint8_t> gattCacheFile;
+};
+Maintenance maintenance; // loop() only; buffers reused
+
+void takeMaintenance(Maintenance &m) {
+  // Batch flush: appends only the entries that changed
+  m.lastSeen = lastSeen.takeFlush(m.lastSeenBatch);
+  m.runLastSeen = replayReport.running && !radarClock.isVirtual() &&
+                  runLastSeen.takeFlush(m.runLastSeenBatch);
+  m.gattCache = gattCache.takeSnapshot(m.gattCacheFile);
+}
+
+void writeMaintenance(Maintenance &m) {
+  if (m.lastSeen) {
+    HotPathTimer timer(hpLastSeenFlush);
+    lastSeen.writeFlush(m.lastSeenBatch);
+  }
+  if (m.runLastSeen)
+    runLastSeen.writeFlush(m.runLastSeenBatch);
+  m.gattCacheLanded = m.gattCache && gattCache.writeSnapshot(m.gattCacheFile);
+}
+
+void endMaintenance(Maintenance &m) {
+  if (m.lastSeen)
+    lastSeen.endFlush(m.lastSeenBatch);
+  if (m.runLastSeen)
+    runLastSeen.endFlush(m.runLastSeenBatch);
+  if (m.gattCache && !m.gattCacheLanded)
+    gattCache.retrySnapshot();
+}
+
 // ------------------------------------------------------------------
 // SETUP
 // ------------------------------------------------------------------
+// Gives detectedDevices its record storage and reports the cost per device.
+bool allocDeviceRecords() {
+  size_t bytes = sizeof(BleDeviceData) * MAX_DEVICES;
+  void *records = nullptr;
+  if (psramFound())
+    records = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  deviceRecordsInPsram = records != nullptr;
+  if (records == nullptr)
+    records = heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  if (records == nullptr)
+    return false;
+  detectedDevices.begin(static_cast<BleDeviceData *>(records));
+  size_t hot = sizeof(detectedDevices) + sizeof(deviceTimers) +
+               sizeof(deviceChanges);
+  Serial.printf("[MEM] %u devices: %u B/device record (%s) + %u B/device "
+                "index (internal), %u B total\n",
+                MAX_DEVICES, (unsigned)sizeof(BleDeviceData),
+                deviceRecordsInPsram ? "PSRAM" : "internal",
+                (unsigned)(hot / MAX_DEVICES), (unsigned)(bytes + hot));
+  return true;
+}
+
 void setup() {
   Serial.begin(115200);
   delay(1000);
 
+  if (!allocDeviceRecords()) {
+    Serial.println("Not enough memory for RADAR_MAX_DEVICES records");
+    return;
+  }
+  cpuCyclesPerUs = ESP.getCpuFreqMHz();
+  for (HotPath *hp : HOT_PATHS)
+    hp->setClock(cpuCyclesPerUs);
+
   // Init File System
   if (!LittleFS.begin(true)) {
     Serial.println("An Error has occurred while mounting LittleFS");
     return;
   }
 
+  stateMutex = xSemaphoreCreateMutex();
+
   // Load data
   loadWhitelist();
   loadWlMeta();
@@ -480,22 +1597,31 @@ void setup() {
   } else {
     Serial.println(" FAILED. Check credentials.");
   }
-  // Always load lastSeen (even without WiFi, reload from NVS)
+  // Always load lastSeen (even without WiFi, reload from LittleFS)
   loadLastSeen();
+  gattCache.begin(LittleFS, "/gattcache.bin", GATT_CACHE_TTL_SEC);
+  gattCache.load();
+
+  deviceChanges.begin(esp_random() >> 2);
+  deviceTimers.begin(radarClock.ms());
+  runLastSeen.begin(LittleFS, "/lastseen_run.bin", LASTSEEN_RESOLUTION_SEC);
 
   // Init BLE
   NimBLEDevice::init("");
   pBLEScan = NimBLEDevice::getScan();
-  pBLEScan->setAdvertisedDeviceCallbacks(new MyAdvertisedDeviceCallbacks(),
-                                         true);
+  pBLEScan->setAdvertisedDeviceCallbacks(&scanCallbacks, true);
   pBLEScan->setActiveScan(true);
-  pBLEScan->setInterval(97);
-  pBLEScan->setWindow(37);
+  // Adverts are consumed in onResult; don't accumulate scan results
+  pBLEScan->setMaxResults(0);
 
   // Create GATT worker task on Core 0 (WiFi runs on Core 0, but this is async)
   gattQueue = xQueueCreate(5, sizeof(GattTask));
   xTaskCreatePinnedToCore(gattWorkerTask, "GATTWorker", 8192, NULL, 1, NULL, 0);
 
+  // Alert dispatcher task (HTTPClient needs a roomy stack)
+  alertQueue = xQueueCreate(16, sizeof(uint64_t));
+  xTaskCreatePinnedToCore(alertTask, "AlertTask", 6144, NULL, 1, NULL, 0);
+
   // Setup Web Server Routes
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
     AsyncWebServerResponse *response =
@@ -516,95 +1642,202 @@ void setup() {
     request->send(LittleFS, "/vendors.json", "application/json");
   });
 
-  // API: Get active devices
+  // API: Get active devices. With ?since=<seq> (the "seq" of a previous
+  // response) only devices changed since then are listed, plus the MACs
+  // that left the list in "removed"; "full":true means the cursor was too
+  // old (or from before a reboot) and the client must replace its state.
   server.on("/api/devices", HTTP_GET, [](AsyncWebServerRequest *request) {
-    DynamicJsonDocument doc(
-        16384); // Increased buffer to avoid truncation with many devices
-    JsonObject root = doc.to<JsonObject>();
-    root["version"] = FIRMWARE_VERSION;
-    JsonArray devices = root.createNestedArray("devices");
-
-    for (const auto &dev : detectedDevices) {
-      // Don't show old devices
-      if (millis() - dev.lastSeen < 60000) {
-        JsonObject obj = devices.createNestedObject();
-        obj["mac"] = dev.address;
-        obj["name"] = dev.name;
-        obj["rssi"] = dev.rssi;
-        obj["vendor"] = dev.vendor;
-        obj["addressType"] = dev.addressType;
-        obj["txPower"] = dev.txPower;
-        obj["services"] = dev.serviceUUIDs;
-        obj["mfgData"] = dev.manufacturerData;
-        obj["appearance"] = dev.appearance;
-        obj["gattName"] = dev.gattName;
-        obj["battery"] = dev.batteryLevel;
-        obj["whitelisted"] = isWhitelisted(dev.address);
+    // Streamed in chunks: one device object at a time is serialized into a
+    // small buffer, so the response costs ~1 KB of heap whatever the number
+    // of devices (the former JsonDocument needed 16 KB and truncated).
+    struct Cursor {
+      char buf[DEVICE_JSON_MAX];
+      size_t len = 0;
+      size_t pos = 0;
+      uint16_t slot = 0;
+      uint8_t phase = 0; // 0 header, 1 removed, 2 devices, 3 footer, 4 done
+      bool first = true;
+      bool delta = false;
+      uint32_t since = 0;
+    };
+    std::shared_ptr<Cursor> cur = std::make_shared<Cursor>();
+    uint32_t seq;
+    {
+      // Released before send(): the library may pull the first chunk from
+      // within it, and each chunk takes the lock for its own duration.
+      StateLock lock;
+      httpRequests++;
+      if (request->hasParam("since")) {
+        uint32_t since =
+            strtoul(request->getParam("since")->value().c_str(), nullptr, 10);
+        cur->delta = deviceChanges.covers(since);
+        if (cur->delta)
+          cur->since = since;
       }
+      seq = deviceChanges.current();
     }
-    String output;
-    serializeJson(doc, output);
-    request->send(200, "application/json", output);
+    AsyncWebServerResponse *response = request->beginChunkedResponse(
+        "application/json",
+        [cur, seq](uint8_t *out, size_t maxLen, size_t) -> size_t {
+          StateLock lock;
+          HotPathTimer timer(hpDevicesChunk);
+          size_t written = 0;
+          while (written < maxLen) {
+            if (cur->pos < cur->len) {
+              size_t n = std::min(cur->len - cur->pos, maxLen - written);
+              memcpy(out + written, cur->buf + cur->pos, n);
+              cur->pos += n;
+              written += n;
+              continue;
+            }
+            // Pending buffer drained: produce the next piece
+            JsonOut json(cur->buf, sizeof(cur->buf));
+            if (cur->phase == 0) {
+              json.raw("{\"version\":");
+              json.str(FIRMWARE_VERSION);
+              json.key("seq");
+              json.num(seq);
+              json.key("full");
+              json.boolean(!cur->delta);
+              if (cur->delta) {
+                json.raw(",\"removed\":[");
+                cur->phase = 1;
+              } else {
+                json.raw(",\"devices\":[");
+                cur->phase = 2;
+              }
+            } else if (cur->phase == 1) {
+              // Removals are listed first: a device that left and came
+              // back since the cursor also appears in "devices".
+              uint64_t mac;
+              bool found = false;
+              while (cur->slot < deviceChanges.capacity() && !found)
+                found = deviceChanges.removedAt(cur->slot++, cur->since, mac);
+              if (!found) {
+                json.raw("],\"devices\":[");
+                cur->slot = 0;
+                cur->first = true;
+                cur->phase = 2;
+              } else {
+                char macStr[18];
+                formatMac(mac, macStr);
+                if (!cur->first)
+                  json.ch(',');
+                json.str(macStr);
+                cur->first = false;
+              }
+            } else if (cur->phase == 2) {
+              uint64_t mac;
+              const BleDeviceData *dev = nullptr;
+              while (cur->slot < detectedDevices.capacity() && !dev) {
+                dev = detectedDevices.atSlot(cur->slot++, mac);
+                // Don't show old devices, nor unchanged ones in delta mode
+                if (dev && (!dev->listed || dev->changeSeq <= cur->since))
+                  dev = nullptr;
+              }
+              if (!dev) {
+                cur->phase = 3;
+                continue;
+              }
+              if (!cur->first)
+                json.ch(',');
+              writeDeviceJson(json, mac, *dev, isWhitelisted(mac));
+              if (!json.ok)
+                continue; // cannot happen with DEVICE_JSON_MAX; skip device
+              cur->first = false;
+            } else if (cur->phase == 3) {
+              json.raw("]}");
+              cur->phase = 4;
+            } else {
+              break;
+            }
+            cur->len = json.length(cur->buf);
+            cur->pos = 0;
+          }
+          return written;
+        });
+    request->send(response);
   });
 
-  // API: Get whitelist with lastSeen + enriched meta
+  // API: Get whitelist with lastSeen + enriched meta. Streamed like
+  // /api/devices, one entry at a time, whatever the size of the list (the
+  // former 4 KB JsonDocument truncated it past a few dozen entries). An
+  // entry added or removed during the response may be missed or repeated.
   server.on("/api/whitelist", HTTP_GET, [](AsyncWebServerRequest *request) {
-    DynamicJsonDocument doc(4096);
-    JsonArray array = doc.to<JsonArray>();
-    for (const String &mac : whitelist) {
-      JsonObject obj = array.createNestedObject();
-      obj["mac"] = mac;
-      // Priority 1: live detected data
-      bool foundLive = false;
-      for (const auto &dev : detectedDevices) {
-        if (dev.address == mac) {
-          obj["name"] = dev.gattName.length() > 0 ? dev.gattName : dev.name;
-          obj["vendor"] = dev.vendor;
-          obj["mfgData"] = dev.manufacturerData;
-          obj["appearance"] = dev.appearance;
-          obj["battery"] = dev.batteryLevel;
-          obj["services"] = dev.serviceUUIDs;
-          obj["addressType"] = dev.addressType;
-          obj["live"] = true;
-          foundLive = true;
-          break;
-        }
-      }
-      // Priority 2: stored meta from NVS
-      if (!foundLive && wlMetaMap.count(mac)) {
-        obj["name"] = wlMetaMap[mac].name;
-        obj["vendor"] = wlMetaMap[mac].vendor;
-        obj["mfgData"] = wlMetaMap[mac].mfgData;
-        obj["live"] = false;
-      } else if (!foundLive) {
-        obj["live"] = false;
-      }
-      obj["lastSeen"] = lastSeenMap.count(mac) ? (long)lastSeenMap[mac] : 0;
+    struct Cursor {
+      char buf[DEVICE_JSON_MAX]; // a whitelist entry is smaller
+      size_t len = 0;
+      size_t pos = 0;
+      size_t index = 0;
+      uint8_t phase = 0; // 0 "[", 1 entries, 2 done
+      bool first = true;
+    };
+    std::shared_ptr<Cursor> cur = std::make_shared<Cursor>();
+    {
+      StateLock lock;
+      httpRequests++;
     }
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    AsyncWebServerResponse *response = request->beginChunkedResponse(
+        "application/json",
+        [cur](uint8_t *out, size_t maxLen, size_t) -> size_t {
+          StateLock lock;
+          size_t written = 0;
+          while (written < maxLen) {
+            if (cur->pos < cur->len) {
+              size_t n = std::min(cur->len - cur->pos, maxLen - written);
+              memcpy(out + written, cur->buf + cur->pos, n);
+              cur->pos += n;
+              written += n;
+              continue;
+            }
+            JsonOut json(cur->buf, sizeof(cur->buf));
+            if (cur->phase == 0) {
+              json.ch('[');
+              cur->phase = 1;
+            } else if (cur->phase == 1) {
+              MacSet::Items items = whitelist.items();
+              if (cur->index >= items.size()) {
+                json.ch(']');
+                cur->phase = 2;
+              } else {
+                if (!cur->first)
+                  json.ch(',');
+                writeWhitelistJson(json, items[cur->index++]);
+                if (!json.ok)
+                  continue; // cannot happen with WL_META_STR_MAX; skip
+                cur->first = false;
+              }
+            } else {
+              break;
+            }
+            cur->len = json.length(cur->buf);
+            cur->pos = 0;
+          }
+          return written;
+        });
+    request->send(response);
   });
 
   // API: Add to whitelist
   server.on(
       "/api/whitelist/add", HTTP_POST, [](AsyncWebServerRequest *request) {
+        StateLock lock;
+        httpRequests++;
         if (request->hasParam("mac", true)) {
           String mac = request->getParam("mac", true)->value();
-          if (!isWhitelisted(mac)) {
-            whitelist.push_back(mac);
+          uint64_t key;
+          if (!parseMac(mac.c_str(), key)) {
+            request->send(400, "text/plain", "Invalid MAC");
+          } else if (whitelist.full() && !whitelist.contains(key)) {
+            request->send(507, "text/plain", "Whitelist full");
+          } else if (whitelist.add(key)) {
             saveWhitelist();
+            touchDevice(key);
             // Save meta from live detected data
-            for (const auto &dev : detectedDevices) {
-              if (dev.address == mac) {
-                WlMeta m;
-                m.name = dev.gattName.length() > 0 ? dev.gattName : dev.name;
-                m.vendor = dev.vendor;
-                m.mfgData = dev.manufacturerData;
-                wlMetaMap[mac] = m;
-                saveWlMeta();
-                break;
-              }
+            const BleDeviceData *dev = detectedDevices.find(key);
+            if (dev != nullptr) {
+              wlMetaMap[key] = wlMetaFrom(*dev);
+              saveWlMeta();
             }
             request->send(200, "text/plain", "Added");
           } else {
@@ -618,12 +1851,14 @@ void setup() {
   // API: Remove from whitelist
   server.on("/api/whitelist/remove", HTTP_POST,
             [](AsyncWebServerRequest *request) {
+              StateLock lock;
+              httpRequests++;
               if (request->hasParam("mac", true)) {
                 String mac = request->getParam("mac", true)->value();
-                auto it = std::find(whitelist.begin(), whitelist.end(), mac);
-                if (it != whitelist.end()) {
-                  whitelist.erase(it);
+                uint64_t key;
+                if (parseMac(mac.c_str(), key) && whitelist.remove(key)) {
                   saveWhitelist();
+                  touchDevice(key);
                   request->send(200, "text/plain", "Removed");
                 } else {
                   request->send(404, "text/plain", "Not found");
@@ -636,18 +1871,17 @@ void setup() {
   // API: Add ALL currently detected (non-whitelisted) devices
   server.on("/api/whitelist/add-all", HTTP_POST,
             [](AsyncWebServerRequest *request) {
+              StateLock lock;
+              httpRequests++;
               int added = 0;
-              for (const auto &dev : detectedDevices) {
-                if (!isWhitelisted(dev.address)) {
-                  whitelist.push_back(dev.address);
-                  WlMeta m;
-                  m.name = dev.gattName.length() > 0 ? dev.gattName : dev.name;
-                  m.vendor = dev.vendor;
-                  m.mfgData = dev.manufacturerData;
-                  wlMetaMap[dev.address] = m;
+              detectedDevices.forEach([&](uint64_t mac,
+                                          const BleDeviceData &dev) {
+                if (whitelist.add(mac)) {
+                  wlMetaMap[mac] = wlMetaFrom(dev);
+                  touchDevice(mac);
                   added++;
                 }
-              }
+              });
               if (added > 0) {
                 saveWhitelist();
                 saveWlMeta();
@@ -659,16 +1893,16 @@ void setup() {
   // API: Clear entire whitelist + meta + lastSeen
   server.on("/api/whitelist/clear", HTTP_POST,
             [](AsyncWebServerRequest *request) {
+              StateLock lock;
+              httpRequests++;
               int removed = whitelist.size();
+              for (uint64_t mac : whitelist.items())
+                touchDevice(mac);
               whitelist.clear();
               wlMetaMap.clear();
-              lastSeenMap.clear();
-              lastSeenDirty = false;
+              lastSeen.clear();
               saveWhitelist();
               saveWlMeta();
-              preferences.begin("radar", false);
-              preferences.remove("lastseen");
-              preferences.end();
               request->send(200, "application/json",
                             "{\"removed\":" + String(removed) + "}");
             });
@@ -683,6 +1917,8 @@ void setup() {
   // API: Toggle surveillance
   server.on("/api/surveillance/toggle", HTTP_POST,
             [](AsyncWebServerRequest *request) {
+              StateLock lock;
+              httpRequests++;
               surveillanceActive = !surveillanceActive;
               if (!surveillanceActive)
                 alertedMacs.clear(); // Reset alerts on disarm
@@ -694,15 +1930,273 @@ void setup() {
 
   // API: Get alerted MACs
   server.on("/api/alerts", HTTP_GET, [](AsyncWebServerRequest *request) {
-    DynamicJsonDocument doc(2048);
+    StateLock lock;
+    httpRequests++;
+    DynamicJsonDocument doc(JSON_ARRAY_SIZE(alertedMacs.size()) +
+                            alertedMacs.size() * 18 + 64);
     JsonArray arr = doc.to<JsonArray>();
-    for (const String &m : alertedMacs)
-      arr.add(m);
+    char macStr[18];
+    for (uint64_t m : alertedMacs.items()) {
+      formatMac(m, macStr);
+      arr.add(macStr);
+    }
+    String output;
+    serializeJson(doc, output);
+    request->send(200, "application/json", output);
+  });
+
+  // API: Download the trace (binary, see adv_trace.h for the layout).
+  // Registered before /api/trace, which would take it as a sub-path.
+  server.on("/api/trace/download", HTTP_GET,
+            [](AsyncWebServerRequest *request) {
+              StateLock lock;
+              httpRequests++;
+              if (traceWriter.active())
+                request->send(409, "text/plain", "Recording");
+              else if (!LittleFS.exists(TRACE_PATH))
+                request->send(404, "text/plain", "No trace");
+              else
+                request->send(LittleFS, TRACE_PATH,
+                              "application/octet-stream", true);
+            });
+
+  // API: Advert trace. Recording and replay status, with the report of
+  // the last replay: throughput and timeline of arrived/left/alert events
+  // ("ms" since the replay started).
+  server.on("/api/trace", HTTP_GET, [](AsyncWebServerRequest *request) {
+    StateLock lock;
+    httpRequests++;
+    const ReplayReport &r = replayReport;
+    DynamicJsonDocument doc(1024 + TRACE_TIMELINE_MAX * 96);
+    JsonObject root = doc.to<JsonObject>();
+    JsonObject rec = root.createNestedObject("record");
+    rec["active"] = traceWriter.active();
+    rec["records"] = traceWriter.records;
+    rec["bytes"] = traceWriter.bytes();
+    rec["maxBytes"] = TRACE_MAX_BYTES;
+    JsonObject rp = root.createNestedObject("replay");
+    rp["running"] = r.running;
+    rp["source"] = r.source ? r.source : "";
+    rp["speed"] = r.speed;
+    rp["adverts"] = r.adverts;
+    rp["durationMs"] = r.durationMs;
+    rp["simulatedMs"] = r.simulatedMs;
+    rp["advertsPerSec"] =
+        r.durationMs ? (float)r.adverts * 1000 / r.durationMs : 0.0f;
+    rp["peakDevices"] = r.peakDevices;
+    rp["arrivals"] = r.arrivals;
+    rp["departures"] = r.departures;
+    rp["alerts"] = r.alerts;
+    rp["peakAlertsPerMin"] = r.peakAlertsPerMin;
+    rp["evictions"] = r.evictions;
+    rp["alertedMacs"] = alertedMacs.size();
+    rp["heapStart"] = r.heapStart;
+    rp["heapMin"] = r.heapMin;
+    rp["nvsWrites"] = r.nvsWrites;
+    rp["lastSeenBytes"] = r.flashBytes;
+    rp["lastSeenCompactions"] = r.compactions;
+    rp["timelineDropped"] = r.timelineDropped;
+#ifdef RADAR_CROWD_SIM
+    JsonObject cs = root.createNestedObject("crowd");
+    cs["active"] = crowdSim.active();
+    cs["visitors"] = crowdSim.visitors();
+    cs["adverts"] = crowdSim.adverts;
+    cs["arrivals"] = crowdSim.arrivals;
+    cs["departures"] = crowdSim.departures;
+    cs["rotations"] = crowdSim.rotations;
+    cs["rejected"] = crowdSim.rejected;
+    cs["maxLagMs"] = crowdSim.maxLagMs;
+#endif
+    JsonArray tl = rp.createNestedArray("timeline");
+    char macStr[18];
+    for (const ReplayEvent &e : r.timeline) {
+      JsonObject o = tl.createNestedObject();
+      o["ms"] = e.ms;
+      formatMac(e.mac, macStr);
+      o["mac"] = macStr;
+      o["event"] = e.event;
+    }
+    String output;
+    serializeJson(doc, output);
+    request->send(200, "application/json", output);
+  });
+
+  // API: Record the radio adverts to TRACE_PATH (replaces the last trace)
+  server.on("/api/trace/record", HTTP_POST,
+            [](AsyncWebServerRequest *request) {
+              StateLock lock;
+              httpRequests++;
+              if (replayReport.running)
+                request->send(409, "text/plain", "Replay running");
+              else if (!traceWriter.start(LittleFS, TRACE_PATH,
+                                          TRACE_MAX_BYTES, radarClock.ms()))
+                request->send(500, "text/plain", "Cannot open trace");
+              else
+                request->send(200, "text/plain", "Recording");
+            });
+
+  // API: Replay TRACE_PATH; ?speed=N plays N times faster, 0 = virtual time
+  server.on("/api/trace/replay", HTTP_POST,
+            [](AsyncWebServerRequest *request) {
+              StateLock lock;
+              httpRequests++;
+              long speed = 1;
+              if (request->hasParam("speed", true))
+                speed = request->getParam("speed", true)->value().toInt();
+              speed = std::min(std::max(speed, 0L), 1000L);
+              if (startReplay(speed))
+                request->send(200, "text/plain", "Replaying");
+              else
+                request->send(404, "text/plain", "No trace");
+            });
+
+  // API: Stop recording, replaying or generating
+  server.on("/api/trace/stop", HTTP_POST,
+            [](AsyncWebServerRequest *request) {
+              StateLock lock;
+              httpRequests++;
+              traceWriter.stop();
+              if (advertSource != nullptr)
+                advertSource->stop(); // loop() closes the report
+              request->send(200, "text/plain", "Stopped");
+            });
+
+#ifdef RADAR_CROWD_SIM
+  // API: Start a synthetic crowd (see crowd_sim.h); every parameter is
+  // optional: rate (arrivals/min), stay (mean, s), advMs, beacons,
+  // rotate (RPA lifetime, s), duration (s, 0 = until stopped), seed,
+  // speed (1 = real time, 0 = virtual time)
+  server.on("/api/sim/crowd", HTTP_POST, [](AsyncWebServerRequest *request) {
+    StateLock lock;
+    httpRequests++;
+    auto param = [request](const char *name, long def) {
+      if (!request->hasParam(name, true))
+        return def;
+      long v = request->getParam(name, true)->value().toInt();
+      return v < 0 ? 0L : v;
+    };
+    CrowdConfig c;
+    c.arrivalsPerMin = param("rate", 60);
+    c.stayMs = param("stay", 600) * 1000;
+    c.advMs = std::max(param("advMs", 300), 20L); // BLE minimum
+    c.beacons = std::min(param("beacons", 10), 512L);
+    c.rotateMs = param("rotate", 900) * 1000;
+    c.durationMs = param("duration", 0) * 1000;
+    c.seed = param("seed", 1);
+    uint16_t speed = param("speed", 1) > 0 ? 1 : 0;
+    traceWriter.stop();
+    crowdSim.begin(c, radarClock.ms());
+    startSourceRun(crowdSim, speed);
+    request->send(200, "text/plain", "Generating");
+  });
+#endif
+
+  // API: Runtime statistics
+  server.on("/api/stats", HTTP_GET, [](AsyncWebServerRequest *request) {
+    StateLock lock;
+    httpRequests++;
+    DynamicJsonDocument doc(2560);
+    JsonObject root = doc.to<JsonObject>();
+    root["version"] = FIRMWARE_VERSION;
+    root["uptimeMs"] = millis();
+    root["freeHeap"] = ESP.getFreeHeap();
+    root["devices"] = detectedDevices.size();
+    root["deviceCapacity"] = MAX_DEVICES;
+    root["deviceRecordsInPsram"] = deviceRecordsInPsram;
+    root["deviceEvictions"] = deviceEvictions;
+    root["presentEvictions"] = presentEvictions;
+    root["alertedMacs"] = alertedMacs.size();
+    root["nvsWrites"] = nvsWrites;
+    root["timers"] = deviceTimers.size();
+    JsonObject sc = root.createNestedObject("scan");
+    sc["mode"] = CONTINUOUS_SCAN ? "continuous" : "dutyCycle";
+    sc["profile"] = SCAN_PROFILES[scanProfile].name;
+    sc["intervalMs"] = SCAN_PROFILES[scanProfile].intervalMs;
+    sc["windowMs"] = SCAN_PROFILES[scanProfile].windowMs;
+    sc["restarts"] = scanRestarts;
+    sc["detectLatencyMs"] = sightingGaps.latencyMs(radarClock.ms());
+    sc["maxGapMs"] = sightingGaps.maxGapMs();
+    sc["gattGapMs"] = sightingGaps.blindMs;
+    JsonObject gt = root.createNestedObject("gatt");
+    gt["enabled"] = GATT_ENABLED;
+    gt["connects"] = gattConnects;
+    gt["failures"] = gattFailures;
+    gt["stale"] = gattStale;
+    gt["cacheEntries"] = gattCache.size();
+    gt["cacheHits"] = gattCache.hits;
+    gt["cacheMisses"] = gattCache.misses;
+    gt["cacheSkips"] = gattCacheSkips;
+    // Radio time since boot; the running scan counts up to now
+    uint64_t scanMs = scanRadioMs;
+    if (scanInProgress)
+      scanMs += millis() - scanOnSince;
+    uint64_t radioMs = scanMs + gattRadioMs;
+    JsonObject radio = root.createNestedObject("radio");
+    radio["scanMs"] = scanMs;
+    radio["gattMs"] = gattRadioMs;
+    radio["gattShare"] = radioMs ? (float)gattRadioMs / radioMs : 0.0f;
+    JsonObject pr = root.createNestedObject("presence");
+    pr["arrivals"] = presenceArrivals;
+    pr["departures"] = presenceDepartures;
+    JsonObject ls = root.createNestedObject("lastSeenJournal");
+    ls["entries"] = lastSeen.size();
+    ls["fileRecords"] = lastSeen.fileRecords();
+    ls["bytesWritten"] = lastSeen.bytesWritten;
+    ls["compactions"] = lastSeen.compactions;
+    ls["repairs"] = lastSeen.repairs;
+    JsonObject push = root.createNestedObject("push");
+    push["clients"] = events.count();
+    push["skipped"] = pushSkipped;
+    push["resyncs"] = pushResyncs;
+    root["bleEventsDropped"] = bleEvents.dropped;
+    JsonObject al = root.createNestedObject("eedomus");
+    al["sent"] = alertBatcher.sentBatches;
+    al["failures"] = alertBatcher.failures;
+    al["coalesced"] = alertBatcher.coalesced;
+    al["dropped"] = alertBatcher.dropped + alertQueueDrops;
+    al["givenUp"] = alertBatcher.givenUp;
+    JsonObject hot = root.createNestedObject("hotPaths");
+    uint32_t over = 0;
+    for (const HotPath *hp : HOT_PATHS) {
+      JsonObject p = hot.createNestedObject(hp->name);
+      p["count"] = hp->count;
+      p["avgUs"] = hp->avgUs(cpuCyclesPerUs);
+      p["maxUs"] = hp->maxUs(cpuCyclesPerUs);
+      p["budgetUs"] = hp->budgetUs;
+      p["over"] = hp->overBudget;
+      over += hp->overBudget;
+    }
+    root["hotPathsOk"] = over == 0;
+    JsonObject vc = root.createNestedObject("vendorCache");
+    uint32_t hits = vendorCache.hits, misses = vendorCache.misses;
+    vc["hits"] = hits;
+    vc["misses"] = misses;
+    vc["hitRate"] = (hits + misses) ? (float)hits / (hits + misses) : 0.0f;
     String output;
     serializeJson(doc, output);
     request->send(200, "application/json", output);
   });
 
+  // Live push: a reconnecting browser resumes from its Last-Event-ID, set
+  // by the next pushEvents() (placePushCursor)
+  pushLock = xSemaphoreCreateMutex();
+  events.onConnect([](AsyncEventSourceClient *client) {
+    xSemaphoreTake(pushLock, portMAX_DELAY);
+    pushClients.push_back({client, 0, true});
+    xSemaphoreGive(pushLock);
+  });
+  events.onDisconnect([](AsyncEventSourceClient *client) {
+    xSemaphoreTake(pushLock, portMAX_DELAY);
+    for (size_t i = 0; i < pushClients.size(); i++) {
+      if (pushClients[i].client == client) {
+        pushClients.erase(pushClients.begin() + i);
+        break;
+      }
+    }
+    xSemaphoreGive(pushLock);
+  });
+  server.addHandler(&events);
+
   server.begin();
   scanStartTime = millis() - SCAN_TIME * 1000; // Trigger immediately
 }
@@ -711,50 +2205,140 @@ void setup() {
 // LOOP
 // ------------------------------------------------------------------
 void loop() {
-  unsigned long currentMillis = millis();
+  bool maintain = false;
+  ScanOp op;
+  ScanProfile profile;
+  bool gattDue = false;
+  GattTask gattTask;
+  static PushOutbox outbox; // loop() only; buffers reused
+  {
+    StateLock lock;
+
+    // A source standing in for the radio queues what is due since the
+    // last pass, as the radio would have meanwhile: the ring drops a burst
+    // it cannot hold. The scan stays off, leaving it the only producer.
+    BleEvent ev;
+    uint16_t n = 0;
+    bool standIn = radioStandIn();
+    if (standIn && scanInProgress) {
+      stopScan();
+      scanInProgress = false;
+    }
+    if (standIn && !radarClock.isVirtual()) {
+      uint32_t now = radarClock.ms();
+      while (advertSource->next(now, ev))
+        scanCallbacks.onResult(ev);
+    }
 
-  // Alternate Scanning and Pausing (to let WiFi work)
-  if (!scanInProgress) {
-    if (currentMillis - scanStartTime >= (PAUSE_TIME * 1000)) {
-      // Start scanning!
-      scanInProgress = true;
-      NimBLEDevice::getScan()->start(SCAN_TIME, false);
-      scanStartTime = currentMillis;
+    // Apply the adverts queued by onResult (the only writer of the table).
+    // millis() is read afterwards so every lastSeen is <= currentMillis.
+    while (bleEvents.pop(ev)) {
+      if (replayReport.running && !standIn)
+        continue; // the radio is muted while a trace plays
+      if (traceWriter.active())
+        traceWriter.add(ev);
+      applyBleEvent(ev);
+      n += standIn;
     }
-  } else {
-    if (currentMillis - scanStartTime >= (SCAN_TIME * 1000)) {
-      // Stop scanning
-      NimBLEDevice::getScan()->stop();
-      scanInProgress = false;
-      scanStartTime = currentMillis;
+    // Then the non-radio source, if any, through the same path
+    if (advertSource != nullptr && radarClock.isVirtual()) {
+      n += stepVirtualTime();
+    } else if (advertSource != nullptr && !standIn) {
+      uint32_t now = radarClock.ms();
+      for (; n < ADVERT_SOURCE_BATCH && advertSource->next(now, ev); n++)
+        applyBleEvent(ev);
+    }
+    updateReplay(n);
+    unsigned long currentMillis = millis();
+    uint32_t radarNow = radarClock.ms();
 
-      // GATT client désactivé — le scan actif suffit pour les noms
-      // (le client GATT monopolise le radio BLE et dégrade la qualité du scan)
+    // Deadlines: presence, list visibility, retention, alert re-arm
+    deviceTimers.advance(radarNow, onDeviceTimer);
 
-      // Cleanup old devices from memory
-      auto i = std::begin(detectedDevices);
-      while (i != std::end(detectedDevices)) {
-        if (currentMillis - i->lastSeen > 120000) {
-          i = detectedDevices.erase(i);
-        } else {
-          ++i;
+    // Live push: device changes coalesced per interval
+    if (currentMillis - lastPush >= PUSH_INTERVAL_MS) {
+      lastPush = currentMillis;
+      pushEvents();
+    }
+
+    // Scan profile follows the web load
+    if (currentMillis - lastScanAdapt >= SCAN_ADAPT_MS) {
+      lastScanAdapt = currentMillis;
+      adaptScanProfile();
+    }
+
+    DeviceHandle gattTarget;
+    if (CONTINUOUS_SCAN) {
+      // Open a scan gap for one GATT connection now and then
+      if (GATT_ENABLED && scanInProgress && !gattTaskRunning &&
+          currentMillis - lastGatt >= GATT_PERIOD_MS) {
+        lastGatt = currentMillis;
+        if (pickGattCandidate(radarNow, gattTarget)) {
+          stopScan();
+          scanInProgress = false;
+          gattGapOpen = true;
+          gattGapSince = radarNow;
+          gattDue = true;
+          startGatt(gattTarget, radarNow, gattTask);
         }
       }
-
-      // Batch NVS flush: only if data changed (flag dirty)
-      if (lastSeenDirty && !lastSeenMap.empty()) {
-        DynamicJsonDocument doc(4096);
-        JsonObject obj = doc.to<JsonObject>();
-        for (auto &kv : lastSeenMap) {
-          obj[kv.first] = (long)kv.second;
+      if (!scanInProgress && gattGapOver(radarNow) && !standIn) {
+        if (gattGapOpen)
+          sightingGaps.addBlind(gattGapSince, radarNow);
+        gattGapOpen = false;
+        scanInProgress = true;
+        startScan();
+      }
+      if (currentMillis - lastMaintenance >= MAINTENANCE_MS) {
+        lastMaintenance = currentMillis;
+        maintain = true;
+      }
+    } else if (!scanInProgress) {
+      // Alternate Scanning and Pausing (to let WiFi work); a GATT
+      // connection set up in the pause delays the next scan, within
+      // GATT_GAP_MAX_MS
+      if (currentMillis - scanStartTime >= (PAUSE_TIME * 1000) &&
+          gattGapOver(radarNow) && !standIn) {
+        // Start scanning!
+        scanInProgress = true;
+        startScan();
+        scanStartTime = currentMillis;
+      }
+    } else {
+      if (currentMillis - scanStartTime >= (SCAN_TIME * 1000)) {
+        // Stop scanning
+        stopScan();
+        scanInProgress = false;
+        scanStartTime = currentMillis;
+
+        // GATT enrichment uses the pause, one device per cycle
+        if (GATT_ENABLED && !gattTaskRunning &&
+            pickGattCandidate(radarNow, gattTarget)) {
+          gattGapSince = radarNow;
+          gattDue = true;
+          startGatt(gattTarget, radarNow, gattTask);
         }
-        String out;
-        serializeJson(doc, out);
-        preferences.begin("radar", false);
-        preferences.putString("lastseen", out);
-        preferences.end();
-        lastSeenDirty = false;
+
+        maintain = true;
       }
     }
+    if (maintain)
+      takeMaintenance(maintenance);
+    op = scanOp;
+    scanOp = ScanOp::None;
+    profile = SCAN_PROFILES[scanProfile];
+    std::swap(outbox, pushOutbox);
+  }
+  // Radio, push and flash work, without the lock
+  applyScanOp(op, profile);
+  if (gattDue)
+    sendGattTask(gattTask);
+  sendPushOutbox(outbox);
+  if (maintain) {
+    writeMaintenance(maintenance);
+    StateLock lock;
+    endMaintenance(maintenance);
   }
+  // Give the web handlers waiting on stateMutex a turn
+  delay(1);
 }
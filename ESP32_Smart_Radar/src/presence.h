@@ -0,0 +1,128 @@
+#ifndef PRESENCE_H
+#define PRESENCE_H
+
+#include <stdint.h>
+
+// Per-device presence state machine:
+//
+//   Unseen -> Candidate -> Present <-> Leaving -> Absent -> Candidate ...
+//
+// (a Candidate that goes silent falls back to Unseen, without an event).
+// A device becomes Candidate when heard at or above enterDbm, Present
+// ("arrived") when heard again enterDwellMs or more after that with a full
+// RSSI median window, Leaving when silent for leaveSilenceMs or when its
+// smoothed level drops below exitDbm, and Absent ("left") after exitDwellMs
+// in Leaving. Heard again at enterDbm or more, a Leaving device is Present
+// again without any event. enterDbm > exitDbm is the RSSI hysteresis; the
+// dwell times keep one burst of packets, or one missed scan, from
+// producing events.
+//
+// presenceStep() is evaluated on every sighting and when the deadline
+// given by presenceDeadline() passes, so no periodic sweep is needed.
+enum class Presence : uint8_t {
+  Unseen = 0, // zero-initialized records start here
+  Candidate,
+  Present,
+  Leaving,
+  Absent,
+};
+
+enum class PresenceEvent : uint8_t { None, Arrived, Left };
+
+struct PresenceConfig {
+  uint32_t enterDwellMs;
+  uint32_t candidateSilenceMs; // a Candidate silent this long is dropped
+  uint32_t leaveSilenceMs;
+  uint32_t exitDwellMs;
+  int8_t enterDbm;
+  int8_t exitDbm;
+};
+
+struct PresenceState {
+  Presence state;
+  uint32_t since; // millis() of the last transition
+};
+
+const uint32_t PRESENCE_NO_DEADLINE = 0xFFFFFFFF;
+
+inline const char *presenceLabel(Presence p) {
+  switch (p) {
+  case Presence::Candidate:
+    return "candidate";
+  case Presence::Present:
+    return "present";
+  case Presence::Leaving:
+    return "leaving";
+  case Presence::Absent:
+    return "absent";
+  default:
+    return "unseen";
+  }
+}
+
+// Applies the transitions due at `now`. `heard` is true when called for a
+// sighting at `now`; `level` is the smoothed RSSI, `ready` whether its
+// median window is full. Times are millis() values (wrap-safe).
+inline PresenceEvent presenceStep(PresenceState &ps, const PresenceConfig &c,
+                                  uint32_t now, uint32_t lastSeen, bool heard,
+                                  int level, bool ready) {
+  uint32_t silence = now - lastSeen;
+  switch (ps.state) {
+  case Presence::Unseen:
+  case Presence::Absent:
+    if (heard && level >= c.enterDbm) {
+      ps.state = Presence::Candidate;
+      ps.since = now;
+    }
+    return PresenceEvent::None;
+  case Presence::Candidate:
+    if (silence >= c.candidateSilenceMs || level < c.exitDbm) {
+      ps.state = Presence::Unseen;
+      ps.since = now;
+    } else if (heard && ready && now - ps.since >= c.enterDwellMs) {
+      ps.state = Presence::Present;
+      ps.since = now;
+      return PresenceEvent::Arrived;
+    }
+    return PresenceEvent::None;
+  case Presence::Present:
+    if (silence >= c.leaveSilenceMs || level < c.exitDbm) {
+      ps.state = Presence::Leaving;
+      ps.since = now;
+    }
+    return PresenceEvent::None;
+  case Presence::Leaving:
+    if (heard && level >= c.enterDbm) {
+      ps.state = Presence::Present;
+      ps.since = now;
+    } else if (now - ps.since >= c.exitDwellMs) {
+      ps.state = Presence::Absent;
+      ps.since = now;
+      return PresenceEvent::Left;
+    }
+    return PresenceEvent::None;
+  }
+  return PresenceEvent::None;
+}
+
+// Next time presenceStep() can change the state without a sighting, or
+// PRESENCE_NO_DEADLINE. Sightings only push the deadline later, so a timer
+// armed for it fires at worst early, and then re-arms. A Candidate only
+// arrives on a sighting, so its deadline is the drop.
+inline uint32_t presenceDeadline(const PresenceState &ps,
+                                 const PresenceConfig &c, uint32_t now,
+                                 uint32_t lastSeen) {
+  (void)now;
+  switch (ps.state) {
+  case Presence::Candidate:
+    return lastSeen + c.candidateSilenceMs;
+  case Presence::Present:
+    return lastSeen + c.leaveSilenceMs;
+  case Presence::Leaving:
+    return ps.since + c.exitDwellMs;
+  default:
+    return PRESENCE_NO_DEADLINE;
+  }
+}
+
+#endif // PRESENCE_H
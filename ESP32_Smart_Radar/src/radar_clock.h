@@ -0,0 +1,84 @@
+#ifndef RADAR_CLOCK_H
+#define RADAR_CLOCK_H
+
+#include <atomic>
+#include <stdint.h>
+#include <time.h>
+
+// Time base of the radar logic: sightings, presence, expiry, GATT retries
+// and the flush cadence read ms() / epoch() instead of millis() / time().
+//
+// Live, ms() and epoch() are the sources given to the constructor
+// (main.cpp passes millis() and time()). In virtual mode the clock only
+// moves when advanceTo() is called, so a replay or a simulation sets it
+// from its own timestamps and a day of traffic runs as fast as it can be
+// applied. ms() stays monotonic across modes: after a virtual run it
+// carries on from the time reached, as the source plus an offset. The wall
+// clock is only virtual during the run; afterwards epoch() is the source's
+// again.
+//
+// ms() may be read from any task (onResult stamps adverts on the NimBLE
+// host task) while another switches modes; the mode, virtual time and
+// offset are atomics for that. epoch() and the mode switches belong to
+// whoever holds the lock around the radar state.
+class RadarClock {
+public:
+  typedef uint32_t (*MsSource)();
+  typedef time_t (*EpochSource)();
+
+  RadarClock(MsSource ms, EpochSource epoch)
+      : msSource_(ms), epochSource_(epoch) {}
+
+  uint32_t ms() const {
+    if (virtual_.load(std::memory_order_acquire))
+      return virtualMs_.load(std::memory_order_relaxed);
+    return msSource_() + offsetMs_.load(std::memory_order_relaxed);
+  }
+
+  time_t epoch() const {
+    if (!virtual_.load(std::memory_order_relaxed))
+      return epochSource_();
+    return epochStart_ == 0
+               ? 0
+               : epochStart_ +
+                     (virtualMs_.load(std::memory_order_relaxed) - startMs_) /
+                         1000;
+  }
+
+  // Freezes the clock at the current time.
+  void startVirtual() {
+    startMs_ = ms();
+    virtualMs_.store(startMs_, std::memory_order_relaxed);
+    epochStart_ = epochSource_();
+    if (epochStart_ < 100000) // no NTP: keep the wall clock unset
+      epochStart_ = 0;
+    virtual_.store(true, std::memory_order_release);
+  }
+
+  // Moves virtual time forward to t (never backward).
+  void advanceTo(uint32_t t) {
+    if ((int32_t)(t - virtualMs_.load(std::memory_order_relaxed)) > 0)
+      virtualMs_.store(t, std::memory_order_relaxed);
+  }
+
+  void stopVirtual() {
+    if (!virtual_.load(std::memory_order_relaxed))
+      return;
+    offsetMs_.store(virtualMs_.load(std::memory_order_relaxed) - msSource_(),
+                    std::memory_order_relaxed);
+    virtual_.store(false, std::memory_order_release);
+  }
+
+  bool isVirtual() const { return virtual_.load(std::memory_order_relaxed); }
+
+private:
+  MsSource msSource_;
+  EpochSource epochSource_;
+  std::atomic<bool> virtual_{false};
+  std::atomic<uint32_t> virtualMs_{0};
+  std::atomic<uint32_t> offsetMs_{0};
+  uint32_t startMs_ = 0;
+  time_t epochStart_ = 0;
+};
+
+#endif // RADAR_CLOCK_H
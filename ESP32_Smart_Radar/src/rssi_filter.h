@@ -0,0 +1,81 @@
+#ifndef RSSI_FILTER_H
+#define RSSI_FILTER_H
+
+#include <math.h>
+#include <stdint.h>
+
+// Per-device RSSI smoothing in 8 bytes. The median of the last three
+// samples rejects single-packet outliers (a reflection, a packet heard on a
+// weaker channel), then a fixed-point EMA (alpha = 1/4) gives the level and
+// an EMA of the squared deviation its variance. Level and variance are kept
+// in 1/16 dB and 1/16 dB^2. Zero-initialized state is "no sample yet", so
+// the filter lives directly in the POD device record.
+struct RssiFilter {
+  static const int FRAC = 16;
+  static const int ALPHA_DIV = 4;
+  static const uint8_t READY_SAMPLES = 3; // a full median window
+
+  int8_t prev[2];  // two previous raw samples, newest first
+  uint8_t samples; // saturates at 255
+  int16_t mean;    // smoothed RSSI, 1/16 dB
+  uint16_t var;    // variance, 1/16 dB^2, saturating
+
+  void add(int8_t rssi) {
+    int8_t m = samples >= 2 ? median3(rssi, prev[0], prev[1]) : rssi;
+    prev[1] = prev[0];
+    prev[0] = rssi;
+    if (samples == 0) {
+      mean = m * FRAC;
+      var = 0;
+    } else {
+      int32_t d = m * FRAC - mean;
+      mean += d / ALPHA_DIV;
+      uint32_t sq = (uint32_t)(d * d) / FRAC;
+      if (sq > 0xFFFF)
+        sq = 0xFFFF;
+      var += ((int32_t)sq - var) / ALPHA_DIV;
+    }
+    if (samples < 255)
+      samples++;
+  }
+
+  bool ready() const { return samples >= READY_SAMPLES; }
+
+  // Smoothed RSSI, rounded to the nearest dB.
+  int level() const {
+    return (mean >= 0 ? mean + FRAC / 2 : mean - FRAC / 2) / FRAC;
+  }
+
+  // Level and variance in tenths, for the API.
+  long levelTenths() const { return roundDiv(mean * 10L, FRAC); }
+  long varianceTenths() const { return roundDiv(var * 10L, FRAC); }
+
+private:
+  static int8_t median3(int8_t a, int8_t b, int8_t c) {
+    if (a > b) {
+      int8_t t = a;
+      a = b;
+      b = t;
+    }
+    // a <= b: the median is c clamped to [a, b]
+    return c < a ? a : (c > b ? b : c);
+  }
+
+  static long roundDiv(long v, long d) {
+    return (v >= 0 ? v + d / 2 : v - d / 2) / d;
+  }
+};
+
+// Log-distance path loss: the advertised TX power is the level at 0 m, about
+// 41 dB above the level at 1 m on 2.4 GHz; RSSI_PATH_LOSS_EXP is 2 in free
+// space, 2.5-3 indoors. Only an order of magnitude: +-6 dB of fading is a
+// factor 1.7 on the distance.
+const float RSSI_PATH_LOSS_EXP = 2.5f;
+const int RSSI_LOSS_AT_1M_DB = 41;
+
+inline float rssiDistanceM(float rssi, int8_t txPower) {
+  float at1m = txPower - RSSI_LOSS_AT_1M_DB;
+  return powf(10.0f, (at1m - rssi) / (10.0f * RSSI_PATH_LOSS_EXP));
+}
+
+#endif // RSSI_FILTER_H
@@ -0,0 +1,76 @@
+#ifndef SCAN_STATS_H
+#define SCAN_STATS_H
+
+#include <stdint.h>
+
+// Detection latency estimate from the gaps between consecutive sightings of
+// the same device. For an advertiser appearing at a uniformly random time,
+// the expected wait until its first sighting is the mean residual gap,
+// E[g^2] / (2 E[g]). decay() halves the sums so the estimate follows the
+// current scan profile rather than the whole uptime.
+//
+// Windows the scan is stopped for (a GATT connection being set up) are
+// counted apart: one of length b in a period T delays an advertiser
+// appearing at random by b^2 / (2T) on average, added to the estimate.
+// Sighting gaps that span such a window are left out, so it is not counted
+// twice.
+class SightingGaps {
+public:
+  static const uint32_t MAX_GAP_MS = 30000; // longer: the device was away
+
+  // A device last heard at fromMs heard again at toMs.
+  void add(uint32_t fromMs, uint32_t toMs) {
+    uint32_t gapMs = toMs - fromMs;
+    if (gapMs > MAX_GAP_MS || (int32_t)(blindEnd_ - fromMs) > 0)
+      return;
+    sum_ += gapMs;
+    sumSq_ += (uint64_t)gapMs * gapMs;
+    if (gapMs > maxGap_)
+      maxGap_ = gapMs;
+  }
+
+  // The scan was off from startMs to endMs.
+  void addBlind(uint32_t startMs, uint32_t endMs) {
+    uint32_t ms = endMs - startMs;
+    blindSq_ += (uint64_t)ms * ms;
+    blindMs += ms;
+    blindEnd_ = endMs;
+    if (ms > maxGap_)
+      maxGap_ = ms;
+  }
+
+  uint32_t latencyMs(uint32_t nowMs) const {
+    uint64_t span = span_ + (nowMs - periodStart_);
+    uint32_t radio = sum_ ? (uint32_t)(sumSq_ / (2 * sum_)) : 0;
+    return radio + (span ? (uint32_t)(blindSq_ / (2 * span)) : 0);
+  }
+
+  // Largest gap over the current and previous decay periods.
+  uint32_t maxGapMs() const {
+    return maxGap_ > prevMaxGap_ ? maxGap_ : prevMaxGap_;
+  }
+
+  void decay(uint32_t nowMs) {
+    sum_ /= 2;
+    sumSq_ /= 2;
+    blindSq_ /= 2;
+    span_ = (span_ + (nowMs - periodStart_)) / 2;
+    periodStart_ = nowMs;
+    prevMaxGap_ = maxGap_;
+    maxGap_ = 0;
+  }
+
+  uint64_t blindMs = 0; // since boot
+
+private:
+  uint64_t sum_ = 0;
+  uint64_t sumSq_ = 0;
+  uint64_t blindSq_ = 0;
+  uint64_t span_ = 0;
+  uint32_t periodStart_ = 0;
+  uint32_t blindEnd_ = 0;
+  uint32_t maxGap_ = 0;
+  uint32_t prevMaxGap_ = 0;
+};
+
+#endif // SCAN_STATS_H
@@ -0,0 +1,48 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Lock-free single-producer / single-consumer ring: exactly one task calls
+// push() and exactly one (other) task calls pop(). Neither side ever
+// blocks; when the ring is full push() drops the item and counts it.
+template <typename T, uint16_t Capacity> class SpscRing {
+public:
+  bool push(const T &item) {
+    uint16_t head = head_.load(std::memory_order_relaxed);
+    if ((uint16_t)(head - tail_.load(std::memory_order_acquire)) == Capacity) {
+      dropped++;
+      return false;
+    }
+    items_[head & (Capacity - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &item) {
+    uint16_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire))
+      return false;
+    item = items_[tail & (Capacity - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  uint16_t size() const {
+    return (uint16_t)(head_.load(std::memory_order_acquire) -
+                      tail_.load(std::memory_order_acquire));
+  }
+
+  // Written by the producer only.
+  uint32_t dropped = 0;
+
+private:
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+  T items_[Capacity];
+  std::atomic<uint16_t> head_{0};
+  std::atomic<uint16_t> tail_{0};
+};
+
+#endif // SPSC_RING_H
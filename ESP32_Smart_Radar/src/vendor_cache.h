@@ -0,0 +1,62 @@
+#ifndef VENDOR_CACHE_H
+#define VENDOR_CACHE_H
+
+#include <stdint.h>
+
+// Small 2-way set-associative cache in front of the flash OUI search.
+// Traffic is dominated by a handful of OUIs (Apple, Samsung, ...), so a
+// few dozen entries absorb most lookups. Misses (nullptr) are cached too:
+// random addresses have no vendor and would otherwise always hit flash.
+template <uint16_t Sets> class VendorCache {
+public:
+  typedef const char *(*LookupFn)(uint32_t prefix);
+
+  explicit VendorCache(LookupFn lookup) : lookup_(lookup) { clear(); }
+
+  void clear() {
+    for (uint16_t s = 0; s < Sets; s++) {
+      for (uint8_t w = 0; w < 2; w++)
+        ways_[s][w].tag = EMPTY;
+      lru_[s] = 0;
+    }
+    hits = misses = 0;
+  }
+
+  const char *get(uint32_t prefix) {
+    uint16_t s = setOf(prefix);
+    for (uint8_t w = 0; w < 2; w++) {
+      if (ways_[s][w].tag == prefix) {
+        lru_[s] = w ^ 1;
+        hits++;
+        return ways_[s][w].vendor;
+      }
+    }
+    misses++;
+    uint8_t victim = lru_[s];
+    ways_[s][victim].tag = prefix;
+    ways_[s][victim].vendor = lookup_(prefix);
+    lru_[s] = victim ^ 1;
+    return ways_[s][victim].vendor;
+  }
+
+  uint32_t hits;
+  uint32_t misses;
+
+private:
+  static_assert((Sets & (Sets - 1)) == 0, "Sets must be a power of two");
+  static const uint32_t EMPTY = 0xFFFFFFFF; // not a valid 24-bit prefix
+
+  static uint16_t setOf(uint32_t prefix) {
+    return (uint16_t)((prefix ^ (prefix >> 7) ^ (prefix >> 15)) & (Sets - 1));
+  }
+
+  struct Way {
+    uint32_t tag;
+    const char *vendor;
+  };
+  Way ways_[Sets][2];
+  uint8_t lru_[Sets]; // way to evict next
+  LookupFn lookup_;
+};
+
+#endif // VENDOR_CACHE_H
@@ -0,0 +1,32 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+// Counts heap allocations of the whole test program by replacing the
+// global operator new / delete. Include from exactly one file of a suite.
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+// GCC pairs the inlined malloc with std::allocator's delete and warns.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+struct AllocCounter {
+  std::atomic<size_t> count{0};
+  std::atomic<size_t> bytes{0};
+};
+inline AllocCounter heapAllocs;
+
+void *operator new(size_t n) {
+  heapAllocs.count.fetch_add(1, std::memory_order_relaxed);
+  heapAllocs.bytes.fetch_add(n, std::memory_order_relaxed);
+  if (void *p = malloc(n ? n : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t n) { return operator new(n); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+#endif // ALLOC_COUNTER_H
@@ -0,0 +1,47 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Timing for the test_bench_* suites (`pio test -e native_bench`, -O2).
+// Each measurement is the best of a few runs, which filters out the host's
+// scheduling noise better than an average.
+#include <chrono>
+#include <stdint.h>
+
+inline uint64_t benchNowNs() {
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Nanoseconds per call of fn(i), i in [0, ops), best of `runs`.
+template <typename Fn>
+double nsPerOp(uint32_t ops, Fn fn, int runs = 3) {
+  double best = 1e30;
+  for (int r = 0; r < runs; r++) {
+    uint64_t t0 = benchNowNs();
+    for (uint32_t i = 0; i < ops; i++)
+      fn(i);
+    double ns = (double)(benchNowNs() - t0) / ops;
+    if (ns < best)
+      best = ns;
+  }
+  return best;
+}
+
+// Keeps the optimizer from dropping a computed value.
+template <typename T> inline void benchKeep(const T &v) {
+  asm volatile("" : : "g"(&v) : "memory");
+}
+
+// Deterministic xorshift32 for workloads.
+struct BenchRng {
+  uint32_t s = 2463534242u;
+  uint32_t next() {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+  }
+};
+
+#endif // BENCH_H
@@ -0,0 +1,287 @@
+#ifndef LEGACY_RADAR_H
+#define LEGACY_RADAR_H
+
+// The pre-DeviceTable device list of the original firmware (String fields,
+// linear search by formatted address, erase(begin()) past the cap), kept as
+// the baseline the test_bench_* suites compare against.
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct LegacyDevice {
+  String address;
+  String name;
+  int rssi;
+  String vendor;
+  String addressType;
+  int txPower;
+  String serviceUUIDs;
+  String manufacturerData;
+  uint16_t appearance;
+  String gattName;
+  int8_t batteryLevel;
+  bool gattAttempted;
+  unsigned long lastSeen;
+};
+
+// Update-or-append as the original onResult did it, for an address already
+// formatted "AA:BB:CC:DD:EE:FF".
+inline void legacyUpsert(std::vector<LegacyDevice> &devices, size_t cap,
+                         const String &address, int rssi) {
+  for (auto &dev : devices) {
+    if (dev.address == address) {
+      dev.rssi = rssi;
+      dev.lastSeen = millis();
+      return;
+    }
+  }
+  if (devices.size() >= cap)
+    devices.erase(devices.begin());
+  devices.push_back({address, "Unknown", rssi, "N/A", "Public (Fixe)", -999,
+                     "", "", 0, "", -1, false, millis()});
+}
+
+inline String legacyMacString(uint64_t mac) {
+  char buf[18];
+  snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X",
+           (unsigned)(mac >> 40) & 0xFF, (unsigned)(mac >> 32) & 0xFF,
+           (unsigned)(mac >> 24) & 0xFF, (unsigned)(mac >> 16) & 0xFF,
+           (unsigned)(mac >> 8) & 0xFF, (unsigned)mac & 0xFF);
+  return String(buf);
+}
+
+// The accessors of NimBLE 1.4's NimBLEAdvertisedDevice the original
+// onResult used: each walks the AD structures again and returns heap
+// std::strings, as the library does.
+class LegacyAdvert {
+public:
+  LegacyAdvert(NimBLEAdvertisedDevice &adv)
+      : adv_(adv), p_(adv.getPayload()), len_(adv.getPayloadLength()) {}
+
+  NimBLEAddress getAddress() { return adv_.getAddress(); }
+  uint8_t getAddressType() { return adv_.getAddressType(); }
+  int getRSSI() { return adv_.getRSSI(); }
+  bool haveName() { return find(0x09) || find(0x08); }
+  std::string getName() {
+    const uint8_t *d = find(0x09);
+    if (d == nullptr)
+      d = find(0x08);
+    return d ? std::string((const char *)d + 2, d[0] - 1) : std::string();
+  }
+  bool haveTXPower() { return find(0x0A) != nullptr; }
+  int8_t getTXPower() { return (int8_t)find(0x0A)[2]; }
+  bool haveServiceUUID() { return find(0x03) || find(0x02); }
+  int getServiceUUIDCount() {
+    const uint8_t *d = find(0x03);
+    if (d == nullptr)
+      d = find(0x02);
+    return d ? (d[0] - 1) / 2 : 0;
+  }
+  NimBLEUUID getServiceUUID(int i) {
+    const uint8_t *d = find(0x03);
+    if (d == nullptr)
+      d = find(0x02);
+    return NimBLEUUID((uint16_t)(d[2 + 2 * i] | d[3 + 2 * i] << 8));
+  }
+  bool haveManufacturerData() { return find(0xFF) != nullptr; }
+  std::string getManufacturerData() {
+    const uint8_t *d = find(0xFF);
+    return std::string((const char *)d + 2, d[0] - 1);
+  }
+  bool haveAppearance() { return find(0x19) != nullptr; }
+  uint16_t getAppearance() {
+    const uint8_t *d = find(0x19);
+    return d[2] | d[3] << 8;
+  }
+
+private:
+  const uint8_t *find(uint8_t type) {
+    for (size_t i = 0; i + 1 < len_ && p_[i] != 0; i += p_[i] + 1)
+      if (p_[i + 1] == type && i + p_[i] < len_)
+        return p_ + i;
+    return nullptr;
+  }
+
+  NimBLEAdvertisedDevice &adv_;
+  const uint8_t *p_;
+  size_t len_;
+};
+
+struct LegacyRadar {
+  std::vector<LegacyDevice> detectedDevices;
+  std::vector<String> whitelist;
+  std::map<String, time_t> lastSeenMap;
+  const char *(*vendorOf)(uint32_t prefix) = nullptr;
+  bool surveillanceActive = true;
+  uint32_t intrusions = 0;
+
+  bool isWhitelisted(String mac) {
+    for (String w : whitelist) {
+      if (w.equalsIgnoreCase(mac))
+        return true;
+    }
+    return false;
+  }
+
+  // The original onResult, line for line minus the serial log and the
+  // Eedomus call.
+  void onResult(LegacyAdvert *advertisedDevice) {
+    String address = String(advertisedDevice->getAddress().toString().c_str());
+    address.toUpperCase();
+    String name = "Unknown";
+    if (advertisedDevice->haveName()) {
+      name = String(advertisedDevice->getName().c_str());
+    }
+    int rssi = advertisedDevice->getRSSI();
+
+    String addrType = "Unknown";
+    switch (advertisedDevice->getAddressType()) {
+    case BLE_ADDR_PUBLIC:
+      addrType = "Public (Fixe)";
+      break;
+    case BLE_ADDR_RANDOM:
+      addrType = "Static Random";
+      break;
+    case BLE_ADDR_PUBLIC_ID:
+      addrType = "Public ID";
+      break;
+    case BLE_ADDR_RANDOM_ID:
+      addrType = "Random Resolvable (Smartphone)";
+      break;
+    }
+
+    int txPower =
+        advertisedDevice->haveTXPower() ? advertisedDevice->getTXPower() : -999;
+
+    String services = "";
+    if (advertisedDevice->haveServiceUUID()) {
+      for (int i = 0; i < advertisedDevice->getServiceUUIDCount(); i++) {
+        NimBLEUUID uuid = advertisedDevice->getServiceUUID(i);
+        services += String(uuid.toString().c_str()) + ", ";
+      }
+    }
+
+    String mfgData = "";
+    if (advertisedDevice->haveManufacturerData()) {
+      std::string rawStr = advertisedDevice->getManufacturerData();
+      char buf[4];
+      for (size_t i = 0; i < rawStr.length(); i++) {
+        sprintf(buf, "%02X", (uint8_t)rawStr[i]);
+        mfgData += String(buf);
+      }
+    }
+
+    uint16_t appearance = advertisedDevice->haveAppearance()
+                              ? advertisedDevice->getAppearance()
+                              : 0;
+
+    String vendor = "N/A";
+    if (address.length() >= 8) {
+      String cleanPrefix = address.substring(0, 8);
+      cleanPrefix.replace(":", "");
+      if (cleanPrefix.length() == 6) {
+        uint32_t prefix_int = strtoul(cleanPrefix.c_str(), NULL, 16);
+        const char *foundVendor = vendorOf(prefix_int);
+        if (foundVendor != nullptr) {
+          vendor = String(foundVendor);
+          if (name == "Unknown") {
+            name = vendor;
+          }
+        }
+      }
+    }
+
+    bool found = false;
+    for (auto &dev : detectedDevices) {
+      if (dev.address == address) {
+        if (name != "Unknown")
+          dev.name = name;
+        dev.rssi = rssi;
+        dev.vendor = vendor;
+        dev.addressType = addrType;
+        if (txPower != -999)
+          dev.txPower = txPower;
+        if (services.length() > 0)
+          dev.serviceUUIDs = services;
+        if (mfgData.length() > 0)
+          dev.manufacturerData = mfgData;
+        dev.appearance = appearance;
+        dev.lastSeen = millis();
+        time_t now;
+        time(&now);
+        if (now > 100000) {
+          lastSeenMap[dev.address] = now;
+        }
+        found = true;
+        break;
+      }
+    }
+
+    if (!found) {
+      if (detectedDevices.size() > 50) {
+        detectedDevices.erase(detectedDevices.begin());
+      }
+      detectedDevices.push_back({address, name, rssi, vendor, addrType, txPower,
+                                 services, mfgData, appearance, "", -1, false,
+                                 millis()});
+    }
+
+    if (surveillanceActive && !isWhitelisted(address)) {
+      if (rssi > -90)
+        intrusions++;
+    }
+  }
+};
+
+// The ESPHome component's lists before the indexed blob: a CSV string of
+// "AA:BB:CC:DD:EE:FF[|label]" entries, searched by re-normalizing every
+// entry (BlePersistentListsComponent::list_contains).
+inline std::string legacyNormalizeMac(const std::string &mac) {
+  std::string out;
+  out.reserve(mac.size());
+  for (char c : mac) {
+    if (c == ':' || c == '-' || (c >= '0' && c <= '9') ||
+        (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f'))
+      out += (char)(c >= 'a' && c <= 'f' ? c - 32 : c);
+  }
+  if (out.size() == 12) {
+    std::string formatted;
+    for (size_t i = 0; i < 12; i += 2) {
+      if (i)
+        formatted += ':';
+      formatted += out[i];
+      formatted += out[i + 1];
+    }
+    return formatted;
+  }
+  return mac;
+}
+
+inline std::string legacyEntryMacOnly(const std::string &entry) {
+  size_t p = entry.find('|');
+  if (p == std::string::npos)
+    return entry;
+  std::string mac = entry.substr(0, p);
+  while (!mac.empty() && mac.back() == ' ')
+    mac.pop_back();
+  return mac;
+}
+
+inline bool legacyListContains(const std::string &list_csv,
+                               const std::string &mac) {
+  std::string n = legacyNormalizeMac(mac);
+  if (n.empty())
+    return false;
+  std::istringstream iss(list_csv);
+  std::string item;
+  while (std::getline(iss, item, ',')) {
+    if (legacyNormalizeMac(legacyEntryMacOnly(item)) == n)
+      return true;
+  }
+  return false;
+}
+
+#endif // LEGACY_RADAR_H
@@ -0,0 +1,69 @@
+#ifndef RADAR_HARNESS_H
+#define RADAR_HARNESS_H
+
+// The firmware on the host, for the suites of test/: src/main.cpp built
+// against the shims of native/. A suite includes this once, boots the
+// radar with bootRadar() and then plays the board's tasks: the NimBLE host
+// task (hearAdvert), the Arduino loop task (runLoop, on the fake clock) and
+// the AsyncTCP task (server.get / server.post).
+//
+// Unity unwinds a failed assertion with longjmp, so never assert while
+// holding a StateLock.
+
+#include "main.cpp"
+
+#include <ArduinoJson.h>
+#include <vector>
+
+inline void bootRadar(const char *suite) {
+  nativeStorageReset(suite);
+  Serial.muted = true;
+  setup();
+}
+
+// Flags, then a Complete Local Name if any.
+inline std::vector<uint8_t> advertPayload(const char *name = nullptr) {
+  std::vector<uint8_t> p = {0x02, 0x01, 0x06};
+  if (name != nullptr) {
+    size_t n = strlen(name);
+    p.push_back((uint8_t)(n + 1));
+    p.push_back(0x09);
+    p.insert(p.end(), name, name + n);
+  }
+  return p;
+}
+
+// The radio hears an advert; false while no scan runs.
+inline bool hearAdvert(uint64_t mac, int rssi,
+                       const std::vector<uint8_t> &payload = advertPayload(),
+                       uint8_t addrType = BLE_ADDR_PUBLIC,
+                       bool connectable = true) {
+  NimBLEAdvertisedDevice adv(NimBLEAddress(mac, addrType), rssi,
+                             payload.data(), payload.size(), connectable);
+  return pBLEScan->hear(adv);
+}
+
+// loop() for `ms` of fake time: each pass ends with delay(1).
+inline void runLoop(uint32_t ms) {
+  uint64_t end = nativeClock.ms() + ms;
+  while (nativeClock.ms() < end)
+    loop();
+}
+
+// The body of a response as JSON; isNull() when it does not parse.
+inline DynamicJsonDocument jsonOf(const NativeHttpResponse &r,
+                                  size_t capacity = 64 * 1024) {
+  DynamicJsonDocument doc(capacity);
+  if (deserializeJson(doc, r.body.c_str()))
+    doc.clear();
+  return doc;
+}
+
+inline bool listedIn(JsonArray devices, const char *mac) {
+  for (JsonObject d : devices)
+    if (strcmp(d["mac"] | "", mac) == 0)
+      return true;
+  return false;
+}
+
+#endif // RADAR_HARNESS_H
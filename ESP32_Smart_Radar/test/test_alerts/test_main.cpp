@@ -0,0 +1,228 @@
+// Intrusion alerts against a slow Eedomus box: while its HTTP call hangs,
+// the radio callback and loop() keep their latency, later intruders are
+// batched into the next notification, and failures are retried then
+// given up. Alerted MACs go with their device record. `pio test -e native`
+#include "../radar_harness.h"
+#include <chrono>
+#include <condition_variable>
+#include <unity.h>
+
+using std::chrono::steady_clock;
+
+static const uint64_t INTRUDER_A = 0x5AA000000001ULL;
+static const uint64_t INTRUDER_B = 0x5AA000000002ULL;
+static const uint64_t INTRUDER_C = 0x5AA000000003ULL;
+static const uint64_t INTRUDER_D = 0x5AA000000004ULL;
+
+// The home automation box: each request blocks until the test opens the
+// gate, then answers `status`.
+struct SlowEedomus {
+  std::mutex m;
+  std::condition_variable cv;
+  bool open = false;
+  int status = 200;
+  int inFlight = 0;
+  std::vector<std::string> urls;
+
+  int serve(const std::string &url) {
+    std::unique_lock<std::mutex> lk(m);
+    urls.push_back(url);
+    inFlight++;
+    cv.wait(lk, [&] { return open; });
+    inFlight--;
+    return status;
+  }
+  void setOpen(bool o) {
+    std::lock_guard<std::mutex> lk(m);
+    open = o;
+    cv.notify_all();
+  }
+  size_t calls() {
+    std::lock_guard<std::mutex> lk(m);
+    return urls.size();
+  }
+  int busy() {
+    std::lock_guard<std::mutex> lk(m);
+    return inFlight;
+  }
+  std::string url(size_t i) {
+    std::lock_guard<std::mutex> lk(m);
+    return urls.at(i);
+  }
+};
+
+static SlowEedomus eedomus;
+
+void setUp() {}
+void tearDown() {}
+
+// Real time, for what the alert task does on its own thread.
+template <typename Pred> static bool waitFor(Pred pred, int ms = 5000) {
+  for (int i = 0; i < ms && !pred(); i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  return pred();
+}
+
+// The loop on the fake clock, letting the alert task see it move, until
+// pred holds or maxMs of fake time passed.
+template <typename Pred> static bool runUntil(Pred pred, uint32_t maxMs) {
+  for (uint32_t t = 0; t < maxMs && !pred(); t += 100) {
+    runLoop(100);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return pred();
+}
+
+static bool alerted(uint64_t mac) {
+  StateLock lock;
+  return isAlerted(mac);
+}
+
+// Heard close by until Present, which raises the alert.
+static bool intrude(uint64_t mac) {
+  for (int i = 0; i < 200 && !alerted(mac); i++) {
+    hearAdvert(mac, -60);
+    runLoop(200);
+  }
+  return alerted(mac);
+}
+
+static uint32_t eedomusStat(const char *key) {
+  DynamicJsonDocument stats = jsonOf(server.get("/api/stats"));
+  return stats["eedomus"][key] | 0xFFFFFFFFu;
+}
+
+static std::string macText(uint64_t mac) {
+  char s[18];
+  formatMac(mac, s);
+  return s;
+}
+
+static void test_hung_notification_does_not_stall_radio_or_loop() {
+  TEST_ASSERT_TRUE(intrude(INTRUDER_A));
+  TEST_ASSERT_TRUE(runUntil([] { return eedomus.busy() == 1; }, 2000));
+
+  // The HTTP call hangs: adverts from a crowd too far to alert, and loop()
+  double worstAdvertUs = 0, totalAdvertUs = 0, worstLoopUs = 0;
+  size_t adverts = 0;
+  for (int pass = 0; pass < 500; pass++) {
+    for (int k = 0; k < 8; k++) {
+      auto t0 = steady_clock::now();
+      bool heard = hearAdvert(0xC0DE00000000ULL + (pass * 8 + k) % 300, -91);
+      double us =
+          std::chrono::duration<double, std::micro>(steady_clock::now() - t0)
+              .count();
+      if (heard) {
+        adverts++;
+        totalAdvertUs += us;
+        worstAdvertUs = std::max(worstAdvertUs, us);
+      }
+    }
+    auto t0 = steady_clock::now();
+    loop();
+    worstLoopUs = std::max(
+        worstLoopUs,
+        std::chrono::duration<double, std::micro>(steady_clock::now() - t0)
+            .count());
+  }
+  printf("Eedomus call hung: %zu adverts, onResult mean %.1f us, worst %.0f "
+         "us; loop() worst %.0f us\n",
+         adverts, totalAdvertUs / adverts, worstAdvertUs, worstLoopUs);
+  TEST_ASSERT_TRUE(adverts > 1000);
+  TEST_ASSERT_TRUE(totalAdvertUs / adverts < 200);
+  TEST_ASSERT_TRUE(worstAdvertUs < 20000);
+  TEST_ASSERT_TRUE(worstLoopUs < 20000);
+  TEST_ASSERT_EQUAL(200, server.get("/api/devices").code);
+  TEST_ASSERT_EQUAL(0, eedomusStat("sent"));
+
+  // Intruders while it hangs are alerted in the UI and wait for the box
+  TEST_ASSERT_TRUE(intrude(INTRUDER_B));
+  TEST_ASSERT_TRUE(intrude(INTRUDER_C));
+  TEST_ASSERT_EQUAL(1, eedomus.calls());
+  TEST_ASSERT_EQUAL(1, eedomus.busy());
+
+  eedomus.setOpen(true);
+  TEST_ASSERT_TRUE(waitFor([] { return eedomus.busy() == 0; }));
+  TEST_ASSERT_TRUE(waitFor([] { return eedomusStat("sent") == 1; }));
+  // One notification for both, after the cooldown
+  TEST_ASSERT_TRUE(runUntil([] { return eedomus.calls() == 2; },
+                            ALERT_COOLDOWN + 10000));
+  TEST_ASSERT_TRUE(waitFor([] { return eedomusStat("sent") == 2; }));
+  std::string first = eedomus.url(0), second = eedomus.url(1);
+  TEST_ASSERT_TRUE(first.find("value=" + macText(INTRUDER_A) + "&") !=
+                   std::string::npos);
+  TEST_ASSERT_TRUE(second.find(macText(INTRUDER_B)) != std::string::npos);
+  TEST_ASSERT_TRUE(second.find(macText(INTRUDER_C)) != std::string::npos);
+  TEST_ASSERT_TRUE(second.find(macText(INTRUDER_A)) == std::string::npos);
+  TEST_ASSERT_EQUAL(1, eedomusStat("coalesced"));
+  TEST_ASSERT_EQUAL(0, eedomusStat("dropped"));
+}
+
+static void test_failing_box_is_retried_then_given_up() {
+  {
+    std::lock_guard<std::mutex> lk(eedomus.m);
+    eedomus.status = 500;
+  }
+  size_t before = eedomus.calls();
+  TEST_ASSERT_TRUE(intrude(INTRUDER_D));
+  // Cooldown, then 1 + 2 + 4 + 8 s of backoff between five attempts
+  size_t attempts = before + AlertBatcher::MAX_ATTEMPTS;
+  TEST_ASSERT_TRUE(runUntil([&] { return eedomus.calls() == attempts; },
+                            ALERT_COOLDOWN + 30000));
+  TEST_ASSERT_TRUE(waitFor([] { return eedomusStat("givenUp") == 1; }));
+  TEST_ASSERT_EQUAL(AlertBatcher::MAX_ATTEMPTS, eedomusStat("failures"));
+  // No sixth attempt
+  runUntil([] { return false; }, 60000);
+  TEST_ASSERT_EQUAL(attempts, eedomus.calls());
+  TEST_ASSERT_EQUAL(2, eedomusStat("sent"));
+}
+
+static bool listedInAlerts(uint64_t mac) {
+  DynamicJsonDocument list = jsonOf(server.get("/api/alerts"));
+  for (JsonVariant m : list.as<JsonArray>())
+    if (macText(mac) == (m | ""))
+      return true;
+  return false;
+}
+
+// An alert lasts as long as the record: pushed out of a full table by
+// devices heard since, the intruder is no longer listed, and alerts again
+// if it comes back. Disarming forgets every alert.
+static void test_alert_forgotten_with_its_record() {
+  const uint64_t INTRUDER_E = 0x5AA000000005ULL;
+  TEST_ASSERT_TRUE(intrude(INTRUDER_E));
+  TEST_ASSERT_TRUE(listedInAlerts(INTRUDER_E));
+  for (uint16_t i = 0; i < MAX_DEVICES; i++) {
+    hearAdvert(0xFA2000000000ULL + i, PRESENCE.exitDbm - 2);
+    runLoop(5);
+  }
+  bool kept;
+  {
+    StateLock lock;
+    kept = detectedDevices.find(INTRUDER_E) != nullptr;
+  }
+  TEST_ASSERT_FALSE(kept);
+  TEST_ASSERT_FALSE(alerted(INTRUDER_E));
+  TEST_ASSERT_FALSE(listedInAlerts(INTRUDER_E));
+  TEST_ASSERT_TRUE(intrude(INTRUDER_E));
+
+  server.post("/api/surveillance/toggle");
+  TEST_ASSERT_EQUAL(0, jsonOf(server.get("/api/alerts")).as<JsonArray>().size());
+  TEST_ASSERT_FALSE(alerted(INTRUDER_E));
+  server.post("/api/surveillance/toggle");
+}
+
+int main() {
+  bootRadar("test_alerts");
+  nativeHttpServer = [](const std::string &url) {
+    return eedomus.serve(url);
+  };
+  if (!(jsonOf(server.get("/api/surveillance"))["active"] | false))
+    server.post("/api/surveillance/toggle");
+  runLoop(10);
+  UNITY_BEGIN();
+  RUN_TEST(test_hung_notification_does_not_stall_radio_or_loop);
+  RUN_TEST(test_failing_box_is_retried_then_given_up);
+  RUN_TEST(test_alert_forgotten_with_its_record);
+  return UNITY_END();
+}
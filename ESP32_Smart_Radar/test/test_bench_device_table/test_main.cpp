@@ -0,0 +1,63 @@
+// DeviceTable::upsert against the original std::vector<BleDeviceData> list,
+// for a steady crowd (hits) and a passing one (every advert evicts).
+// `pio test -e native_bench`
+#include "../bench.h"
+#include "../legacy_radar.h"
+#include "ble_record.h"
+#include "device_table.h"
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+static const uint32_t OPS = 200000;
+
+template <uint16_t Cap>
+static void compare(const char *label, uint32_t population, double minSpeedup) {
+  std::vector<uint64_t> macs(population);
+  std::vector<String> addresses(population);
+  BenchRng rng;
+  for (uint32_t i = 0; i < population; i++) {
+    macs[i] = 0xA4C138000000ULL | (rng.next() & 0xFFFFFF);
+    addresses[i] = legacyMacString(macs[i]);
+  }
+  std::vector<uint32_t> order(OPS);
+  for (auto &o : order)
+    o = rng.next() % population;
+
+  static BleDeviceData records[Cap];
+  static DeviceTable<BleDeviceData, Cap> table;
+  table.clear();
+  table.begin(records);
+  double tableNs = nsPerOp(OPS, [&](uint32_t i) {
+    bool inserted;
+    BleDeviceData *d = table.upsert(macs[order[i]], inserted);
+    d->rssi = -60;
+    benchKeep(d);
+  });
+
+  std::vector<LegacyDevice> legacy;
+  double legacyNs = nsPerOp(OPS, [&](uint32_t i) {
+    legacyUpsert(legacy, Cap, addresses[order[i]], -60);
+  });
+
+  printf("%-28s cap %4u pop %5u  table %7.1f ns  vector %8.1f ns  x%.1f\n",
+         label, Cap, population, tableNs, legacyNs, legacyNs / tableNs);
+  TEST_ASSERT_TRUE(legacyNs / tableNs >= minSpeedup);
+}
+
+static void test_steady_crowd_64() { compare<64>("steady crowd", 50, 2.0); }
+static void test_steady_crowd_256() { compare<256>("steady crowd", 200, 4.0); }
+static void test_passing_crowd_64() { compare<64>("passing crowd", 5000, 2.0); }
+static void test_passing_crowd_256() {
+  compare<256>("passing crowd", 5000, 4.0);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_steady_crowd_64);
+  RUN_TEST(test_steady_crowd_256);
+  RUN_TEST(test_passing_crowd_64);
+  RUN_TEST(test_passing_crowd_256);
+  return UNITY_END();
+}
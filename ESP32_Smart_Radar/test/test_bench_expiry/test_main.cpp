@@ -0,0 +1,259 @@
+// Per-device expiry with three TTLs (presence silence 20 s, list
+// visibility 60 s, retention 120 s) for 50, 500 and 5,000 tracked devices:
+// the timer wheel with lazy deadlines, as loop() drives deviceTimers,
+// against the original once-per-cycle walk of a vector with erase(), and
+// the 1 s sweep over table slots it was replaced with.
+// `pio test -e native_bench`
+#include "../bench.h"
+#include "expiry_wheel.h"
+#include <unity.h>
+#include <vector>
+
+void setUp() {}
+void tearDown() {}
+
+static const uint32_t SIM_MS = 600000; // 10 minutes of traffic
+static const uint32_t STEP_MS = 100;   // one loop() pass per step
+static const uint32_t PRESENCE_MS = 20000;
+static const uint32_t VISIBLE_MS = 60000;
+static const uint32_t RETAIN_MS = 120000;
+
+// Traffic: `crowd` devices around, each heard once a second; every second
+// crowd/60 of them leave for good and as many new ones arrive. Devices are
+// numbered in arrival order; the schedule is the same for every variant.
+struct Traffic {
+  uint32_t crowd;
+  uint32_t arrivalsPerSec;
+  std::vector<uint32_t> lastSeen; // by device number
+
+  explicit Traffic(uint32_t n)
+      : crowd(n), arrivalsPerSec(n / 60 ? n / 60 : 1),
+        lastSeen(n + (SIM_MS / 1000 + 1) * arrivalsPerSec, 0) {}
+
+  // Devices [first, end) are around at `now`; those with d % 10 == phase
+  // are heard in this step.
+  uint32_t first(uint32_t now) const { return now / 1000 * arrivalsPerSec; }
+  uint32_t end(uint32_t now) const { return first(now) + crowd; }
+
+  template <typename Fn> void hear(uint32_t now, Fn fn) {
+    uint32_t phase = now / STEP_MS % 10;
+    for (uint32_t d = first(now) + (10 + phase - first(now) % 10) % 10;
+         d < end(now); d += 10) {
+      lastSeen[d] = now;
+      fn(d);
+    }
+  }
+};
+
+struct Result {
+  double usPerSimSec;
+  uint32_t forgotten;
+};
+
+// The firmware's scheme: one wheel entry per slot and TTL, armed when
+// something starts (insert, listing, presence) and re-armed at
+// lastSeen + TTL when it fires for a device heard since.
+template <uint16_t Slots> static Result runWheel(Traffic &t) {
+  enum { PRESENCE, VISIBLE, RETAIN, KINDS };
+  struct Slot {
+    uint32_t device;
+    uint16_t gen;
+    bool used, listed, present;
+  };
+  static Slot slots[Slots];
+  static ExpiryWheel<Slots * KINDS, 256> wheel(250);
+  static std::vector<uint16_t> freeSlots;
+  freeSlots.clear();
+  for (uint16_t s = 0; s < Slots; s++) {
+    slots[s] = {};
+    freeSlots.push_back(Slots - 1 - s);
+    for (int k = 0; k < KINDS; k++)
+      wheel.cancel(s * KINDS + k);
+  }
+  std::vector<uint16_t> slotOf(t.lastSeen.size(), 0xFFFF);
+  uint32_t forgotten = 0;
+  uint32_t now = 0;
+  wheel.begin(now);
+
+  auto onTimer = [&](uint16_t id, uint16_t gen) {
+    Slot &s = slots[id / KINDS];
+    if (!s.used || s.gen != gen)
+      return;
+    uint32_t seen = t.lastSeen[s.device];
+    uint16_t kind = id % KINDS;
+    uint32_t ttl = kind == PRESENCE ? PRESENCE_MS
+                   : kind == VISIBLE ? VISIBLE_MS
+                                     : RETAIN_MS;
+    if (now - seen < ttl) {
+      wheel.schedule(id, gen, seen + ttl);
+    } else if (kind == PRESENCE) {
+      s.present = false;
+    } else if (kind == VISIBLE) {
+      s.listed = false;
+    } else {
+      for (int k = 0; k < KINDS; k++)
+        wheel.cancel(id / KINDS * KINDS + k);
+      s.used = false;
+      slotOf[s.device] = 0xFFFF;
+      freeSlots.push_back(id / KINDS);
+      forgotten++;
+    }
+  };
+
+  uint64_t t0 = benchNowNs();
+  for (now = 0; now < SIM_MS; now += STEP_MS) {
+    t.hear(now, [&](uint32_t d) {
+      uint16_t s = slotOf[d];
+      if (s == 0xFFFF) {
+        s = freeSlots.back();
+        freeSlots.pop_back();
+        slotOf[d] = s;
+        slots[s].device = d;
+        slots[s].gen++;
+        slots[s].used = true;
+        wheel.schedule(s * KINDS + RETAIN, slots[s].gen, now + RETAIN_MS);
+      }
+      Slot &r = slots[s];
+      if (!r.listed) {
+        r.listed = true;
+        wheel.schedule(s * KINDS + VISIBLE, r.gen, now + VISIBLE_MS);
+      }
+      if (!r.present) {
+        r.present = true;
+        wheel.schedule(s * KINDS + PRESENCE, r.gen, now + PRESENCE_MS);
+      }
+    });
+    wheel.advance(now, onTimer);
+  }
+  double ns = (double)(benchNowNs() - t0);
+  return {ns / 1000 / (SIM_MS / 1000), forgotten};
+}
+
+// The original loop(): every cycle, walk the list, check each TTL and
+// erase() what is past retention.
+static Result runVectorErase(Traffic &t) {
+  struct Entry {
+    uint32_t device;
+    bool listed, present;
+  };
+  std::vector<Entry> devices;
+  std::vector<bool> known(t.lastSeen.size(), false);
+  uint32_t forgotten = 0;
+  uint64_t t0 = benchNowNs();
+  for (uint32_t now = 0; now < SIM_MS; now += STEP_MS) {
+    t.hear(now, [&](uint32_t d) {
+      if (!known[d]) {
+        known[d] = true;
+        devices.push_back({d, true, true});
+      }
+    });
+    if (now % 1000 != 0)
+      continue;
+    for (auto it = devices.begin(); it != devices.end();) {
+      uint32_t age = now - t.lastSeen[it->device];
+      if (age > RETAIN_MS) {
+        known[it->device] = false;
+        it = devices.erase(it);
+        forgotten++;
+        continue;
+      }
+      it->present = age < PRESENCE_MS;
+      it->listed = age < VISIBLE_MS;
+      ++it;
+    }
+  }
+  double ns = (double)(benchNowNs() - t0);
+  return {ns / 1000 / (SIM_MS / 1000), forgotten};
+}
+
+// The sweep before the wheel: fixed slots, every one checked each second.
+template <uint16_t Slots> static Result runSlotSweep(Traffic &t) {
+  struct Slot {
+    uint32_t device;
+    bool used, listed, present;
+  };
+  static Slot slots[Slots];
+  static std::vector<uint16_t> freeSlots;
+  freeSlots.clear();
+  for (uint16_t s = 0; s < Slots; s++) {
+    slots[s] = {};
+    freeSlots.push_back(Slots - 1 - s);
+  }
+  std::vector<uint16_t> slotOf(t.lastSeen.size(), 0xFFFF);
+  uint32_t forgotten = 0;
+  uint64_t t0 = benchNowNs();
+  for (uint32_t now = 0; now < SIM_MS; now += STEP_MS) {
+    t.hear(now, [&](uint32_t d) {
+      if (slotOf[d] == 0xFFFF) {
+        uint16_t s = freeSlots.back();
+        freeSlots.pop_back();
+        slotOf[d] = s;
+        slots[s] = {d, true, true, true};
+      }
+    });
+    if (now % 1000 != 0)
+      continue;
+    for (uint16_t s = 0; s < Slots; s++) {
+      Slot &r = slots[s];
+      if (!r.used)
+        continue;
+      uint32_t age = now - t.lastSeen[r.device];
+      if (age > RETAIN_MS) {
+        r.used = false;
+        slotOf[r.device] = 0xFFFF;
+        freeSlots.push_back(s);
+        forgotten++;
+        continue;
+      }
+      r.present = age < PRESENCE_MS;
+      r.listed = age < VISIBLE_MS;
+    }
+  }
+  double ns = (double)(benchNowNs() - t0);
+  return {ns / 1000 / (SIM_MS / 1000), forgotten};
+}
+
+// Each variant's best of three, in microseconds per second of traffic.
+template <uint16_t Slots>
+static void compare(uint32_t crowd, double minVsVector, double minVsSweep) {
+  Result wheel = {1e30, 0}, vec = {1e30, 0}, sweep = {1e30, 0};
+  for (int r = 0; r < 3; r++) {
+    Traffic a(crowd), b(crowd), c(crowd);
+    Result w = runWheel<Slots>(a), v = runVectorErase(b),
+           s = runSlotSweep<Slots>(c);
+    if (w.usPerSimSec < wheel.usPerSimSec)
+      wheel = w;
+    if (v.usPerSimSec < vec.usPerSimSec)
+      vec = v;
+    if (s.usPerSimSec < sweep.usPerSimSec)
+      sweep = s;
+  }
+  printf("%5u devices: wheel %7.2f us/s  vector+erase %8.2f us/s (x%.1f)  "
+         "slot sweep %7.2f us/s (x%.1f)  forgotten %u\n",
+         (unsigned)crowd, wheel.usPerSimSec, vec.usPerSimSec,
+         vec.usPerSimSec / wheel.usPerSimSec, sweep.usPerSimSec,
+         sweep.usPerSimSec / wheel.usPerSimSec, (unsigned)wheel.forgotten);
+  // Same traffic, same devices forgotten, give or take the last second
+  Traffic t(crowd);
+  TEST_ASSERT_TRUE(wheel.forgotten > 0);
+  TEST_ASSERT_TRUE(wheel.forgotten <= vec.forgotten + t.arrivalsPerSec &&
+                   vec.forgotten <= wheel.forgotten + t.arrivalsPerSec);
+  TEST_ASSERT_EQUAL(vec.forgotten, sweep.forgotten);
+  TEST_ASSERT_TRUE(vec.usPerSimSec / wheel.usPerSimSec >= minVsVector);
+  TEST_ASSERT_TRUE(sweep.usPerSimSec / wheel.usPerSimSec >= minVsSweep);
+}
+
+// Slots for the crowd plus those gone but retained (2 minutes of leavers).
+// The hearing side is the same in all three and is counted in each. At 50
+// devices the wheel only has to keep up; erase() turns quadratic at 5,000.
+static void test_50_devices() { compare<256>(50, 0.8, 0.8); }
+static void test_500_devices() { compare<1600>(500, 1.0, 1.0); }
+static void test_5000_devices() { compare<16000>(5000, 4.0, 1.1); }
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_50_devices);
+  RUN_TEST(test_500_devices);
+  RUN_TEST(test_5000_devices);
+  return UNITY_END();
+}
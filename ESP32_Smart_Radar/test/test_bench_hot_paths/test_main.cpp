@@ -0,0 +1,362 @@
+// The hot paths /api/stats times on the board (onResult, applyBleEvent,
+// vendorLookup, isWhitelisted, devicesChunk, lastSeenFlush) and the ESPHome
+// component's BlePersistentListsComponent::is_in_whitelist, on the host, at
+// 50, 500 and 5,000 devices and whitelists of 10 to 10,000 entries. The
+// firmware is built with RADAR_MAX_DEVICES=5000. The component's lists stop
+// at the NVS budget (about 570 MACs), so they are swept up to their cap.
+//
+// Results are written as JSON to $RADAR_BENCH_JSON (bench_hot_paths.json by
+// default). A result fails its test when it exceeds its limit: a tenth of
+// the path's budget on the board (see HOT_PATHS in main.cpp; the host runs
+// these about ten times faster than a 240 MHz ESP32). When
+// $RADAR_BENCH_BASELINE names an earlier results file, it also fails when
+// it is slower than there by more than $RADAR_BENCH_TOLERANCE (1 = twice as
+// slow, the default). That comparison is in units of a calibration loop
+// timed around each measurement, so a shared CI host running slower as a
+// whole does not count as a regression; what is left of its noise (up to
+// +70 % on a busy host) is the tolerance.
+// `pio test -e native_bench`
+#define RADAR_MAX_DEVICES 5000
+#include "../radar_harness.h"
+
+#include "../bench.h"
+#include "../legacy_radar.h"
+#include "ble_persistent_lists/ble_persistent_lists.cpp"
+#include <algorithm>
+#include <unity.h>
+
+using esphome::ble_persistent_lists::BlePersistentListsComponent;
+
+static const uint32_t HOST_SPEEDUP = 10;
+static const size_t WHITELIST_SIZES[] = {10, 100, 1000, 10000};
+
+struct BenchResult {
+  std::string name;
+  size_t size;
+  double ns;      // per operation
+  double limitNs; // 0: for comparison only
+  double calibrationNs;
+  double baselineNs; // in this run's calibration units, 0: none
+};
+static std::vector<BenchResult> results;
+static DynamicJsonDocument baseline(64 * 1024);
+static double tolerance = 1.0;
+static const int RUNS = 5;
+static size_t checked = 0;
+static double calibrationNs = 0; // the last calibration
+
+// The calibration loop: a binary search in 4096 sorted values.
+static double calibrate() {
+  static uint32_t sorted[4096];
+  BenchRng rng;
+  for (uint32_t &v : sorted)
+    v = rng.next();
+  std::sort(sorted, sorted + 4096);
+  return calibrationNs = nsPerOp(
+             100000,
+             [&](uint32_t) {
+               benchKeep(std::lower_bound(sorted, sorted + 4096, rng.next()));
+             },
+             RUNS);
+}
+
+void setUp() { calibrate(); }
+void tearDown() {}
+
+static double limitOf(const HotPath &hp) {
+  return hp.budgetUs * 1000.0 / HOST_SPEEDUP;
+}
+
+// Records a result; checkResults() judges it. The calibration is the mean
+// of those just before and just after the measurement.
+static void record(const char *name, size_t size, double ns, double limitNs) {
+  double before = calibrationNs;
+  double calibration = (before + calibrate()) / 2;
+  double base = 0;
+  for (JsonObject r : baseline["results"].as<JsonArray>()) {
+    double ns0 = r["ns"] | 0.0, calibration0 = r["calibrationNs"] | 0.0;
+    if (!strcmp(r["name"] | "", name) && (r["size"] | 0) == (long)size &&
+        calibration0 > 0)
+      base = ns0 / calibration0 * calibration;
+  }
+  results.push_back({name, size, ns, limitNs, calibration, base});
+  printf("%-16s %6u  %12.1f ns", name, (unsigned)size, ns);
+  if (limitNs > 0)
+    printf("  limit %10.0f", limitNs);
+  if (base > 0)
+    printf("  baseline %10.1f (%+.0f %%)", base, 100 * (ns / base - 1));
+  printf("\n");
+}
+
+// Fails the running test, naming every result recorded since the last
+// check that exceeds its limit or the baseline.
+static void checkResults() {
+  std::string over;
+  for (; checked < results.size(); checked++) {
+    const BenchResult &r = results[checked];
+    char line[96];
+    if (r.limitNs > 0 && r.ns > r.limitNs)
+      snprintf(line, sizeof(line), " %s/%u over its limit;", r.name.c_str(),
+               (unsigned)r.size);
+    else if (r.baselineNs > 0 && r.ns > r.baselineNs * (1 + tolerance))
+      snprintf(line, sizeof(line), " %s/%u slower than the baseline;",
+               r.name.c_str(), (unsigned)r.size);
+    else
+      continue;
+    over += line;
+  }
+  if (!over.empty())
+    TEST_FAIL_MESSAGE(over.c_str());
+}
+
+static uint64_t nthDevice(size_t i) { return 0x6C5AB0000000ULL + i * 40503; }
+static uint64_t nthListed(size_t i) { return 0xC0FFEE000000ULL + i * 7919; }
+
+// The advert of device i: flags, name, a service, manufacturer data.
+static NimBLEAdvertisedDevice advertOf(size_t i) {
+  char name[16];
+  snprintf(name, sizeof(name), "Dev-%05u", (unsigned)i);
+  std::vector<uint8_t> p = advertPayload(name);
+  p.insert(p.end(), {0x03, 0x03, 0x0F, 0x18, 0x02, 0x0A, 0xF4});
+  p.insert(p.end(), {0x07, 0xFF, 0x4C, 0x00, 0x10, 0x05, (uint8_t)i,
+                     (uint8_t)(i >> 8)});
+  return NimBLEAdvertisedDevice(NimBLEAddress(nthDevice(i), BLE_ADDR_PUBLIC),
+                                -50 - (int)(i % 40), p.data(), p.size(), true);
+}
+
+static void drainRing() {
+  StateLock lock;
+  BleEvent ev;
+  while (bleEvents.pop(ev))
+    applyBleEvent(ev);
+}
+
+static size_t populated = 0;
+
+// onResult (radio side) and applyBleEvent (loop side) per advert, the
+// adverts coming from n known devices.
+static void benchIngest(size_t n) {
+  std::vector<NimBLEAdvertisedDevice> pool;
+  for (size_t i = 0; i < n; i++)
+    pool.push_back(advertOf(i));
+  for (; populated < n; populated++) {
+    pBLEScan->hear(pool[populated]);
+    if (populated % 32 == 31)
+      drainRing();
+  }
+  drainRing();
+  TEST_ASSERT_EQUAL(n, detectedDevices.size());
+
+  const uint32_t OPS = 64 * 1024, BATCH = 32;
+  BenchRng rng;
+  std::vector<uint32_t> order(OPS);
+  for (auto &o : order)
+    o = rng.next() % n;
+  double onResultNs = 1e30, applyNs = 1e30;
+  for (int run = 0; run < RUNS; run++) {
+    uint64_t hearNs = 0, drainNs = 0;
+    for (uint32_t i = 0; i < OPS; i += BATCH) {
+      uint64_t t0 = benchNowNs();
+      for (uint32_t k = 0; k < BATCH; k++)
+        pBLEScan->hear(pool[order[i + k]]);
+      uint64_t t1 = benchNowNs();
+      drainRing();
+      drainNs += benchNowNs() - t1;
+      hearNs += t1 - t0;
+    }
+    onResultNs = std::min(onResultNs, (double)hearNs / OPS);
+    applyNs = std::min(applyNs, (double)drainNs / OPS);
+  }
+  TEST_ASSERT_EQUAL(0, bleEvents.dropped);
+  record("onResult", n, onResultNs, limitOf(hpOnResult));
+  record("applyBleEvent", n, applyNs, limitOf(hpApplyAdvert));
+}
+
+// The full /api/devices response, per chunk of the TCP window; small
+// responses are repeated more, being timed one at a time.
+static void benchDevicesApi(size_t n) {
+  NativeHttpResponse r;
+  double best = 1e30;
+  for (size_t run = 0; run < RUNS * 5000 / n; run++) {
+    uint64_t t0 = benchNowNs();
+    r = server.get("/api/devices");
+    best = std::min(best, (double)(benchNowNs() - t0));
+  }
+  TEST_ASSERT_EQUAL(200, r.code);
+  DynamicJsonDocument doc = jsonOf(r, 4 * 1024 * 1024);
+  TEST_ASSERT_EQUAL(n, doc["devices"].as<JsonArray>().size());
+  record("devicesChunk", n, best / r.chunks, limitOf(hpDevicesChunk));
+  record("devicesResponse", n, best, 0);
+}
+
+static void test_50_devices() {
+  benchIngest(50);
+  benchDevicesApi(50);
+  checkResults();
+}
+static void test_500_devices() {
+  benchIngest(500);
+  benchDevicesApi(500);
+  checkResults();
+}
+static void test_5000_devices() {
+  benchIngest(5000);
+  benchDevicesApi(5000);
+  checkResults();
+}
+
+// Known prefixes and strangers, half each, on the flash search itself.
+static void test_vendor_lookup() {
+  std::vector<uint32_t> probes(4096);
+  BenchRng rng;
+  for (auto &p : probes)
+    p = rng.next() % 2 ? ouiPrefixAt(rng.next() % OUI_TABLE_SIZE)
+                       : rng.next() & 0xFFFFFF;
+  double ns = nsPerOp(
+      200000,
+      [&](uint32_t i) { benchKeep(getVendorFromPROGMEM(probes[i & 4095])); },
+      RUNS);
+  record("vendorLookup", OUI_TABLE_SIZE, ns, limitOf(hpVendorLookup));
+  checkResults();
+}
+
+// Half hits, half strangers.
+static std::vector<uint64_t> whitelistProbes(size_t n) {
+  std::vector<uint64_t> probes(4096);
+  BenchRng rng;
+  for (auto &p : probes)
+    p = rng.next() % 2 ? nthListed(rng.next() % n)
+                       : 0xA4C138000000ULL | (rng.next() & 0xFFFFFF);
+  return probes;
+}
+
+static void benchWhitelist(size_t n) {
+  std::vector<uint64_t> macs;
+  for (size_t i = 0; i < n; i++)
+    macs.push_back(nthListed(i));
+  {
+    StateLock lock;
+    whitelist.assign(macs);
+  }
+  std::vector<uint64_t> probes = whitelistProbes(n);
+  double ns = nsPerOp(
+      200000, [&](uint32_t i) { benchKeep(isWhitelisted(probes[i & 4095])); },
+      RUNS);
+  record("isWhitelisted", n, ns, limitOf(hpWhitelist));
+
+  // Every whitelisted device heard since the last maintenance pass: the
+  // worst flush of the lastSeen journal
+  double flushNs = 1e30;
+  for (size_t run = 0; run < RUNS * (n < 1000 ? 10 : 2); run++) {
+    static uint32_t rounds = 0;
+    time_t now = radarClock.epoch() + ++rounds * 2 * LASTSEEN_RESOLUTION_SEC;
+    for (uint64_t mac : macs)
+      lastSeen.update(mac, now);
+    uint64_t t0 = benchNowNs();
+    lastSeen.flush();
+    flushNs = std::min(flushNs, (double)(benchNowNs() - t0));
+  }
+  record("lastSeenFlush", n, flushNs, limitOf(hpLastSeenFlush));
+}
+
+static void test_whitelists() {
+  for (size_t n : WHITELIST_SIZES)
+    benchWhitelist(n);
+  checkResults();
+}
+
+// The component's whitelist check, against the CSV search it replaced.
+static void test_component_whitelist() {
+  BlePersistentListsComponent lists;
+  lists.setup();
+  std::string csv;
+  size_t n = 0;
+  for (size_t target : {(size_t)10, (size_t)100, (size_t)10000}) {
+    for (; n < target; n++) {
+      std::string mac = BlePersistentListsComponent::format_mac(nthListed(n));
+      if (!lists.add_to_whitelist(mac))
+        break; // at the NVS budget
+      csv = mac + (csv.empty() ? "" : "," + csv);
+    }
+    std::vector<std::string> probes;
+    for (uint64_t p : whitelistProbes(n))
+      probes.push_back(BlePersistentListsComponent::format_mac(p));
+    double ns = nsPerOp(
+        100000,
+        [&](uint32_t i) { benchKeep(lists.is_in_whitelist(probes[i & 4095])); },
+        RUNS);
+    record("is_in_whitelist", n, ns, limitOf(hpWhitelist));
+    double csvNs = nsPerOp(n > 100 ? 2000 : 20000, [&](uint32_t i) {
+      benchKeep(legacyListContains(csv, probes[i & 4095]));
+    });
+    record("list_contains", n, csvNs, 0);
+  }
+  checkResults();
+}
+
+static void writeResults() {
+  const char *path = getenv("RADAR_BENCH_JSON");
+  if (path == nullptr)
+    path = "bench_hot_paths.json";
+  DynamicJsonDocument doc(64 * 1024);
+  doc["suite"] = "test_bench_hot_paths";
+  doc["hostSpeedup"] = HOST_SPEEDUP;
+  doc["tolerance"] = tolerance;
+  JsonArray out = doc.createNestedArray("results");
+  for (const BenchResult &r : results) {
+    JsonObject o = out.createNestedObject();
+    o["name"] = r.name.c_str();
+    o["size"] = r.size;
+    o["ns"] = r.ns;
+    o["calibrationNs"] = r.calibrationNs;
+    if (r.limitNs > 0)
+      o["limitNs"] = r.limitNs;
+    if (r.baselineNs > 0)
+      o["baselineNs"] = r.baselineNs;
+  }
+  String json;
+  serializeJson(doc, json);
+  FILE *f = fopen(path, "w");
+  if (f == nullptr) {
+    printf("cannot write %s\n", path);
+    return;
+  }
+  fwrite(json.c_str(), 1, json.length(), f);
+  fclose(f);
+  printf("results: %s\n", path);
+}
+
+static void loadBaseline() {
+  if (const char *t = getenv("RADAR_BENCH_TOLERANCE"))
+    tolerance = atof(t);
+  const char *path = getenv("RADAR_BENCH_BASELINE");
+  if (path == nullptr)
+    return;
+  FILE *f = fopen(path, "r");
+  std::string text;
+  char buf[4096];
+  size_t n;
+  while (f && (n = fread(buf, 1, sizeof(buf), f)) > 0)
+    text.append(buf, n);
+  if (f)
+    fclose(f);
+  if (!f || deserializeJson(baseline, text.c_str())) {
+    printf("baseline %s unreadable, ignored\n", path);
+    baseline.clear();
+  }
+}
+
+int main() {
+  bootRadar("test_bench_hot_paths");
+  runLoop(10);
+  loadBaseline();
+  UNITY_BEGIN();
+  RUN_TEST(test_50_devices);
+  RUN_TEST(test_500_devices);
+  RUN_TEST(test_5000_devices);
+  RUN_TEST(test_vendor_lookup);
+  RUN_TEST(test_whitelists);
+  RUN_TEST(test_component_whitelist);
+  writeResults();
+  return UNITY_END();
+}
@@ -0,0 +1,121 @@
+// Advert ingest, radio to device table: the firmware's onResult -> ring ->
+// applyBleEvent against the original onResult building Strings, in adverts
+// per second and heap bytes per advert. `pio test -e native_bench`
+#include "../alloc_counter.h"
+#include "../radar_harness.h"
+
+#include "../bench.h"
+#include "../legacy_radar.h"
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+static const uint32_t OPS = 100000;
+static const uint32_t DEVICES = 50; // the original list's cap
+
+static std::vector<NimBLEAdvertisedDevice> pool;
+static std::vector<uint32_t> order;
+
+// A typical crowd: a name on half the devices, manufacturer data, one or
+// two 16-bit services, TX power; four RSSI values per device.
+static void buildCrowd() {
+  BenchRng rng;
+  for (uint32_t d = 0; d < DEVICES; d++) {
+    uint64_t mac = ((uint64_t)(rng.next() % 3 == 0 ? 0xA4C138 : 0x001A7D)
+                    << 24) | (rng.next() & 0xFFFFFF);
+    std::vector<uint8_t> p = {0x02, 0x01, 0x06, 0x02, 0x0A, 0xF4};
+    if (d % 2 == 0) {
+      char name[16];
+      snprintf(name, sizeof(name), "Sensor-%04u", (unsigned)d);
+      std::vector<uint8_t> n = advertPayload(name);
+      p.insert(p.end(), n.begin() + 3, n.end());
+    }
+    uint8_t uuids = 1 + d % 2;
+    p.push_back(1 + 2 * uuids);
+    p.push_back(0x03);
+    for (uint8_t u = 0; u < uuids; u++) {
+      p.push_back(0x0F + u);
+      p.push_back(0x18);
+    }
+    p.push_back(13);
+    p.push_back(0xFF);
+    for (int b = 0; b < 12; b++)
+      p.push_back((uint8_t)rng.next());
+    for (int r = 0; r < 4; r++)
+      pool.emplace_back(NimBLEAddress(mac, BLE_ADDR_PUBLIC), -50 - 7 * r,
+                        p.data(), p.size(), true);
+  }
+  for (uint32_t i = 0; i < OPS; i++)
+    order.push_back(rng.next() % pool.size());
+}
+
+// loop()'s share of an advert, without the rest of the loop.
+static void drainRing() {
+  StateLock lock;
+  BleEvent ev;
+  while (bleEvents.pop(ev))
+    applyBleEvent(ev);
+}
+
+struct IngestResult {
+  double ns;
+  double bytesPerAdvert;
+  double allocsPerAdvert;
+};
+
+template <typename Fn> static IngestResult measure(Fn ingest) {
+  for (uint32_t i = 0; i < OPS; i++) // warm: every device known
+    ingest(i);
+  size_t allocs = heapAllocs.count.load(), bytes = heapAllocs.bytes.load();
+  for (uint32_t i = 0; i < OPS; i++)
+    ingest(i);
+  IngestResult r;
+  r.allocsPerAdvert = (double)(heapAllocs.count.load() - allocs) / OPS;
+  r.bytesPerAdvert = (double)(heapAllocs.bytes.load() - bytes) / OPS;
+  r.ns = nsPerOp(OPS, ingest);
+  return r;
+}
+
+static void report(const char *label, const IngestResult &r) {
+  printf("%-10s %9.0f adverts/s  %7.1f ns  %6.1f B/advert  %5.2f allocs\n",
+         label, 1e9 / r.ns, r.ns, r.bytesPerAdvert, r.allocsPerAdvert);
+}
+
+static IngestResult firmware, legacy;
+
+static void test_firmware_ingest() {
+  surveillanceActive = true;
+  pBLEScan->start(0, nullptr);
+  firmware = measure([](uint32_t i) {
+    pBLEScan->hear(pool[order[i]]);
+    if ((i & 31) == 31) // well under the 64-slot ring
+      drainRing();
+  });
+  drainRing();
+  report("firmware", firmware);
+  TEST_ASSERT_EQUAL(0, bleEvents.dropped);
+  TEST_ASSERT_TRUE(firmware.allocsPerAdvert == 0);
+}
+
+static void test_legacy_ingest() {
+  static LegacyRadar radar;
+  radar.vendorOf = getVendorFromPROGMEM;
+  legacy = measure([](uint32_t i) {
+    LegacyAdvert adv(pool[order[i]]);
+    radar.onResult(&adv);
+  });
+  report("original", legacy);
+  printf("speedup x%.1f\n", legacy.ns / firmware.ns);
+  TEST_ASSERT_TRUE(legacy.bytesPerAdvert > 100);
+  TEST_ASSERT_TRUE(legacy.ns / firmware.ns >= 2.0);
+}
+
+int main() {
+  bootRadar("test_bench_ingest");
+  buildCrowd();
+  UNITY_BEGIN();
+  RUN_TEST(test_firmware_ingest);
+  RUN_TEST(test_legacy_ingest);
+  return UNITY_END();
+}
@@ -0,0 +1,121 @@
+// OUI vendor search: the layout compiled in (Eytzinger in the native envs,
+// see platformio.ini) against a classic binary search over a sorted copy
+// of the same table, for random prefixes and for a radar's real mix.
+// `pio test -e native_bench`
+#include "../bench.h"
+#include "progmem_vendors.h"
+#include <algorithm>
+#include <string.h>
+#include <unity.h>
+#include <vector>
+
+void setUp() {}
+void tearDown() {}
+
+static const uint32_t OPS = 1000000;
+
+struct SortedEntry {
+  uint32_t prefix;
+  uint32_t slot; // position in the generated arrays
+};
+static std::vector<SortedEntry> sorted;
+
+static const char *binarySearchVendor(uint32_t prefix) {
+  int left = 0, right = (int)sorted.size() - 1;
+  while (left <= right) {
+    int mid = left + (right - left) / 2;
+    uint32_t p = sorted[mid].prefix;
+    if (p == prefix)
+      return ouiVendorAt(sorted[mid].slot);
+    if (p < prefix)
+      left = mid + 1;
+    else
+      right = mid - 1;
+  }
+  return nullptr;
+}
+
+static void buildSortedCopy() {
+  for (uint32_t i = 0; i < OUI_TABLE_SIZE; i++)
+    sorted.push_back({ouiPrefixAt(i), i});
+  std::sort(sorted.begin(), sorted.end(),
+            [](const SortedEntry &a, const SortedEntry &b) {
+              return a.prefix < b.prefix;
+            });
+}
+
+static void test_layouts_agree_on_every_prefix() {
+  for (const SortedEntry &e : sorted)
+    TEST_ASSERT_EQUAL_PTR(ouiVendorAt(e.slot), getVendorFromPROGMEM(e.prefix));
+  BenchRng rng;
+  for (int i = 0; i < 100000; i++) {
+    uint32_t p = rng.next() & 0xFFFFFF;
+    TEST_ASSERT_EQUAL_PTR(binarySearchVendor(p), getVendorFromPROGMEM(p));
+  }
+}
+
+static void compare(const char *label, const std::vector<uint32_t> &prefixes,
+                    double maxRatio) {
+  size_t mask = prefixes.size() - 1;
+  double layoutNs = nsPerOp(OPS, [&](uint32_t i) {
+    benchKeep(getVendorFromPROGMEM(prefixes[i & mask]));
+  });
+  double binaryNs = nsPerOp(OPS, [&](uint32_t i) {
+    benchKeep(binarySearchVendor(prefixes[i & mask]));
+  });
+  printf("%-22s layout %5.1f ns (%5.1f M/s)  binary %5.1f ns (%5.1f M/s)\n",
+         label, layoutNs, 1e3 / layoutNs, binaryNs, 1e3 / binaryNs);
+  TEST_ASSERT_TRUE(layoutNs <= binaryNs * maxRatio);
+}
+
+static void test_random_prefixes() {
+  std::vector<uint32_t> prefixes(1 << 16);
+  BenchRng rng;
+  for (auto &p : prefixes)
+    p = rng.next() & 0xFFFFFF; // mostly unassigned: full-depth misses
+  compare("random prefixes", prefixes, 1.25);
+}
+
+static void test_assigned_prefixes() {
+  std::vector<uint32_t> prefixes(1 << 16);
+  BenchRng rng;
+  for (auto &p : prefixes)
+    p = sorted[rng.next() % sorted.size()].prefix;
+  compare("assigned prefixes", prefixes, 1.25);
+}
+
+// What a radar hears: most public addresses from a few prefixes of a
+// handful of vendors, the rest private random addresses whose top bits are
+// noise.
+static void test_real_world_mix() {
+  static const char *const POPULAR[] = {"Apple", "Samsung", "Google",
+                                        "Espressif", "Xiaomi", "Huawei"};
+  std::vector<uint32_t> popular;
+  for (const SortedEntry &e : sorted)
+    for (const char *v : POPULAR)
+      if (strncmp(ouiVendorAt(e.slot), v, strlen(v)) == 0)
+        popular.push_back(e.prefix);
+  TEST_ASSERT_TRUE(popular.size() > 100);
+  std::vector<uint32_t> prefixes(1 << 16);
+  BenchRng rng;
+  for (auto &p : prefixes) {
+    uint32_t r = rng.next() % 10;
+    if (r < 4)
+      p = popular[rng.next() % 16]; // the hot dozen
+    else if (r < 6)
+      p = popular[rng.next() % popular.size()];
+    else
+      p = rng.next() & 0xFFFFFF;
+  }
+  compare("real-world mix", prefixes, 1.25);
+}
+
+int main() {
+  buildSortedCopy();
+  UNITY_BEGIN();
+  RUN_TEST(test_layouts_agree_on_every_prefix);
+  RUN_TEST(test_random_prefixes);
+  RUN_TEST(test_assigned_prefixes);
+  RUN_TEST(test_real_world_mix);
+  return UNITY_END();
+}
@@ -0,0 +1,104 @@
+// Vendor cache hit rate on a replayed trace: a crowd is recorded through
+// the fake radio, then replayed in virtual time, and /api/stats tells how
+// many new devices the cache answered without searching the OUI table.
+// `pio test -e native_bench`
+#include "../radar_harness.h"
+
+#include "../bench.h"
+#include <set>
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+static const uint32_t STEPS = 3000;
+static const uint32_t STEP_MS = 200;
+
+static uint32_t heard;
+static std::set<uint64_t> publicDevices, privateDevices; // heard at least once
+
+static std::vector<uint32_t> hotOuis() {
+  static const char *const POPULAR[] = {"Apple", "Samsung", "Google",
+                                        "Espressif", "Xiaomi", "Huawei"};
+  std::vector<uint32_t> ouis;
+  for (const char *v : POPULAR) {
+    int taken = 0;
+    for (size_t i = 0; i < OUI_TABLE_SIZE && taken < 2; i++)
+      if (strncmp(ouiVendorAt(i), v, strlen(v)) == 0) {
+        ouis.push_back(ouiPrefixAt(i));
+        taken++;
+      }
+  }
+  return ouis;
+}
+
+// A passing crowd, 10 minutes: a new device every ~3 adverts, 70% public
+// addresses from the hot dozen of OUIs, 30% private random addresses.
+static void recordCrowd() {
+  TEST_ASSERT_EQUAL(200, server.post("/api/trace/record").code);
+  std::vector<uint32_t> ouis = hotOuis();
+  TEST_ASSERT_EQUAL(12, ouis.size());
+  std::vector<std::pair<uint64_t, uint8_t>> recent;
+  BenchRng rng;
+  runLoop(10);
+  for (uint32_t s = 0; s < STEPS; s++) {
+    if (recent.empty() || rng.next() % 3 == 0) {
+      bool pub = rng.next() % 10 < 7;
+      uint64_t mac = pub ? ((uint64_t)ouis[rng.next() % ouis.size()] << 24) |
+                               (rng.next() & 0xFFFFFF)
+                         : (0x400000000000ULL |
+                            ((uint64_t)rng.next() << 16 | rng.next() >> 16)) &
+                               0x7FFFFFFFFFFFULL;
+      recent.push_back({mac, pub ? BLE_ADDR_PUBLIC : BLE_ADDR_RANDOM});
+      if (recent.size() > 40)
+        recent.erase(recent.begin());
+    }
+    auto &d = recent[rng.next() % recent.size()];
+    if (hearAdvert(d.first, -55 - (int)(rng.next() % 30), advertPayload(),
+                   d.second)) {
+      heard++;
+      (d.second == BLE_ADDR_PUBLIC ? publicDevices : privateDevices)
+          .insert(d.first);
+    }
+    runLoop(STEP_MS);
+  }
+  TEST_ASSERT_EQUAL(200, server.post("/api/trace/stop").code);
+}
+
+static void test_hit_rate_on_replayed_trace() {
+  recordCrowd();
+  DynamicJsonDocument before = jsonOf(server.get("/api/stats"));
+  uint32_t hits0 = before["vendorCache"]["hits"];
+  uint32_t misses0 = before["vendorCache"]["misses"];
+
+  TEST_ASSERT_EQUAL(200, server.post("/api/trace/replay", {{"speed", "0"}}).code);
+  for (int i = 0; i < 100000 && replayReport.running; i++)
+    loop();
+  DynamicJsonDocument trace = jsonOf(server.get("/api/trace"));
+  TEST_ASSERT_FALSE(trace["replay"]["running"].as<bool>());
+  // Adverts sent while the scan paused (duty cycle, GATT) were not heard
+  TEST_ASSERT_EQUAL(heard, trace["replay"]["adverts"].as<uint32_t>());
+
+  DynamicJsonDocument after = jsonOf(server.get("/api/stats"));
+  uint32_t hits = after["vendorCache"]["hits"].as<uint32_t>() - hits0;
+  uint32_t misses = after["vendorCache"]["misses"].as<uint32_t>() - misses0;
+  double rate = (double)hits / (hits + misses);
+  size_t devices = publicDevices.size() + privateDevices.size();
+  double publicShare = (double)publicDevices.size() / devices;
+  printf("replay: %u adverts, %u lookups, %u hits / %u misses, hit rate "
+         "%.1f%% (%.1f%% of the devices have a public address)\n",
+         (unsigned)heard, (unsigned)(hits + misses), (unsigned)hits,
+         (unsigned)misses, 100 * rate, 100 * publicShare);
+  // One lookup per device entering the table (some return after expiry)
+  TEST_ASSERT_TRUE(hits + misses >= devices);
+  // Private addresses always miss, and evict a hot OUI now and then; the
+  // hot OUIs should still hit most of the time.
+  TEST_ASSERT_TRUE(rate >= publicShare * 0.8);
+}
+
+int main() {
+  bootRadar("test_bench_vendor_cache");
+  UNITY_BEGIN();
+  RUN_TEST(test_hit_rate_on_replayed_trace);
+  return UNITY_END();
+}
@@ -0,0 +1,104 @@
+// Whitelist at 10, 1,000 and 10,000 entries: MacSet lookups against the
+// original linear equalsIgnoreCase scan, save/load, and /api/whitelist.
+// `pio test -e native_bench`
+#include "../radar_harness.h"
+
+#include "../bench.h"
+#include "../legacy_radar.h"
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+static uint64_t nthMac(size_t i) { return 0xC0FFEE000000ULL + i * 7919; }
+
+static void fill(size_t n) {
+  StateLock lock;
+  std::vector<uint64_t> macs;
+  wlMetaMap.clear();
+  for (size_t i = 0; i < n; i++) {
+    macs.push_back(nthMac(i));
+    WlMeta m;
+    m.name = "Tag";
+    m.vendor = "Apple, Inc.";
+    m.mfgData = "4C000215";
+    wlMetaMap[nthMac(i)] = m;
+  }
+  whitelist.assign(macs);
+}
+
+static double msOf(void (*fn)()) {
+  uint64_t t0 = benchNowNs();
+  fn();
+  return (benchNowNs() - t0) / 1e6;
+}
+
+static void run(size_t n, double maxLookupNs, double minSpeedup,
+                double maxResponseMs) {
+  fill(n);
+  // Half hits, half misses, as an advert stream of strangers and familiars
+  std::vector<uint64_t> probes(4096);
+  BenchRng rng;
+  for (auto &p : probes)
+    p = rng.next() % 2 ? nthMac(rng.next() % n)
+                       : 0xA4C138000000ULL | (rng.next() & 0xFFFFFF);
+  // The set itself: isWhitelisted() adds the HotPathTimer, two clock
+  // reads that cost more than the search on the host
+  double lookupNs = nsPerOp(200000, [&](uint32_t i) {
+    benchKeep(whitelist.contains(probes[i & 4095]));
+  });
+
+  LegacyRadar legacy;
+  char macStr[18];
+  for (size_t i = 0; i < n; i++) {
+    formatMac(nthMac(i), macStr);
+    legacy.whitelist.push_back(String(macStr).c_str());
+  }
+  std::vector<String> probeStrs;
+  for (uint64_t p : probes) {
+    formatMac(p, macStr);
+    probeStrs.push_back(macStr);
+  }
+  uint32_t legacyOps = n >= 10000 ? 2000 : 20000;
+  double legacyNs = nsPerOp(legacyOps, [&](uint32_t i) {
+    benchKeep(legacy.isWhitelisted(probeStrs[i & 4095]));
+  });
+
+  double saveMs = msOf([] {
+    saveWhitelist();
+    saveWlMeta();
+  });
+  double loadMs = msOf([] {
+    loadWhitelist();
+    loadWlMeta();
+  });
+  NativeHttpResponse r;
+  double responseMs = 1e30;
+  for (int i = 0; i < 3; i++) {
+    uint64_t t0 = benchNowNs();
+    r = server.get("/api/whitelist");
+    responseMs = std::min(responseMs, (benchNowNs() - t0) / 1e6);
+  }
+  printf("%5zu entries (%6zu B): lookup %6.1f ns (original %9.1f ns, "
+         "x%.0f)  save %6.2f ms  load %6.2f ms  /api/whitelist %7.2f ms, %zu B in "
+         "%u chunks\n",
+         n, n * MacSet::BYTES_PER_ENTRY, lookupNs, legacyNs, legacyNs / lookupNs, saveMs, loadMs,
+         responseMs, r.body.size(), (unsigned)r.chunks);
+  TEST_ASSERT_EQUAL(n, whitelist.size());
+  TEST_ASSERT_TRUE(lookupNs <= maxLookupNs);
+  TEST_ASSERT_TRUE(legacyNs / lookupNs >= minSpeedup);
+  TEST_ASSERT_TRUE(responseMs <= maxResponseMs);
+}
+
+static void test_10_entries() { run(10, 30, 5, 5); }
+static void test_1000_entries() { run(1000, 100, 100, 50); }
+static void test_10000_entries() { run(10000, 150, 1000, 500); }
+
+int main() {
+  bootRadar("test_bench_whitelist");
+  UNITY_BEGIN();
+  RUN_TEST(test_10_entries);
+  RUN_TEST(test_1000_entries);
+  RUN_TEST(test_10000_entries);
+  return UNITY_END();
+}
@@ -0,0 +1,147 @@
+// The crowd generator (src/crowd_sim.h, built with -DRADAR_CROWD_SIM) in
+// the firmware: it stands in for the radio, so its adverts go through
+// onResult() and the 64-slot bleEvents ring with the scan off, and a burst
+// loop() did not drain in time is dropped as the radio's would be. Alerts
+// raised by the crowd stay bounded by the device table. `pio test -e native`
+#define RADAR_CROWD_SIM
+#include "../radar_harness.h"
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+// POST /api/sim/crowd; fields as in the README.
+static int startCrowd(
+    const std::vector<std::pair<std::string, std::string>> &form) {
+  return server.post("/api/sim/crowd", form).code;
+}
+
+// loop() until the run's report closes, or maxMs of fake time.
+static bool runUntilDone(uint32_t maxMs) {
+  for (uint32_t t = 0; t < maxMs && replayReport.running; t += 100)
+    runLoop(100);
+  return !replayReport.running;
+}
+
+static void test_crowd_takes_the_radio_path() {
+  server.post("/api/surveillance/toggle");
+  TEST_ASSERT_TRUE(surveillanceActive);
+  runLoop(10);
+  TEST_ASSERT_TRUE(pBLEScan->isScanning());
+  uint32_t onResults = hpOnResult.count;
+  uint32_t dropped = bleEvents.dropped;
+  // ~50 visitors at a time, 200 over two minutes: the 64-device table fills
+  // with those gone and evicts them
+  TEST_ASSERT_EQUAL(200, startCrowd({{"rate", "100"},
+                                     {"stay", "30"},
+                                     {"advMs", "100"},
+                                     {"beacons", "4"},
+                                     {"duration", "120"},
+                                     {"seed", "7"}}));
+  runLoop(1000);
+  // The crowd has the radio: no scan, nothing heard from the air
+  TEST_ASSERT_FALSE(pBLEScan->isScanning());
+  TEST_ASSERT_FALSE(hearAdvert(0x5CA1AB1E0001ULL, -50));
+  TEST_ASSERT_TRUE(runUntilDone(130000));
+
+  DynamicJsonDocument trace = jsonOf(server.get("/api/trace"));
+  uint32_t adverts = trace["replay"]["adverts"];
+  uint32_t generated = trace["crowd"]["adverts"];
+  printf("crowd: %u adverts generated, %u applied, %u arrivals, %u "
+         "evictions, %u alerts, %u alerted\n",
+         (unsigned)generated, (unsigned)adverts,
+         trace["crowd"]["arrivals"].as<unsigned>(),
+         trace["replay"]["evictions"].as<unsigned>(),
+         trace["replay"]["alerts"].as<unsigned>(),
+         trace["replay"]["alertedMacs"].as<unsigned>());
+  TEST_ASSERT_EQUAL_STRING("crowd", trace["replay"]["source"] | "");
+  TEST_ASSERT_TRUE(generated > 10000);
+  // Every advert went through onResult() and the ring, none dropped at
+  // one loop() pass a millisecond
+  TEST_ASSERT_EQUAL(generated, hpOnResult.count - onResults);
+  TEST_ASSERT_EQUAL(dropped, bleEvents.dropped);
+  TEST_ASSERT_EQUAL(generated, adverts);
+  TEST_ASSERT_TRUE(trace["replay"]["evictions"].as<uint32_t>() > 0);
+  TEST_ASSERT_TRUE(trace["replay"]["alerts"].as<uint32_t>() > MAX_DEVICES);
+
+  // Alerts outlive neither eviction nor retention: every alerted MAC still
+  // has its record
+  std::vector<uint64_t> alerted;
+  size_t orphans = 0;
+  {
+    StateLock lock;
+    alerted.assign(alertedMacs.items().begin(), alertedMacs.items().end());
+    for (uint64_t m : alerted)
+      orphans += detectedDevices.find(m) == nullptr;
+  }
+  TEST_ASSERT_TRUE(alerted.size() > 0);
+  TEST_ASSERT_TRUE(alerted.size() <= MAX_DEVICES);
+  TEST_ASSERT_EQUAL(0, orphans);
+  DynamicJsonDocument list = jsonOf(server.get("/api/alerts"));
+  TEST_ASSERT_EQUAL(alerted.size(), list.as<JsonArray>().size());
+
+  // The radio is back
+  runLoop(10);
+  TEST_ASSERT_TRUE(pBLEScan->isScanning());
+  server.post("/api/surveillance/toggle");
+  TEST_ASSERT_EQUAL(0, jsonOf(server.get("/api/alerts")).as<JsonArray>().size());
+}
+
+// loop() stalls for 200 ms while 100 beacons send 1,000 adverts a second:
+// the ring keeps 64, the rest is dropped and counted, nothing is lost
+// without a trace.
+static void test_stalled_loop_drops_at_the_ring() {
+  TEST_ASSERT_EQUAL(200, startCrowd({{"rate", "0"},
+                                     {"beacons", "100"},
+                                     {"duration", "10"}}));
+  runLoop(1000);
+  uint32_t dropped = bleEvents.dropped;
+  uint32_t generated = crowdSim.adverts;
+  nativeClock.advance(200);
+  loop();
+  uint32_t burst = crowdSim.adverts - generated;
+  TEST_ASSERT_TRUE(burst >= 150);
+  TEST_ASSERT_EQUAL(burst - 64, bleEvents.dropped - dropped);
+  TEST_ASSERT_TRUE(runUntilDone(20000));
+  DynamicJsonDocument trace = jsonOf(server.get("/api/trace"));
+  TEST_ASSERT_EQUAL(trace["crowd"]["adverts"].as<uint32_t>(),
+                    trace["replay"]["adverts"].as<uint32_t>() +
+                        bleEvents.dropped - dropped);
+}
+
+// An hour of crowd in virtual time: through the ring one advert at a time,
+// nothing dropped, the same run for the same seed.
+static void test_virtual_crowd_is_reproducible() {
+  std::string timelines[2];
+  for (std::string &timeline : timelines) {
+    uint32_t dropped = bleEvents.dropped;
+    TEST_ASSERT_EQUAL(200, startCrowd({{"rate", "30"},
+                                       {"stay", "300"},
+                                       {"beacons", "2"},
+                                       {"duration", "3600"},
+                                       {"speed", "0"},
+                                       {"seed", "11"}}));
+    for (int i = 0; i < 100000 && replayReport.running; i++)
+      loop();
+    DynamicJsonDocument trace = jsonOf(server.get("/api/trace"));
+    TEST_ASSERT_FALSE(trace["replay"]["running"].as<bool>());
+    TEST_ASSERT_TRUE(trace["replay"]["simulatedMs"].as<uint32_t>() >=
+                     3600000);
+    TEST_ASSERT_EQUAL(trace["crowd"]["adverts"].as<uint32_t>(),
+                      trace["replay"]["adverts"].as<uint32_t>());
+    TEST_ASSERT_EQUAL(dropped, bleEvents.dropped);
+    TEST_ASSERT_TRUE(trace["replay"]["arrivals"].as<uint32_t>() > 50);
+    serializeJson(trace["replay"]["timeline"], timeline);
+  }
+  TEST_ASSERT_EQUAL_STRING(timelines[0].c_str(), timelines[1].c_str());
+}
+
+int main() {
+  bootRadar("test_crowd_sim");
+  runLoop(10);
+  UNITY_BEGIN();
+  RUN_TEST(test_crowd_takes_the_radio_path);
+  RUN_TEST(test_stalled_loop_drops_at_the_ring);
+  RUN_TEST(test_virtual_crowd_is_reproducible);
+  return UNITY_END();
+}
@@ -0,0 +1,187 @@
+// DeviceTable (src/device_table.h): index, LRU order, handles, and a
+// randomized check against std::unordered_map. `pio test -e native`
+#include "../alloc_counter.h"
+#include "device_table.h"
+#include <unity.h>
+#include <unordered_map>
+#include <vector>
+
+struct Rec {
+  uint32_t value = 0;
+};
+
+typedef DeviceTable<Rec, 8> SmallTable;
+
+static Rec smallRecords[8];
+static SmallTable table;
+
+void setUp() {
+  table.clear();
+  table.begin(smallRecords);
+}
+void tearDown() {}
+
+static std::vector<uint64_t> lruOrder(SmallTable &t) {
+  std::vector<uint64_t> macs;
+  t.forEach([&](uint64_t mac, Rec &) { macs.push_back(mac); });
+  return macs;
+}
+
+static void test_insert_find_remove() {
+  bool inserted;
+  table.upsert(0x111111111111ULL, inserted)->value = 1;
+  TEST_ASSERT_TRUE(inserted);
+  table.upsert(0x222222222222ULL, inserted)->value = 2;
+  TEST_ASSERT_EQUAL(2, table.size());
+  TEST_ASSERT_EQUAL(1, table.upsert(0x111111111111ULL, inserted)->value);
+  TEST_ASSERT_FALSE(inserted);
+  TEST_ASSERT_EQUAL(2, table.find(0x222222222222ULL)->value);
+  TEST_ASSERT_NULL(table.find(0x333333333333ULL));
+  TEST_ASSERT_TRUE(table.remove(0x111111111111ULL));
+  TEST_ASSERT_FALSE(table.remove(0x111111111111ULL));
+  TEST_ASSERT_NULL(table.find(0x111111111111ULL));
+  TEST_ASSERT_EQUAL(1, table.size());
+}
+
+static void test_new_record_is_reset() {
+  bool inserted;
+  table.upsert(1, inserted)->value = 42;
+  table.remove(1);
+  TEST_ASSERT_EQUAL(0, table.upsert(2, inserted)->value);
+}
+
+static void test_full_table_evicts_least_recently_seen() {
+  bool inserted;
+  for (uint64_t mac = 1; mac <= 8; mac++)
+    table.upsert(mac, inserted);
+  TEST_ASSERT_TRUE(table.full());
+  table.upsert(1, inserted); // 2 is now the oldest
+  uint64_t oldest = 0;
+  TEST_ASSERT_NOT_NULL(table.oldest(oldest));
+  TEST_ASSERT_EQUAL_UINT64(2, oldest);
+  table.upsert(9, inserted);
+  TEST_ASSERT_TRUE(inserted);
+  TEST_ASSERT_EQUAL(8, table.size());
+  TEST_ASSERT_NULL(table.find(2));
+  std::vector<uint64_t> expect = {3, 4, 5, 6, 7, 8, 1, 9};
+  TEST_ASSERT_TRUE(lruOrder(table) == expect);
+}
+
+static void test_handle_dies_with_its_device() {
+  bool inserted;
+  table.upsert(0xAA, inserted)->value = 7;
+  DeviceHandle h = table.handleOf(0xAA);
+  uint64_t mac = 0;
+  TEST_ASSERT_EQUAL(7, table.get(h, &mac)->value);
+  TEST_ASSERT_EQUAL_UINT64(0xAA, mac);
+  table.remove(0xAA);
+  TEST_ASSERT_NULL(table.get(h));
+  table.upsert(0xBB, inserted); // reuses the freed slot
+  TEST_ASSERT_EQUAL(h.slot, table.handleOf(0xBB).slot);
+  TEST_ASSERT_NULL(table.get(h));
+  TEST_ASSERT_EQUAL(0, table.handleOf(0xCC).gen);
+  TEST_ASSERT_NULL(table.get(DeviceHandle{0, 0}));
+}
+
+static void test_handle_invalid_after_clear() {
+  bool inserted;
+  table.upsert(0xAA, inserted);
+  DeviceHandle h = table.handleOf(0xAA);
+  table.clear();
+  table.upsert(0xAA, inserted);
+  TEST_ASSERT_NULL(table.get(h));
+}
+
+static void test_evict_oldest_while_stops_at_first_fresh() {
+  bool inserted;
+  for (uint64_t mac = 1; mac <= 6; mac++)
+    table.upsert(mac, inserted)->value = mac <= 3 ? 100 : 200;
+  table.upsert(5, inserted); // order 1 2 3 4 6 5
+  size_t removed = table.evictOldestWhile(
+      [](uint64_t, const Rec &r) { return r.value < 150; });
+  TEST_ASSERT_EQUAL(3, removed);
+  std::vector<uint64_t> expect = {4, 6, 5};
+  TEST_ASSERT_TRUE(lruOrder(table) == expect);
+}
+
+static void test_at_slot_walks_live_records() {
+  bool inserted;
+  table.upsert(10, inserted);
+  table.upsert(20, inserted);
+  table.upsert(30, inserted);
+  table.remove(20);
+  size_t seen = 0;
+  for (uint16_t s = 0; s < SmallTable::capacity(); s++) {
+    uint64_t mac;
+    if (table.atSlot(s, mac)) {
+      TEST_ASSERT_TRUE(mac == 10 || mac == 30);
+      seen++;
+    }
+  }
+  TEST_ASSERT_EQUAL(2, seen);
+  uint64_t mac;
+  TEST_ASSERT_NULL(table.atSlot(SmallTable::capacity(), mac));
+}
+
+// Random upserts/removes over a small key space, so probe chains collide
+// and backward-shift deletion runs often; the model tracks LRU by stamp.
+static void test_matches_a_reference_map() {
+  static Rec records[64];
+  static DeviceTable<Rec, 64> big;
+  big.begin(records);
+  std::unordered_map<uint64_t, uint64_t> model; // mac -> last use
+  uint32_t rng = 12345;
+  uint64_t tick = 0;
+  for (int i = 0; i < 200000; i++) {
+    rng = rng * 1103515245u + 12345u;
+    // Share the OUI half like real crowds do.
+    uint64_t mac = 0xA4C138000000ULL | ((rng >> 8) % 160);
+    bool inserted;
+    if ((rng >> 28) < 3) {
+      TEST_ASSERT_EQUAL(model.erase(mac) == 1, big.remove(mac));
+    } else {
+      if (model.size() == 64 && !model.count(mac)) {
+        auto oldest = model.begin();
+        for (auto it = model.begin(); it != model.end(); ++it)
+          if (it->second < oldest->second)
+            oldest = it;
+        model.erase(oldest);
+      }
+      bool had = model.count(mac);
+      model[mac] = ++tick;
+      big.upsert(mac, inserted)->value = (uint32_t)mac;
+      TEST_ASSERT_EQUAL(!had, inserted);
+    }
+    TEST_ASSERT_EQUAL(model.size(), big.size());
+  }
+  for (auto &kv : model)
+    TEST_ASSERT_EQUAL((uint32_t)kv.first, big.find(kv.first)->value);
+  uint64_t prevTick = 0;
+  big.forEach([&](uint64_t mac, Rec &) {
+    TEST_ASSERT_TRUE(model[mac] > prevTick);
+    prevTick = model[mac];
+  });
+}
+
+static void test_upsert_never_allocates() {
+  bool inserted;
+  size_t before = heapAllocs.count.load();
+  for (uint64_t mac = 0; mac < 10000; mac++)
+    table.upsert(mac * 7919, inserted);
+  table.evictOldestWhile([](uint64_t, const Rec &) { return true; });
+  TEST_ASSERT_EQUAL(before, heapAllocs.count.load());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_insert_find_remove);
+  RUN_TEST(test_new_record_is_reset);
+  RUN_TEST(test_full_table_evicts_least_recently_seen);
+  RUN_TEST(test_handle_dies_with_its_device);
+  RUN_TEST(test_handle_invalid_after_clear);
+  RUN_TEST(test_evict_oldest_while_stops_at_first_fresh);
+  RUN_TEST(test_at_slot_walks_live_records);
+  RUN_TEST(test_matches_a_reference_map);
+  RUN_TEST(test_upsert_never_allocates);
+  return UNITY_END();
+}
@@ -0,0 +1,187 @@
+// /api/devices streamed in chunks: byte for byte what ArduinoJson
+// serializes for the same devices, at every chunk size the TCP stack may
+// ask for, full and delta, empty to past the table's capacity.
+// `pio test -e native`
+#include "../radar_harness.h"
+#include <unity.h>
+
+static const size_t CHUNK_SIZES[] = {1, 2, 7, 64, 100, 831, 832, 833, 1436,
+                                     4096};
+
+void setUp() {}
+void tearDown() {}
+
+static uint64_t nthMac(size_t i) { return 0xD0A1B2000000ULL + i * 65537; }
+
+// Names with every escaped character, services, TX power, appearance and
+// manufacturer data on some devices, bare flags on others.
+static std::vector<uint8_t> payloadFor(size_t i) {
+  static const char *NAMES[] = {"Pixel 7", "Tag \"front\"", "C:\\dev\\ble",
+                                "tab\there", "line\nfeed", "\b\f\r", ""};
+  std::vector<uint8_t> p = advertPayload(
+      i % 8 == 7 ? nullptr : NAMES[i % (sizeof(NAMES) / sizeof(*NAMES))]);
+  if (i % 3 == 0)
+    p.insert(p.end(), {0x05, 0x03, 0x0F, 0x18, 0x0A, 0x18}); // 180F, 180A
+  if (i % 4 == 1)
+    p.insert(p.end(), {0x02, 0x0A, (uint8_t)(int8_t)(-4 - (int)(i % 20))});
+  if (i % 5 == 2)
+    p.insert(p.end(), {0x03, 0x19, 0x40, 0x02});
+  if (i % 2 == 0)
+    p.insert(p.end(), {0x07, 0xFF, 0x4C, 0x00, 0x10, 0x05, (uint8_t)i,
+                       (uint8_t)(i >> 8)});
+  return p;
+}
+
+static size_t heard = 0;
+
+// Up to n devices in the table, each heard three times: a steady RSSI on
+// odd ones (whole level, no variance), a moving one on even ones.
+static void hearDevices(size_t n) {
+  while (heard < n) {
+    runLoop(5);
+    bool any = false;
+    int step = heard % 2 ? 0 : 3;
+    for (int k = 0; k < 3; k++)
+      any |= hearAdvert(nthMac(heard), -50 - (int)(heard % 40) - step * k,
+                        payloadFor(heard),
+                        heard % 6 == 5 ? BLE_ADDR_RANDOM : BLE_ADDR_PUBLIC);
+    if (any)
+      heard++;
+  }
+  runLoop(5);
+}
+
+// The former handler's document, with the members added since in the
+// same order; fixed-point members as the doubles they stand for.
+static String referenceJson(const char *since = nullptr) {
+  StateLock lock;
+  DynamicJsonDocument doc(64 * 1024);
+  JsonObject root = doc.to<JsonObject>();
+  root["version"] = FIRMWARE_VERSION;
+  root["seq"] = deviceChanges.current();
+  uint32_t from = since ? strtoul(since, nullptr, 10) : 0;
+  bool delta = since && deviceChanges.covers(from);
+  root["full"] = !delta;
+  if (delta) {
+    JsonArray removed = root.createNestedArray("removed");
+    for (uint16_t s = 0; s < deviceChanges.capacity(); s++) {
+      uint64_t mac;
+      char macStr[18];
+      if (deviceChanges.removedAt(s, from, mac)) {
+        formatMac(mac, macStr);
+        removed.add(macStr);
+      }
+    }
+  } else {
+    from = 0;
+  }
+  JsonArray devices = root.createNestedArray("devices");
+  for (uint16_t s = 0; s < detectedDevices.capacity(); s++) {
+    uint64_t mac;
+    const BleDeviceData *dev = detectedDevices.atSlot(s, mac);
+    if (!dev || !dev->listed || dev->changeSeq <= from)
+      continue;
+    char macStr[18];
+    char services[BLE_SERVICES_STR_MAX];
+    char mfgHex[2 * BLE_MFG_MAX + 1];
+    formatMac(mac, macStr);
+    formatServices(*dev, services);
+    formatMfgHex(*dev, mfgHex);
+    JsonObject obj = devices.createNestedObject();
+    obj["mac"] = macStr;
+    obj["name"] = String(deviceDisplayName(*dev));
+    obj["rssi"] = dev->rssi;
+    obj["rssiSmooth"] = dev->rssiFilter.levelTenths() / 10.0;
+    obj["rssiVar"] = dev->rssiFilter.varianceTenths() / 10.0;
+    if (dev->hasTxPower) {
+      float d = rssiDistanceM(dev->rssiFilter.levelTenths() / 10.0f,
+                              dev->txPower);
+      obj["distanceM"] = lroundf(10 * (d < 999.9f ? d : 999.9f)) / 10.0;
+    } else {
+      obj["distanceM"] = nullptr;
+    }
+    obj["vendor"] = dev->vendor ? dev->vendor : "N/A";
+    obj["addressType"] = addrTypeLabel(dev->addressType);
+    obj["txPower"] = dev->hasTxPower ? dev->txPower : BLE_TX_POWER_UNKNOWN;
+    obj["services"] = services;
+    obj["mfgData"] = mfgHex;
+    obj["appearance"] = dev->appearance;
+    obj["gattName"] = String(dev->gattName);
+    obj["battery"] = dev->batteryLevel;
+    obj["whitelisted"] = isWhitelisted(mac);
+    obj["presence"] = presenceLabel(dev->presence.state);
+  }
+  String out;
+  serializeJson(doc, out);
+  return out;
+}
+
+static void checkAllChunkSizes(const char *since = nullptr) {
+  std::string url = "/api/devices";
+  if (since)
+    url += std::string("?since=") + since;
+  String expected = referenceJson(since);
+  for (size_t chunk : CHUNK_SIZES) {
+    server.chunkSize = chunk;
+    NativeHttpResponse r = server.get(url);
+    TEST_ASSERT_EQUAL(200, r.code);
+    TEST_ASSERT_EQUAL(expected.length(), r.body.size());
+    TEST_ASSERT_TRUE(r.body == expected.c_str());
+    TEST_ASSERT_EQUAL((expected.length() + chunk - 1) / chunk, r.chunks);
+  }
+  server.chunkSize = 1436;
+}
+
+static void test_empty_table() {
+  checkAllChunkSizes();
+  TEST_ASSERT_TRUE(referenceJson().indexOf("\"devices\":[]") > 0);
+}
+
+static void test_one_device() {
+  hearDevices(1);
+  checkAllChunkSizes();
+}
+
+static void test_escapes_and_optional_fields() {
+  server.post("/api/whitelist/add", {{"mac", "D0:A1:B2:01:00:01"}});
+  hearDevices(24);
+  checkAllChunkSizes();
+  String expected = referenceJson();
+  // The fixture covers what it claims to
+  TEST_ASSERT_TRUE(expected.indexOf("\\\"front\\\"") > 0);
+  TEST_ASSERT_TRUE(expected.indexOf("C:\\\\dev") > 0);
+  TEST_ASSERT_TRUE(expected.indexOf("\\t") > 0);
+  TEST_ASSERT_TRUE(expected.indexOf("\\b\\f\\r") > 0);
+  TEST_ASSERT_TRUE(expected.indexOf("\"distanceM\":null") > 0);
+  TEST_ASSERT_TRUE(expected.indexOf("\"whitelisted\":true") > 0);
+  TEST_ASSERT_TRUE(expected.indexOf("\"rssiVar\":0,") > 0);
+  TEST_ASSERT_TRUE(expected.indexOf(".5,\"rssiVar\"") > 0 ||
+                   expected.indexOf(".3,\"rssiVar\"") > 0 ||
+                   expected.indexOf(".7,\"rssiVar\"") > 0);
+}
+
+static void test_full_table_and_delta_with_removals() {
+  hearDevices(MAX_DEVICES);
+  checkAllChunkSizes();
+  char since[12];
+  {
+    StateLock lock;
+    snprintf(since, sizeof(since), "%lu",
+             (unsigned long)deviceChanges.current());
+  }
+  hearDevices(MAX_DEVICES + 20); // evicts the 20 oldest
+  checkAllChunkSizes(since);
+  TEST_ASSERT_TRUE(referenceJson(since).indexOf("\"removed\":[\"") > 0);
+  checkAllChunkSizes("0"); // not covered: full list
+  checkAllChunkSizes();
+}
+
+int main() {
+  bootRadar("test_devices_api");
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_table);
+  RUN_TEST(test_one_device);
+  RUN_TEST(test_escapes_and_optional_fields);
+  RUN_TEST(test_full_table_and_delta_with_removals);
+  return UNITY_END();
+}
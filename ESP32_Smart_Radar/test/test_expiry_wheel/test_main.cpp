@@ -0,0 +1,217 @@
+// ExpiryWheel (src/expiry_wheel.h): never early, at most one tick late,
+// cancel and re-schedule, deadlines past the horizon, callbacks that
+// re-arm, the millis() wrap, clear(), and a randomized check against a
+// sorted reference. `pio test -e native`
+#include "expiry_wheel.h"
+#include <map>
+#include <unity.h>
+#include <vector>
+
+static const uint32_t TICK = 250;
+typedef ExpiryWheel<64, 16> Wheel; // 4 s horizon
+
+void setUp() {}
+void tearDown() {}
+
+struct Fired {
+  uint16_t id;
+  uint16_t tag;
+  uint32_t at;
+};
+
+// Advances in steps of `step` ms up to `until`, recording what fires.
+static std::vector<Fired> run(Wheel &w, uint32_t &now, uint32_t until,
+                              uint32_t step = 10) {
+  std::vector<Fired> fired;
+  while ((int32_t)(until - now) > 0) {
+    now += step;
+    w.advance(now, [&](uint16_t id, uint16_t tag) {
+      fired.push_back({id, tag, now});
+    });
+  }
+  return fired;
+}
+
+static void test_fires_within_one_tick_never_early() {
+  Wheel w(TICK);
+  uint32_t now = 1000;
+  w.begin(now);
+  const uint32_t dues[] = {1000, 1001, 1249, 1250, 1251, 1700, 2999, 3000};
+  for (uint16_t i = 0; i < 8; i++)
+    w.schedule(i, 100 + i, dues[i]);
+  TEST_ASSERT_EQUAL(8, w.size());
+  std::vector<Fired> fired = run(w, now, 5000, 1);
+  TEST_ASSERT_EQUAL(8, fired.size());
+  for (const Fired &f : fired) {
+    uint32_t due = dues[f.id];
+    TEST_ASSERT_EQUAL(100 + f.id, f.tag);
+    TEST_ASSERT_TRUE(f.at >= due);
+    TEST_ASSERT_TRUE(f.at - due <= TICK);
+  }
+  TEST_ASSERT_EQUAL(0, w.size());
+}
+
+static void test_cancel_and_reschedule() {
+  Wheel w(TICK);
+  uint32_t now = 0;
+  w.begin(now);
+  w.schedule(1, 0, 500);
+  w.schedule(2, 0, 500);
+  w.schedule(3, 0, 500);
+  w.cancel(2);
+  w.cancel(2); // twice is harmless
+  w.schedule(3, 7, 2000); // moved later, new tag
+  TEST_ASSERT_FALSE(w.scheduled(2));
+  TEST_ASSERT_EQUAL(2, w.size());
+  std::vector<Fired> fired = run(w, now, 1000);
+  TEST_ASSERT_EQUAL(1, fired.size());
+  TEST_ASSERT_EQUAL(1, fired[0].id);
+  fired = run(w, now, 3000);
+  TEST_ASSERT_EQUAL(1, fired.size());
+  TEST_ASSERT_EQUAL(3, fired[0].id);
+  TEST_ASSERT_EQUAL(7, fired[0].tag);
+}
+
+static void test_deadline_past_the_horizon() {
+  Wheel w(TICK);
+  uint32_t now = 0;
+  w.begin(now);
+  w.schedule(5, 0, 120000); // 30 horizons away
+  std::vector<Fired> fired = run(w, now, 119990, 50);
+  TEST_ASSERT_EQUAL(0, fired.size());
+  TEST_ASSERT_TRUE(w.scheduled(5));
+  fired = run(w, now, 120000 + TICK, 50);
+  TEST_ASSERT_EQUAL(1, fired.size());
+  TEST_ASSERT_TRUE(fired[0].at >= 120000 && fired[0].at <= 120000 + TICK);
+}
+
+static void test_callback_rearms_and_cancels() {
+  Wheel w(TICK);
+  uint32_t now = 0;
+  w.begin(now);
+  w.schedule(1, 0, 100);
+  w.schedule(0, 0, 100); // a bucket runs newest first
+  int firstFires = 0, secondFires = 0;
+  // id 0 re-arms itself with an overdue deadline and cancels id 1, filed
+  // in the same bucket: it lands in the next bucket, id 1 never fires
+  auto fn = [&](uint16_t id, uint16_t) {
+    if (id == 0 && firstFires++ == 0) {
+      w.schedule(0, 0, now - 1000);
+      w.cancel(1);
+    } else if (id == 1) {
+      secondFires++;
+    }
+  };
+  now = TICK;
+  TEST_ASSERT_EQUAL(1, w.advance(now, fn));
+  TEST_ASSERT_EQUAL(0, secondFires);
+  TEST_ASSERT_TRUE(w.scheduled(0));
+  now = 2 * TICK;
+  TEST_ASSERT_EQUAL(1, w.advance(now, fn));
+  TEST_ASSERT_EQUAL(2, firstFires);
+  TEST_ASSERT_EQUAL(0, w.size());
+}
+
+static void test_across_the_millis_wrap() {
+  Wheel w(TICK);
+  uint32_t now = 0xFFFFFFFFu - 1000;
+  w.begin(now);
+  w.schedule(0, 0, now + 500);
+  w.schedule(1, 0, now + 1500); // after the wrap
+  w.schedule(2, 0, now + 9000); // past the horizon, after the wrap
+  std::vector<Fired> fired = run(w, now, now + 10000);
+  TEST_ASSERT_EQUAL(3, fired.size());
+  uint32_t start = 0xFFFFFFFFu - 1000;
+  const uint32_t offsets[] = {500, 1500, 9000};
+  for (const Fired &f : fired) {
+    uint32_t late = f.at - (start + offsets[f.id]);
+    TEST_ASSERT_TRUE(late <= TICK);
+  }
+}
+
+// clear() forgets everything and restarts the ticks at its `now`: the same
+// offsets fire at the same offsets, whatever the phase before.
+static void test_clear_realigns() {
+  Wheel w(TICK);
+  uint32_t now = 0;
+  w.begin(now);
+  w.schedule(1, 0, 300);
+  w.schedule(2, 0, 9000);
+  run(w, now, 100 + TICK);
+  std::vector<uint32_t> lateness;
+  for (uint32_t offset : {0u, 70u, 180u}) {
+    now += offset;
+    w.clear(now);
+    TEST_ASSERT_EQUAL(0, w.size());
+    TEST_ASSERT_FALSE(w.scheduled(2));
+    uint32_t start = now;
+    w.schedule(3, 0, start + 600);
+    std::vector<Fired> fired = run(w, now, start + 2000, 1);
+    TEST_ASSERT_EQUAL(1, fired.size());
+    TEST_ASSERT_EQUAL(3, fired[0].id);
+    lateness.push_back(fired[0].at - start);
+  }
+  TEST_ASSERT_EQUAL(lateness[0], lateness[1]);
+  TEST_ASSERT_EQUAL(lateness[0], lateness[2]);
+}
+
+// Random schedules and cancels, irregular advance steps: every deadline
+// fires once, in [due, due + tick + step], and only if not cancelled.
+static void test_randomized_against_reference() {
+  Wheel w(TICK);
+  uint32_t seed = 99;
+  auto rnd = [&](uint32_t n) {
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 8) % n;
+  };
+  uint32_t now = 0xFFFF0000u;
+  w.begin(now);
+  std::map<uint16_t, uint32_t> pending; // id -> due
+  size_t firedTotal = 0;
+  for (int op = 0; op < 200000; op++) {
+    uint16_t id = rnd(64);
+    switch (rnd(4)) {
+    case 0:
+    case 1: {
+      uint32_t due = now + rnd(rnd(8) ? 5000 : 30000);
+      w.schedule(id, (uint16_t)op, due);
+      pending[id] = due;
+      break;
+    }
+    case 2:
+      w.cancel(id);
+      pending.erase(id);
+      break;
+    default: {
+      uint32_t step = 1 + rnd(300);
+      now += step;
+      bool ok = true;
+      w.advance(now, [&](uint16_t fid, uint16_t) {
+        auto it = pending.find(fid);
+        ok &= it != pending.end() && (int32_t)(now - it->second) >= 0 &&
+              now - it->second <= TICK + step;
+        pending.erase(fid);
+        firedTotal++;
+      });
+      TEST_ASSERT_TRUE(ok);
+      for (auto &p : pending)
+        TEST_ASSERT_TRUE((int32_t)(now - p.second) < (int32_t)TICK);
+      break;
+    }
+    }
+    TEST_ASSERT_EQUAL(pending.size(), w.size());
+  }
+  TEST_ASSERT_TRUE(firedTotal > 10000);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fires_within_one_tick_never_early);
+  RUN_TEST(test_cancel_and_reschedule);
+  RUN_TEST(test_deadline_past_the_horizon);
+  RUN_TEST(test_callback_rearms_and_cancels);
+  RUN_TEST(test_across_the_millis_wrap);
+  RUN_TEST(test_clear_realigns);
+  RUN_TEST(test_randomized_against_reference);
+  return UNITY_END();
+}
@@ -0,0 +1,66 @@
+// The whole firmware on the host: boot, radio -> loop() -> web API, and
+// what survives a reboot. `pio test -e native`
+#include "../radar_harness.h"
+#include <unity.h>
+
+static const uint64_t PHONE = 0xA4C1380A0B0CULL;
+static const char *PHONE_STR = "A4:C1:38:0A:0B:0C";
+
+void setUp() {}
+void tearDown() {}
+
+static void test_boot_serves_the_api() {
+  TEST_ASSERT_TRUE(server.begun);
+  NativeHttpResponse r = server.get("/api/stats");
+  TEST_ASSERT_EQUAL(200, r.code);
+  DynamicJsonDocument stats = jsonOf(r);
+  TEST_ASSERT_FALSE(stats.isNull());
+  TEST_ASSERT_EQUAL(404, server.get("/api/nothing").code);
+}
+
+static void test_advert_reaches_devices_api() {
+  runLoop(10); // first pass starts the scan
+  TEST_ASSERT_TRUE(pBLEScan->isScanning());
+  TEST_ASSERT_TRUE(hearAdvert(PHONE, -60, advertPayload("Pixel")));
+  runLoop(5);
+  NativeHttpResponse r = server.get("/api/devices");
+  TEST_ASSERT_EQUAL(200, r.code);
+  DynamicJsonDocument doc = jsonOf(r);
+  TEST_ASSERT_TRUE(listedIn(doc["devices"], PHONE_STR));
+}
+
+static void test_device_leaves_the_list_on_the_fake_clock() {
+  hearAdvert(PHONE, -60);
+  runLoop(5);
+  runLoop(DEVICE_RETAIN_MS + 2000);
+  DynamicJsonDocument doc = jsonOf(server.get("/api/devices"));
+  TEST_ASSERT_FALSE(listedIn(doc["devices"], PHONE_STR));
+}
+
+static void test_whitelist_survives_a_reboot() {
+  NativeHttpResponse r =
+      server.post("/api/whitelist/add", {{"mac", PHONE_STR}});
+  TEST_ASSERT_EQUAL(200, r.code);
+  // Reboot: RAM state gone, NVS and LittleFS kept
+  {
+    StateLock lock;
+    whitelist.clear();
+  }
+  loadWhitelist();
+  bool listed;
+  {
+    StateLock lock;
+    listed = whitelist.contains(PHONE);
+  }
+  TEST_ASSERT_TRUE(listed);
+}
+
+int main() {
+  bootRadar("test_firmware");
+  UNITY_BEGIN();
+  RUN_TEST(test_boot_serves_the_api);
+  RUN_TEST(test_advert_reaches_devices_api);
+  RUN_TEST(test_device_leaves_the_list_on_the_fake_clock);
+  RUN_TEST(test_whitelist_survives_a_reboot);
+  return UNITY_END();
+}
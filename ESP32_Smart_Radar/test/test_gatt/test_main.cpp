@@ -0,0 +1,192 @@
+// GATT enrichment on the fake radio: candidates ranked by gattPriority(),
+// results cached across evictions and reboots with a TTL, rotating
+// addresses left out of the cache, radio time split between scanning and
+// connections, and the scan gap of a slow connection cut at
+// GATT_GAP_MAX_MS. `pio test -e native`
+#include "../radar_harness.h"
+#include <thread>
+#include <unity.h>
+
+struct Peer {
+  uint64_t mac;
+  int rssi;
+  uint8_t type;
+};
+
+static const Peer ALPHA = {0x001A2B000001ULL, -50, BLE_ADDR_PUBLIC};
+static const Peer BRAVO = {0x001A2B000002ULL, -60, BLE_ADDR_PUBLIC};
+static const Peer CHARLIE = {0x001A2B000003ULL, -75, BLE_ADDR_PUBLIC};
+static const Peer DELTA = {0x001A2B000004ULL, -85, BLE_ADDR_PUBLIC};
+static const Peer ECHO = {0x4A1B2C3D4E5FULL, -50, BLE_ADDR_RANDOM}; // RPA
+static const uint32_t CONNECT_MS = 800;
+
+void setUp() {}
+void tearDown() {}
+
+static void addPeripheral(const Peer &p, const char *name, int battery) {
+  std::lock_guard<std::mutex> lk(NimBLEDevice::peripheralsLock());
+  NimBLEDevice::peripherals()[p.mac] = {name, battery, CONNECT_MS};
+}
+
+static std::vector<uint64_t> connections() {
+  std::lock_guard<std::mutex> lk(NimBLEDevice::peripheralsLock());
+  return NimBLEDevice::connected();
+}
+
+static size_t connectionsTo(const Peer &p) {
+  std::vector<uint64_t> c = connections();
+  return std::count(c.begin(), c.end(), p.mac);
+}
+
+// The peers advertise every 200 ms for `ms` of fake time while loop() runs;
+// the GATT worker connects on its own thread meanwhile.
+static void keepAround(const std::vector<Peer> &peers, uint32_t ms) {
+  for (uint32_t t = 0; t < ms; t += 200) {
+    for (const Peer &p : peers)
+      hearAdvert(p.mac, p.rssi, advertPayload(), p.type);
+    runLoop(200);
+    std::this_thread::sleep_for(std::chrono::microseconds(300));
+  }
+}
+
+static std::string gattNameOf(const Peer &p) {
+  StateLock lock;
+  const BleDeviceData *dev = detectedDevices.find(p.mac);
+  return dev ? dev->gattName : "(evicted)";
+}
+
+static std::string cachedNameOf(const Peer &p) {
+  StateLock lock;
+  const auto *e = gattCache.find(p.mac);
+  return e ? e->name : "(none)";
+}
+
+// Weak, non-connectable strangers, enough to push the given peer (and
+// every other) out of the table.
+static void evict(const Peer &) {
+  for (size_t i = 0; i < MAX_DEVICES + 8; i++) {
+    hearAdvert(0x00EEEE000000ULL + (i * 131) % 100000, -95, advertPayload(),
+               BLE_ADDR_PUBLIC, false);
+    if (i % 32 == 31)
+      runLoop(5);
+  }
+  runLoop(5);
+}
+
+static void test_candidates_go_by_priority() {
+  addPeripheral(ALPHA, "Alpha", 80);
+  addPeripheral(BRAVO, "Bravo", 55);
+  addPeripheral(CHARLIE, "Charlie", -1);
+  addPeripheral(DELTA, "Delta", 10);
+  server.post("/api/whitelist/add", {{"mac", "00:1A:2B:00:00:01"}});
+  // Scores: Bravo 20 + 40 + 20, Alpha 30 + 40, Charlie 5 + 40 + 20; Delta
+  // is under GATT_MIN_RSSI
+  keepAround({ALPHA, BRAVO, CHARLIE, DELTA}, 4 * GATT_PERIOD_MS + 2000);
+  std::vector<uint64_t> c = connections();
+  TEST_ASSERT_EQUAL(3, c.size());
+  TEST_ASSERT_TRUE(c[0] == BRAVO.mac);
+  TEST_ASSERT_TRUE(c[1] == ALPHA.mac);
+  TEST_ASSERT_TRUE(c[2] == CHARLIE.mac);
+  TEST_ASSERT_EQUAL_STRING("Bravo", gattNameOf(BRAVO).c_str());
+  TEST_ASSERT_EQUAL_STRING("Charlie", gattNameOf(CHARLIE).c_str());
+  TEST_ASSERT_EQUAL_STRING("", gattNameOf(DELTA).c_str());
+}
+
+static void test_radio_time_is_split() {
+  DynamicJsonDocument stats = jsonOf(server.get("/api/stats"));
+  uint32_t gattMs = stats["radio"]["gattMs"];
+  uint32_t scanMs = stats["radio"]["scanMs"];
+  float share = stats["radio"]["gattShare"];
+  printf("radio: scan %u ms, GATT %u ms (%.1f %%)\n", (unsigned)scanMs,
+         (unsigned)gattMs, 100 * share);
+  TEST_ASSERT_TRUE(gattMs >= 3 * CONNECT_MS && gattMs < 3 * (CONNECT_MS + 500));
+  TEST_ASSERT_TRUE(scanMs > 3 * GATT_PERIOD_MS);
+  TEST_ASSERT_TRUE(fabsf(share - (float)gattMs / (gattMs + scanMs)) < 0.01f);
+  TEST_ASSERT_EQUAL(3, stats["gatt"]["connects"].as<int>());
+}
+
+static void test_cache_outlives_eviction_and_reboot() {
+  evict(BRAVO);
+  TEST_ASSERT_EQUAL_STRING("(evicted)", gattNameOf(BRAVO).c_str());
+  uint32_t hits = jsonOf(server.get("/api/stats"))["gatt"]["cacheHits"];
+  // Back: named at once from the cache, no new connection
+  keepAround({BRAVO}, 2 * GATT_PERIOD_MS);
+  TEST_ASSERT_EQUAL_STRING("Bravo", gattNameOf(BRAVO).c_str());
+  TEST_ASSERT_EQUAL(1, connectionsTo(BRAVO));
+  DynamicJsonDocument stats = jsonOf(server.get("/api/stats"));
+  TEST_ASSERT_EQUAL(hits + 1, stats["gatt"]["cacheHits"].as<uint32_t>());
+
+  // Flushed with the maintenance pass: a rebooted board reads it back
+  runLoop(MAINTENANCE_MS);
+  GattCache<128> rebooted;
+  rebooted.begin(LittleFS, "/gattcache.bin", GATT_CACHE_TTL_SEC);
+  TEST_ASSERT_TRUE(rebooted.load());
+  const auto *e = rebooted.find(BRAVO.mac);
+  TEST_ASSERT_NOT_NULL(e);
+  TEST_ASSERT_EQUAL_STRING("Bravo", e->name);
+  TEST_ASSERT_EQUAL(55, e->battery);
+}
+
+static void test_stale_entry_is_fetched_again() {
+  addPeripheral(BRAVO, "Bravo II", 50);
+  evict(BRAVO);
+  nativeClock.epochStart += GATT_CACHE_TTL_SEC + 3600; // a day later
+  keepAround({BRAVO}, 2 * GATT_PERIOD_MS);
+  TEST_ASSERT_EQUAL(2, connectionsTo(BRAVO));
+  TEST_ASSERT_EQUAL_STRING("Bravo II", gattNameOf(BRAVO).c_str());
+  TEST_ASSERT_EQUAL_STRING("Bravo II", cachedNameOf(BRAVO).c_str());
+}
+
+static void test_rotating_address_is_not_cached() {
+  addPeripheral(ECHO, "Echo", 90);
+  keepAround({ECHO}, 2 * GATT_PERIOD_MS);
+  TEST_ASSERT_EQUAL(1, connectionsTo(ECHO));
+  TEST_ASSERT_EQUAL_STRING("Echo", gattNameOf(ECHO).c_str());
+  TEST_ASSERT_EQUAL_STRING("(none)", cachedNameOf(ECHO).c_str());
+}
+
+// A peripheral slower to connect than GATT_GAP_MAX_MS: the scan resumes at
+// the bound while the worker still waits, and the gap counts in the
+// detection latency estimate.
+static void test_scan_gap_is_bounded() {
+  const Peer FOXTROT = {0x001A2B000006ULL, -55, BLE_ADDR_PUBLIC};
+  {
+    std::lock_guard<std::mutex> lk(NimBLEDevice::peripheralsLock());
+    NimBLEDevice::peripherals()[FOXTROT.mac] = {"Foxtrot", -1, 6000};
+  }
+  uint64_t gapsBefore = jsonOf(server.get("/api/stats"))["scan"]["gattGapMs"];
+  for (uint32_t t = 0; t < 2 * GATT_PERIOD_MS && pBLEScan->isScanning();
+       t += 200) {
+    hearAdvert(FOXTROT.mac, FOXTROT.rssi, advertPayload(), FOXTROT.type);
+    runLoop(200);
+  }
+  TEST_ASSERT_FALSE(pBLEScan->isScanning());
+  uint32_t stopped = radarClock.ms(); // within the last step
+  while (!pBLEScan->isScanning() && radarClock.ms() - stopped < 10000)
+    runLoop(1);
+  TEST_ASSERT_TRUE(gattTaskRunning);
+  TEST_ASSERT_TRUE(radarClock.ms() - stopped <= GATT_GAP_MAX_MS);
+  // Heard again while the link is set up
+  TEST_ASSERT_TRUE(hearAdvert(FOXTROT.mac, FOXTROT.rssi, advertPayload(),
+                              FOXTROT.type));
+  for (uint32_t t = 0; t < 20000 && gattTaskRunning; t += 200)
+    keepAround({FOXTROT}, 200);
+  TEST_ASSERT_EQUAL_STRING("Foxtrot", gattNameOf(FOXTROT).c_str());
+  DynamicJsonDocument stats = jsonOf(server.get("/api/stats"));
+  uint64_t gaps = stats["scan"]["gattGapMs"];
+  TEST_ASSERT_EQUAL(GATT_GAP_MAX_MS, gaps - gapsBefore);
+  TEST_ASSERT_TRUE(stats["scan"]["detectLatencyMs"].as<uint32_t>() > 0);
+}
+
+int main() {
+  bootRadar("test_gatt");
+  runLoop(10);
+  UNITY_BEGIN();
+  RUN_TEST(test_candidates_go_by_priority);
+  RUN_TEST(test_radio_time_is_split);
+  RUN_TEST(test_cache_outlives_eviction_and_reboot);
+  RUN_TEST(test_stale_entry_is_fetched_again);
+  RUN_TEST(test_rotating_address_is_not_cached);
+  RUN_TEST(test_scan_gap_is_bounded);
+  return UNITY_END();
+}
@@ -0,0 +1,242 @@
+// LastSeenJournal (src/lastseen_journal.h) on the LittleFS shim: power cuts
+// during compaction, damaged files, and flash bytes written per hour under
+// a day of churn. `pio test -e native`
+#include <LittleFS.h>
+#include <lastseen_journal.h>
+#include <map>
+#include <native_storage.h>
+#include <stdio.h>
+#include <unity.h>
+
+static const char *PATH = "/lastseen.bin";
+static const uint32_t RESOLUTION = 60;
+static const uint32_t T0 = 1700000000;
+
+static uint64_t nthMac(size_t i) { return 0xA4C138000000ULL + i; }
+
+void setUp() {
+  nativeStorageReset("test_lastseen_journal");
+  LittleFS.powerRestore();
+}
+void tearDown() { LittleFS.powerRestore(); }
+
+static std::map<uint64_t, uint32_t> reloaded(LastSeenJournal *into = nullptr) {
+  LastSeenJournal j;
+  LastSeenJournal &journal = into ? *into : j;
+  journal.begin(LittleFS, PATH, RESOLUTION);
+  journal.load();
+  std::map<uint64_t, uint32_t> seen;
+  for (size_t i = 0; i < 1000; i++)
+    if (journal.get(nthMac(i)))
+      seen[nthMac(i)] = (uint32_t)journal.get(nthMac(i));
+  return seen;
+}
+
+static void writeRaw(const char *path, const std::string &bytes) {
+  File f = LittleFS.open(path, "w");
+  f.write((const uint8_t *)bytes.data(), bytes.size());
+  f.close();
+}
+
+// A journal with dead records, so that the next flush compacts.
+static void fillWithHistory(LastSeenJournal &j, size_t macs, uint32_t &now) {
+  j.begin(LittleFS, PATH, RESOLUTION);
+  j.load();
+  while (j.fileRecords() <= 2 * macs + 64 - macs) {
+    now += RESOLUTION;
+    for (size_t i = 0; i < macs; i++)
+      j.update(nthMac(i), now);
+    j.flush();
+  }
+}
+
+static void test_power_cut_during_compaction_keeps_a_journal() {
+  const size_t MACS = 40;
+  for (int writes = 0; writes <= 3; writes++) {
+    nativeStorageReset("test_lastseen_journal");
+    uint32_t now = T0;
+    LastSeenJournal j;
+    fillWithHistory(j, MACS, now);
+    std::map<uint64_t, uint32_t> before = reloaded();
+    TEST_ASSERT_EQUAL(MACS, before.size());
+    uint32_t compactions = j.compactions;
+    now += RESOLUTION;
+    for (size_t i = 0; i < MACS; i++)
+      j.update(nthMac(i), now);
+    LittleFS.powerCutAfter(writes);
+    j.flush();
+    LittleFS.powerRestore();
+
+    // Reboot: every MAC is there, either as before or as flushed
+    LastSeenJournal after;
+    std::map<uint64_t, uint32_t> seen = reloaded(&after);
+    TEST_ASSERT_EQUAL(MACS, seen.size());
+    bool landed = j.compactions > compactions;
+    for (auto &kv : seen)
+      TEST_ASSERT_EQUAL(landed ? now : before[kv.first], kv.second);
+    TEST_ASSERT_FALSE(LittleFS.exists("/lastseen.bin.tmp"));
+    // What did not land is still dirty and goes out with the next flush
+    TEST_ASSERT_EQUAL(!landed, j.pending());
+    j.flush();
+    for (auto &kv : reloaded())
+      TEST_ASSERT_EQUAL(now, kv.second);
+  }
+}
+
+static void test_leftover_temp_file_is_recovered_or_dropped() {
+  uint32_t now = T0;
+  LastSeenJournal j;
+  fillWithHistory(j, 10, now);
+  j.compact();
+  // Only the temp file: firmware that removed the journal before renaming
+  LittleFS.rename(PATH, "/lastseen.bin.tmp");
+  TEST_ASSERT_EQUAL(10, reloaded().size());
+  TEST_ASSERT_FALSE(LittleFS.exists("/lastseen.bin.tmp"));
+  // Both: the temp file is a partial rewrite and the journal wins
+  writeRaw("/lastseen.bin.tmp", "LSJ1\x01\x02\x03");
+  TEST_ASSERT_EQUAL(10, reloaded().size());
+  TEST_ASSERT_FALSE(LittleFS.exists("/lastseen.bin.tmp"));
+}
+
+static void test_bad_magic_is_rewritten() {
+  writeRaw(PATH, std::string("garbage, not a journal"));
+  LastSeenJournal j;
+  j.begin(LittleFS, PATH, RESOLUTION);
+  TEST_ASSERT_TRUE(j.load());
+  TEST_ASSERT_EQUAL(0, j.size());
+  TEST_ASSERT_EQUAL(1, j.repairs);
+  j.update(nthMac(1), T0);
+  j.flush();
+  std::map<uint64_t, uint32_t> seen = reloaded();
+  TEST_ASSERT_EQUAL(1, seen.size());
+  TEST_ASSERT_EQUAL(T0, seen[nthMac(1)]);
+}
+
+static void test_torn_last_record_is_truncated() {
+  uint32_t now = T0;
+  LastSeenJournal j;
+  j.begin(LittleFS, PATH, RESOLUTION);
+  j.load();
+  for (size_t i = 0; i < 5; i++)
+    j.update(nthMac(i), now);
+  j.flush();
+  // An append cut after 4 of its 10 bytes
+  File f = LittleFS.open(PATH, "a");
+  f.write((const uint8_t *)"\xA4\xC1\x38\x00", 4);
+  f.close();
+
+  LastSeenJournal k;
+  k.begin(LittleFS, PATH, RESOLUTION);
+  k.load();
+  TEST_ASSERT_EQUAL(1, k.repairs);
+  TEST_ASSERT_EQUAL(5, k.size());
+  k.update(nthMac(7), now + RESOLUTION);
+  k.flush();
+  File g = LittleFS.open(PATH, "r");
+  TEST_ASSERT_EQUAL(4 + 6 * LastSeenJournal::RECORD_SIZE, g.size());
+  g.close();
+  std::map<uint64_t, uint32_t> seen = reloaded();
+  TEST_ASSERT_EQUAL(6, seen.size());
+  TEST_ASSERT_EQUAL(now + RESOLUTION, seen[nthMac(7)]);
+}
+
+// Former firmware: the whole {"MAC":time,...} NVS string rewritten at each
+// scan cycle.
+// loop() writes a taken batch without the lock: what changes meanwhile is
+// flushed next time, and a clear() in between wins over the late write.
+static void test_changes_during_an_unlocked_write() {
+  uint32_t now = T0;
+  LastSeenJournal j;
+  j.begin(LittleFS, PATH, RESOLUTION);
+  j.load();
+  for (size_t i = 0; i < 10; i++)
+    j.update(nthMac(i), now);
+  LastSeenJournal::FlushBatch b;
+  TEST_ASSERT_TRUE(j.takeFlush(b));
+  TEST_ASSERT_FALSE(j.pending());
+  j.update(nthMac(3), now + 2 * RESOLUTION);
+  j.writeFlush(b);
+  j.endFlush(b);
+  TEST_ASSERT_TRUE(b.landed);
+  TEST_ASSERT_TRUE(j.pending());
+  j.flush();
+  std::map<uint64_t, uint32_t> seen = reloaded();
+  TEST_ASSERT_EQUAL(10, seen.size());
+  TEST_ASSERT_EQUAL(now + 2 * RESOLUTION, seen[nthMac(3)]);
+
+  j.update(nthMac(20), now + 4 * RESOLUTION);
+  TEST_ASSERT_TRUE(j.takeFlush(b));
+  j.clear();
+  j.writeFlush(b);
+  j.endFlush(b);
+  TEST_ASSERT_FALSE(LittleFS.exists(PATH));
+  TEST_ASSERT_EQUAL(0, reloaded().size());
+  TEST_ASSERT_EQUAL(0, j.size());
+}
+
+static size_t legacyJsonBytes(size_t macs) {
+  return macs ? 2 + macs * (2 + 17 + 1 + 10) + (macs - 1) : 2;
+}
+
+// A day of a 300-entry whitelist, 60 of them around at any time and a
+// tenth of those replaced every 10 minutes, flushed once per 12 s scan
+// cycle like runMaintenance().
+static void test_churn_bytes_written_per_hour() {
+  const size_t WHITELIST = 300, PRESENT = 60;
+  const uint32_t CYCLE_S = 12, HOURS = 24;
+  LastSeenJournal j;
+  j.begin(LittleFS, PATH, RESOLUTION);
+  j.load();
+  std::vector<size_t> present;
+  for (size_t i = 0; i < PRESENT; i++)
+    present.push_back(i);
+  size_t next = PRESENT;
+  uint64_t legacy = 0, committedBefore = LittleFS.bytesCommitted;
+  std::map<uint64_t, uint32_t> expected;
+  for (uint32_t t = 0; t < HOURS * 3600; t += CYCLE_S) {
+    if (t % 600 == 0 && t)
+      for (size_t k = 0; k < PRESENT / 10; k++) {
+        present[(t / 600 * 7 + k * 13) % PRESENT] = next;
+        next = (next + 1) % WHITELIST;
+      }
+    for (size_t i : present) {
+      j.update(nthMac(i), T0 + t);
+      expected[nthMac(i)] = T0 + t;
+    }
+    j.flush();
+    legacy += legacyJsonBytes(expected.size());
+  }
+  double perHour = (double)j.bytesWritten / HOURS;
+  double committedPerHour =
+      (double)(LittleFS.bytesCommitted - committedBefore) / HOURS;
+  double legacyPerHour = (double)legacy / HOURS;
+  printf("lastSeen churn: %.0f B/h appended+compacted (%u compactions), "
+         "%.0f B/h whole-file commits on the shim, legacy NVS JSON %.0f "
+         "B/h\n",
+         perHour, (unsigned)j.compactions, committedPerHour, legacyPerHour);
+  // One record per present MAC per resolution, plus compactions that at
+  // most double it
+  double bound = 2.0 * PRESENT * (3600.0 / RESOLUTION) *
+                     LastSeenJournal::RECORD_SIZE +
+                 (4 + WHITELIST * LastSeenJournal::RECORD_SIZE) * 12;
+  TEST_ASSERT_TRUE(perHour <= bound);
+  TEST_ASSERT_TRUE(perHour * 20 < legacyPerHour);
+  TEST_ASSERT_TRUE(j.fileRecords() <= 2 * WHITELIST + 64);
+
+  // The last flush is what a reboot reads, to the resolution
+  std::map<uint64_t, uint32_t> seen = reloaded();
+  TEST_ASSERT_EQUAL(expected.size(), seen.size());
+  for (auto &kv : expected)
+    TEST_ASSERT_TRUE(kv.second - seen[kv.first] < RESOLUTION);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_power_cut_during_compaction_keeps_a_journal);
+  RUN_TEST(test_leftover_temp_file_is_recovered_or_dropped);
+  RUN_TEST(test_bad_magic_is_rewritten);
+  RUN_TEST(test_torn_last_record_is_truncated);
+  RUN_TEST(test_changes_during_an_unlocked_write);
+  RUN_TEST(test_churn_bytes_written_per_hour);
+  return UNITY_END();
+}
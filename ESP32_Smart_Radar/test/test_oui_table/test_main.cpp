@@ -0,0 +1,43 @@
+// The generated OUI table (src/progmem_vendors.h, the layout compiled in)
+// against the original firmware's {prefix, vendor} table: every one of the
+// 2^24 prefixes must give the same vendor, or none in both. A generator bug
+// that damaged the packed table would pass the layout comparison of
+// test_bench_oui, which searches the packed table both ways; it fails here.
+// `pio test -e native`
+#include "../legacy_oui_table.h"
+#include "progmem_vendors.h"
+#include <string.h>
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+static void test_same_size() {
+  TEST_ASSERT_EQUAL(LEGACY_OUI_TABLE_SIZE, OUI_TABLE_SIZE);
+}
+
+static void test_every_prefix_matches_the_original() {
+  uint32_t hits = 0, mismatches = 0, firstMismatch = 0;
+  for (uint32_t p = 0; p < (1u << 24); p++) {
+    const char *want = legacyVendorOf(p);
+    const char *got = getVendorFromPROGMEM(p);
+    bool same = want == nullptr ? got == nullptr
+                                : got != nullptr && strcmp(want, got) == 0;
+    if (!same && mismatches++ == 0)
+      firstMismatch = p;
+    hits += want != nullptr;
+  }
+  printf("%u prefixes assigned, %u mismatches\n", (unsigned)hits,
+         (unsigned)mismatches);
+  char msg[48];
+  snprintf(msg, sizeof(msg), "first mismatch at %06X", (unsigned)firstMismatch);
+  TEST_ASSERT_EQUAL_MESSAGE(0, mismatches, msg);
+  TEST_ASSERT_EQUAL(LEGACY_OUI_TABLE_SIZE, hits);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_same_size);
+  RUN_TEST(test_every_prefix_matches_the_original);
+  return UNITY_END();
+}
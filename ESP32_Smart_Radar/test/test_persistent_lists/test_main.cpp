@@ -0,0 +1,152 @@
+// BlePersistentListsComponent (components/ble_persistent_lists) on the NVS
+// shim: lists capped at what NVS stores, and failed writes reported and
+// rolled back. `pio test -e native`
+#include "ble_persistent_lists/ble_persistent_lists.cpp"
+#include <native_storage.h>
+#include <unity.h>
+
+using esphome::ble_persistent_lists::BlePersistentListsComponent;
+using esphome::ble_persistent_lists::MacList;
+using esphome::ble_persistent_lists::MAX_BLOB_BYTES;
+
+static std::string nthMac(size_t i) {
+  return BlePersistentListsComponent::format_mac(0xC0FFEE000000ULL + i);
+}
+
+void setUp() {
+  nativeStorageReset("test_persistent_lists");
+  nativeNvsPartition(0x5000);
+}
+void tearDown() {}
+
+// A fresh component reading what NVS holds, as after a reboot.
+static std::string reloaded() {
+  BlePersistentListsComponent c;
+  c.setup();
+  return c.get_whitelist_str();
+}
+
+static void test_lists_stop_at_the_nvs_budget() {
+  BlePersistentListsComponent lists;
+  lists.setup();
+  std::string label(64, 'x');
+  size_t wl = 0, bl = 0;
+  while (lists.add_to_whitelist(nthMac(wl)))
+    wl++;
+  while (lists.add_to_blacklist(nthMac(100000 + bl), label))
+    bl++;
+  // ~570 bare MACs, ~55 with full labels, both held by a 20 KB partition
+  TEST_ASSERT_TRUE(wl > 500 && wl < 600);
+  TEST_ASSERT_TRUE(bl > 50 && bl < 60);
+  TEST_ASSERT_FALSE(lists.is_in_whitelist(nthMac(wl)));
+  // Both lists full and still rewritable within the partition
+  TEST_ASSERT_TRUE(lists.remove_from_whitelist(nthMac(0)));
+  TEST_ASSERT_TRUE(lists.add_to_whitelist(nthMac(0)));
+  TEST_ASSERT_EQUAL_STRING(lists.get_whitelist_str().c_str(),
+                           reloaded().c_str());
+}
+
+static void test_long_labels_count_against_the_budget() {
+  BlePersistentListsComponent lists;
+  lists.setup();
+  TEST_ASSERT_TRUE(lists.add_to_whitelist(nthMac(0), "a"));
+  size_t n = 1;
+  while (lists.add_to_whitelist(nthMac(n)))
+    n++;
+  // Full: a longer label no longer fits, a shorter one does
+  TEST_ASSERT_FALSE(lists.set_whitelist_label(nthMac(0), std::string(64, 'y')));
+  TEST_ASSERT_EQUAL_STRING("a", lists.get_whitelist_label(n - 1).c_str());
+  TEST_ASSERT_TRUE(lists.set_whitelist_label(nthMac(0), ""));
+  TEST_ASSERT_EQUAL_STRING(lists.get_whitelist_str().c_str(),
+                           reloaded().c_str());
+}
+
+static void test_failed_write_is_reported_and_rolled_back() {
+  BlePersistentListsComponent lists;
+  lists.setup();
+  TEST_ASSERT_TRUE(lists.add_to_whitelist(nthMac(1), "one"));
+  TEST_ASSERT_TRUE(lists.add_to_whitelist(nthMac(2), "two"));
+  std::string saved = lists.get_whitelist_str();
+
+  nativeNvsPartition(2 * 4096); // one usable page: no room for a rewrite
+  std::string label(64, 'z');
+  size_t i = 3;
+  while (lists.add_to_whitelist(nthMac(i), label))
+    i++;
+  TEST_ASSERT_FALSE(lists.is_in_whitelist(nthMac(i)));
+  saved = lists.get_whitelist_str();
+  TEST_ASSERT_EQUAL_STRING(saved.c_str(), reloaded().c_str());
+
+  nativeNvsPartition(4096); // nothing usable: every write fails
+  TEST_ASSERT_FALSE(lists.remove_from_whitelist(nthMac(1)));
+  TEST_ASSERT_TRUE(lists.is_in_whitelist(nthMac(1)));
+  TEST_ASSERT_FALSE(lists.set_whitelist_label(nthMac(2), "renamed"));
+  TEST_ASSERT_FALSE(lists.clear_whitelist());
+  TEST_ASSERT_FALSE(lists.add_to_blacklist(nthMac(9)));
+  TEST_ASSERT_FALSE(lists.is_in_blacklist(nthMac(9)));
+  // Same entries, same order, same labels
+  TEST_ASSERT_EQUAL_STRING(saved.c_str(), lists.get_whitelist_str().c_str());
+  nativeNvsPartition(0x5000);
+  TEST_ASSERT_EQUAL_STRING(saved.c_str(), reloaded().c_str());
+}
+
+// A blob written with a larger budget (or a duplicate) loads what fits and
+// reports the entries it dropped.
+static void test_dropped_blob_entries_are_reported() {
+  MacList big;
+  while (big.add(0xC0FFEE000000ULL + big.size(), ""))
+    ;
+  std::vector<uint8_t> blob = big.to_blob();
+  const uint8_t extra[] = {0xC0, 0xFF, 0xEE, 0xAB, 0xCD, 0xEF, 0,
+                           0xC0, 0xFF, 0xEE, 0x00, 0x00, 0x00, 0};
+  blob.insert(blob.end(), extra, extra + sizeof(extra));
+  uint32_t n = big.size() + 2;
+  for (int b = 0; b < 4; b++)
+    blob[4 + b] = (uint8_t)(n >> (8 * b));
+  MacList list;
+  TEST_ASSERT_FALSE(list.from_blob(blob));
+  TEST_ASSERT_EQUAL(big.size(), list.size());
+  TEST_ASSERT_FALSE(list.contains(0xC0FFEEABCDEFULL));
+
+  nvs_handle_t h;
+  nvs_open("ble_intrusion", NVS_READWRITE, &h);
+  nvs_set_blob(h, "wl_bin", blob.data(), blob.size());
+  nvs_commit(h);
+  nvs_close(h);
+  BlePersistentListsComponent lists;
+  lists.setup();
+  TEST_ASSERT_EQUAL_STRING(big.to_csv().c_str(),
+                           lists.get_whitelist_str().c_str());
+  // NVS keeps the blob as written until the list changes
+  size_t len = 0;
+  nvs_open("ble_intrusion", NVS_READWRITE, &h);
+  nvs_get_blob(h, "wl_bin", nullptr, &len);
+  nvs_close(h);
+  TEST_ASSERT_EQUAL(blob.size(), len);
+}
+
+static void test_legacy_csv_is_migrated() {
+  nvs_handle_t h;
+  nvs_open("ble_intrusion", NVS_READWRITE, &h);
+  nvs_set_str(h, "wl", "AA:BB:CC:DD:EE:02|new,AA:BB:CC:DD:EE:01|old");
+  nvs_commit(h);
+  nvs_close(h);
+  BlePersistentListsComponent lists;
+  lists.setup();
+  TEST_ASSERT_EQUAL_STRING("AA:BB:CC:DD:EE:02|new,AA:BB:CC:DD:EE:01|old",
+                           lists.get_whitelist_str().c_str());
+  size_t len = 0;
+  nvs_open("ble_intrusion", NVS_READWRITE, &h);
+  TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, nvs_get_str(h, "wl", nullptr, &len));
+  nvs_close(h);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_lists_stop_at_the_nvs_budget);
+  RUN_TEST(test_long_labels_count_against_the_budget);
+  RUN_TEST(test_failed_write_is_reported_and_rolled_back);
+  RUN_TEST(test_dropped_blob_entries_are_reported);
+  RUN_TEST(test_legacy_csv_is_migrated);
+  return UNITY_END();
+}
@@ -0,0 +1,219 @@
+// Presence (src/presence.h): dwell and RSSI hysteresis of presenceStep(),
+// presenceDeadline() against a sweep every millisecond, and the firmware's
+// "arrived" / "left" events on /api/events, /api/devices and /api/stats.
+// `pio test -e native`
+#include "../radar_harness.h"
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+// One device as the firmware keeps it: filter, last sighting, presence.
+struct Tracked {
+  PresenceState ps = {};
+  RssiFilter filter = {};
+  uint32_t lastSeen = 0;
+  std::vector<std::pair<uint32_t, PresenceEvent>> events;
+
+  void hear(uint32_t now, int rssi) {
+    filter.add((int8_t)rssi);
+    lastSeen = now;
+    step(now, true);
+  }
+  void step(uint32_t now, bool heard) {
+    PresenceEvent e = presenceStep(ps, PRESENCE, now, lastSeen, heard,
+                                   filter.level(), filter.ready());
+    if (e != PresenceEvent::None)
+      events.push_back({now, e});
+  }
+  // Timers as loop() runs them: at each deadline until `until`.
+  void idle(uint32_t until) {
+    for (;;) {
+      uint32_t due = presenceDeadline(ps, PRESENCE, until, lastSeen);
+      if (due == PRESENCE_NO_DEADLINE || (int32_t)(until - due) < 0)
+        return;
+      step(due, false);
+    }
+  }
+};
+
+static void test_arrives_after_dwell_when_kept_heard() {
+  Tracked d;
+  for (uint32_t t = 0; t <= 5000; t += 500) {
+    d.idle(t);
+    d.hear(t, -60);
+  }
+  TEST_ASSERT_EQUAL(1, d.events.size());
+  TEST_ASSERT_EQUAL(PRESENCE.enterDwellMs, d.events[0].first);
+  TEST_ASSERT_TRUE(d.events[0].second == PresenceEvent::Arrived);
+  TEST_ASSERT_TRUE(d.ps.state == Presence::Present);
+}
+
+static void test_burst_does_not_arrive() {
+  Tracked d;
+  d.hear(0, -55);
+  d.hear(100, -55);
+  d.hear(200, -55);
+  d.idle(60000);
+  TEST_ASSERT_EQUAL(0, d.events.size());
+  TEST_ASSERT_TRUE(d.ps.state == Presence::Unseen);
+  TEST_ASSERT_EQUAL(200 + PRESENCE.candidateSilenceMs, d.ps.since);
+}
+
+static void test_weak_device_is_never_candidate() {
+  Tracked d;
+  for (uint32_t t = 0; t <= 60000; t += 500) {
+    d.idle(t);
+    d.hear(t, PRESENCE.enterDbm - 1);
+  }
+  TEST_ASSERT_TRUE(d.ps.state == Presence::Unseen);
+  TEST_ASSERT_EQUAL(0, d.events.size());
+}
+
+static void test_rssi_hysteresis() {
+  Tracked d;
+  uint32_t t = 0;
+  auto hearFor = [&](uint32_t ms, int rssi) {
+    for (uint32_t end = t + ms; t < end; t += 500) {
+      d.idle(t);
+      d.hear(t, rssi);
+    }
+  };
+  hearFor(4000, -70);
+  TEST_ASSERT_TRUE(d.ps.state == Presence::Present);
+  // Between the thresholds: stays Present
+  hearFor(20000, (PRESENCE.enterDbm + PRESENCE.exitDbm) / 2);
+  TEST_ASSERT_TRUE(d.ps.state == Presence::Present);
+  // Under exitDbm: Leaving; back between the thresholds is not enough
+  hearFor(5000, PRESENCE.exitDbm - 4);
+  TEST_ASSERT_TRUE(d.ps.state == Presence::Leaving);
+  hearFor(5000, PRESENCE.exitDbm + 2);
+  TEST_ASSERT_TRUE(d.ps.state == Presence::Leaving);
+  // At enterDbm again: Present, without a second "arrived"
+  hearFor(5000, PRESENCE.enterDbm + 10);
+  TEST_ASSERT_TRUE(d.ps.state == Presence::Present);
+  TEST_ASSERT_EQUAL(1, d.events.size());
+  // Weak for longer than exitDwellMs while still heard: "left"
+  hearFor(PRESENCE.exitDwellMs + 10000, PRESENCE.exitDbm - 4);
+  TEST_ASSERT_TRUE(d.ps.state == Presence::Absent);
+  TEST_ASSERT_EQUAL(2, d.events.size());
+  TEST_ASSERT_TRUE(d.events[1].second == PresenceEvent::Left);
+}
+
+static void test_silence_leaves_then_left() {
+  Tracked d;
+  for (uint32_t t = 0; t <= 4000; t += 500)
+    d.hear(t, -65);
+  d.idle(4000 + PRESENCE.leaveSilenceMs - 1);
+  TEST_ASSERT_TRUE(d.ps.state == Presence::Present);
+  d.idle(4000 + PRESENCE.leaveSilenceMs);
+  TEST_ASSERT_TRUE(d.ps.state == Presence::Leaving);
+  // One missed scan is not a departure
+  d.hear(4000 + PRESENCE.leaveSilenceMs + 5000, -65);
+  TEST_ASSERT_TRUE(d.ps.state == Presence::Present);
+  uint32_t last = 4000 + PRESENCE.leaveSilenceMs + 5000;
+  d.idle(last + 120000);
+  TEST_ASSERT_TRUE(d.ps.state == Presence::Absent);
+  TEST_ASSERT_EQUAL(2, d.events.size());
+  TEST_ASSERT_EQUAL(last + PRESENCE.leaveSilenceMs + PRESENCE.exitDwellMs,
+                    d.events[1].first);
+  // Back after leaving: a new arrival
+  for (uint32_t t = last + 200000; t <= last + 205000; t += 500)
+    d.hear(t, -65);
+  TEST_ASSERT_EQUAL(3, d.events.size());
+  TEST_ASSERT_TRUE(d.events[2].second == PresenceEvent::Arrived);
+}
+
+// Sightings at random times and levels, across the millis() wrap: timers
+// at presenceDeadline() see the same events, at the same times, as calling
+// presenceStep() every millisecond.
+static void test_deadlines_match_a_sweep() {
+  uint32_t seed = 12345;
+  auto rnd = [&](uint32_t n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+  };
+  const uint32_t start = 0xFFFFFFFFu - 300000;
+  size_t total = 0;
+  for (int round = 0; round < 20; round++) {
+    Tracked swept, timed;
+    swept.lastSeen = timed.lastSeen = start;
+    uint32_t next = start + rnd(2000);
+    for (uint32_t t = start; t != start + 1200000; t++) {
+      if (t == next) {
+        // Bursts, gaps up to a minute, levels on both sides of both
+        // thresholds
+        int rssi = -60 - (int)rnd(40);
+        timed.idle(t - 1);
+        swept.hear(t, rssi);
+        timed.hear(t, rssi);
+        next = t + 1 + (rnd(4) ? rnd(1500) : rnd(60000));
+      } else {
+        swept.step(t, false);
+      }
+    }
+    timed.idle(start + 1200000 - 1);
+    TEST_ASSERT_EQUAL(swept.events.size(), timed.events.size());
+    TEST_ASSERT_TRUE(swept.events == timed.events);
+    TEST_ASSERT_TRUE(swept.ps.state == timed.ps.state);
+    total += timed.events.size();
+  }
+  TEST_ASSERT_TRUE(total >= 20);
+}
+
+// The firmware: events pushed to a browser, presence in the device list,
+// counters in the stats.
+static void test_firmware_reports_arrivals_and_departures() {
+  const uint64_t VISITOR = 0x9E5E00000001ULL;
+  const uint64_t PASSERBY = 0x9E5E00000002ULL;
+  AsyncEventSourceClient *page = events.connect();
+  runLoop(10);
+  page->take();
+
+  hearAdvert(PASSERBY, -60); // one burst, then gone
+  hearAdvert(PASSERBY, -60);
+  hearAdvert(PASSERBY, -60);
+  for (int i = 0; i < 10; i++) {
+    hearAdvert(VISITOR, -62);
+    runLoop(500);
+  }
+  DynamicJsonDocument list = jsonOf(server.get("/api/devices"));
+  std::string visitorPresence, passerbyPresence;
+  for (JsonObject d : list["devices"].as<JsonArray>()) {
+    if (!strcmp(d["mac"] | "", "9E:5E:00:00:00:01"))
+      visitorPresence = d["presence"] | "";
+    if (!strcmp(d["mac"] | "", "9E:5E:00:00:00:02"))
+      passerbyPresence = d["presence"] | "";
+  }
+  TEST_ASSERT_EQUAL_STRING("present", visitorPresence.c_str());
+  TEST_ASSERT_EQUAL_STRING("candidate", passerbyPresence.c_str());
+
+  // Gone: Leaving after leaveSilenceMs, "left" after exitDwellMs more
+  runLoop(PRESENCE.leaveSilenceMs + PRESENCE.exitDwellMs + 2000);
+  std::vector<std::string> seen;
+  for (auto &e : page->take())
+    if (e.event == "arrived" || e.event == "left")
+      seen.push_back(e.event + " " + e.data.substr(8, 17));
+  events.disconnect(page);
+  TEST_ASSERT_EQUAL(2, seen.size());
+  TEST_ASSERT_EQUAL_STRING("arrived 9E:5E:00:00:00:01", seen[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("left 9E:5E:00:00:00:01", seen[1].c_str());
+
+  DynamicJsonDocument stats = jsonOf(server.get("/api/stats"));
+  TEST_ASSERT_EQUAL(1, stats["presence"]["arrivals"].as<int>());
+  TEST_ASSERT_EQUAL(1, stats["presence"]["departures"].as<int>());
+}
+
+int main() {
+  bootRadar("test_presence");
+  runLoop(10);
+  UNITY_BEGIN();
+  RUN_TEST(test_arrives_after_dwell_when_kept_heard);
+  RUN_TEST(test_burst_does_not_arrive);
+  RUN_TEST(test_weak_device_is_never_candidate);
+  RUN_TEST(test_rssi_hysteresis);
+  RUN_TEST(test_silence_leaves_then_left);
+  RUN_TEST(test_deadlines_match_a_sweep);
+  RUN_TEST(test_firmware_reports_arrivals_and_departures);
+  return UNITY_END();
+}
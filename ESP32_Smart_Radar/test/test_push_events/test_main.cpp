@@ -0,0 +1,201 @@
+// Live push (/api/events): a browser connecting while loop() holds
+// StateLock is not held up, Last-Event-ID resumes, and browsers coming and
+// going on the AsyncTCP task while the radio and loop() run never deadlock.
+// `pio test -e native`
+#include "../radar_harness.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+static bool waitFor(std::atomic<bool> &flag, int ms) {
+  for (int i = 0; i < ms && !flag; i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  return flag;
+}
+
+// What a browser would make of its events: the first cursor event, the
+// last sync id, and whether deltas came before a fresh page resynced.
+struct Stream {
+  std::string first;
+  uint32_t lastSync = 0;
+  bool ordered = true;
+
+  void feed(const std::vector<AsyncEventSourceClient::Event> &events,
+            bool fresh) {
+    for (auto &e : events) {
+      bool cursor = e.event == "resync" || e.event == "sync";
+      bool delta = e.event == "upsert" || e.event == "expire";
+      if (first.empty() && (cursor || delta)) {
+        first = e.event;
+        if (fresh && first != "resync")
+          ordered = false;
+      }
+      if (e.event == "sync") {
+        if (e.id < lastSync)
+          ordered = false;
+        lastSync = e.id;
+      }
+    }
+  }
+};
+
+static void test_connect_does_not_wait_for_state_lock() {
+  std::atomic<bool> returned{false};
+  AsyncEventSourceClient *client = nullptr;
+  std::thread tcp;
+  bool inTime;
+  {
+    StateLock lock; // loop() in the middle of a pass
+    tcp = std::thread([&] {
+      client = events.connect();
+      returned = true;
+    });
+    inTime = waitFor(returned, 2000);
+  }
+  tcp.join();
+  TEST_ASSERT_TRUE(inTime);
+  runLoop(PUSH_INTERVAL_MS + 10);
+  Stream s;
+  s.feed(client->take(), true);
+  TEST_ASSERT_EQUAL_STRING("resync", s.first.c_str());
+  TEST_ASSERT_TRUE(s.ordered);
+  events.disconnect(client);
+}
+
+static void test_last_event_id_resumes() {
+  AsyncEventSourceClient *page = events.connect();
+  runLoop(10);
+  hearAdvert(0xABCDEF000001ULL, -60);
+  runLoop(PUSH_INTERVAL_MS + 10);
+  Stream s;
+  s.feed(page->take(), true);
+  TEST_ASSERT_TRUE(s.lastSync > 0);
+  events.disconnect(page);
+
+  hearAdvert(0xABCDEF000002ULL, -60);
+  runLoop(10);
+  AsyncEventSourceClient *back = events.connect(s.lastSync);
+  runLoop(PUSH_INTERVAL_MS + 10);
+  std::vector<AsyncEventSourceClient::Event> got = back->take();
+  bool resync = false, upsert = false;
+  for (auto &e : got) {
+    resync |= e.event == "resync";
+    upsert |= e.event == "upsert" &&
+              e.data.find("AB:CD:EF:00:00:02") != std::string::npos;
+  }
+  TEST_ASSERT_FALSE(resync);
+  TEST_ASSERT_TRUE(upsert);
+  events.disconnect(back);
+
+  AsyncEventSourceClient *stale = events.connect(0xFFFFFF);
+  runLoop(PUSH_INTERVAL_MS + 10);
+  Stream t;
+  t.feed(stale->take(), false);
+  TEST_ASSERT_EQUAL_STRING("resync", t.first.c_str());
+  events.disconnect(stale);
+}
+
+// Three tasks as on the board: the radio hears a crowd arriving and
+// leaving, AsyncTCP connects and drops browsers (half of them resuming),
+// loop() applies and pushes. A watchdog ends the run if neither loop() nor
+// AsyncTCP makes progress for 5 s.
+static void test_connect_churn_under_load() {
+  std::atomic<bool> stop{false};
+  std::atomic<uint32_t> loopPasses{0}, connects{0}, badStreams{0};
+
+  std::thread watchdog([&] {
+    uint32_t lastLoop = 0, lastConnects = 0;
+    int idle = 0;
+    while (!stop) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      uint32_t l = loopPasses, c = connects;
+      idle = (l == lastLoop && c == lastConnects) ? idle + 1 : 0;
+      lastLoop = l;
+      lastConnects = c;
+      if (idle >= 50) {
+        printf("deadlock: loop() at %u passes, %u connects\n", (unsigned)l,
+               (unsigned)c);
+        fflush(stdout);
+        std::_Exit(1);
+      }
+    }
+  });
+
+  std::thread radio([&] {
+    for (uint32_t i = 0; !stop; i++) {
+      hearAdvert(0x7E57000000ULL + (i % 120), -60 - (int)(i % 25));
+      if (i % 64 == 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+  });
+
+  std::thread tcp([&] {
+    struct Page {
+      AsyncEventSourceClient *client;
+      bool fresh;
+      Stream stream;
+    };
+    std::vector<Page> pages;
+    uint32_t resumeFrom = 0;
+    for (uint32_t i = 0; !stop; i++) {
+      bool fresh = i % 2 == 0 || resumeFrom == 0;
+      pages.push_back({events.connect(fresh ? 0 : resumeFrom), fresh, {}});
+      connects++;
+      for (Page &p : pages)
+        p.stream.feed(p.client->take(), p.fresh);
+      if (pages.size() > 6) {
+        Page &p = pages[i % pages.size()];
+        badStreams += !p.stream.ordered;
+        if (p.stream.lastSync)
+          resumeFrom = p.stream.lastSync;
+        events.disconnect(p.client);
+        pages.erase(pages.begin() + (i % pages.size()));
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(300));
+    }
+    for (Page &p : pages) {
+      p.stream.feed(p.client->take(), p.fresh);
+      badStreams += !p.stream.ordered;
+      events.disconnect(p.client);
+    }
+  });
+
+  for (int pass = 0; pass < 40000; pass++) {
+    loop();
+    loopPasses++;
+    if (pass % 16 == 0)
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  stop = true;
+  radio.join();
+  tcp.join();
+  watchdog.join();
+
+  size_t tracked;
+  {
+    StateLock lock;
+    xSemaphoreTake(pushLock, portMAX_DELAY);
+    tracked = pushClients.size();
+    xSemaphoreGive(pushLock);
+  }
+  printf("push churn: %u loop passes, %u connects\n",
+         (unsigned)loopPasses.load(), (unsigned)connects.load());
+  TEST_ASSERT_TRUE(connects > 100);
+  TEST_ASSERT_EQUAL(0, badStreams.load());
+  TEST_ASSERT_EQUAL(0, tracked);
+  TEST_ASSERT_EQUAL(0, events.count());
+}
+
+int main() {
+  bootRadar("test_push_events");
+  runLoop(10);
+  UNITY_BEGIN();
+  RUN_TEST(test_connect_does_not_wait_for_state_lock);
+  RUN_TEST(test_last_event_id_resumes);
+  RUN_TEST(test_connect_churn_under_load);
+  return UNITY_END();
+}
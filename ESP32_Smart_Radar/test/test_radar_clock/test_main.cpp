@@ -0,0 +1,122 @@
+// RadarClock (src/radar_clock.h) on its own, with injected sources and no
+// Arduino: live and virtual time, monotonic across modes, the virtual wall
+// clock, and ms() read from another thread while the modes switch.
+// `pio test -e native`
+#include "radar_clock.h"
+#include <thread>
+#include <unity.h>
+
+static std::atomic<uint32_t> fakeMillis{0};
+static time_t fakeEpoch = 0;
+static uint32_t readMillis() { return fakeMillis.load(); }
+static time_t readEpoch() { return fakeEpoch; }
+
+void setUp() {
+  fakeMillis = 5000;
+  fakeEpoch = 1700000000;
+}
+void tearDown() {}
+
+static void test_live_follows_the_sources() {
+  RadarClock clock(readMillis, readEpoch);
+  TEST_ASSERT_FALSE(clock.isVirtual());
+  TEST_ASSERT_EQUAL(5000, clock.ms());
+  fakeMillis += 250;
+  fakeEpoch += 1;
+  TEST_ASSERT_EQUAL(5250, clock.ms());
+  TEST_ASSERT_EQUAL(1700000001, clock.epoch());
+}
+
+static void test_virtual_time_moves_only_when_advanced() {
+  RadarClock clock(readMillis, readEpoch);
+  clock.startVirtual();
+  TEST_ASSERT_TRUE(clock.isVirtual());
+  fakeMillis += 10000; // real time passes, radar time does not
+  TEST_ASSERT_EQUAL(5000, clock.ms());
+  clock.advanceTo(5000 + 3600000);
+  clock.advanceTo(6000); // never backward
+  TEST_ASSERT_EQUAL(5000 + 3600000, clock.ms());
+  // The wall clock follows, from the time the run started
+  TEST_ASSERT_EQUAL(1700000000 + 3600, clock.epoch());
+}
+
+static void test_monotonic_after_a_virtual_run() {
+  RadarClock clock(readMillis, readEpoch);
+  clock.startVirtual();
+  clock.advanceTo(5000 + 86400000u); // a day
+  clock.stopVirtual();
+  clock.stopVirtual(); // twice is harmless
+  TEST_ASSERT_FALSE(clock.isVirtual());
+  TEST_ASSERT_EQUAL(5000 + 86400000u, clock.ms());
+  fakeMillis += 40;
+  TEST_ASSERT_EQUAL(5000 + 86400000u + 40, clock.ms());
+  TEST_ASSERT_EQUAL(fakeEpoch, clock.epoch());
+  // A second run starts from there
+  clock.startVirtual();
+  TEST_ASSERT_EQUAL(5000 + 86400000u + 40, clock.ms());
+}
+
+static void test_no_ntp_keeps_the_wall_clock_unset() {
+  fakeEpoch = 12; // time() before NTP
+  RadarClock clock(readMillis, readEpoch);
+  clock.startVirtual();
+  clock.advanceTo(100000);
+  TEST_ASSERT_EQUAL(0, clock.epoch());
+}
+
+static void test_across_the_millis_wrap() {
+  fakeMillis = 0xFFFFFFFFu - 500;
+  RadarClock clock(readMillis, readEpoch);
+  clock.startVirtual();
+  clock.advanceTo(clock.ms() + 2000);
+  TEST_ASSERT_EQUAL(1499, clock.ms());
+  clock.advanceTo(0xFFFFFFFFu - 100); // behind, across the wrap
+  TEST_ASSERT_EQUAL(1499, clock.ms());
+  clock.stopVirtual();
+  fakeMillis += 1;
+  TEST_ASSERT_EQUAL(1500, clock.ms());
+}
+
+// The NimBLE task stamps adverts with ms() while loop() runs virtual
+// sessions: with the source still during each switch, every value read is
+// one the clock really had, and reads never go backward.
+static void test_ms_read_while_modes_switch() {
+  RadarClock clock(readMillis, readEpoch);
+  std::atomic<bool> done{false};
+  std::atomic<uint32_t> reads{0};
+  uint32_t backwards = 0;
+  std::thread reader([&] {
+    uint32_t last = clock.ms();
+    while (!done.load()) {
+      uint32_t now = clock.ms();
+      backwards += (int32_t)(now - last) < 0;
+      last = now;
+      reads++;
+    }
+  });
+  while (reads.load() == 0)
+    std::this_thread::yield();
+  uint32_t runs = 0;
+  for (; runs < 20000 || reads.load() < 1000000; runs++) {
+    clock.startVirtual();
+    for (int step = 0; step < 10; step++)
+      clock.advanceTo(clock.ms() + 250);
+    clock.stopVirtual();
+    fakeMillis += 3;
+  }
+  done = true;
+  reader.join();
+  TEST_ASSERT_EQUAL(0, backwards);
+  TEST_ASSERT_EQUAL(5000 + runs * (2500 + 3), clock.ms());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_live_follows_the_sources);
+  RUN_TEST(test_virtual_time_moves_only_when_advanced);
+  RUN_TEST(test_monotonic_after_a_virtual_run);
+  RUN_TEST(test_no_ntp_keeps_the_wall_clock_unset);
+  RUN_TEST(test_across_the_millis_wrap);
+  RUN_TEST(test_ms_read_while_modes_switch);
+  return UNITY_END();
+}
@@ -0,0 +1,178 @@
+// RssiFilter and rssiDistanceM (src/rssi_filter.h) on RSSI traces written
+// out with the features of what the radar hears: fading, single-packet
+// reflections, body shadowing, a walk away, a device hovering at a
+// threshold.
+// `pio test -e native`
+#include <rssi_filter.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+// A phone on a desk about 2 m away: -62 dB with +-3 dB fading, a
+// reflection now and then (one packet ~12 dB hotter) and a body passing
+// (one or two packets ~15 dB lower).
+static const int8_t DESK[] = {
+    -62, -61, -64, -60, -63, -62, -50, -61, -63, -65, -62, -59, -62, -77,
+    -63, -61, -62, -64, -61, -60, -63, -62, -78, -79, -62, -61, -63, -64,
+    -62, -60, -49, -62, -63, -61, -62, -65, -62, -61, -60, -62, -63, -61,
+    -64, -62, -76, -62, -61, -63, -62, -60, -62, -61, -51, -63, -62, -64,
+    -61, -62, -63, -60};
+
+// Hovering around -90 dB: the raw samples cross any threshold there on
+// most packets.
+static const int8_t THRESHOLD[] = {
+    -88, -92, -89, -91, -87, -93, -90, -88, -92, -89, -91, -90, -86, -92,
+    -89, -91, -88, -93, -90, -89, -91, -88, -92, -90, -87, -91, -89, -92,
+    -88, -90, -91, -89, -93, -88, -90, -92, -89, -87, -91, -90};
+
+template <size_t N> static RssiFilter feed(const int8_t (&trace)[N]) {
+  RssiFilter f = {};
+  for (int8_t s : trace)
+    f.add(s);
+  return f;
+}
+
+static void test_fits_in_the_device_record() {
+  TEST_ASSERT_EQUAL(8, sizeof(RssiFilter));
+  RssiFilter f = {}; // zero-initialized: no sample yet
+  TEST_ASSERT_FALSE(f.ready());
+  f.add(-70);
+  f.add(-70);
+  TEST_ASSERT_FALSE(f.ready());
+  f.add(-70);
+  TEST_ASSERT_TRUE(f.ready());
+  TEST_ASSERT_EQUAL(-70, f.level());
+  TEST_ASSERT_EQUAL(-700, f.levelTenths());
+  TEST_ASSERT_EQUAL(0, f.varianceTenths());
+}
+
+static void test_single_packet_outliers_are_rejected() {
+  RssiFilter f = {};
+  for (int i = 0; i < 20; i++)
+    f.add(-60);
+  f.add(-90); // one packet on a faded channel
+  f.add(-60);
+  f.add(-35); // one reflection
+  f.add(-60);
+  TEST_ASSERT_EQUAL(-600, f.levelTenths());
+  TEST_ASSERT_EQUAL(0, f.varianceTenths());
+  // Two in a row are a change, not an outlier, and get through
+  f.add(-80);
+  f.add(-80);
+  TEST_ASSERT_TRUE(f.level() < -60);
+}
+
+static void test_desk_trace_level_and_variance() {
+  long sum = 0;
+  int rawWorst = 0, smoothWorst = 0;
+  RssiFilter f = {};
+  for (size_t i = 0; i < sizeof(DESK); i++) {
+    f.add(DESK[i]);
+    sum += DESK[i];
+    if (i >= RssiFilter::READY_SAMPLES) {
+      rawWorst = std::max(rawWorst, abs(DESK[i] + 62));
+      smoothWorst = std::max(smoothWorst, abs(f.level() + 62));
+    }
+  }
+  printf("desk trace: raw mean %.1f dB, level %.1f dB, variance %.1f dB^2, "
+         "worst deviation raw %d dB, smoothed %d dB\n",
+         (double)sum / sizeof(DESK), f.levelTenths() / 10.0,
+         f.varianceTenths() / 10.0, rawWorst, smoothWorst);
+  // Single packets are gone; the shadowing pair gets through the median
+  // and is spread by the EMA
+  TEST_ASSERT_TRUE(rawWorst >= 15);
+  TEST_ASSERT_TRUE(2 * smoothWorst <= rawWorst);
+  TEST_ASSERT_TRUE(abs(f.level() + 62) <= 1);
+  // The fading stays in the variance, the outliers do not
+  TEST_ASSERT_TRUE(f.varianceTenths() > 0 && f.varianceTenths() < 60);
+}
+
+static void test_threshold_crossings_are_damped() {
+  int rawCrossings = 0, smoothCrossings = 0;
+  bool rawAbove = THRESHOLD[0] > -90, smoothAbove = rawAbove;
+  RssiFilter f = {};
+  for (int8_t s : THRESHOLD) {
+    f.add(s);
+    bool r = s > -90, m = f.levelTenths() > -900;
+    rawCrossings += r != rawAbove;
+    smoothCrossings += f.ready() && m != smoothAbove;
+    rawAbove = r;
+    if (f.ready())
+      smoothAbove = m;
+  }
+  printf("threshold trace: %d raw crossings of -90 dB, %d smoothed\n",
+         rawCrossings, smoothCrossings);
+  // The filter alone halves them at least; the enter/exit hysteresis of
+  // presence.h does the rest
+  TEST_ASSERT_TRUE(rawCrossings >= 20);
+  TEST_ASSERT_TRUE(2 * smoothCrossings < rawCrossings);
+}
+
+static void test_walk_away_is_followed() {
+  // From 1 m to ~15 m in a minute, one packet per second, +-2 dB fading
+  RssiFilter f = {};
+  int worstLag = 0;
+  for (int i = 0; i < 60; i++) {
+    int truth = -55 - i / 2;
+    f.add((int8_t)(truth + ((i * 7) % 5) - 2));
+    if (i >= 10)
+      worstLag = std::max(worstLag, abs(f.level() - truth));
+  }
+  TEST_ASSERT_TRUE(worstLag <= 4);
+  // A step settles within 1 dB in about a dozen packets
+  RssiFilter g = {};
+  for (int i = 0; i < 10; i++)
+    g.add(-80);
+  int n = 0;
+  while (g.level() < -51 && n < 50) {
+    g.add(-50);
+    n++;
+  }
+  TEST_ASSERT_TRUE(n <= 14);
+}
+
+static void test_extremes_do_not_overflow() {
+  RssiFilter f = {};
+  for (int i = 0; i < 1000; i++)
+    f.add(i % 4 < 2 ? -127 : 0); // pairs get through the median
+  TEST_ASSERT_TRUE(f.level() >= -127 && f.level() <= 0);
+  TEST_ASSERT_TRUE(f.varianceTenths() > 0);
+  TEST_ASSERT_TRUE(f.var <= 0xFFFF);
+  for (int i = 0; i < 300; i++)
+    f.add(-40);
+  TEST_ASSERT_EQUAL(-40, f.level());
+  TEST_ASSERT_EQUAL(255, f.samples);
+}
+
+static void test_distance_from_tx_power() {
+  // TX power is the level at 0 m, 41 dB above the level at 1 m
+  TEST_ASSERT_TRUE(fabsf(rssiDistanceM(-45, -4) - 1.0f) < 0.01f);
+  // 25 dB more path loss is a decade with an exponent of 2.5
+  TEST_ASSERT_TRUE(fabsf(rssiDistanceM(-70, -4) - 10.0f) < 0.05f);
+  TEST_ASSERT_TRUE(rssiDistanceM(-30, -4) < 1.0f);
+  float prev = 0;
+  for (int rssi = -30; rssi >= -100; rssi--) {
+    float d = rssiDistanceM(rssi, -4);
+    TEST_ASSERT_TRUE(d > prev);
+    prev = d;
+  }
+  // The desk phone, advertising -4 dBm at 0 m: about 2 m
+  RssiFilter f = feed(DESK);
+  float d = rssiDistanceM(f.levelTenths() / 10.0f, -4 - 8);
+  TEST_ASSERT_TRUE(d > 1.0f && d < 3.0f);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fits_in_the_device_record);
+  RUN_TEST(test_single_packet_outliers_are_rejected);
+  RUN_TEST(test_desk_trace_level_and_variance);
+  RUN_TEST(test_threshold_crossings_are_damped);
+  RUN_TEST(test_walk_away_is_followed);
+  RUN_TEST(test_extremes_do_not_overflow);
+  RUN_TEST(test_distance_from_tx_power);
+  return UNITY_END();
+}
@@ -0,0 +1,114 @@
+// A day of crowd on the host, in virtual time: the firmware run as a
+// discrete-event simulation (crowd_sim.h through onResult(), the ring and
+// the timer wheel), in seconds. Everyone who arrived has left by the end,
+// what the radar keeps stays bounded by its tables, and the radar clock
+// carries on from the day it simulated.
+// `pio test -e native`
+#define RADAR_CROWD_SIM
+#include "../radar_harness.h"
+#include <chrono>
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+static const uint32_t DAY_MS = 86400000;
+
+static void test_a_day_of_crowd() {
+  server.post("/api/surveillance/toggle");
+  TEST_ASSERT_TRUE(surveillanceActive);
+  runLoop(10);
+  uint32_t start = radarClock.ms();
+  uint32_t dropped = bleEvents.dropped;
+  uint32_t onResults = hpOnResult.count;
+  // ~40 visitors at a time, 10 minutes each, and two beacons rotating their
+  // address every 15 minutes
+  TEST_ASSERT_EQUAL(200, server.post("/api/sim/crowd", {{"rate", "4"},
+                                                        {"stay", "600"},
+                                                        {"advMs", "1000"},
+                                                        {"beacons", "2"},
+                                                        {"rotate", "900"},
+                                                        {"duration", "86400"},
+                                                        {"speed", "0"},
+                                                        {"seed", "24"}})
+                             .code);
+  auto wallStart = std::chrono::steady_clock::now();
+  size_t peakAlerted = 0, peakTimers = 0;
+  for (int i = 0; i < 1000000 && replayReport.running; i++) {
+    loop();
+    StateLock lock;
+    peakAlerted = std::max(peakAlerted, alertedMacs.size());
+    peakTimers = std::max(peakTimers, deviceTimers.size());
+  }
+  double wallSec = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - wallStart)
+                       .count();
+
+  DynamicJsonDocument trace = jsonOf(server.get("/api/trace"));
+  JsonObject rp = trace["replay"];
+  JsonObject cs = trace["crowd"];
+  printf("day: %u adverts, %u arrived, %u left, %u alerts, %u evictions, "
+         "%u NVS writes, %u lastSeen bytes, peak %u devices / %u alerted / "
+         "%u timers, %.2f s wall\n",
+         rp["adverts"].as<unsigned>(), rp["arrivals"].as<unsigned>(),
+         rp["departures"].as<unsigned>(), rp["alerts"].as<unsigned>(),
+         rp["evictions"].as<unsigned>(), rp["nvsWrites"].as<unsigned>(),
+         rp["lastSeenBytes"].as<unsigned>(), rp["peakDevices"].as<unsigned>(),
+         (unsigned)peakAlerted, (unsigned)peakTimers, wallSec);
+  TEST_ASSERT_FALSE(rp["running"].as<bool>());
+  TEST_ASSERT_TRUE(rp["simulatedMs"].as<uint32_t>() >= DAY_MS);
+  TEST_ASSERT_TRUE(wallSec < 120);
+
+  // Every advert went through the radio path, none dropped
+  uint32_t adverts = rp["adverts"];
+  TEST_ASSERT_TRUE(adverts > 1000000);
+  TEST_ASSERT_EQUAL(cs["adverts"].as<uint32_t>(), adverts);
+  TEST_ASSERT_EQUAL(adverts, hpOnResult.count - onResults);
+  TEST_ASSERT_EQUAL(dropped, bleEvents.dropped);
+
+  // A day of arrivals, all gone by the end
+  uint32_t arrivals = rp["arrivals"];
+  TEST_ASSERT_TRUE(arrivals > 5000);
+  TEST_ASSERT_EQUAL(arrivals, rp["departures"].as<uint32_t>());
+  TEST_ASSERT_TRUE(rp["alerts"].as<uint32_t>() > 0);
+
+  // Bounded by the table, not by the day
+  TEST_ASSERT_TRUE(rp["peakDevices"].as<uint32_t>() <= MAX_DEVICES);
+  TEST_ASSERT_TRUE(peakAlerted <= MAX_DEVICES);
+  TEST_ASSERT_TRUE(peakTimers <= MAX_DEVICES * TIMER_KINDS);
+  TEST_ASSERT_TRUE(rp["heapMin"].as<uint32_t>() > 0);
+  // Strangers are never written to NVS, and the report keeps the first
+  // events only
+  TEST_ASSERT_EQUAL(0, rp["nvsWrites"].as<uint32_t>());
+  TEST_ASSERT_EQUAL(TRACE_TIMELINE_MAX, rp["timeline"].as<JsonArray>().size());
+  TEST_ASSERT_EQUAL(rp["timelineDropped"].as<uint32_t>() + TRACE_TIMELINE_MAX,
+                    arrivals + rp["departures"].as<uint32_t>() +
+                        rp["alerts"].as<uint32_t>());
+  // Nothing left behind once the day's devices are forgotten
+  size_t devices, alerted, timers;
+  {
+    StateLock lock;
+    devices = detectedDevices.size();
+    alerted = alertedMacs.size();
+    timers = deviceTimers.size();
+  }
+  TEST_ASSERT_EQUAL(0, devices);
+  TEST_ASSERT_EQUAL(0, alerted);
+  TEST_ASSERT_EQUAL(0, timers);
+
+  // Back to real time, a day later, and moving with millis()
+  TEST_ASSERT_FALSE(radarClock.isVirtual());
+  uint32_t after = radarClock.ms();
+  TEST_ASSERT_TRUE(after - start >= DAY_MS);
+  runLoop(100);
+  TEST_ASSERT_EQUAL(after + 100, radarClock.ms());
+  server.post("/api/surveillance/toggle");
+}
+
+int main() {
+  bootRadar("test_simulated_day");
+  runLoop(10);
+  UNITY_BEGIN();
+  RUN_TEST(test_a_day_of_crowd);
+  return UNITY_END();
+}
@@ -0,0 +1,173 @@
+// Advert traces end to end: a scripted scene is recorded through the fake
+// radio, the SpscRing and loop(), downloaded from /api/trace/download, and
+// replayed in virtual time. The replay must see every advert that was
+// heard and produce the arrivals and departures of the live run, at the
+// same radar times give or take a timer tick, the same way every time.
+// `pio test -e native`
+#include "../radar_harness.h"
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+static const uint32_t STEP_MS = 100;
+static const uint32_t SCENE_MS = 45000;
+static const uint64_t VISITOR = 0x7AC0FFEE0001ULL; // 1 s .. 20 s
+static const uint64_t LATECOMER = 0x7AC0FFEE0002ULL; // 10 s .. 40 s
+static const uint64_t BURST = 0x7AC0FFEE0003ULL;     // three adverts at 5 s
+static const uint64_t FAR = 0x7AC0FFEE0004ULL;       // all along, too weak
+
+struct SceneEvent {
+  uint32_t ms; // since the recording (or the replay) started
+  std::string mac;
+  std::string event;
+};
+
+static uint32_t heard;
+static std::vector<SceneEvent> live;
+static std::string recordedTrace;
+
+// "arrived" / "left" pushed to a page since the last call, stamped `ms`.
+static void collect(AsyncEventSourceClient *page, uint32_t ms) {
+  for (auto &e : page->take())
+    if (e.event == "arrived" || e.event == "left")
+      live.push_back({ms, e.data.substr(8, 17), e.event});
+}
+
+// Not connectable: no GATT connection opens a gap in the scan, so the
+// live run hears the whole scene.
+static void hear(uint64_t mac, int rssi) {
+  heard += hearAdvert(mac, rssi, advertPayload("Replay"), BLE_ADDR_PUBLIC,
+                      false);
+}
+
+static void test_download_before_recording() {
+  TEST_ASSERT_EQUAL(404, server.get("/api/trace/download").code);
+  TEST_ASSERT_EQUAL(404, server.post("/api/trace/replay").code);
+}
+
+// The scene, live: adverts on the radio, loop() every millisecond, events
+// read every STEP_MS. Then two more minutes for the departures.
+static void test_record_live_scene() {
+  AsyncEventSourceClient *page = events.connect();
+  runLoop(10);
+  page->take();
+  TEST_ASSERT_EQUAL(200, server.post("/api/trace/record").code);
+  uint32_t start = radarClock.ms();
+  // Not while recording: the file is still open
+  TEST_ASSERT_EQUAL(409, server.get("/api/trace/download").code);
+  for (uint32_t t = 0; t < SCENE_MS; t += STEP_MS) {
+    if (t >= 1000 && t <= 20000 && t % 500 == 0)
+      hear(VISITOR, -60);
+    if (t >= 10000 && t <= 40000 && t % 700 == 0)
+      hear(LATECOMER, -66);
+    if (t == 5000 || t == 5100 || t == 5200)
+      hear(BURST, -55);
+    if (t % 1000 == 300)
+      hear(FAR, PRESENCE.enterDbm - 4);
+    runLoop(STEP_MS);
+    collect(page, radarClock.ms() - start);
+  }
+  TEST_ASSERT_EQUAL(200, server.post("/api/trace/stop").code);
+  for (uint32_t t = 0; t < DEVICE_RETAIN_MS; t += STEP_MS) {
+    runLoop(STEP_MS);
+    collect(page, radarClock.ms() - start);
+  }
+  events.disconnect(page);
+
+  DynamicJsonDocument trace = jsonOf(server.get("/api/trace"));
+  TEST_ASSERT_FALSE(trace["record"]["active"].as<bool>());
+  TEST_ASSERT_EQUAL(heard, trace["record"]["records"].as<uint32_t>());
+  uint32_t bytes = trace["record"]["bytes"];
+  // Two arrivals, two departures; the burst and the far device never arrive
+  TEST_ASSERT_EQUAL(4, live.size());
+  TEST_ASSERT_EQUAL_STRING("arrived", live[0].event.c_str());
+  TEST_ASSERT_EQUAL_STRING("7A:C0:FF:EE:00:01", live[0].mac.c_str());
+
+  NativeHttpResponse r = server.get("/api/trace/download");
+  TEST_ASSERT_EQUAL(200, r.code);
+  TEST_ASSERT_TRUE(r.download);
+  TEST_ASSERT_EQUAL_STRING("application/octet-stream", r.contentType.c_str());
+  TEST_ASSERT_EQUAL(bytes, r.body.size());
+  TEST_ASSERT_EQUAL(0, r.body.compare(0, 4, "BTR1"));
+  recordedTrace = r.body;
+}
+
+// Replays the trace in virtual time; returns the report.
+static DynamicJsonDocument replayVirtual() {
+  TEST_ASSERT_EQUAL(200,
+                    server.post("/api/trace/replay", {{"speed", "0"}}).code);
+  for (int i = 0; i < 100000 && replayReport.running; i++)
+    loop();
+  DynamicJsonDocument trace = jsonOf(server.get("/api/trace"));
+  TEST_ASSERT_FALSE(trace["replay"]["running"].as<bool>());
+  return trace;
+}
+
+static void test_virtual_replay_matches_live() {
+  DynamicJsonDocument trace = replayVirtual();
+  JsonObject rp = trace["replay"];
+  TEST_ASSERT_EQUAL(heard, rp["adverts"].as<uint32_t>());
+  TEST_ASSERT_EQUAL(2, rp["arrivals"].as<int>());
+  TEST_ASSERT_EQUAL(2, rp["departures"].as<int>());
+  // Hours would replay in seconds: the radar clock ran ahead of the wall
+  uint32_t simulatedMs = rp["simulatedMs"];
+  uint32_t durationMs = rp["durationMs"];
+  TEST_ASSERT_TRUE(simulatedMs >= SCENE_MS - 5000 + DEVICE_RETAIN_MS);
+  TEST_ASSERT_TRUE(simulatedMs > 10 * durationMs);
+
+  JsonArray tl = rp["timeline"];
+  TEST_ASSERT_EQUAL(live.size(), tl.size());
+  size_t i = 0;
+  for (JsonObject e : tl) {
+    const SceneEvent &l = live[i++];
+    TEST_ASSERT_EQUAL_STRING(l.event.c_str(), e["event"] | "");
+    TEST_ASSERT_EQUAL_STRING(l.mac.c_str(), e["mac"] | "");
+    // Live events were read every STEP_MS; timers fire within a tick
+    int32_t skew = (int32_t)(e["ms"].as<uint32_t>() - l.ms);
+    TEST_ASSERT_TRUE(abs(skew) <= (int32_t)(STEP_MS + 250));
+  }
+}
+
+static void test_replay_is_deterministic() {
+  DynamicJsonDocument first = replayVirtual();
+  DynamicJsonDocument second = replayVirtual();
+  std::string a, b;
+  serializeJson(first["replay"]["timeline"], a);
+  serializeJson(second["replay"]["timeline"], b);
+  TEST_ASSERT_TRUE(a.size() > 2);
+  TEST_ASSERT_EQUAL_STRING(a.c_str(), b.c_str());
+  // The trace on flash is read, not rewritten
+  TEST_ASSERT_TRUE(server.get("/api/trace/download").body == recordedTrace);
+}
+
+// The radio is muted while a trace plays, and the replay's devices are the
+// trace's only.
+static void test_radio_muted_during_replay() {
+  const uint64_t INTRUDER = 0x7AC0FFEE0099ULL;
+  TEST_ASSERT_EQUAL(200,
+                    server.post("/api/trace/replay", {{"speed", "1"}}).code);
+  for (int i = 0; i < 50; i++) {
+    hearAdvert(INTRUDER, -50);
+    runLoop(100);
+  }
+  DynamicJsonDocument list = jsonOf(server.get("/api/devices"));
+  TEST_ASSERT_FALSE(listedIn(list["devices"], "7A:C0:FF:EE:00:99"));
+  TEST_ASSERT_TRUE(listedIn(list["devices"], "7A:C0:FF:EE:00:01"));
+  TEST_ASSERT_EQUAL(200, server.post("/api/trace/stop").code);
+  runLoop(10);
+  TEST_ASSERT_FALSE(replayReport.running);
+  TEST_ASSERT_FALSE(radarClock.isVirtual());
+}
+
+int main() {
+  bootRadar("test_trace_replay");
+  runLoop(10);
+  UNITY_BEGIN();
+  RUN_TEST(test_download_before_recording);
+  RUN_TEST(test_record_live_scene);
+  RUN_TEST(test_virtual_replay_matches_live);
+  RUN_TEST(test_replay_is_deterministic);
+  RUN_TEST(test_radio_muted_during_replay);
+  return UNITY_END();
+}
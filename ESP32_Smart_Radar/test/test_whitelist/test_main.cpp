@@ -0,0 +1,248 @@
+// Whitelist at 10, 1,000 and 10,000 entries: /api/whitelist streamed byte
+// for byte like the former ArduinoJson handler, persistence across a
+// reboot, the legacy NVS key, and the import from older NVS formats.
+// `pio test -e native`
+#include "../radar_harness.h"
+#include <unity.h>
+
+static const uint64_t LIVE = 0xA4C1380A0B0CULL;
+
+void setUp() {}
+void tearDown() {}
+
+static uint64_t nthMac(size_t i) { return 0xC0FFEE000000ULL + i * 7919; }
+
+// n entries, metadata on every other one, LIVE first and in the table
+static void fillWhitelist(size_t n) {
+  StateLock lock;
+  whitelist.clear();
+  wlMetaMap.clear();
+  std::vector<uint64_t> macs = {LIVE};
+  for (size_t i = 1; i < n; i++)
+    macs.push_back(nthMac(i));
+  whitelist.assign(macs);
+  for (size_t i = 1; i < n; i += 2) {
+    WlMeta m;
+    m.name = ("Tag \"" + String((unsigned)i) + "\"").c_str();
+    m.vendor = "Vendor\\Co";
+    m.mfgData = "4C000215";
+    wlMetaMap[nthMac(i)] = m;
+  }
+  lastSeen.update(nthMac(1), 1700001234);
+  saveWhitelist();
+  saveWlMeta();
+}
+
+// The former handler, verbatim but for the document size.
+static String referenceJson(size_t n) {
+  StateLock lock;
+  DynamicJsonDocument doc(1024 + n * 512);
+  JsonArray array = doc.to<JsonArray>();
+  for (uint64_t key : whitelist.items()) {
+    char macStr[18];
+    formatMac(key, macStr);
+    JsonObject obj = array.createNestedObject();
+    obj["mac"] = macStr;
+    bool foundLive = false;
+    const BleDeviceData *dev = detectedDevices.find(key);
+    if (dev != nullptr) {
+      char services[BLE_SERVICES_STR_MAX];
+      char mfgHex[2 * BLE_MFG_MAX + 1];
+      formatServices(*dev, services);
+      formatMfgHex(*dev, mfgHex);
+      obj["name"] = String(dev->gattName[0] ? dev->gattName
+                                            : deviceDisplayName(*dev));
+      obj["vendor"] = dev->vendor ? dev->vendor : "N/A";
+      obj["mfgData"] = mfgHex;
+      obj["appearance"] = dev->appearance;
+      obj["battery"] = dev->batteryLevel;
+      obj["services"] = services;
+      obj["addressType"] = addrTypeLabel(dev->addressType);
+      obj["live"] = true;
+      foundLive = true;
+    }
+    auto meta = wlMetaMap.find(key);
+    if (!foundLive && meta != wlMetaMap.end()) {
+      obj["name"] = meta->second.name;
+      obj["vendor"] = meta->second.vendor;
+      obj["mfgData"] = meta->second.mfgData;
+      obj["live"] = false;
+    } else if (!foundLive) {
+      obj["live"] = false;
+    }
+    obj["lastSeen"] = (long)lastSeen.get(key);
+  }
+  String out;
+  serializeJson(doc, out);
+  return out;
+}
+
+// RAM state lost, NVS and LittleFS kept
+static void reboot() {
+  StateLock lock;
+  whitelist.clear();
+  wlMetaMap.clear();
+  loadWhitelist();
+  loadWlMeta();
+}
+
+static void checkSize(size_t n) {
+  fillWhitelist(n);
+  NativeHttpResponse r = server.get("/api/whitelist");
+  TEST_ASSERT_EQUAL(200, r.code);
+  TEST_ASSERT_TRUE(r.chunks > 0);
+  String expected = referenceJson(n);
+  TEST_ASSERT_EQUAL(expected.length(), r.body.size());
+  TEST_ASSERT_TRUE(r.body == expected.c_str());
+
+  MacSet::Items items = whitelist.items();
+  std::vector<uint64_t> before(items.begin(), items.end());
+  std::map<uint64_t, WlMeta> metaBefore = wlMetaMap;
+  reboot();
+  TEST_ASSERT_TRUE(std::equal(before.begin(), before.end(), items.begin()) &&
+                   items.size() == before.size());
+  TEST_ASSERT_EQUAL(metaBefore.size(), wlMetaMap.size());
+  for (auto &kv : metaBefore) {
+    TEST_ASSERT_EQUAL_STRING(kv.second.name.c_str(),
+                             wlMetaMap[kv.first].name.c_str());
+    TEST_ASSERT_EQUAL_STRING(kv.second.mfgData.c_str(),
+                             wlMetaMap[kv.first].mfgData.c_str());
+  }
+  TEST_ASSERT_TRUE(server.get("/api/whitelist").body == expected.c_str());
+
+  // Older firmware reads NVS "whitelist": the first entries, never none
+  Preferences prefs;
+  prefs.begin("radar", true);
+  String legacy = prefs.getString("whitelist", "");
+  bool wlbin = prefs.isKey("wlbin");
+  prefs.end();
+  TEST_ASSERT_FALSE(wlbin);
+  TEST_ASSERT_TRUE(legacy.length() <= NVS_STR_MAX);
+  DynamicJsonDocument doc(64 * 1024);
+  TEST_ASSERT_FALSE(deserializeJson(doc, legacy.c_str()));
+  JsonArray arr = doc.as<JsonArray>();
+  TEST_ASSERT_EQUAL(std::min(n, (NVS_STR_MAX - 2) / WL_JSON_ENTRY),
+                    arr.size());
+  for (size_t i = 0; i < arr.size(); i++) {
+    uint64_t mac;
+    TEST_ASSERT_TRUE(parseMac(arr[i].as<const char *>(), mac));
+    TEST_ASSERT_EQUAL_UINT64(before[i], mac);
+  }
+}
+
+static void test_10_entries() { checkSize(10); }
+static void test_1000_entries() { checkSize(1000); }
+static void test_10000_entries() { checkSize(10000); }
+
+// WHITELIST_MAX bounds the RAM (MacSet::BYTES_PER_ENTRY each): a full
+// list refuses new MACs but still takes a known one, and a removal frees a
+// slot without disturbing the order or the lookups.
+static void test_full_whitelist() {
+  fillWhitelist(WHITELIST_MAX);
+  TEST_ASSERT_TRUE(whitelist.full());
+  char macStr[18];
+  formatMac(0x0A0B0C0D0E0FULL, macStr);
+  TEST_ASSERT_EQUAL(507, server.post("/api/whitelist/add", {{"mac", macStr}})
+                             .code);
+  formatMac(nthMac(5), macStr);
+  NativeHttpResponse r = server.post("/api/whitelist/add", {{"mac", macStr}});
+  TEST_ASSERT_EQUAL_STRING("Already in list", r.body.c_str());
+  TEST_ASSERT_EQUAL(200, server.post("/api/whitelist/remove",
+                                     {{"mac", macStr}})
+                             .code);
+  formatMac(0x0A0B0C0D0E0FULL, macStr);
+  TEST_ASSERT_EQUAL(200, server.post("/api/whitelist/add", {{"mac", macStr}})
+                             .code);
+
+  reboot();
+  StateLock lock;
+  MacSet::Items items = whitelist.items();
+  TEST_ASSERT_EQUAL(WHITELIST_MAX, items.size());
+  TEST_ASSERT_EQUAL_UINT64(LIVE, items[0]);
+  TEST_ASSERT_EQUAL_UINT64(nthMac(4), items[4]);
+  TEST_ASSERT_EQUAL_UINT64(nthMac(6), items[5]);
+  TEST_ASSERT_EQUAL_UINT64(0x0A0B0C0D0E0FULL, items[WHITELIST_MAX - 1]);
+  TEST_ASSERT_FALSE(whitelist.contains(nthMac(5)));
+  for (size_t i = 1; i < WHITELIST_MAX; i += 97)
+    TEST_ASSERT_EQUAL(i != 5, whitelist.contains(nthMac(i)));
+}
+
+static void test_empty_whitelist() {
+  {
+    StateLock lock;
+    whitelist.clear();
+    wlMetaMap.clear();
+    saveWhitelist();
+    saveWlMeta();
+  }
+  NativeHttpResponse r = server.get("/api/whitelist");
+  TEST_ASSERT_EQUAL_STRING("[]", r.body.c_str());
+}
+
+// Lists stored by earlier firmware in NVS only: moved to LittleFS once,
+// with documents big enough for all of them.
+static void test_import_from_nvs() {
+  LittleFS.remove(WHITELIST_PATH);
+  LittleFS.remove(WLMETA_PATH);
+  String list = "[", meta = "{";
+  char macStr[18];
+  for (size_t i = 0; i < 150; i++) {
+    formatMac(nthMac(i), macStr);
+    list += String(i ? "," : "") + "\"" + macStr + "\"";
+    if (i < 60)
+      meta += String(i ? "," : "") + "\"" + macStr + "\":{\"n\":\"N" +
+              String((unsigned)i) + "\",\"v\":\"Apple\",\"m\":\"4C\"}";
+  }
+  list += "]";
+  meta += "}";
+  // Fits in an NVS string, but holds more entries than the former 4 KB
+  // document could (~40)
+  TEST_ASSERT_TRUE(meta.length() < NVS_STR_MAX);
+  Preferences prefs;
+  prefs.begin("radar", false);
+  prefs.remove("wlbin");
+  prefs.putString("whitelist", list);
+  prefs.putString("wlmeta", meta);
+  prefs.end();
+
+  reboot();
+  TEST_ASSERT_EQUAL(150, whitelist.size());
+  TEST_ASSERT_EQUAL(60, wlMetaMap.size());
+  TEST_ASSERT_EQUAL_STRING("N59", wlMetaMap[nthMac(59)].name.c_str());
+  TEST_ASSERT_TRUE(LittleFS.exists(WHITELIST_PATH));
+  TEST_ASSERT_TRUE(LittleFS.exists(WLMETA_PATH));
+  prefs.begin("radar", true);
+  TEST_ASSERT_FALSE(prefs.isKey("wlmeta"));
+  TEST_ASSERT_TRUE(prefs.isKey("whitelist"));
+  prefs.end();
+}
+
+static void test_truncated_meta_file_keeps_complete_entries() {
+  fillWhitelist(10);
+  size_t entries = wlMetaMap.size();
+  File f = LittleFS.open(WLMETA_PATH, "r");
+  std::vector<uint8_t> data(f.size());
+  f.read(data.data(), data.size());
+  f.close();
+  f = LittleFS.open(WLMETA_PATH, "w");
+  f.write(data.data(), data.size() - 3);
+  f.close();
+  reboot();
+  TEST_ASSERT_EQUAL(entries - 1, wlMetaMap.size());
+}
+
+int main() {
+  bootRadar("test_whitelist");
+  runLoop(10);
+  hearAdvert(LIVE, -60, advertPayload("Pixel"));
+  runLoop(5);
+  UNITY_BEGIN();
+  RUN_TEST(test_10_entries);
+  RUN_TEST(test_1000_entries);
+  RUN_TEST(test_10000_entries);
+  RUN_TEST(test_full_whitelist);
+  RUN_TEST(test_empty_whitelist);
+  RUN_TEST(test_import_from_nvs);
+  RUN_TEST(test_truncated_meta_file_keeps_complete_entries);
+  return UNITY_END();
+}
@@ -10,8 +10,16 @@ namespace ble_persistent_lists {
 
 static const char *const TAG = "ble_lists";
 static const char *const NVS_NS = "ble_intrusion";
+// Legacy CSV string keys, migrated to the binary blobs on first load
 static const char *const KEY_WL = "wl";
 static const char *const KEY_BL = "bl";
+static const char *const KEY_WL_BLOB = "wl_bin";
+static const char *const KEY_BL_BLOB = "bl_bin";
+
+// Blob layout (version 1), all integers little-endian:
+//   'M' 'L' version reserved | u32 count |
+//   count x { 6-byte MAC (big-endian) | u8 label_len | label bytes }
+static const uint8_t BLOB_VERSION = 1;
 
 std::string BlePersistentListsComponent::normalize_mac(const std::string &mac) {
   std::string out;
@@ -47,274 +55,381 @@ BlePersistentListsComponent::entry_mac_only(const std::string &entry) {
   return mac;
 }
 
-bool BlePersistentListsComponent::list_contains(const std::string &list_csv,
-                                                const std::string &mac) {
-  std::string n = normalize_mac(mac);
-  if (n.empty())
+static std::string sanitize_label(const std::string &label) {
+  std::string out;
+  for (char c : label) {
+    if (c != ',' && c != '|')
+      out += c;
+    if (out.size() == MAX_LABEL_LEN)
+      break;
+  }
+  return out;
+}
+
+bool BlePersistentListsComponent::parse_mac(const std::string &mac,
+                                            uint64_t &out) {
+  uint64_t v = 0;
+  int digits = 0;
+  for (char c : mac) {
+    int n;
+    if (c >= '0' && c <= '9')
+      n = c - '0';
+    else if (c >= 'A' && c <= 'F')
+      n = c - 'A' + 10;
+    else if (c >= 'a' && c <= 'f')
+      n = c - 'a' + 10;
+    else if (c == ':' || c == '-' || c == ' ')
+      continue;
+    else
+      return false;
+    if (digits == 12)
+      return false;
+    v = (v << 4) | (uint64_t)n;
+    digits++;
+  }
+  if (digits != 12)
+    return false;
+  out = v;
+  return true;
+}
+
+std::string BlePersistentListsComponent::format_mac(uint64_t mac) {
+  char buf[18];
+  snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X",
+           (unsigned)(mac >> 40) & 0xFF, (unsigned)(mac >> 32) & 0xFF,
+           (unsigned)(mac >> 24) & 0xFF, (unsigned)(mac >> 16) & 0xFF,
+           (unsigned)(mac >> 8) & 0xFF, (unsigned)mac & 0xFF);
+  return buf;
+}
+
+// ------------------------------------------------------------------
+// MacList
+// ------------------------------------------------------------------
+
+bool MacList::add(uint64_t mac, const std::string &label) {
+  if (contains(mac))
+    return false;
+  std::string clean = sanitize_label(label);
+  size_t bytes = BLOB_ENTRY_SIZE + clean.size();
+  if (blob_size_ + bytes > MAX_BLOB_BYTES) {
+    ESP_LOGW(TAG, "List full (%u entries, %u bytes), %s not added",
+             (unsigned)entries_.size(), (unsigned)blob_size_,
+             BlePersistentListsComponent::format_mac(mac).c_str());
     return false;
-  std::istringstream iss(list_csv);
-  std::string item;
-  while (std::getline(iss, item, ',')) {
-    if (normalize_mac(entry_mac_only(item)) == n)
-      return true;
   }
-  return false;
+  index_[mac] = entries_.size();
+  entries_.push_back({mac, clean});
+  blob_size_ += bytes;
+  return true;
 }
 
-void BlePersistentListsComponent::list_add(std::string &list_csv,
-                                           const std::string &mac,
-                                           const std::string &suffix) {
-  std::string n = normalize_mac(mac);
-  if (n.empty())
-    return;
-  if (list_contains(list_csv, n))
-    return;
-  std::string entry = n;
-  if (!suffix.empty()) {
-    entry += '|';
-    for (char c : suffix) {
-      if (c != ',' && c != '|')
-        entry += c;
+bool MacList::remove(uint64_t mac) {
+  auto it = index_.find(mac);
+  if (it == index_.end())
+    return false;
+  blob_size_ -= BLOB_ENTRY_SIZE + entries_[it->second].label.size();
+  entries_.erase(entries_.begin() + it->second);
+  reindex();
+  return true;
+}
+
+bool MacList::set_label(uint64_t mac, const std::string &label) {
+  auto it = index_.find(mac);
+  if (it == index_.end())
+    return false;
+  std::string clean = sanitize_label(label);
+  std::string &old = entries_[it->second].label;
+  if (blob_size_ - old.size() + clean.size() > MAX_BLOB_BYTES)
+    return false;
+  blob_size_ = blob_size_ - old.size() + clean.size();
+  old = clean;
+  return true;
+}
+
+void MacList::clear() {
+  entries_.clear();
+  index_.clear();
+  blob_size_ = BLOB_HEADER_SIZE;
+}
+
+const MacListEntry *MacList::at(int index_0based) const {
+  if (index_0based < 0 || (size_t)index_0based >= entries_.size())
+    return nullptr;
+  return &entries_[entries_.size() - 1 - index_0based];
+}
+
+void MacList::reindex() {
+  index_.clear();
+  for (size_t i = 0; i < entries_.size(); i++)
+    index_[entries_[i].mac] = i;
+}
+
+std::string MacList::to_csv() const {
+  std::string out;
+  for (size_t i = 0; i < entries_.size(); i++) {
+    const MacListEntry &e = *at(i);
+    if (i)
+      out += ',';
+    out += BlePersistentListsComponent::format_mac(e.mac);
+    if (!e.label.empty()) {
+      out += '|';
+      out += e.label;
     }
   }
-  list_csv = entry + (list_csv.empty() ? "" : "," + list_csv);
-  if (list_csv.size() > MAX_LIST_BYTES)
-    list_csv.resize(MAX_LIST_BYTES);
+  return out;
 }
 
-void BlePersistentListsComponent::list_remove(std::string &list_csv,
-                                              const std::string &mac) {
-  std::string n = normalize_mac(mac);
-  if (n.empty())
-    return;
-  std::string new_list;
-  std::istringstream iss(list_csv);
+void MacList::from_csv(const std::string &csv) {
+  clear();
+  // CSV is newest first; add oldest first so positions are preserved.
+  std::vector<std::string> items;
+  std::istringstream iss(csv);
   std::string item;
-  bool first = true;
-  while (std::getline(iss, item, ',')) {
-    if (normalize_mac(entry_mac_only(item)) == n)
-      continue;
-    if (!first)
-      new_list += ',';
-    new_list += item;
-    first = false;
+  while (std::getline(iss, item, ','))
+    items.push_back(item);
+  for (auto it = items.rbegin(); it != items.rend(); ++it) {
+    size_t p = it->find('|');
+    std::string mac_part = p == std::string::npos ? *it : it->substr(0, p);
+    uint64_t mac;
+    if (BlePersistentListsComponent::parse_mac(mac_part, mac))
+      add(mac, p == std::string::npos ? "" : it->substr(p + 1));
   }
-  list_csv = new_list;
 }
 
-void BlePersistentListsComponent::list_set_suffix(std::string &list_csv,
-                                                  const std::string &mac,
-                                                  const std::string &suffix) {
-  std::string n = normalize_mac(mac);
-  if (n.empty())
-    return;
-  std::string new_list;
-  std::istringstream iss(list_csv);
-  std::string item;
-  bool first = true;
-  while (std::getline(iss, item, ',')) {
-    if (normalize_mac(entry_mac_only(item)) == n) {
-      if (!first)
-        new_list += ',';
-      new_list += n;
-      if (!suffix.empty()) {
-        new_list += '|';
-        for (char c : suffix) {
-          if (c != ',' && c != '|')
-            new_list += c;
-        }
-      }
-      first = false;
-      continue;
-    }
-    if (!first)
-      new_list += ',';
-    new_list += item;
-    first = false;
+std::vector<uint8_t> MacList::to_blob() const {
+  std::vector<uint8_t> out;
+  out.reserve(blob_size_);
+  uint32_t n = entries_.size();
+  out.insert(out.end(), {'M', 'L', BLOB_VERSION, 0, (uint8_t)n,
+                         (uint8_t)(n >> 8), (uint8_t)(n >> 16),
+                         (uint8_t)(n >> 24)});
+  for (const MacListEntry &e : entries_) {
+    for (int b = 5; b >= 0; b--)
+      out.push_back((uint8_t)(e.mac >> (8 * b)));
+    out.push_back((uint8_t)e.label.size());
+    out.insert(out.end(), e.label.begin(), e.label.end());
   }
-  list_csv = new_list;
+  return out;
 }
 
-void BlePersistentListsComponent::load_all() {
+bool MacList::from_blob(const std::vector<uint8_t> &blob) {
+  clear();
+  if (blob.size() < BLOB_HEADER_SIZE || blob[0] != 'M' || blob[1] != 'L' ||
+      blob[2] != BLOB_VERSION)
+    return false;
+  uint32_t n = blob[4] | (blob[5] << 8) | (blob[6] << 16) |
+               ((uint32_t)blob[7] << 24);
+  size_t pos = BLOB_HEADER_SIZE;
+  uint32_t dropped = 0;
+  entries_.reserve(n);
+  for (uint32_t i = 0; i < n; i++) {
+    if (pos + 7 > blob.size())
+      return false;
+    uint64_t mac = 0;
+    for (int b = 0; b < 6; b++)
+      mac = (mac << 8) | blob[pos + b];
+    uint8_t len = blob[pos + 6];
+    pos += 7;
+    if (pos + len > blob.size())
+      return false;
+    // A duplicate, or an entry past MAX_BLOB_BYTES (a blob written with a
+    // larger budget): the rest of the list is still loaded
+    dropped += !add(mac, std::string((const char *)&blob[pos], len));
+    pos += len;
+  }
+  if (dropped > 0)
+    ESP_LOGW(TAG, "%u of %u blob entries dropped", (unsigned)dropped,
+             (unsigned)n);
+  return dropped == 0;
+}
+
+// ------------------------------------------------------------------
+// NVS persistence
+// ------------------------------------------------------------------
+
+void BlePersistentListsComponent::load_list(const char *blob_key,
+                                            const char *csv_key,
+                                            MacList &list) {
   nvs_handle_t h;
-  if (nvs_open(NVS_NS, NVS_READONLY, &h) != ESP_OK) {
+  if (nvs_open(NVS_NS, NVS_READWRITE, &h) != ESP_OK) {
     ESP_LOGD(TAG, "NVS open read failed");
     return;
   }
   size_t len = 0;
-  if (nvs_get_str(h, KEY_WL, nullptr, &len) == ESP_OK && len > 0) {
-    std::vector<char> buf(len);
-    if (nvs_get_str(h, KEY_WL, buf.data(), &len) == ESP_OK)
-      whitelist_.assign(buf.data());
+  if (nvs_get_blob(h, blob_key, nullptr, &len) == ESP_OK && len > 0) {
+    std::vector<uint8_t> buf(len);
+    if (nvs_get_blob(h, blob_key, buf.data(), &len) == ESP_OK &&
+        !list.from_blob(buf))
+      ESP_LOGW(TAG, "NVS blob %s incomplete, %u entries loaded", blob_key,
+               (unsigned)list.size());
+    nvs_close(h);
+    return;
   }
+  // Migration from the legacy CSV string
   len = 0;
-  if (nvs_get_str(h, KEY_BL, nullptr, &len) == ESP_OK && len > 0) {
+  if (nvs_get_str(h, csv_key, nullptr, &len) == ESP_OK && len > 0) {
     std::vector<char> buf(len);
-    if (nvs_get_str(h, KEY_BL, buf.data(), &len) == ESP_OK)
-      blacklist_.assign(buf.data());
+    if (nvs_get_str(h, csv_key, buf.data(), &len) == ESP_OK) {
+      list.from_csv(buf.data());
+      std::vector<uint8_t> blob = list.to_blob();
+      if (nvs_set_blob(h, blob_key, blob.data(), blob.size()) == ESP_OK &&
+          nvs_erase_key(h, csv_key) == ESP_OK && nvs_commit(h) == ESP_OK)
+        ESP_LOGI(TAG, "Migrated %s (%u entries) to binary format", csv_key,
+                 (unsigned)list.size());
+    }
   }
   nvs_close(h);
-  ESP_LOGD(TAG, "Loaded whitelist %u bytes, blacklist %u bytes",
-           (unsigned)whitelist_.size(), (unsigned)blacklist_.size());
-  unsigned n_wl = 0;
-  for (char c : whitelist_)
-    if (c == ',')
-      n_wl++;
-  if (!whitelist_.empty())
-    n_wl++;
-  ESP_LOGI(TAG,
-           "Whitelist chargee: %u MAC(s) (NVS conservee au flash, ne pas "
-           "effacer la flash)",
-           n_wl);
 }
 
-void BlePersistentListsComponent::save_whitelist() {
+bool BlePersistentListsComponent::save_list(const char *blob_key,
+                                            const MacList &list) {
   nvs_handle_t h;
   if (nvs_open(NVS_NS, NVS_READWRITE, &h) != ESP_OK) {
-    ESP_LOGD(TAG, "NVS open write failed");
-    return;
+    ESP_LOGW(TAG, "NVS open write failed");
+    return false;
   }
-  esp_err_t err = nvs_set_str(h, KEY_WL, whitelist_.c_str());
+  std::vector<uint8_t> blob = list.to_blob();
+  esp_err_t err = nvs_set_blob(h, blob_key, blob.data(), blob.size());
   if (err == ESP_OK)
-    nvs_commit(h);
+    err = nvs_commit(h);
+  if (err != ESP_OK)
+    ESP_LOGW(TAG, "NVS write of %s failed (%u bytes): %d", blob_key,
+             (unsigned)blob.size(), err);
   nvs_close(h);
+  return err == ESP_OK;
 }
 
-void BlePersistentListsComponent::save_blacklist() {
-  nvs_handle_t h;
-  if (nvs_open(NVS_NS, NVS_READWRITE, &h) != ESP_OK) {
-    ESP_LOGD(TAG, "NVS open write failed");
-    return;
-  }
-  esp_err_t err = nvs_set_str(h, KEY_BL, blacklist_.c_str());
-  if (err == ESP_OK)
-    nvs_commit(h);
-  nvs_close(h);
+void BlePersistentListsComponent::load_all() {
+  load_list(KEY_WL_BLOB, KEY_WL, whitelist_);
+  load_list(KEY_BL_BLOB, KEY_BL, blacklist_);
+  ESP_LOGI(TAG,
+           "Whitelist chargee: %u MAC(s), blacklist: %u MAC(s) (NVS conservee "
+           "au flash, ne pas effacer la flash)",
+           (unsigned)whitelist_.size(), (unsigned)blacklist_.size());
+}
+
+bool BlePersistentListsComponent::save_whitelist() {
+  return save_list(KEY_WL_BLOB, whitelist_);
+}
+
+bool BlePersistentListsComponent::save_blacklist() {
+  return save_list(KEY_BL_BLOB, blacklist_);
 }
 
 void BlePersistentListsComponent::setup() { load_all(); }
 
+// ------------------------------------------------------------------
+// Whitelist / blacklist API
+// ------------------------------------------------------------------
+
 bool BlePersistentListsComponent::is_in_whitelist(const std::string &mac) {
-  return list_contains(whitelist_, mac);
+  uint64_t m;
+  return parse_mac(mac, m) && whitelist_.contains(m);
 }
 
 std::string BlePersistentListsComponent::get_whitelist_display() const {
   std::string out;
-  std::istringstream iss(whitelist_);
-  std::string item;
-  while (std::getline(iss, item, ',')) {
-    if (item.empty())
-      continue;
+  for (size_t i = 0; i < whitelist_.size(); i++) {
     if (!out.empty())
       out += '\n';
-    size_t p = item.find('|');
-    if (p == std::string::npos) {
-      out += item;
-    } else {
-      out += item.substr(0, p);
-      out += " | ";
-      out += item.substr(p + 1);
-    }
+    out += get_whitelist_line(i);
   }
   return out.empty() ? "-" : out;
 }
 
 std::string
 BlePersistentListsComponent::get_whitelist_line(int index_0based) const {
-  if (index_0based < 0)
+  const MacListEntry *e = whitelist_.at(index_0based);
+  if (e == nullptr)
     return "";
-  std::istringstream iss(whitelist_);
-  std::string item;
-  int idx = 0;
-  while (std::getline(iss, item, ',')) {
-    if (item.empty())
-      continue;
-    if (idx == index_0based) {
-      size_t p = item.find('|');
-      if (p == std::string::npos)
-        return item;
-      return item.substr(0, p) + " | " + item.substr(p + 1);
-    }
-    idx++;
-  }
-  return "";
+  std::string line = format_mac(e->mac);
+  if (!e->label.empty())
+    line += " | " + e->label;
+  return line;
 }
 
 std::string
 BlePersistentListsComponent::get_whitelist_mac(int index_0based) const {
-  if (index_0based < 0)
-    return "";
-  std::istringstream iss(whitelist_);
-  std::string item;
-  int idx = 0;
-  while (std::getline(iss, item, ',')) {
-    if (item.empty())
-      continue;
-    if (idx == index_0based)
-      return entry_mac_only(item);
-    idx++;
-  }
-  return "";
+  const MacListEntry *e = whitelist_.at(index_0based);
+  return e == nullptr ? "" : format_mac(e->mac);
 }
 
 std::string
 BlePersistentListsComponent::get_whitelist_label(int index_0based) const {
-  if (index_0based < 0)
-    return "";
-  std::istringstream iss(whitelist_);
-  std::string item;
-  int idx = 0;
-  while (std::getline(iss, item, ',')) {
-    if (item.empty())
-      continue;
-    if (idx == index_0based) {
-      size_t p = item.find('|');
-      if (p == std::string::npos)
-        return "";
-      return item.substr(p + 1);
-    }
-    idx++;
-  }
-  return "";
+  const MacListEntry *e = whitelist_.at(index_0based);
+  return e == nullptr ? "" : e->label;
 }
 
-void BlePersistentListsComponent::add_to_whitelist(const std::string &mac,
+bool BlePersistentListsComponent::add_to_whitelist(const std::string &mac,
                                                    const std::string &label) {
-  list_add(whitelist_, mac, label);
-  save_whitelist();
+  uint64_t m;
+  if (!parse_mac(mac, m) || !whitelist_.add(m, label))
+    return false;
+  if (save_whitelist())
+    return true;
+  whitelist_.remove(m);
+  return false;
 }
 
-void BlePersistentListsComponent::remove_from_whitelist(
+bool BlePersistentListsComponent::remove_from_whitelist(
     const std::string &mac) {
-  list_remove(whitelist_, mac);
-  save_whitelist();
+  uint64_t m;
+  MacList before = whitelist_;
+  if (!parse_mac(mac, m) || !whitelist_.remove(m))
+    return false;
+  if (save_whitelist())
+    return true;
+  whitelist_ = before;
+  return false;
 }
 
-void BlePersistentListsComponent::clear_whitelist() {
+bool BlePersistentListsComponent::clear_whitelist() {
+  MacList before = whitelist_;
   whitelist_.clear();
-  save_whitelist();
+  if (save_whitelist())
+    return true;
+  whitelist_ = before;
+  return false;
 }
 
-void BlePersistentListsComponent::set_whitelist_label(
+bool BlePersistentListsComponent::set_whitelist_label(
     const std::string &mac, const std::string &label) {
-  list_set_suffix(whitelist_, mac, label);
-  save_whitelist();
+  uint64_t m;
+  MacList before = whitelist_;
+  if (!parse_mac(mac, m) || !whitelist_.set_label(m, label))
+    return false;
+  if (save_whitelist())
+    return true;
+  whitelist_ = before;
+  return false;
 }
 
 bool BlePersistentListsComponent::is_in_blacklist(const std::string &mac) {
-  return list_contains(blacklist_, mac);
+  uint64_t m;
+  return parse_mac(mac, m) && blacklist_.contains(m);
 }
 
-void BlePersistentListsComponent::add_to_blacklist(const std::string &mac,
+bool BlePersistentListsComponent::add_to_blacklist(const std::string &mac,
                                                    const std::string &info) {
-  list_add(blacklist_, mac, info);
-  save_blacklist();
+  uint64_t m;
+  if (!parse_mac(mac, m) || !blacklist_.add(m, info))
+    return false;
+  if (save_blacklist())
+    return true;
+  blacklist_.remove(m);
+  return false;
 }
 
-void BlePersistentListsComponent::remove_from_blacklist(
+bool BlePersistentListsComponent::remove_from_blacklist(
     const std::string &mac) {
-  list_remove(blacklist_, mac);
-  save_blacklist();
+  uint64_t m;
+  MacList before = blacklist_;
+  if (!parse_mac(mac, m) || !blacklist_.remove(m))
+    return false;
+  if (save_blacklist())
+    return true;
+  blacklist_ = before;
+  return false;
 }
 
 } // namespace ble_persistent_lists
@@ -1,12 +1,59 @@
 #pragma once
 
 #include "esphome/core/component.h"
+#include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace esphome {
 namespace ble_persistent_lists {
 
-static const size_t MAX_LIST_BYTES = 3800;
+// Bytes of NVS one list may take as a blob. The default 20 KB partition
+// holds ~16 KB of values, NVS writes a new blob before erasing the old
+// one, and ESPHome keeps its own preferences there too: 4000 bytes per
+// list leaves room for both lists plus one rewrite. That is ~570 bare
+// MACs, or ~55 with 64-character labels; longer lists need another store
+// (LittleFS) rather than a larger cap.
+static const size_t MAX_BLOB_BYTES = 4000;
+static const size_t MAX_LABEL_LEN = 64;
+
+static const size_t BLOB_HEADER_SIZE = 8;
+static const size_t BLOB_ENTRY_SIZE = 7; // + label bytes
+
+struct MacListEntry {
+  uint64_t mac; // 48-bit, "AA:BB:CC:DD:EE:FF" == 0xAABBCCDDEEFF
+  std::string label;
+};
+
+// Ordered MAC list with O(1) membership and O(1) access by position.
+// Entries are stored oldest first; position 0 is the most recently added,
+// as in the former CSV where new entries were prepended. add() and
+// set_label() refuse what would make the blob exceed MAX_BLOB_BYTES.
+// from_blob() keeps what it can read and returns false if the blob is
+// damaged or an entry was dropped (duplicate, over the budget).
+class MacList {
+public:
+  bool contains(uint64_t mac) const { return index_.count(mac) != 0; }
+  bool add(uint64_t mac, const std::string &label);
+  bool remove(uint64_t mac);
+  bool set_label(uint64_t mac, const std::string &label);
+  void clear();
+  size_t size() const { return entries_.size(); }
+  size_t blob_size() const { return blob_size_; }
+  const MacListEntry *at(int index_0based) const;
+
+  std::string to_csv() const;
+  void from_csv(const std::string &csv);
+  std::vector<uint8_t> to_blob() const;
+  bool from_blob(const std::vector<uint8_t> &blob);
+
+private:
+  void reindex();
+  std::vector<MacListEntry> entries_;
+  std::unordered_map<uint64_t, size_t> index_;
+  size_t blob_size_ = BLOB_HEADER_SIZE;
+};
 
 class BlePersistentListsComponent : public Component {
 public:
@@ -14,11 +61,14 @@ public:
   float get_setup_priority() const override { return setup_priority::DATA; }
 
   bool is_in_whitelist(const std::string &mac);
-  void add_to_whitelist(const std::string &mac, const std::string &label = "");
-  void remove_from_whitelist(const std::string &mac);
-  void clear_whitelist();
-  void set_whitelist_label(const std::string &mac, const std::string &label);
-  std::string get_whitelist_str() const { return whitelist_; }
+  // Changes return false when nothing changed: invalid MAC, already (or
+  // not) listed, list full, or the NVS write failed (the list is then
+  // left as it was, so RAM never claims more than flash holds).
+  bool add_to_whitelist(const std::string &mac, const std::string &label = "");
+  bool remove_from_whitelist(const std::string &mac);
+  bool clear_whitelist();
+  bool set_whitelist_label(const std::string &mac, const std::string &label);
+  std::string get_whitelist_str() const { return whitelist_.to_csv(); }
   std::string get_whitelist_display() const;
   std::string get_whitelist_line(int index_0based) const;
   std::string get_whitelist_mac(int index_0based) const;
@@ -32,26 +82,25 @@ public:
   std::string get_recent_mac(int index_0based) const;
 
   bool is_in_blacklist(const std::string &mac);
-  void add_to_blacklist(const std::string &mac, const std::string &info = "");
-  void remove_from_blacklist(const std::string &mac);
-  std::string get_blacklist_str() const { return blacklist_; }
+  bool add_to_blacklist(const std::string &mac, const std::string &info = "");
+  bool remove_from_blacklist(const std::string &mac);
+  std::string get_blacklist_str() const { return blacklist_.to_csv(); }
+
+  static bool parse_mac(const std::string &mac, uint64_t &out);
+  static std::string format_mac(uint64_t mac);
 
 private:
   void load_all();
-  void save_whitelist();
-  void save_blacklist();
+  static void load_list(const char *blob_key, const char *csv_key,
+                        MacList &list);
+  static bool save_list(const char *blob_key, const MacList &list);
+  bool save_whitelist();
+  bool save_blacklist();
   static std::string normalize_mac(const std::string &mac);
   static std::string entry_mac_only(const std::string &entry);
-  static bool list_contains(const std::string &list_csv,
-                            const std::string &mac);
-  static void list_add(std::string &list_csv, const std::string &mac,
-                       const std::string &suffix = "");
-  static void list_remove(std::string &list_csv, const std::string &mac);
-  static void list_set_suffix(std::string &list_csv, const std::string &mac,
-                              const std::string &suffix);
-
-  std::string whitelist_;
-  std::string blacklist_;
+
+  MacList whitelist_;
+  MacList blacklist_;
   std::vector<std::string>
       recent_macs_; // Stocke les MACs recemment vues (tampon non persistant)
 };